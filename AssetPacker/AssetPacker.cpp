@@ -0,0 +1,213 @@
+// Offline packer: directories of loose assets -> one .pak archive read by PakArchive
+#include "PakCodec.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace fs = std::filesystem;
+
+struct InputFile {
+	std::string name;
+	fs::path path;
+};
+
+static void
+printUsage()
+{
+	std::cout << "usage: AssetPacker <output.pak> <directory>... [--codec=stored|lz4|zstd] [--ext=.spv] [--chunk-kb=N]" << std::endl;
+	std::cout << "       entries are named <directory name>/<relative path>, e.g. shaders/vert.spv" << std::endl;
+}
+
+static PakCodec
+parseCodec(const std::string& name)
+{
+	if (name == "stored") return PakCodec::Stored;
+	if (name == "lz4") return PakCodec::LZ4;
+	if (name == "zstd") return PakCodec::Zstd;
+	throw std::invalid_argument("unknown codec " + name);
+}
+
+static std::vector<uint8_t>
+readFile(const fs::path& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path.string());
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	return data;
+}
+
+static void
+alignStream(std::ofstream& file, size_t alignment)
+{
+	static const char padding[16] = {};
+	size_t position = static_cast<size_t>(file.tellp());
+	file.write(padding, (alignment - position % alignment) % alignment);
+}
+
+int main(int argc, char** argv)
+{
+	std::string output;
+	std::vector<fs::path> directories;
+	std::vector<std::string> extensions;
+	PakCodec codec = PakCodec::Stored;
+	uint32_t chunkSize = PAK_DEFAULT_CHUNK_SIZE;
+
+	// Prefer the fastest decoder that is built in
+	if (isPakCodecAvailable(PakCodec::LZ4))
+		codec = PakCodec::LZ4;
+	else if (isPakCodecAvailable(PakCodec::Zstd))
+		codec = PakCodec::Zstd;
+
+	try {
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg.compare(0, 8, "--codec=") == 0)
+				codec = parseCodec(arg.substr(8));
+			else if (arg.compare(0, 6, "--ext=") == 0)
+				extensions.push_back(arg.substr(6));
+			else if (arg.compare(0, 11, "--chunk-kb=") == 0)
+				chunkSize = static_cast<uint32_t>(std::stoul(arg.substr(11))) * 1024;
+			else if (output.empty())
+				output = arg;
+			else
+				directories.push_back(arg);
+		}
+
+		if (output.empty() || directories.empty() || chunkSize == 0)
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+
+		if (!isPakCodecAvailable(codec))
+			throw std::invalid_argument(std::string("codec not available in this build: ") + pakCodecName(codec));
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<InputFile> inputs;
+		for (const fs::path& directory : directories)
+		{
+			fs::path root = fs::absolute(directory).lexically_normal();
+			if (!root.has_filename())
+				root = root.parent_path();
+
+			for (const auto& item : fs::recursive_directory_iterator(root))
+			{
+				if (!item.is_regular_file())
+					continue;
+
+				std::string extension = item.path().extension().string();
+				if (!extensions.empty() && std::find(extensions.begin(), extensions.end(), extension) == extensions.end())
+					continue;
+
+				std::string name = (root.filename() / fs::relative(item.path(), root)).generic_string();
+				inputs.push_back({ name, item.path() });
+			}
+		}
+
+		// PakArchive::find does a binary search over the TOC
+		std::sort(inputs.begin(), inputs.end(), [](const InputFile& a, const InputFile& b) { return a.name < b.name; });
+
+		std::ofstream file(output, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			throw std::runtime_error("failed to open " + output + " for writing");
+
+		PakHeader header{};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		std::vector<PakEntry> entries;
+		std::vector<PakChunk> chunks;
+		std::string strings;
+		std::vector<uint8_t> compressed;
+		uint64_t totalBytes = 0;
+
+		for (const InputFile& input : inputs)
+		{
+			std::vector<uint8_t> data = readFile(input.path);
+
+			PakEntry entry{};
+			entry.nameOffset = static_cast<uint32_t>(strings.size());
+			entry.nameLength = static_cast<uint32_t>(input.name.size());
+			entry.size = data.size();
+			entry.firstChunk = static_cast<uint32_t>(chunks.size());
+			strings += input.name;
+
+			for (size_t offset = 0; offset < data.size(); offset += chunkSize)
+			{
+				size_t size = std::min<size_t>(chunkSize, data.size() - offset);
+
+				PakChunk chunk{};
+				chunk.offset = static_cast<uint64_t>(file.tellp());
+
+				if (compressPakChunk(codec, data.data() + offset, size, compressed))
+				{
+					chunk.codec = codec;
+					chunk.compressedSize = static_cast<uint32_t>(compressed.size());
+					file.write(reinterpret_cast<const char*>(compressed.data()), compressed.size());
+				}
+				else
+				{
+					chunk.codec = PakCodec::Stored;
+					chunk.compressedSize = static_cast<uint32_t>(size);
+					file.write(reinterpret_cast<const char*>(data.data() + offset), size);
+				}
+
+				chunks.push_back(chunk);
+				entry.chunkCount++;
+			}
+
+			totalBytes += data.size();
+			entries.push_back(entry);
+		}
+
+		alignStream(file, 16);
+		header.chunkTableOffset = static_cast<uint64_t>(file.tellp());
+		file.write(reinterpret_cast<const char*>(chunks.data()), chunks.size() * sizeof(PakChunk));
+
+		alignStream(file, 16);
+		header.tocOffset = static_cast<uint64_t>(file.tellp());
+		file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PakEntry));
+
+		header.stringTableOffset = static_cast<uint64_t>(file.tellp());
+		header.stringTableSize = strings.size();
+		file.write(strings.data(), strings.size());
+
+		uint64_t archiveBytes = static_cast<uint64_t>(file.tellp());
+
+		header.magic = PAK_FILE_MAGIC;
+		header.version = PAK_FILE_VERSION;
+		header.entryCount = static_cast<uint32_t>(entries.size());
+		header.chunkCount = static_cast<uint32_t>(chunks.size());
+		header.chunkSize = chunkSize;
+
+		file.seekp(0);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		if (!file)
+			throw std::runtime_error("failed to write " + output);
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "[INFO] - " << output << ": " << entries.size() << " entries, " << chunks.size() << " chunks, "
+			<< totalBytes << " -> " << archiveBytes << " bytes (" << pakCodecName(codec) << ", " << elapsed << " ms)" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,455 @@
+#include "MeshImport.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// Just enough JSON for glTF: objects, arrays, strings, numbers, booleans and null
+struct Json {
+	enum class Type { Null, Bool, Number, String, Array, Object } type = Type::Null;
+	double number = 0.0;
+	bool boolean = false;
+	std::string string;
+	std::vector<Json> array;
+	std::map<std::string, Json> object;
+
+	const Json* find(const std::string& key) const
+	{
+		auto it = this->object.find(key);
+		return it == this->object.end() ? nullptr : &it->second;
+	}
+
+	const Json& operator[](const std::string& key) const
+	{
+		const Json* value = this->find(key);
+		if (!value)
+			throw std::runtime_error("glTF: missing property \"" + key + "\"");
+		return *value;
+	}
+
+	const Json& operator[](size_t index) const
+	{
+		if (index >= this->array.size())
+			throw std::runtime_error("glTF: index out of range");
+		return this->array[index];
+	}
+
+	size_t asIndex() const { return static_cast<size_t>(this->number); }
+};
+
+class JsonParser {
+public:
+	JsonParser(const char* begin, const char* end) : cursor(begin), end(end) {}
+
+	Json parse()
+	{
+		Json value = this->parseValue();
+		this->skipWhitespace();
+		return value;
+	}
+
+private:
+	void skipWhitespace()
+	{
+		while (this->cursor < this->end && (*this->cursor == ' ' || *this->cursor == '\t' || *this->cursor == '\n' || *this->cursor == '\r'))
+			this->cursor++;
+	}
+
+	char peek()
+	{
+		this->skipWhitespace();
+		if (this->cursor >= this->end)
+			throw std::runtime_error("glTF: unexpected end of JSON");
+		return *this->cursor;
+	}
+
+	void expect(char c)
+	{
+		if (this->peek() != c)
+			throw std::runtime_error(std::string("glTF: expected '") + c + "' in JSON");
+		this->cursor++;
+	}
+
+	bool consumeLiteral(const char* literal)
+	{
+		size_t length = std::strlen(literal);
+		if (static_cast<size_t>(this->end - this->cursor) >= length && std::strncmp(this->cursor, literal, length) == 0)
+		{
+			this->cursor += length;
+			return true;
+		}
+		return false;
+	}
+
+	Json parseValue()
+	{
+		Json value;
+		char c = this->peek();
+
+		if (c == '{')
+		{
+			value.type = Json::Type::Object;
+			this->cursor++;
+			if (this->peek() == '}') { this->cursor++; return value; }
+			do {
+				std::string key = this->parseString();
+				this->expect(':');
+				value.object[key] = this->parseValue();
+			} while (this->peek() == ',' && this->cursor++);
+			this->expect('}');
+		}
+		else if (c == '[')
+		{
+			value.type = Json::Type::Array;
+			this->cursor++;
+			if (this->peek() == ']') { this->cursor++; return value; }
+			do {
+				value.array.push_back(this->parseValue());
+			} while (this->peek() == ',' && this->cursor++);
+			this->expect(']');
+		}
+		else if (c == '"')
+		{
+			value.type = Json::Type::String;
+			value.string = this->parseString();
+		}
+		else if (this->consumeLiteral("true"))
+		{
+			value.type = Json::Type::Bool;
+			value.boolean = true;
+		}
+		else if (this->consumeLiteral("false"))
+		{
+			value.type = Json::Type::Bool;
+		}
+		else if (this->consumeLiteral("null"))
+		{
+			value.type = Json::Type::Null;
+		}
+		else
+		{
+			value.type = Json::Type::Number;
+			std::string text;
+			while (this->cursor < this->end && std::strchr("+-0123456789.eE", *this->cursor))
+				text += *this->cursor++;
+			if (text.empty())
+				throw std::runtime_error("glTF: invalid JSON value");
+			value.number = std::stod(text);
+		}
+
+		return value;
+	}
+
+	std::string parseString()
+	{
+		this->expect('"');
+		std::string result;
+
+		while (this->cursor < this->end && *this->cursor != '"')
+		{
+			char c = *this->cursor++;
+			if (c == '\\' && this->cursor < this->end)
+			{
+				char escaped = *this->cursor++;
+				switch (escaped)
+				{
+				case 'n': result += '\n'; break;
+				case 't': result += '\t'; break;
+				case 'r': result += '\r'; break;
+				case 'b': result += '\b'; break;
+				case 'f': result += '\f'; break;
+				// Non-ASCII escapes never show up in the parts of glTF we read
+				case 'u': this->cursor = std::min(this->cursor + 4, this->end); result += '?'; break;
+				default: result += escaped; break;
+				}
+			}
+			else
+			{
+				result += c;
+			}
+		}
+
+		this->expect('"');
+		return result;
+	}
+
+	const char* cursor;
+	const char* end;
+};
+
+std::vector<uint8_t>
+readFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path);
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	return data;
+}
+
+std::vector<uint8_t>
+decodeBase64(const std::string& text)
+{
+	static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	std::vector<uint8_t> result;
+	uint32_t bits = 0;
+	int bitCount = 0;
+
+	for (char c : text)
+	{
+		size_t value = alphabet.find(c);
+		if (value == std::string::npos)
+			continue;
+
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		bitCount += 6;
+
+		if (bitCount >= 8)
+		{
+			bitCount -= 8;
+			result.push_back(static_cast<uint8_t>(bits >> bitCount));
+		}
+	}
+
+	return result;
+}
+
+std::string
+directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+struct GltfDocument {
+	Json json;
+	std::vector<std::vector<uint8_t>> buffers;
+};
+
+// Reads accessor element i, component c as float, handling the normalized integer encodings glTF allows
+class AccessorReader {
+public:
+	AccessorReader(const GltfDocument& document, size_t accessorIndex)
+	{
+		const Json& accessor = document.json["accessors"][accessorIndex];
+
+		if (!accessor.find("bufferView"))
+			throw std::runtime_error("glTF: sparse / empty accessors are not supported");
+
+		const Json& view = document.json["bufferViews"][accessor["bufferView"].asIndex()];
+		const std::vector<uint8_t>& buffer = document.buffers.at(view["buffer"].asIndex());
+
+		this->componentType = static_cast<uint32_t>(accessor["componentType"].number);
+		this->count = accessor["count"].asIndex();
+		this->normalized = accessor.find("normalized") && accessor["normalized"].boolean;
+
+		const std::string& type = accessor["type"].string;
+		this->components = type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : type == "VEC4" ? 4 : 0;
+		if (this->components == 0)
+			throw std::runtime_error("glTF: unsupported accessor type " + type);
+
+		size_t componentSize = this->componentType == 5126 || this->componentType == 5125 ? 4 :
+			this->componentType == 5123 || this->componentType == 5122 ? 2 : 1;
+
+		size_t viewOffset = view.find("byteOffset") ? view["byteOffset"].asIndex() : 0;
+		size_t accessorOffset = accessor.find("byteOffset") ? accessor["byteOffset"].asIndex() : 0;
+		this->stride = view.find("byteStride") ? view["byteStride"].asIndex() : componentSize * this->components;
+		this->componentSize = componentSize;
+
+		size_t offset = viewOffset + accessorOffset;
+		size_t lastByte = this->count == 0 ? offset : offset + (this->count - 1) * this->stride + componentSize * this->components;
+		if (lastByte > buffer.size())
+			throw std::runtime_error("glTF: accessor out of buffer range");
+
+		this->data = buffer.data() + offset;
+	}
+
+	float read(size_t index, uint32_t component) const
+	{
+		const uint8_t* p = this->data + index * this->stride + component * this->componentSize;
+
+		switch (this->componentType)
+		{
+		case 5126: { float v; std::memcpy(&v, p, 4); return v; }
+		case 5125: { uint32_t v; std::memcpy(&v, p, 4); return static_cast<float>(v); }
+		case 5123: { uint16_t v; std::memcpy(&v, p, 2); return this->normalized ? v / 65535.0f : v; }
+		case 5122: { int16_t v; std::memcpy(&v, p, 2); return this->normalized ? std::max(v / 32767.0f, -1.0f) : v; }
+		case 5121: { uint8_t v = *p; return this->normalized ? v / 255.0f : v; }
+		case 5120: { int8_t v = static_cast<int8_t>(*p); return this->normalized ? std::max(v / 127.0f, -1.0f) : v; }
+		default: throw std::runtime_error("glTF: unsupported component type");
+		}
+	}
+
+	uint32_t readIndex(size_t index) const
+	{
+		const uint8_t* p = this->data + index * this->stride;
+
+		switch (this->componentType)
+		{
+		case 5125: { uint32_t v; std::memcpy(&v, p, 4); return v; }
+		case 5123: { uint16_t v; std::memcpy(&v, p, 2); return v; }
+		case 5121: return *p;
+		default: throw std::runtime_error("glTF: invalid index component type");
+		}
+	}
+
+	size_t count = 0;
+	uint32_t components = 0;
+
+private:
+	const uint8_t* data = nullptr;
+	size_t stride = 0;
+	size_t componentSize = 0;
+	uint32_t componentType = 0;
+	bool normalized = false;
+};
+
+GltfDocument
+loadDocument(const std::string& path)
+{
+	std::vector<uint8_t> file = readFile(path);
+	GltfDocument document;
+	std::vector<uint8_t> binaryChunk;
+
+	const char* jsonBegin = reinterpret_cast<const char*>(file.data());
+	const char* jsonEnd = jsonBegin + file.size();
+
+	// .glb: 12 byte header, then a JSON chunk and an optional BIN chunk
+	if (file.size() >= 12 && std::memcmp(file.data(), "glTF", 4) == 0)
+	{
+		size_t offset = 12;
+		jsonBegin = jsonEnd = nullptr;
+
+		while (offset + 8 <= file.size())
+		{
+			uint32_t chunkLength, chunkType;
+			std::memcpy(&chunkLength, &file[offset], 4);
+			std::memcpy(&chunkType, &file[offset + 4], 4);
+			offset += 8;
+
+			if (offset + chunkLength > file.size())
+				throw std::runtime_error("glTF: truncated chunk in " + path);
+
+			if (chunkType == 0x4E4F534A) // "JSON"
+			{
+				jsonBegin = reinterpret_cast<const char*>(&file[offset]);
+				jsonEnd = jsonBegin + chunkLength;
+			}
+			else if (chunkType == 0x004E4942) // "BIN\0"
+			{
+				binaryChunk.assign(file.begin() + offset, file.begin() + offset + chunkLength);
+			}
+
+			offset += chunkLength;
+		}
+
+		if (!jsonBegin)
+			throw std::runtime_error("glTF: no JSON chunk in " + path);
+	}
+
+	document.json = JsonParser(jsonBegin, jsonEnd).parse();
+
+	if (const Json* buffers = document.json.find("buffers"))
+	{
+		for (const Json& buffer : buffers->array)
+		{
+			const Json* uri = buffer.find("uri");
+
+			if (!uri)
+				document.buffers.push_back(binaryChunk);
+			else if (uri->string.compare(0, 5, "data:") == 0)
+				document.buffers.push_back(decodeBase64(uri->string.substr(uri->string.find(',') + 1)));
+			else
+				document.buffers.push_back(readFile(directoryOf(path) + uri->string));
+		}
+	}
+
+	return document;
+}
+
+} // namespace
+
+ImportedMesh
+importGltf(const std::string& path)
+{
+	GltfDocument document = loadDocument(path);
+	ImportedMesh mesh;
+	bool hasNormals = true;
+
+	const Json* meshes = document.json.find("meshes");
+	if (!meshes)
+		throw std::runtime_error("glTF: no meshes in " + path);
+
+	for (const Json& gltfMesh : meshes->array)
+	{
+		for (const Json& primitive : gltfMesh["primitives"].array)
+		{
+			// 4 = TRIANGLES, the default
+			if (primitive.find("mode") && primitive["mode"].number != 4)
+			{
+				std::cout << "[WARN] - skipping non triangle-list primitive in " << path << std::endl;
+				continue;
+			}
+
+			const Json& attributes = primitive["attributes"];
+			AccessorReader positions(document, attributes["POSITION"].asIndex());
+			uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+
+			std::unique_ptr<AccessorReader> normals, uvs;
+			if (attributes.find("NORMAL"))
+				normals = std::make_unique<AccessorReader>(document, attributes["NORMAL"].asIndex());
+			else
+				hasNormals = false;
+			if (attributes.find("TEXCOORD_0"))
+				uvs = std::make_unique<AccessorReader>(document, attributes["TEXCOORD_0"].asIndex());
+
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				MeshVertex vertex{};
+				for (uint32_t c = 0; c < 3; c++)
+					vertex.position[c] = positions.read(i, c);
+				if (normals && i < normals->count)
+					for (uint32_t c = 0; c < 3; c++)
+						vertex.normal[c] = normals->read(i, c);
+				if (uvs && i < uvs->count)
+					for (uint32_t c = 0; c < 2; c++)
+						vertex.uv[c] = uvs->read(i, c);
+				mesh.vertices.push_back(vertex);
+			}
+
+			if (primitive.find("indices"))
+			{
+				AccessorReader indices(document, primitive["indices"].asIndex());
+				for (size_t i = 0; i < indices.count; i++)
+				{
+					uint32_t index = indices.readIndex(i);
+					if (index >= positions.count)
+						throw std::runtime_error("glTF: vertex index out of range in " + path);
+					mesh.indices.push_back(baseVertex + index);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < positions.count; i++)
+					mesh.indices.push_back(baseVertex + static_cast<uint32_t>(i));
+			}
+		}
+	}
+
+	if (!hasNormals)
+		generateNormals(mesh);
+
+	return mesh;
+}
@@ -0,0 +1,315 @@
+#include "MeshBuilder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+struct Vec3 {
+	float x, y, z;
+
+	Vec3 operator+(const Vec3& o) const { return { x + o.x, y + o.y, z + o.z }; }
+	Vec3 operator-(const Vec3& o) const { return { x - o.x, y - o.y, z - o.z }; }
+	Vec3 operator*(float s) const { return { x * s, y * s, z * s }; }
+	float dot(const Vec3& o) const { return x * o.x + y * o.y + z * o.z; }
+	Vec3 cross(const Vec3& o) const { return { y * o.z - z * o.y, z * o.x - x * o.z, x * o.y - y * o.x }; }
+	float length() const { return std::sqrt(this->dot(*this)); }
+};
+
+Vec3
+positionOf(const MeshVertex& vertex)
+{
+	return { vertex.position[0], vertex.position[1], vertex.position[2] };
+}
+
+Vec3
+normalize(const Vec3& v)
+{
+	float length = v.length();
+	return length > 0.0f ? v * (1.0f / length) : Vec3{ 0.0f, 0.0f, 0.0f };
+}
+
+// Sphere around the AABB centre, not minimal but cheap and stable
+void
+boundingSphere(const std::vector<MeshVertex>& vertices, const uint32_t* indices, size_t count, float center[3], float& radius)
+{
+	Vec3 lo{ INFINITY, INFINITY, INFINITY }, hi{ -INFINITY, -INFINITY, -INFINITY };
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Vec3 p = positionOf(vertices[indices[i]]);
+		lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+		hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+	}
+
+	Vec3 c = (lo + hi) * 0.5f;
+	radius = 0.0f;
+
+	for (size_t i = 0; i < count; i++)
+		radius = std::max(radius, (positionOf(vertices[indices[i]]) - c).length());
+
+	center[0] = c.x;
+	center[1] = c.y;
+	center[2] = c.z;
+}
+
+// Vertex clustering: snap vertices to a grid, keep the first vertex of every cell and drop the
+// triangles that collapse. Crude compared to quadric simplification but fast and never creates vertices.
+std::vector<uint32_t>
+clusterSimplify(const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices, float cellSize)
+{
+	std::unordered_map<uint64_t, uint32_t> cells;
+	std::vector<uint32_t> remap(vertices.size());
+
+	for (uint32_t i = 0; i < vertices.size(); i++)
+	{
+		Vec3 p = positionOf(vertices[i]) * (1.0f / cellSize);
+		uint64_t key = (uint64_t(int64_t(std::floor(p.x)) & 0x1FFFFF) << 42) |
+			(uint64_t(int64_t(std::floor(p.y)) & 0x1FFFFF) << 21) |
+			uint64_t(int64_t(std::floor(p.z)) & 0x1FFFFF);
+
+		remap[i] = cells.emplace(key, i).first->second;
+	}
+
+	std::vector<uint32_t> result;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+
+		if (a != b && b != c && a != c)
+			result.insert(result.end(), { a, b, c });
+	}
+
+	return result;
+}
+
+void
+buildLods(BuiltMesh& built, const std::vector<uint32_t>& baseIndices, uint32_t maxLods)
+{
+	built.indices = baseIndices;
+	built.lods.push_back({ 0, static_cast<uint32_t>(baseIndices.size()), 0.0f, 0 });
+
+	// Start at 1/64 of the diameter and double the cell every level
+	float cellSize = built.boundsRadius / 32.0f;
+	std::vector<uint32_t> previous = baseIndices;
+
+	while (built.lods.size() < maxLods && cellSize > 0.0f)
+	{
+		std::vector<uint32_t> lod = clusterSimplify(built.vertices, baseIndices, cellSize);
+
+		// Not worth a level if it barely removed anything, and nothing left means we went too far
+		if (lod.empty() || lod.size() > previous.size() * 3 / 4)
+		{
+			if (lod.empty())
+				break;
+			cellSize *= 2.0f;
+			continue;
+		}
+
+		built.lods.push_back({ static_cast<uint32_t>(built.indices.size()), static_cast<uint32_t>(lod.size()), cellSize, 0 });
+		built.indices.insert(built.indices.end(), lod.begin(), lod.end());
+		previous = std::move(lod);
+		cellSize *= 2.0f;
+	}
+}
+
+void
+finishMeshlet(BuiltMesh& built, Meshlet& meshlet, const std::vector<Vec3>& triangleNormals)
+{
+	const uint32_t* localVertices = &built.meshletVertices[meshlet.vertexOffset];
+	boundingSphere(built.vertices, localVertices, meshlet.vertexCount, meshlet.center, meshlet.radius);
+
+	Vec3 axis{ 0.0f, 0.0f, 0.0f };
+	for (const Vec3& n : triangleNormals)
+		axis = axis + n;
+	axis = normalize(axis);
+
+	float minDot = 1.0f;
+	for (const Vec3& n : triangleNormals)
+		minDot = std::min(minDot, axis.dot(n));
+
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	// A cone wider than a hemisphere can't be back-face culled as a whole, a cutoff of 1 never passes the test
+	meshlet.coneCutoff = minDot <= 0.0f || axis.length() == 0.0f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+
+	// Shaders read the triangle blob as uints, keep every meshlet's triangles 4 byte aligned
+	while (built.meshletTriangles.size() % 4 != 0)
+		built.meshletTriangles.push_back(0);
+
+	built.meshlets.push_back(meshlet);
+}
+
+// Greedy in index order: good enough when the input is already vertex cache optimised
+void
+buildMeshlets(BuiltMesh& built, const std::vector<uint32_t>& indices)
+{
+	std::vector<int32_t> localIndex(built.vertices.size(), -1);
+	std::vector<Vec3> triangleNormals;
+
+	Meshlet meshlet{};
+
+	auto flush = [&]() {
+		if (meshlet.triangleCount == 0)
+			return;
+
+		finishMeshlet(built, meshlet, triangleNormals);
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			localIndex[built.meshletVertices[meshlet.vertexOffset + i]] = -1;
+
+		meshlet = Meshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(built.meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(built.meshletTriangles.size());
+		triangleNormals.clear();
+	};
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const uint32_t corners[3] = { indices[i], indices[i + 1], indices[i + 2] };
+
+		uint32_t newVertices = 0;
+		for (uint32_t corner : corners)
+			newVertices += localIndex[corner] < 0 ? 1 : 0;
+
+		if (meshlet.vertexCount + newVertices > MESHLET_MAX_VERTICES || meshlet.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+			flush();
+
+		for (uint32_t corner : corners)
+		{
+			if (localIndex[corner] < 0)
+			{
+				localIndex[corner] = static_cast<int32_t>(meshlet.vertexCount++);
+				built.meshletVertices.push_back(corner);
+			}
+			built.meshletTriangles.push_back(static_cast<uint8_t>(localIndex[corner]));
+		}
+
+		meshlet.triangleCount++;
+
+		Vec3 a = positionOf(built.vertices[corners[0]]);
+		Vec3 b = positionOf(built.vertices[corners[1]]);
+		Vec3 c = positionOf(built.vertices[corners[2]]);
+		Vec3 normal = normalize((b - a).cross(c - a));
+
+		// Degenerate triangles don't constrain the cone
+		if (normal.length() > 0.0f)
+			triangleNormals.push_back(normal);
+	}
+
+	flush();
+}
+
+size_t
+alignOffset(size_t offset)
+{
+	return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+} // namespace
+
+void
+generateNormals(ImportedMesh& mesh)
+{
+	std::vector<Vec3> normals(mesh.vertices.size(), Vec3{ 0.0f, 0.0f, 0.0f });
+
+	// Area weighted: the unnormalised cross product is twice the triangle area
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		Vec3 pa = positionOf(mesh.vertices[a]);
+		Vec3 n = (positionOf(mesh.vertices[b]) - pa).cross(positionOf(mesh.vertices[c]) - pa);
+
+		normals[a] = normals[a] + n;
+		normals[b] = normals[b] + n;
+		normals[c] = normals[c] + n;
+	}
+
+	for (size_t i = 0; i < mesh.vertices.size(); i++)
+	{
+		Vec3 n = normalize(normals[i]);
+		mesh.vertices[i].normal[0] = n.x;
+		mesh.vertices[i].normal[1] = n.y;
+		mesh.vertices[i].normal[2] = n.z;
+	}
+}
+
+BuiltMesh
+buildMesh(ImportedMesh mesh, uint32_t maxLods)
+{
+	if (mesh.indices.empty() || mesh.indices.size() % 3 != 0)
+		throw std::runtime_error("mesh has no triangles");
+
+	BuiltMesh built;
+	built.vertices = std::move(mesh.vertices);
+
+	std::vector<uint32_t> all(built.vertices.size());
+	for (uint32_t i = 0; i < all.size(); i++)
+		all[i] = i;
+	boundingSphere(built.vertices, all.data(), all.size(), built.boundsCenter, built.boundsRadius);
+
+	buildLods(built, mesh.indices, std::max(maxLods, 1u));
+	buildMeshlets(built, mesh.indices);
+
+	return built;
+}
+
+void
+writeMeshFile(const std::string& path, const BuiltMesh& mesh)
+{
+	MeshFileHeader header{};
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+	header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+	header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+	header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	header.meshletVertexCount = static_cast<uint32_t>(mesh.meshletVertices.size());
+	header.meshletTriangleBytes = static_cast<uint32_t>(mesh.meshletTriangles.size());
+	std::memcpy(header.boundsCenter, mesh.boundsCenter, sizeof(header.boundsCenter));
+	header.boundsRadius = mesh.boundsRadius;
+
+	struct Blob { uint64_t* offset; const void* data; size_t bytes; };
+	const Blob blobs[] = {
+		{ &header.vertexOffset, mesh.vertices.data(), mesh.vertices.size() * sizeof(MeshVertex) },
+		{ &header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t) },
+		{ &header.lodOffset, mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod) },
+		{ &header.meshletOffset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet) },
+		{ &header.meshletVertexOffset, mesh.meshletVertices.data(), mesh.meshletVertices.size() * sizeof(uint32_t) },
+		{ &header.meshletTriangleOffset, mesh.meshletTriangles.data(), mesh.meshletTriangles.size() },
+	};
+
+	size_t offset = sizeof(MeshFileHeader);
+	for (const Blob& blob : blobs)
+	{
+		offset = alignOffset(offset);
+		*blob.offset = offset;
+		offset += blob.bytes;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path + " for writing");
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const char padding[MESH_FILE_ALIGNMENT] = {};
+	size_t written = sizeof(header);
+
+	for (const Blob& blob : blobs)
+	{
+		file.write(padding, *blob.offset - written);
+		file.write(static_cast<const char*>(blob.data), blob.bytes);
+		written = *blob.offset + blob.bytes;
+	}
+
+	if (!file)
+		throw std::runtime_error("failed to write " + path);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "MeshImport.hpp"
+
+// Everything that goes into a .vmesh, already in file order
+struct BuiltMesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	float boundsCenter[3];
+	float boundsRadius;
+};
+
+BuiltMesh buildMesh(ImportedMesh mesh, uint32_t maxLods);
+void writeMeshFile(const std::string& path, const BuiltMesh& mesh);
@@ -0,0 +1,74 @@
+// Offline converter: OBJ / glTF -> .vmesh, the memory mappable format loaded by GameCore::LoadMesh
+#include "MeshBuilder.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static bool
+endsWith(const std::string& text, const std::string& suffix)
+{
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static void
+printUsage()
+{
+	std::cout << "usage: MeshConverter <input.obj|input.gltf|input.glb> <output.vmesh> [--lods=N]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	std::string input, output;
+	uint32_t maxLods = 4;
+
+	try {
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg.compare(0, 7, "--lods=") == 0)
+				maxLods = static_cast<uint32_t>(std::stoul(arg.substr(7)));
+			else if (input.empty())
+				input = arg;
+			else if (output.empty())
+				output = arg;
+			else
+				throw std::invalid_argument("unexpected argument " + arg);
+		}
+
+		if (input.empty() || output.empty())
+		{
+			printUsage();
+			return EXIT_FAILURE;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		ImportedMesh imported;
+		if (endsWith(input, ".obj"))
+			imported = importObj(input);
+		else if (endsWith(input, ".gltf") || endsWith(input, ".glb"))
+			imported = importGltf(input);
+		else
+			throw std::invalid_argument("unsupported input format: " + input);
+
+		BuiltMesh built = buildMesh(std::move(imported), maxLods);
+		writeMeshFile(output, built);
+
+		auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << "[INFO] - " << output << ": " << built.vertices.size() << " vertices, "
+			<< built.lods.size() << " LODs, " << built.meshlets.size() << " meshlets (" << elapsed << " ms)" << std::endl;
+
+		for (size_t i = 0; i < built.lods.size(); i++)
+			std::cout << "[INFO] -   LOD " << i << ": " << built.lods[i].indexCount / 3 << " triangles, error " << built.lods[i].error << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
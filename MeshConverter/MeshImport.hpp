@@ -0,0 +1,22 @@
+#pragma once
+
+#include "MeshFormat.hpp"
+
+#include <string>
+#include <vector>
+
+// Triangle list with deduplicated vertices, the common input of every importer
+struct ImportedMesh {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+// Wavefront OBJ: v / vt / vn / f, polygons are fan triangulated, negative (relative) indices supported
+ImportedMesh importObj(const std::string& path);
+
+// glTF 2.0 (.gltf with external or data URI buffers, or .glb): every triangle primitive of every mesh,
+// POSITION / NORMAL / TEXCOORD_0 and the index accessor. Node transforms are not applied.
+ImportedMesh importGltf(const std::string& path);
+
+// Fills in smooth normals for meshes that came without any
+void generateNormals(ImportedMesh& mesh);
@@ -0,0 +1,136 @@
+#include "MeshImport.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace {
+
+struct ObjKeyHash {
+	size_t operator()(const std::tuple<int, int, int>& key) const
+	{
+		return std::get<0>(key) * 73856093u ^ std::get<1>(key) * 19349663u ^ std::get<2>(key) * 83492791u;
+	}
+};
+
+// OBJ indices are 1-based, negative ones count back from the end of the list read so far
+int
+resolveIndex(int index, size_t count)
+{
+	if (index > 0)
+		return index - 1;
+	if (index < 0)
+		return static_cast<int>(count) + index;
+	return -1;
+}
+
+} // namespace
+
+ImportedMesh
+importObj(const std::string& path)
+{
+	std::ifstream file(path);
+
+	if (!file.is_open())
+		throw std::runtime_error("failed to open " + path);
+
+	std::vector<float> positions, normals, uvs;
+	std::unordered_map<std::tuple<int, int, int>, uint32_t, ObjKeyHash> vertexCache;
+	ImportedMesh mesh;
+	bool hasNormals = false;
+
+	std::string line;
+	std::vector<uint32_t> polygon;
+
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		std::string type;
+		stream >> type;
+
+		if (type == "v")
+		{
+			float x = 0, y = 0, z = 0;
+			stream >> x >> y >> z;
+			positions.insert(positions.end(), { x, y, z });
+		}
+		else if (type == "vn")
+		{
+			float x = 0, y = 0, z = 0;
+			stream >> x >> y >> z;
+			normals.insert(normals.end(), { x, y, z });
+		}
+		else if (type == "vt")
+		{
+			float u = 0, v = 0;
+			stream >> u >> v;
+			// OBJ has the origin bottom left, Vulkan samples from the top left
+			uvs.insert(uvs.end(), { u, 1.0f - v });
+		}
+		else if (type == "f")
+		{
+			polygon.clear();
+
+			std::string corner;
+			while (stream >> corner)
+			{
+				int v = 0, vt = 0, vn = 0;
+
+				// v, v/vt, v//vn or v/vt/vn
+				const char* text = corner.c_str();
+				v = std::atoi(text);
+				const char* slash = std::strchr(text, '/');
+				if (slash)
+				{
+					if (slash[1] != '/')
+						vt = std::atoi(slash + 1);
+					const char* second = std::strchr(slash + 1, '/');
+					if (second)
+						vn = std::atoi(second + 1);
+				}
+
+				int p = resolveIndex(v, positions.size() / 3);
+				int t = resolveIndex(vt, uvs.size() / 2);
+				int n = resolveIndex(vn, normals.size() / 3);
+
+				if (p < 0 || p >= static_cast<int>(positions.size() / 3))
+					throw std::runtime_error("invalid vertex index in " + path + ": " + corner);
+				if (t >= static_cast<int>(uvs.size() / 2) || n >= static_cast<int>(normals.size() / 3))
+					throw std::runtime_error("invalid attribute index in " + path + ": " + corner);
+
+				auto key = std::make_tuple(p, t, n);
+				auto it = vertexCache.find(key);
+
+				if (it == vertexCache.end())
+				{
+					MeshVertex vertex{};
+					std::memcpy(vertex.position, &positions[p * 3], sizeof(vertex.position));
+					if (n >= 0)
+					{
+						std::memcpy(vertex.normal, &normals[n * 3], sizeof(vertex.normal));
+						hasNormals = true;
+					}
+					if (t >= 0)
+						std::memcpy(vertex.uv, &uvs[t * 2], sizeof(vertex.uv));
+
+					it = vertexCache.emplace(key, static_cast<uint32_t>(mesh.vertices.size())).first;
+					mesh.vertices.push_back(vertex);
+				}
+
+				polygon.push_back(it->second);
+			}
+
+			for (size_t i = 2; i < polygon.size(); i++)
+				mesh.indices.insert(mesh.indices.end(), { polygon[0], polygon[i - 1], polygon[i] });
+		}
+	}
+
+	if (!hasNormals)
+		generateNormals(mesh);
+
+	return mesh;
+}
@@ -0,0 +1,150 @@
+// Benchmarks the scene store the renderer is fed from: creating, iterating and updating 1M entities and
+// draining their dirty transforms the way GameCore::recordSceneUpload does
+#include "Scene.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+static void
+printUsage()
+{
+	std::cout << "usage: SceneBenchmark [--entities=N] [--repeat=N] [--threads=N]" << std::endl;
+}
+
+// Runs setup untimed and body timed, repeat times, and prints the fastest and the median run
+template<typename Setup, typename Body>
+static void
+measure(const char* name, uint32_t repeat, size_t entityCount, Setup setup, Body body)
+{
+	std::vector<double> runsMs;
+
+	for (uint32_t i = 0; i < repeat; i++)
+	{
+		setup();
+
+		auto start = std::chrono::steady_clock::now();
+		body();
+		runsMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	std::sort(runsMs.begin(), runsMs.end());
+	double medianMs = runsMs[runsMs.size() / 2];
+
+	std::cout << "[PERF] - " << name << ": min " << runsMs.front() << " ms, median " << medianMs << " ms ("
+		<< entityCount / 1000.0 / medianMs << " M entities/s)" << std::endl;
+}
+
+static void
+populate(Scene& scene, size_t entityCount)
+{
+	for (size_t i = 0; i < entityCount; i++)
+	{
+		Entity entity = scene.createEntity(COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_BOUNDS);
+
+		Transform& transform = scene.editTransform(entity);
+		transform = { { float(i % 1000), 0.0f, float(i / 1000) }, 1.0f, { 0.0f, 0.0f, 0.0f, 1.0f } };
+		scene.getMesh(entity).meshIndex = static_cast<uint32_t>(i % 16);
+	}
+}
+
+static void
+moveChunk(SceneChunk& chunk)
+{
+	for (uint32_t row = 0; row < chunk.count; row++)
+	{
+		chunk.transforms[row].position[1] += 0.01f;
+		chunk.markDirty(row);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	size_t entityCount = 1'000'000;
+	uint32_t repeat = 9;
+	uint32_t threadCount = 0;
+
+	try {
+		for (int i = 1; i < argc; i++)
+		{
+			std::string arg = argv[i];
+
+			if (arg.compare(0, 11, "--entities=") == 0)
+				entityCount = std::stoul(arg.substr(11));
+			else if (arg.compare(0, 9, "--repeat=") == 0)
+				repeat = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(arg.substr(9))));
+			else if (arg.compare(0, 10, "--threads=") == 0)
+				threadCount = static_cast<uint32_t>(std::stoul(arg.substr(10)));
+			else
+			{
+				printUsage();
+				return EXIT_FAILURE;
+			}
+		}
+
+		ThreadPool pool(threadCount);
+		std::cout << "[INFO] - " << entityCount << " entities, " << repeat << " runs, "
+			<< pool.getThreadCount() << " workers + the calling thread" << std::endl;
+
+		measure("create", repeat, entityCount, []() {}, [entityCount]() {
+			Scene scene;
+			populate(scene, entityCount);
+		});
+
+		Scene scene;
+		populate(scene, entityCount);
+
+		// Keeps the read loop from being optimized away
+		volatile float sink = 0.0f;
+		measure("iterate transforms", repeat, entityCount, []() {}, [&scene, &sink]() {
+			float sum = 0.0f;
+			scene.forEachChunk(COMPONENT_TRANSFORM, [&sum](SceneChunk& chunk) {
+				for (uint32_t row = 0; row < chunk.count; row++)
+					sum += chunk.transforms[row].position[1];
+			});
+			sink = sum;
+		});
+
+		measure("update all, serial", repeat, entityCount, []() {}, [&scene]() {
+			scene.forEachChunk(COMPONENT_TRANSFORM, moveChunk);
+		});
+
+		measure("update all, parallel", repeat, entityCount, []() {}, [&scene, &pool]() {
+			scene.parallelForEachChunk(pool, COMPONENT_TRANSFORM, moveChunk);
+		});
+
+		// What the upload path does with the result: one copy region per run of dirty rows
+		size_t uploaded = 0;
+		auto drain = [&scene, &uploaded]() {
+			scene.consumeDirtyTransforms([&uploaded](uint32_t, const Transform*, uint32_t count) { uploaded += count; });
+		};
+
+		measure("drain all dirty", repeat, entityCount, [&scene]() { scene.markAllTransformsDirty(); }, drain);
+
+		// A typical frame: a few moving objects scattered over the scene
+		std::mt19937 random(1234);
+		std::vector<Entity> entities;
+		scene.forEachChunk(COMPONENT_TRANSFORM, [&entities](SceneChunk& chunk) {
+			for (uint32_t row = 0; row < chunk.count; row++)
+				entities.push_back({ chunk.entityIndices[row], 0 });
+		});
+
+		measure("drain 1% dirty", repeat, entityCount, [&]() {
+			drain();
+			for (size_t i = 0; i < entityCount / 100; i++)
+			{
+				uint32_t index = entities[random() % entities.size()].index;
+				scene.editTransform({ index, 0 }).position[0] += 1.0f;
+			}
+		}, drain);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+#include "AsyncCompute.hpp"
+
+#include <algorithm>
+
+void
+AsyncCompute::create(VkDevice device, VkQueue queue, uint32_t family, VkQueue graphicsQueue, uint32_t graphicsFamily, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->queue = queue;
+	this->family = family;
+	this->graphicsFamily = graphicsFamily;
+	this->async = family != graphicsFamily || queue != graphicsQueue;
+	this->allocator = allocator;
+	this->timeline.create(device, 0, allocator);
+
+	VkCommandPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = family;
+	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(device, &createInfo, allocator, &this->commandPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create compute command pool!");
+}
+
+void
+AsyncCompute::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	// Command buffers go with the pool
+	vkDestroyCommandPool(this->device, this->commandPool, this->allocator);
+	this->timeline.destroy();
+
+	this->commandPool = VK_NULL_HANDLE;
+	this->inFlight.clear();
+	this->freeCommandBuffers.clear();
+	this->pendingHandoffs.clear();
+	this->pendingReturns.clear();
+	this->device = VK_NULL_HANDLE;
+}
+
+std::vector<VkBufferMemoryBarrier>
+AsyncCompute::handoffBarriers(const std::vector<ComputeHandoff>& handoffs, bool acquire, bool toCompute) const
+{
+	bool transfer = this->family != this->graphicsFamily;
+	uint32_t srcFamily = toCompute ? this->graphicsFamily : this->family;
+	uint32_t dstFamily = toCompute ? this->family : this->graphicsFamily;
+	std::vector<VkBufferMemoryBarrier> barriers;
+
+	for (const ComputeHandoff& handoff : handoffs)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.buffer = handoff.buffer;
+		barrier.offset = handoff.offset;
+		barrier.size = handoff.size;
+		barrier.srcQueueFamilyIndex = transfer ? srcFamily : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = transfer ? dstFamily : VK_QUEUE_FAMILY_IGNORED;
+
+		// The release half only makes the writes available, the acquire half makes them visible.
+		// Without a family change the acquire side alone is a regular barrier.
+		if (toCompute)
+		{
+			// Graphics mostly reads them, but the first return follows the upload that filled them
+			barrier.srcAccessMask = acquire ? 0 : VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = acquire ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : 0;
+		}
+		else
+		{
+			barrier.srcAccessMask = acquire && transfer ? 0 : VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = acquire ? handoff.dstAccess : 0;
+		}
+
+		barriers.push_back(barrier);
+	}
+
+	return barriers;
+}
+
+uint64_t
+AsyncCompute::submit(const std::function<void(VkCommandBuffer)>& record, const std::vector<ComputeHandoff>& handoffs,
+	VkSemaphore waitSemaphore, uint64_t waitValue, VkPipelineStageFlags waitStage)
+{
+	this->recycle();
+
+	VkCommandBuffer commandBuffer;
+
+	if (!this->freeCommandBuffers.empty())
+	{
+		commandBuffer = this->freeCommandBuffers.back();
+		this->freeCommandBuffers.pop_back();
+		vkResetCommandBuffer(commandBuffer, 0);
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = this->commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate compute command buffer!");
+	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording compute command buffer!");
+
+	// Acquire what graphics handed back, the caller's wait on the graphics timeline orders it after the release
+	if (!this->pendingReturns.empty())
+	{
+		std::vector<VkBufferMemoryBarrier> acquire = this->handoffBarriers(this->pendingReturns, true, true);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(acquire.size()), acquire.data(), 0, nullptr);
+		this->pendingReturns.clear();
+	}
+
+	record(commandBuffer);
+
+	// Release to the graphics family, only needed when the families differ
+	if (!handoffs.empty() && this->family != this->graphicsFamily)
+	{
+		std::vector<VkBufferMemoryBarrier> release = this->handoffBarriers(handoffs, false);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, static_cast<uint32_t>(release.size()), release.data(), 0, nullptr);
+	}
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record compute command buffer!");
+
+	uint64_t signalValue = this->timeline.nextValue();
+	VkSemaphore timelineSemaphore = this->timeline.handle();
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timelineSemaphore;
+
+	if (waitSemaphore != VK_NULL_HANDLE)
+	{
+		timelineInfo.waitSemaphoreValueCount = 1;
+		timelineInfo.pWaitSemaphoreValues = &waitValue;
+		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.pWaitSemaphores = &waitSemaphore;
+		submitInfo.pWaitDstStageMask = &waitStage;
+	}
+
+	if (vkQueueSubmit(this->queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("failed to submit compute command buffer!");
+
+	this->inFlight.push_back({ commandBuffer, signalValue });
+
+	if (!handoffs.empty())
+	{
+		this->pendingHandoffs.insert(this->pendingHandoffs.end(), handoffs.begin(), handoffs.end());
+		this->pendingValue = signalValue;
+	}
+
+	return signalValue;
+}
+
+uint64_t
+AsyncCompute::recordAcquire(VkCommandBuffer graphicsCommandBuffer, VkPipelineStageFlags& waitStages)
+{
+	waitStages = 0;
+
+	if (this->pendingHandoffs.empty())
+		return 0;
+
+	VkPipelineStageFlags dstStages = 0;
+	for (const ComputeHandoff& handoff : this->pendingHandoffs)
+		dstStages |= handoff.dstStage;
+
+	// With a family transfer the semaphore wait already covers the compute writes, the source stage is a no-op
+	bool transfer = this->family != this->graphicsFamily;
+	std::vector<VkBufferMemoryBarrier> acquire = this->handoffBarriers(this->pendingHandoffs, true);
+	vkCmdPipelineBarrier(graphicsCommandBuffer, transfer ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0,
+		0, nullptr, static_cast<uint32_t>(acquire.size()), acquire.data(), 0, nullptr);
+
+	this->pendingHandoffs.clear();
+	waitStages = dstStages;
+
+	return this->pendingValue;
+}
+
+void
+AsyncCompute::recordReturn(VkCommandBuffer graphicsCommandBuffer, const std::vector<ComputeHandoff>& handoffs)
+{
+	// Same family: the semaphore waits order the queues, there is no ownership to give back
+	if (handoffs.empty() || this->family == this->graphicsFamily)
+		return;
+
+	VkPipelineStageFlags srcStages = 0;
+	for (const ComputeHandoff& handoff : handoffs)
+		srcStages |= handoff.dstStage;
+
+	std::vector<VkBufferMemoryBarrier> release = this->handoffBarriers(handoffs, false, true);
+	vkCmdPipelineBarrier(graphicsCommandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, static_cast<uint32_t>(release.size()), release.data(), 0, nullptr);
+
+	this->pendingReturns.insert(this->pendingReturns.end(), handoffs.begin(), handoffs.end());
+}
+
+void
+AsyncCompute::recycle()
+{
+	if (this->inFlight.empty())
+		return;
+
+	uint64_t completed = this->timeline.completedValue();
+
+	auto firstPending = std::find_if(this->inFlight.begin(), this->inFlight.end(),
+		[completed](const PendingSubmit& submit) { return submit.timelineValue > completed; });
+
+	for (auto it = this->inFlight.begin(); it != firstPending; ++it)
+		this->freeCommandBuffers.push_back(it->commandBuffer);
+
+	this->inFlight.erase(this->inFlight.begin(), firstPending);
+}
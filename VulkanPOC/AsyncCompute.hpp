@@ -0,0 +1,77 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "GpuTimeline.hpp"
+
+#include <functional>
+#include <vector>
+
+// A buffer written by a compute submission and read by the graphics queue afterwards.
+// When the two queues belong to different families the ownership transfer (release on compute, acquire on
+// graphics) is recorded automatically; on a shared family it degrades to a plain memory barrier.
+// Buffers compute writes again later go back the same way with recordReturn().
+struct ComputeHandoff {
+	VkBuffer buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = VK_WHOLE_SIZE;
+	// How the graphics queue is going to use it
+	VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT;
+};
+
+// Submits compute work on a queue separate from graphics when the device has one (a compute-only family, or a
+// second queue of the graphics family), so culling / particles / post work overlaps the raster work of the frame.
+// Falls back to the graphics queue otherwise. Every submission signals the compute timeline.
+// Not thread safe, submit from the thread that records frames.
+class AsyncCompute {
+public:
+	// Async when queue is not graphicsQueue: another family, or another queue of the graphics family
+	void create(VkDevice device, VkQueue queue, uint32_t family, VkQueue graphicsQueue, uint32_t graphicsFamily, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	// False when compute shares the graphics queue, the work is then serialized with the frame
+	bool isAsync() const { return this->async; }
+	uint32_t getFamily() const { return this->family; }
+	GpuTimeline& getTimeline() { return this->timeline; }
+
+	// waitSemaphore/waitValue (a graphics timeline value for instance) orders the work after something the
+	// graphics queue produced. The handoffs are released here and acquired by the next recordAcquire().
+	uint64_t submit(const std::function<void(VkCommandBuffer)>& record, const std::vector<ComputeHandoff>& handoffs = {},
+		VkSemaphore waitSemaphore = VK_NULL_HANDLE, uint64_t waitValue = 0, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Graphics side: records the acquire barriers for everything handed off since the last call, and returns the compute
+	// timeline value (0 if none) plus the stages the graphics submission has to wait on it with
+	uint64_t recordAcquire(VkCommandBuffer graphicsCommandBuffer, VkPipelineStageFlags& waitStages);
+	// Graphics side, after the last use (dstStage of each handoff) of buffers compute is going to write again: releases
+	// them to the compute family, the next submit() acquires them. That submit has to wait on the graphics submission
+	// carrying the release. Records nothing when both queues share a family.
+	void recordReturn(VkCommandBuffer graphicsCommandBuffer, const std::vector<ComputeHandoff>& handoffs);
+
+private:
+	struct PendingSubmit {
+		VkCommandBuffer commandBuffer;
+		uint64_t timelineValue;
+	};
+
+	void recycle();
+	// toCompute: the way back, from graphics to compute
+	std::vector<VkBufferMemoryBarrier> handoffBarriers(const std::vector<ComputeHandoff>& handoffs, bool acquire, bool toCompute = false) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkQueue queue = VK_NULL_HANDLE;
+	uint32_t family = 0;
+	uint32_t graphicsFamily = 0;
+	bool async = false;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	GpuTimeline timeline;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<PendingSubmit> inFlight;
+	std::vector<VkCommandBuffer> freeCommandBuffers;
+
+	// Released by compute, not yet acquired by graphics
+	std::vector<ComputeHandoff> pendingHandoffs;
+	uint64_t pendingValue = 0;
+	// Released by graphics, acquired by the next submit
+	std::vector<ComputeHandoff> pendingReturns;
+};
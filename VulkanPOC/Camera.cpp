@@ -0,0 +1,69 @@
+#include "Camera.hpp"
+
+#include <cmath>
+
+namespace {
+	void normalize(float v[3])
+	{
+		float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.0f)
+		{
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	void cross(const float a[3], const float b[3], float out[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+}
+
+void
+Camera::viewProjection(float aspect, float out[16]) const
+{
+	// Right handed view space, looking down -z
+	float forward[3] = { this->target[0] - this->position[0], this->target[1] - this->position[1], this->target[2] - this->position[2] };
+	normalize(forward);
+	float side[3];
+	cross(forward, this->up, side);
+	normalize(side);
+	float cameraUp[3];
+	cross(side, forward, cameraUp);
+
+	float view[16] = {
+		side[0], cameraUp[0], -forward[0], 0.0f,
+		side[1], cameraUp[1], -forward[1], 0.0f,
+		side[2], cameraUp[2], -forward[2], 0.0f,
+		-dot(side, this->position), -dot(cameraUp, this->position), dot(forward, this->position), 1.0f,
+	};
+
+	// y is negated so +y in the world ends up at the top of the screen
+	float t = 1.0f / std::tan(this->fovY * 0.5f);
+	float depthScale = this->farPlane / (this->nearPlane - this->farPlane);
+	float projection[16] = {
+		t / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, -t, 0.0f, 0.0f,
+		0.0f, 0.0f, depthScale, -1.0f,
+		0.0f, 0.0f, this->nearPlane * depthScale, 0.0f,
+	};
+
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; k++)
+				sum += projection[k * 4 + row] * view[column * 4 + k];
+			out[column * 4 + row] = sum;
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// Perspective look-at camera. The matrices follow Vulkan conventions: clip space y points down and depth goes
+// from 0 at the near plane to 1 at the far plane. Matrices are column major, as GLSL expects them.
+struct Camera {
+	float position[3] = { 0.0f, 20.0f, -40.0f };
+	float target[3] = { 0.0f, 0.0f, 0.0f };
+	float up[3] = { 0.0f, 1.0f, 0.0f };
+	// Vertical field of view in radians
+	float fovY = 1.0471976f;
+	float nearPlane = 0.1f;
+	float farPlane = 1000.0f;
+
+	void viewProjection(float aspect, float out[16]) const;
+};
@@ -0,0 +1,121 @@
+#include "CommandCache.hpp"
+
+CommandKey&
+CommandKey::addBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		this->hash ^= bytes[i];
+		this->hash *= 1099511628211ull;
+	}
+
+	this->data.insert(this->data.end(), bytes, bytes + size);
+	return *this;
+}
+
+void
+CommandCache::create(VkDevice device, VkCommandPool commandPool, uint32_t slotCount)
+{
+	this->device = device;
+	this->commandPool = commandPool;
+	this->slots.resize(slotCount);
+
+	std::vector<VkCommandBuffer> commandBuffers(slotCount);
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocInfo.commandBufferCount = slotCount;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate cached command buffers!");
+
+	for (uint32_t i = 0; i < slotCount; i++)
+		this->slots[i].commandBuffer = commandBuffers[i];
+}
+
+void
+CommandCache::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	for (Slot& slot : this->slots)
+		vkFreeCommandBuffers(this->device, this->commandPool, 1, &slot.commandBuffer);
+
+	this->slots.clear();
+	this->device = VK_NULL_HANDLE;
+}
+
+VkCommandBuffer
+CommandCache::lookup(uint32_t slot, const CommandKey& key)
+{
+	const Slot& entry = this->slots[slot];
+	if (!entry.valid || entry.key != key)
+		return VK_NULL_HANDLE;
+
+	this->intervalHits++;
+	return entry.commandBuffer;
+}
+
+VkCommandBuffer
+CommandCache::begin(uint32_t slot, const CommandKey& key, const VkCommandBufferInheritanceInfo& inheritance)
+{
+	Slot& entry = this->slots[slot];
+	entry.key = key;
+	entry.valid = false;
+
+	// The pool allows resetting buffers one by one; begin resets implicitly, the explicit reset releases the old commands first
+	vkResetCommandBuffer(entry.commandBuffer, 0);
+
+	// Not one time submit, the point is to execute it again
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &inheritance;
+
+	if (vkBeginCommandBuffer(entry.commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording cached command buffer!");
+
+	this->intervalRecords++;
+	return entry.commandBuffer;
+}
+
+void
+CommandCache::end(uint32_t slot)
+{
+	Slot& entry = this->slots[slot];
+
+	if (vkEndCommandBuffer(entry.commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record cached command buffer!");
+
+	entry.valid = true;
+}
+
+void
+CommandCache::invalidate()
+{
+	for (Slot& slot : this->slots)
+		slot.valid = false;
+}
+
+void
+CommandCache::report(std::chrono::seconds reportInterval)
+{
+	auto now = std::chrono::steady_clock::now();
+	if (now - this->intervalStart < reportInterval)
+		return;
+
+	uint64_t total = this->intervalHits + this->intervalRecords;
+	if (total > 0)
+	{
+		std::cout << "[PERF] - command cache: " << this->intervalHits << "/" << total << " segments replayed, "
+			<< this->intervalRecords << " re-recorded\n";
+	}
+
+	this->intervalHits = 0;
+	this->intervalRecords = 0;
+	this->intervalStart = now;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+#include <vector>
+
+// Everything a cached segment's commands depend on, kept byte for byte plus its FNV-1a hash: the hash rejects
+// most mismatches cheaply, the bytes rule out replaying a recording over a collision. Only feed it scalars and
+// handles, struct padding would make equal states compare different.
+class CommandKey {
+public:
+	template<typename T>
+	CommandKey& add(const T& value) { return this->addBytes(&value, sizeof(T)); }
+	CommandKey& addBytes(const void* data, size_t size);
+
+	uint64_t value() const { return this->hash; }
+	const std::vector<uint8_t>& bytes() const { return this->data; }
+
+	bool operator==(const CommandKey& other) const { return this->hash == other.hash && this->data == other.data; }
+	bool operator!=(const CommandKey& other) const { return !(*this == other); }
+
+private:
+	uint64_t hash = 14695981039346656037ull;
+	std::vector<uint8_t> data;
+};
+
+// Secondary command buffers that are recorded once and replayed for as long as their key stays the same.
+// A slot is owned by one frame in flight, so it is only re-recorded after the primary that last executed it retired.
+// Not thread safe, use from the thread that records frames.
+class CommandCache {
+public:
+	void create(VkDevice device, VkCommandPool commandPool, uint32_t slotCount);
+	void destroy();
+
+	bool isEnabled() const { return this->device != VK_NULL_HANDLE; }
+
+	// The slot's recording when it was made with key, VK_NULL_HANDLE when it has to be recorded (again)
+	VkCommandBuffer lookup(uint32_t slot, const CommandKey& key);
+	// Begins re-recording the slot for use inside the render pass / rendering scope described by inheritance
+	VkCommandBuffer begin(uint32_t slot, const CommandKey& key, const VkCommandBufferInheritanceInfo& inheritance);
+	void end(uint32_t slot);
+
+	// Every slot is recorded again on its next use
+	void invalidate();
+
+	// Prints how many lookups were served from the cache over the interval, then restarts it
+	void report(std::chrono::seconds reportInterval = std::chrono::seconds(1));
+
+private:
+	struct Slot {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		CommandKey key;
+		bool valid = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	std::vector<Slot> slots;
+
+	uint64_t intervalHits = 0;
+	uint64_t intervalRecords = 0;
+	std::chrono::steady_clock::time_point intervalStart = std::chrono::steady_clock::now();
+};
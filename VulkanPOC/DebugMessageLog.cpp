@@ -0,0 +1,219 @@
+#include "DebugMessageLog.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+DebugMessageLog::DebugMessageLog() :
+	slots(new Slot[CAPACITY]),
+	severityFilter(VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT),
+	typeFilter(VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT)
+{
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+
+	for (size_t i = 0; i < CAPACITY; i++)
+		this->slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+void
+DebugMessageLog::start()
+{
+	if (this->running.exchange(true))
+		return;
+
+	this->logger = std::thread(&DebugMessageLog::loggerLoop, this);
+}
+
+void
+DebugMessageLog::stop()
+{
+	if (!this->running.exchange(false))
+		return;
+
+	this->wakeUp.notify_one();
+	this->logger.join();
+}
+
+void
+DebugMessageLog::setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities, VkDebugUtilsMessageTypeFlagsEXT types)
+{
+	this->severityFilter.store(severities, std::memory_order_relaxed);
+	this->typeFilter.store(types, std::memory_order_relaxed);
+}
+
+bool
+DebugMessageLog::push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data)
+{
+	if (!(severity & this->severityFilter.load(std::memory_order_relaxed)) || !(type & this->typeFilter.load(std::memory_order_relaxed)))
+		return false;
+
+	size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+	Slot* slot;
+
+	while (true)
+	{
+		slot = &this->slots[position & (CAPACITY - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+		if (difference == 0)
+		{
+			if (this->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			// Full: the logger is behind, losing a message beats blocking the driver thread
+			this->dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else
+		{
+			position = this->enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+
+	Message& message = slot->message;
+	message.severity = severity;
+	message.type = type;
+	message.idNumber = data->messageIdNumber;
+	strncpy(message.idName, data->pMessageIdName ? data->pMessageIdName : "", sizeof(message.idName) - 1);
+	message.idName[sizeof(message.idName) - 1] = '\0';
+	strncpy(message.text, data->pMessage ? data->pMessage : "", sizeof(message.text) - 1);
+	message.text[sizeof(message.text) - 1] = '\0';
+
+	slot->sequence.store(position + 1, std::memory_order_release);
+
+	// Errors are worth a wake up, everything else waits for the next poll
+	if (severity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT)
+		this->wakeUp.notify_one();
+
+	return true;
+}
+
+bool
+DebugMessageLog::pop(Message& message)
+{
+	size_t position = this->dequeuePosition.load(std::memory_order_relaxed);
+	Slot& slot = this->slots[position & (CAPACITY - 1)];
+
+	if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+		return false;
+
+	message = slot.message;
+	slot.sequence.store(position + CAPACITY, std::memory_order_release);
+	this->dequeuePosition.store(position + 1, std::memory_order_relaxed);
+
+	return true;
+}
+
+VKAPI_ATTR VkBool32 VKAPI_CALL
+DebugMessageLog::callback(
+	VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+	VkDebugUtilsMessageTypeFlagsEXT messageType,
+	const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+	void* pUserData)
+{
+	static_cast<DebugMessageLog*>(pUserData)->push(messageSeverity, messageType, pCallbackData);
+
+	return VK_FALSE;
+}
+
+static const char*
+severityName(VkDebugUtilsMessageSeverityFlagBitsEXT severity)
+{
+	switch (severity)
+	{
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT: return "error";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT: return "warning";
+	case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT: return "info";
+	default: return "verbose";
+	}
+}
+
+void
+DebugMessageLog::drain(std::string& output)
+{
+	Message message;
+
+	while (this->pop(message))
+	{
+		// Messages without an id (loader / general) are keyed by their text
+		std::string key = message.idName[0] != '\0' || message.idNumber != 0
+			? std::string(message.idName) + '#' + std::to_string(message.idNumber)
+			: std::string(message.text);
+
+		auto inserted = this->seen.emplace(key, Repeat{ message.idName, 0 });
+		if (!inserted.second)
+		{
+			inserted.first->second.pending++;
+			continue;
+		}
+
+		output += "[DEBUG] - validation layer (";
+		output += severityName(message.severity);
+		output += "): ";
+		output += message.text;
+		output += '\n';
+	}
+}
+
+void
+DebugMessageLog::summariseRepeats(std::string& output)
+{
+	for (auto& entry : this->seen)
+	{
+		Repeat& repeat = entry.second;
+		if (repeat.pending == 0)
+			continue;
+
+		output += "[DEBUG] - validation layer: " + (repeat.idName.empty() ? entry.first.substr(0, 80) : repeat.idName) +
+			" repeated " + std::to_string(repeat.pending) + " more times\n";
+		repeat.pending = 0;
+	}
+
+	uint64_t dropped = this->getDroppedCount();
+	if (dropped != this->droppedReported)
+	{
+		output += "[WARN] - " + std::to_string(dropped - this->droppedReported) + " debug messages dropped, the log ring was full\n";
+		this->droppedReported = dropped;
+	}
+}
+
+void
+DebugMessageLog::loggerLoop()
+{
+	using clock = std::chrono::steady_clock;
+
+	std::string output;
+	clock::time_point lastSummary = clock::now();
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->wakeMutex);
+			this->wakeUp.wait_for(lock, std::chrono::milliseconds(20));
+		}
+
+		bool stopping = !this->running.load();
+
+		this->drain(output);
+
+		if (stopping || clock::now() - lastSummary >= std::chrono::seconds(1))
+		{
+			this->summariseRepeats(output);
+			lastSummary = clock::now();
+		}
+
+		// One write and one flush per batch instead of per message
+		if (!output.empty())
+		{
+			std::cerr.write(output.data(), output.size());
+			std::cerr.flush();
+			output.clear();
+		}
+
+		if (stopping)
+			return;
+	}
+}
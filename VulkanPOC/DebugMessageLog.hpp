@@ -0,0 +1,87 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// Validation / debug utils messages without stalling the thread that triggered them: the messenger
+// callback filters, copies the message into a lock-free ring and returns, a logger thread prints.
+// Repeats of the same message id are counted and summarised instead of printed again.
+class DebugMessageLog {
+public:
+	static constexpr size_t CAPACITY = 512;
+	static constexpr size_t MAX_TEXT = 1024;
+
+	DebugMessageLog();
+	~DebugMessageLog() { this->stop(); }
+
+	DebugMessageLog(const DebugMessageLog&) = delete;
+	DebugMessageLog& operator=(const DebugMessageLog&) = delete;
+
+	void start();
+	// Drains whatever is left, call after the last object that can report (the instance) is gone
+	void stop();
+
+	// Runtime filter, checked before anything is copied
+	void setFilter(VkDebugUtilsMessageSeverityFlagsEXT severities, VkDebugUtilsMessageTypeFlagsEXT types);
+
+	// Messenger callback side, safe from any thread. Returns false if filtered or the ring is full.
+	bool push(VkDebugUtilsMessageSeverityFlagBitsEXT severity, VkDebugUtilsMessageTypeFlagsEXT type, const VkDebugUtilsMessengerCallbackDataEXT* data);
+
+	uint64_t getDroppedCount() const { return this->dropped.load(std::memory_order_relaxed); }
+
+	static VKAPI_ATTR VkBool32 VKAPI_CALL callback(
+		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+		VkDebugUtilsMessageTypeFlagsEXT messageType,
+		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+		void* pUserData);
+
+private:
+	struct Message {
+		VkDebugUtilsMessageSeverityFlagBitsEXT severity;
+		VkDebugUtilsMessageTypeFlagsEXT type;
+		int32_t idNumber;
+		char idName[64];
+		char text[MAX_TEXT];
+	};
+
+	// Bounded MPSC ring: a slot's sequence says whether it is free for the producer at that position
+	// (sequence == position) or holds a message for the consumer (sequence == position + 1)
+	struct Slot {
+		std::atomic<size_t> sequence;
+		Message message;
+	};
+
+	struct Repeat {
+		std::string idName;
+		uint64_t pending = 0;
+	};
+
+	bool pop(Message& message);
+	void loggerLoop();
+	void drain(std::string& output);
+	void summariseRepeats(std::string& output);
+
+	std::unique_ptr<Slot[]> slots;
+	alignas(64) std::atomic<size_t> enqueuePosition{ 0 };
+	alignas(64) std::atomic<size_t> dequeuePosition{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+
+	std::atomic<uint32_t> severityFilter;
+	std::atomic<uint32_t> typeFilter;
+
+	// Logger thread only
+	std::unordered_map<std::string, Repeat> seen;
+	uint64_t droppedReported = 0;
+
+	std::thread logger;
+	std::mutex wakeMutex;
+	std::condition_variable wakeUp;
+	std::atomic<bool> running{ false };
+};
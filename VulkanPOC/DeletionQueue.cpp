@@ -0,0 +1,91 @@
+#include "DeletionQueue.hpp"
+
+void
+DeletionQueue::push(std::function<void()> deleter)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->unstamped.push_back(std::move(deleter));
+}
+
+void
+DeletionQueue::push(uint64_t retireValue, std::function<void()> deleter)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->entries.push_back({ retireValue, std::move(deleter) });
+}
+
+void
+DeletionQueue::stamp(uint64_t frameValue)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	for (auto& deleter : this->unstamped)
+	{
+		this->entries.push_back({ frameValue, std::move(deleter) });
+	}
+
+	this->unstamped.clear();
+}
+
+size_t
+DeletionQueue::collect(uint64_t completedValue)
+{
+	std::vector<std::function<void()>> ready;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		auto retired = std::stable_partition(this->entries.begin(), this->entries.end(),
+			[completedValue](const Entry& entry) { return entry.retireValue > completedValue; });
+
+		for (auto it = retired; it != this->entries.end(); ++it)
+		{
+			ready.push_back(std::move(it->deleter));
+		}
+
+		this->entries.erase(retired, this->entries.end());
+	}
+
+	// Run outside the lock so a deleter may itself push (e.g. a parent object releasing children)
+	for (auto& deleter : ready)
+	{
+		deleter();
+	}
+
+	return ready.size();
+}
+
+void
+DeletionQueue::flush()
+{
+	std::vector<std::function<void()>> all;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		for (auto& entry : this->entries)
+		{
+			all.push_back(std::move(entry.deleter));
+		}
+
+		for (auto& deleter : this->unstamped)
+		{
+			all.push_back(std::move(deleter));
+		}
+
+		this->entries.clear();
+		this->unstamped.clear();
+	}
+
+	for (auto& deleter : all)
+	{
+		deleter();
+	}
+}
+
+size_t
+DeletionQueue::pendingCount() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->entries.size() + this->unstamped.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <functional>
+#include <mutex>
+
+// Holds destroy/free callbacks until the GPU timeline passes the submission that last used the resource.
+// Callbacks pushed without a value belong to the frame being recorded and get their value from stamp()
+// once that frame is submitted. All methods are thread-safe, deleters run on the thread calling collect().
+class DeletionQueue {
+public:
+	// Released while the current frame is still being recorded, retires with that frame
+	void push(std::function<void()> deleter);
+	// Released after a known submission (e.g. a staging buffer after its upload)
+	void push(uint64_t retireValue, std::function<void()> deleter);
+
+	// Assigns the timeline value of the frame that was just submitted to everything pushed during it
+	void stamp(uint64_t frameValue);
+
+	// Runs every deleter whose value the GPU already reached, returns how many ran
+	size_t collect(uint64_t completedValue);
+
+	// Runs everything, only valid once the device is idle
+	void flush();
+
+	size_t pendingCount() const;
+
+private:
+	struct Entry {
+		uint64_t retireValue;
+		std::function<void()> deleter;
+	};
+
+	mutable std::mutex mutex;
+	std::vector<std::function<void()>> unstamped;
+	std::vector<Entry> entries;
+};
@@ -0,0 +1,80 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Aim below the budget, the frame time still varies with what is on screen
+	constexpr double HEADROOM = 0.9;
+	// Weight of a new sample in the smoothed cost
+	constexpr double SMOOTHING = 0.2;
+	// Only grow when the budget allows at least this much more scale, avoids hunting around the target
+	constexpr float GROW_DEAD_BAND = 0.03f;
+	constexpr float MAX_GROW_STEP = 0.02f;
+}
+
+void
+DynamicResolution::configure(double budgetMs, float minScale, float maxScale)
+{
+	this->budgetMs = std::max(budgetMs, 0.1);
+	this->minScale = std::clamp(minScale, 0.1f, 1.0f);
+	this->maxScale = std::clamp(maxScale, this->minScale, 1.0f);
+	this->scale = this->maxScale;
+	this->filteredCost = 0.0;
+}
+
+void
+DynamicResolution::update(double gpuMs, float renderScale)
+{
+	if (gpuMs <= 0.0 || renderScale <= 0.0f)
+		return;
+
+	double cost = gpuMs / (static_cast<double>(renderScale) * renderScale);
+	this->filteredCost = this->filteredCost == 0.0 ? cost : this->filteredCost + (cost - this->filteredCost) * SMOOTHING;
+
+	// A spike is acted on right away, recovery follows the smoothed cost
+	double target = this->budgetMs * HEADROOM;
+	float desired = static_cast<float>(std::sqrt(target / std::max(cost, this->filteredCost)));
+
+	if (desired < this->scale)
+		this->scale = desired;
+	else if (desired > this->scale + GROW_DEAD_BAND)
+		this->scale = std::min(desired, this->scale + MAX_GROW_STEP);
+
+	this->scale = std::clamp(this->scale, this->minScale, this->maxScale);
+}
+
+VkExtent2D
+DynamicResolution::renderExtent(VkExtent2D target) const
+{
+	auto scaled = [this](uint32_t size) {
+		uint32_t value = static_cast<uint32_t>(size * this->scale) & ~1u;
+		return std::clamp(value, std::min(size, 2u), size);
+	};
+
+	return { scaled(target.width), scaled(target.height) };
+}
+
+void
+DynamicResolution::report(VkExtent2D target, std::chrono::seconds reportInterval)
+{
+	this->intervalMin = std::min(this->intervalMin, this->scale);
+	this->intervalMax = std::max(this->intervalMax, this->scale);
+	this->intervalScaleSum += this->scale;
+	this->intervalFrames++;
+
+	auto now = std::chrono::steady_clock::now();
+	if (now - this->intervalStart < reportInterval)
+		return;
+
+	VkExtent2D extent = this->renderExtent(target);
+	std::cout << "[PERF] - dynamic resolution: " << extent.width << "x" << extent.height << " (scale "
+		<< this->intervalScaleSum / this->intervalFrames << " avg, " << this->intervalMin << "-" << this->intervalMax
+		<< "), budget " << this->budgetMs << " ms\n";
+
+	this->intervalMin = 1.0f;
+	this->intervalMax = 0.0f;
+	this->intervalScaleSum = 0.0;
+	this->intervalFrames = 0;
+	this->intervalStart = now;
+}
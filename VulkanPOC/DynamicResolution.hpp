@@ -0,0 +1,43 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+
+// Picks the render resolution from measured GPU frame times so the GPU stays within a time budget.
+// GPU time is modelled as proportional to the rendered pixel count, i.e. to scale squared, so each sample is
+// normalised by the scale its frame was rendered at: samples arrive frames late (the slot has to retire first),
+// and without that a single spike would keep shrinking the resolution until the late samples caught up.
+// Over budget the scale drops at once; under budget it only grows in small steps, past a dead band.
+class DynamicResolution {
+public:
+	void configure(double budgetMs, float minScale, float maxScale);
+
+	// GPU time of a frame rendered at renderScale, as returned by getScale when the frame was recorded
+	void update(double gpuMs, float renderScale);
+
+	// Per axis, in [minScale, maxScale]
+	float getScale() const { return this->scale; }
+	double getBudgetMs() const { return this->budgetMs; }
+
+	// The scaled target extent, never below 1x1 and a multiple of 2 so the upscale filter stays symmetric
+	VkExtent2D renderExtent(VkExtent2D target) const;
+
+	// Prints the scale range over the interval, then restarts it
+	void report(VkExtent2D target, std::chrono::seconds reportInterval = std::chrono::seconds(1));
+
+private:
+	double budgetMs = 16.0;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float scale = 1.0f;
+
+	// Milliseconds per unit of scale squared, smoothed
+	double filteredCost = 0.0;
+
+	float intervalMin = 1.0f;
+	float intervalMax = 0.0f;
+	double intervalScaleSum = 0.0;
+	uint64_t intervalFrames = 0;
+	std::chrono::steady_clock::time_point intervalStart = std::chrono::steady_clock::now();
+};
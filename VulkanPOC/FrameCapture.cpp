@@ -0,0 +1,230 @@
+#include "FrameCapture.hpp"
+
+#include <array>
+#include <filesystem>
+
+void
+FrameCapture::init(VkDevice device, ThreadPool* threadPool, uint32_t slotCount, Consumer consumer)
+{
+	this->device = device;
+	this->threadPool = threadPool;
+	this->consumer = std::move(consumer);
+	this->slots.reset(new Slot[slotCount]);
+	this->slotCount = slotCount;
+}
+
+FrameCapture::Slot*
+FrameCapture::acquire()
+{
+	// Round robin, so frames reach the consumer in order as long as it keeps up
+	Slot& slot = this->slots[this->nextSlot];
+
+	if (slot.state.load(std::memory_order_acquire) != SlotState::Free)
+	{
+		this->dropped++;
+		return nullptr;
+	}
+
+	this->nextSlot = (this->nextSlot + 1) % this->slotCount;
+	return &slot;
+}
+
+void
+FrameCapture::submitted(Slot* slot, uint64_t timelineValue)
+{
+	slot->timelineValue = timelineValue;
+	slot->state.store(SlotState::Pending, std::memory_order_release);
+}
+
+void
+FrameCapture::poll(GpuTimeline& timeline)
+{
+	for (uint32_t i = 0; i < this->slotCount; i++)
+	{
+		Slot& slot = this->slots[i];
+
+		if (slot.state.load(std::memory_order_acquire) != SlotState::Pending || !timeline.hasReached(slot.timelineValue))
+			continue;
+
+		if (!slot.coherent)
+		{
+			VkMappedMemoryRange range{};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.memory = slot.memory;
+			range.offset = 0;
+			range.size = VK_WHOLE_SIZE;
+			vkInvalidateMappedMemoryRanges(this->device, 1, &range);
+		}
+
+		slot.state.store(SlotState::Consuming, std::memory_order_release);
+		slot.frame.pixels = slot.mapped;
+
+		// The consumer reads straight out of the mapped buffer, the slot is only reused once it returns
+		this->threadPool->submit([this, &slot]() {
+			if (this->consumer)
+				this->consumer(slot.frame);
+
+			this->captured.fetch_add(1);
+			slot.state.store(SlotState::Free, std::memory_order_release);
+		});
+	}
+}
+
+void
+FrameCapture::flush(GpuTimeline& timeline)
+{
+	for (uint32_t i = 0; i < this->slotCount; i++)
+	{
+		if (this->slots[i].state.load() == SlotState::Pending)
+			timeline.wait(this->slots[i].timelineValue);
+	}
+
+	this->poll(timeline);
+
+	for (uint32_t i = 0; i < this->slotCount; i++)
+	{
+		while (this->slots[i].state.load(std::memory_order_acquire) != SlotState::Free)
+			std::this_thread::yield();
+	}
+}
+
+FrameCapture::Consumer
+FrameCapture::fileWriter(const std::string& directory, bool png)
+{
+	std::filesystem::create_directories(directory);
+
+	return [directory, png](const CapturedFrame& frame) {
+		char name[32];
+		snprintf(name, sizeof(name), "frame_%06llu.%s", static_cast<unsigned long long>(frame.frameNumber), png ? "png" : "raw");
+
+		std::string path = (std::filesystem::path(directory) / name).string();
+		bool written = png ? writePng(path, frame) : writeRaw(path, frame);
+
+		if (!written)
+			std::cerr << "[WARN] - failed to write capture " << path << std::endl;
+	};
+}
+
+bool
+FrameCapture::writeRaw(const std::string& path, const CapturedFrame& frame)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(frame.pixels), static_cast<std::streamsize>(frame.rowPitch) * frame.height);
+	return file.good();
+}
+
+static uint32_t
+crc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+	static const std::array<uint32_t, 256> table = []() {
+		std::array<uint32_t, 256> table{};
+		for (uint32_t i = 0; i < 256; i++)
+		{
+			uint32_t c = i;
+			for (int bit = 0; bit < 8; bit++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+		return table;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void
+appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(uint8_t(value >> 24));
+	out.push_back(uint8_t(value >> 16));
+	out.push_back(uint8_t(value >> 8));
+	out.push_back(uint8_t(value));
+}
+
+static void
+appendChunk(std::vector<uint8_t>& out, const char type[4], const std::vector<uint8_t>& data)
+{
+	appendBigEndian(out, static_cast<uint32_t>(data.size()));
+	size_t typeOffset = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	appendBigEndian(out, crc32(0, out.data() + typeOffset, data.size() + 4));
+}
+
+bool
+FrameCapture::writePng(const std::string& path, const CapturedFrame& frame)
+{
+	bool bgra = frame.format == VK_FORMAT_B8G8R8A8_UNORM || frame.format == VK_FORMAT_B8G8R8A8_SRGB;
+	bool rgba = frame.format == VK_FORMAT_R8G8B8A8_UNORM || frame.format == VK_FORMAT_R8G8B8A8_SRGB;
+	if (!bgra && !rgba)
+		return false;
+
+	// Filter byte + RGB per row, alpha is dropped: the swap chain is composited opaque
+	size_t rowBytes = 1 + size_t(frame.width) * 3;
+	std::vector<uint8_t> scanlines(rowBytes * frame.height);
+
+	for (uint32_t y = 0; y < frame.height; y++)
+	{
+		const uint8_t* src = frame.pixels + size_t(y) * frame.rowPitch;
+		uint8_t* dst = scanlines.data() + y * rowBytes;
+		*dst++ = 0;
+
+		for (uint32_t x = 0; x < frame.width; x++, src += 4)
+		{
+			*dst++ = src[bgra ? 2 : 0];
+			*dst++ = src[1];
+			*dst++ = src[bgra ? 0 : 2];
+		}
+	}
+
+	// zlib stream of stored (uncompressed) deflate blocks: no dependency and cheap enough for a worker thread
+	std::vector<uint8_t> idat = { 0x78, 0x01 };
+	uint32_t adlerA = 1, adlerB = 0;
+
+	for (size_t offset = 0; offset < scanlines.size() || offset == 0; )
+	{
+		uint16_t length = static_cast<uint16_t>(std::min<size_t>(65535, scanlines.size() - offset));
+		bool last = offset + length == scanlines.size();
+
+		idat.push_back(last ? 1 : 0);
+		idat.push_back(uint8_t(length));
+		idat.push_back(uint8_t(length >> 8));
+		idat.push_back(uint8_t(~length));
+		idat.push_back(uint8_t(~length >> 8));
+		idat.insert(idat.end(), scanlines.begin() + offset, scanlines.begin() + offset + length);
+
+		// 5552 bytes is the most that can be summed before the 32 bit sums have to be reduced
+		for (size_t block = offset; block < offset + length; block += 5552)
+		{
+			size_t blockEnd = std::min<size_t>(block + 5552, offset + length);
+			for (size_t i = block; i < blockEnd; i++)
+			{
+				adlerA += scanlines[i];
+				adlerB += adlerA;
+			}
+			adlerA %= 65521;
+			adlerB %= 65521;
+		}
+
+		offset += length;
+		if (last)
+			break;
+	}
+	appendBigEndian(idat, (adlerB << 16) | adlerA);
+
+	std::vector<uint8_t> header;
+	appendBigEndian(header, frame.width);
+	appendBigEndian(header, frame.height);
+	header.insert(header.end(), { 8, 2, 0, 0, 0 }); // 8 bit, truecolor, deflate, no filter, no interlace
+
+	std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	appendChunk(png, "IHDR", header);
+	appendChunk(png, "IDAT", idat);
+	appendChunk(png, "IEND", {});
+
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+	return file.good();
+}
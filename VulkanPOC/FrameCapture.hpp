@@ -0,0 +1,77 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "GpuTimeline.hpp"
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+
+// A rendered frame as it sits in a capture buffer, only valid during the consumer call
+struct CapturedFrame {
+	uint64_t frameNumber = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	uint32_t rowPitch = 0;
+	const uint8_t* pixels = nullptr;
+};
+
+// Ring of persistently mapped host visible buffers that frames are copied into on the GPU. A slot is handed to
+// the consumer on a worker thread once the graphics timeline passed its copy, and goes back to the ring when the
+// consumer returns. Nothing waits: when every slot is busy the frame is skipped and counted as dropped.
+class FrameCapture {
+public:
+	using Consumer = std::function<void(const CapturedFrame&)>;
+
+	enum class SlotState { Free, Pending, Consuming };
+
+	struct Slot {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint8_t* mapped = nullptr;
+		// Host cached memory is usually not coherent and has to be invalidated before the CPU reads it
+		bool coherent = true;
+		uint64_t timelineValue = 0;
+		CapturedFrame frame;
+		std::atomic<SlotState> state{ SlotState::Free };
+	};
+
+	void init(VkDevice device, ThreadPool* threadPool, uint32_t slotCount, Consumer consumer);
+	void setConsumer(Consumer consumer) { this->consumer = std::move(consumer); }
+	bool isEnabled() const { return this->slotCount > 0; }
+
+	// Render thread: a free slot for this frame's copy, nullptr if the ring is full (the frame is dropped)
+	Slot* acquire();
+	// Render thread: the copy into slot was submitted and completes at timelineValue
+	void submitted(Slot* slot, uint64_t timelineValue);
+	// Render thread: hands every completed slot to the consumer, never blocks
+	void poll(GpuTimeline& timeline);
+	// Waits for the GPU and the consumers to finish with every slot
+	void flush(GpuTimeline& timeline);
+
+	Slot* getSlots() { return this->slots.get(); }
+	uint32_t getSlotCount() const { return this->slotCount; }
+	uint64_t getCapturedCount() const { return this->captured.load(); }
+	uint64_t getDroppedCount() const { return this->dropped; }
+
+	// Consumer writing frame_<number>.png (or .raw, pixels as copied) into directory
+	static Consumer fileWriter(const std::string& directory, bool png);
+	static bool writePng(const std::string& path, const CapturedFrame& frame);
+	static bool writeRaw(const std::string& path, const CapturedFrame& frame);
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	ThreadPool* threadPool = nullptr;
+	Consumer consumer;
+
+	std::unique_ptr<Slot[]> slots;
+	uint32_t slotCount = 0;
+	uint32_t nextSlot = 0;
+
+	std::atomic<uint64_t> captured{ 0 };
+	uint64_t dropped = 0;
+};
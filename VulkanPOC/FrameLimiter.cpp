@@ -0,0 +1,39 @@
+#include "FrameLimiter.hpp"
+
+#include <thread>
+
+void
+FrameLimiter::setTargetFps(double fps)
+{
+	this->targetFps = fps > 0.0 ? fps : 0.0;
+	this->period = fps > 0.0
+		? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps))
+		: clock::duration{ 0 };
+	this->nextDeadline = clock::time_point{};
+}
+
+void
+FrameLimiter::wait()
+{
+	if (this->period.count() == 0)
+		return;
+
+	auto now = clock::now();
+
+	// First frame, or we fell more than a frame behind (hitch, breakpoint): restart the cadence instead of bursting to catch up
+	if (this->nextDeadline == clock::time_point{} || now - this->nextDeadline > this->period)
+	{
+		this->nextDeadline = now + this->period;
+		return;
+	}
+
+	if (this->nextDeadline - now > this->spinMargin)
+		std::this_thread::sleep_until(this->nextDeadline - this->spinMargin);
+
+	while (clock::now() < this->nextDeadline)
+	{
+		std::this_thread::yield();
+	}
+
+	this->nextDeadline += this->period;
+}
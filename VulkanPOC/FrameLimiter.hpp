@@ -0,0 +1,28 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+
+// Paces the main loop to a target frame rate. The OS sleep is only accurate to a millisecond or
+// worse (~15ms on a default Windows timer), so it sleeps until spinMargin before the deadline
+// and busy-waits the rest.
+class FrameLimiter {
+public:
+	using clock = std::chrono::steady_clock;
+
+	// fps <= 0 disables the limiter
+	void setTargetFps(double fps);
+	double getTargetFps() const { return this->targetFps; }
+
+	void setSpinMargin(std::chrono::microseconds margin) { this->spinMargin = margin; }
+
+	// Blocks until the next frame deadline, returns immediately when disabled
+	void wait();
+
+private:
+	double targetFps = 0.0;
+	clock::duration period{ 0 };
+	std::chrono::microseconds spinMargin{ 2000 };
+	clock::time_point nextDeadline{};
+};
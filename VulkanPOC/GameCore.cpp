@@ -1,8 +1,10 @@
 #include "GameCore.hpp"
+#include "ParticleReference.hpp"
 
 #include <set>
 #include <cstdint> // Necessary for UINT32_MAX
 #include <algorithm> // Necessary for std::min/std::max
+#include <cctype>
 #include <filesystem>
 namespace fs = std::filesystem;
 
@@ -24,6 +26,17 @@ static std::vector<char> readFile(const std::string& filename) {
 	return buffer;
 }
 
+static const char* presentModeName(VkPresentModeKHR mode) {
+	switch (mode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR: return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "FIFO_RELAXED";
+	default: return "UNKNOWN";
+	}
+}
+
 void 
 GameCore::initWindow()
 {
@@ -32,6 +45,8 @@ GameCore::initWindow()
 	// Options
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	// Golden runs only need the swap chain, not a window on screen
+	glfwWindowHint(GLFW_VISIBLE, this->isGoldenRun() ? GLFW_FALSE : GLFW_TRUE);
 
 	this->window = glfwCreateWindow(this->width, this->height, "Vulkan", nullptr, nullptr);
 
@@ -115,11 +130,14 @@ GameCore::createVulkanInstance()
 		throw std::runtime_error("validation layers requested, but not available!");
 	}
 
-	showAvaialbleExtensions();
+	// Enumerating and printing every extension is measurable at startup, only do it when asked
+	if (this->settings.verboseStartup)
+		showAvaialbleExtensions();
 
 	VkApplicationInfo appInfo{};
 
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// 1.2 for timeline semaphores (1.1 would already be enough for the vkGetPhysicalDeviceFeatures2 queries)
+	appInfo.apiVersion = VK_API_VERSION_1_2;
 	appInfo.applicationVersion = VK_MAKE_API_VERSION(1, 0, 0, 0);
 	appInfo.engineVersion = VK_MAKE_API_VERSION(1, 0, 0, 0);
 	appInfo.pEngineName = "No Engine";
@@ -147,6 +165,8 @@ GameCore::createVulkanInstance()
 
 		VkDebugUtilsMessengerCreateInfoEXT debugCreateInfo{};
 
+		// Instance creation / destruction already report through this messenger
+		this->debugLog.start();
 		this->populateDebugMessengerCreateInfo(debugCreateInfo);
 		createInfo.pNext = (VkDebugUtilsMessengerCreateInfoEXT*)&debugCreateInfo;
 	}
@@ -157,7 +177,7 @@ GameCore::createVulkanInstance()
 	}
 
 	// Finally create the instance
-	VkResult res = vkCreateInstance(&createInfo, nullptr, &this->instance);
+	VkResult res = vkCreateInstance(&createInfo, this->allocationCallbacks(), &this->instance);
 
 	if (res != VK_SUCCESS)
 		throw std::runtime_error("Unable to create vulkan instance");
@@ -176,28 +196,88 @@ GameCore::pickPhysicalDevice()
 
 	vkEnumeratePhysicalDevices(this->instance, &deviceCount, devices.data());
 
-	std::multimap<int, VkPhysicalDevice> orderedDevices;
+	std::string deviceOverride = this->settings.device.deviceOverride;
+	if (deviceOverride.empty())
+	{
+		const char* environment = std::getenv("VKPOC_DEVICE");
+		deviceOverride = environment ? environment : "";
+	}
 
-	for (const auto& device : devices)
+	int bestScore = 0;
+
+	for (uint32_t i = 0; i < deviceCount; i++)
 	{
-		if (isDeviceSuitable(device))
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(devices[i], &properties);
+
+		std::string reason;
+		bool suitable = this->isDeviceSuitable(devices[i], reason);
+
+		if (!deviceOverride.empty())
 		{
-			orderedDevices.insert(std::make_pair(this->rateDeviceSuitability(device), device));
+			if (!this->matchesDeviceOverride(devices[i], i, deviceOverride))
+				continue;
+
+			if (!suitable)
+				throw std::runtime_error("device " + std::to_string(i) + " (" + properties.deviceName + ") selected by override is not usable: " + reason);
+
+			std::cout << "[INFO] - device " << i << " (" << properties.deviceName << "): selected by override " << deviceOverride << std::endl;
+			this->physicalDevice = devices[i];
+			break;
 		}
-	}
 
-	if (orderedDevices.size() == 0)
-	{
-		throw std::runtime_error("No devices suitable");
+		if (!suitable)
+		{
+			std::cout << "[INFO] - device " << i << " (" << properties.deviceName << "): rejected, " << reason << std::endl;
+			continue;
+		}
+
+		std::string breakdown;
+		int score = this->rateDeviceSuitability(devices[i], breakdown);
+
+		std::cout << "[INFO] - device " << i << " (" << properties.deviceName << "): accepted, score " << score << " (" << breakdown << ")" << std::endl;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			this->physicalDevice = devices[i];
+		}
 	}
 
-	if (orderedDevices.rbegin()->first <= 0)
+	if (this->physicalDevice == VK_NULL_HANDLE)
 	{
+		if (!deviceOverride.empty())
+			throw std::runtime_error("no device matches override " + deviceOverride);
+
 		throw std::runtime_error("No devices suitable for application");
 	}
 
-
-	this->physicalDevice = orderedDevices.rbegin()->second;
+	VkPhysicalDeviceProperties selectedProperties;
+	vkGetPhysicalDeviceProperties(this->physicalDevice, &selectedProperties);
+	std::cout << "[INFO] - using " << selectedProperties.deviceName << std::endl;
+
+	this->dynamicRenderingEnabled = this->settings.preferDynamicRendering && this->checkDynamicRenderingSupport(this->physicalDevice);
+	this->presentWaitEnabled = this->checkPresentWaitSupport(this->physicalDevice);
+	this->memoryBudgetEnabled = this->checkMemoryBudgetSupport(this->physicalDevice);
+
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(this->physicalDevice, &supportedFeatures);
+	this->pipelineStatisticsEnabled = this->settings.pipelineStatistics && supportedFeatures.pipelineStatisticsQuery;
+	this->multiDrawIndirectEnabled = supportedFeatures.multiDrawIndirect;
+	this->inheritedQueriesEnabled = this->settings.cacheCommandBuffers && this->pipelineStatisticsEnabled && supportedFeatures.inheritedQueries;
+	// The cull shader hands every instance its transform slot through firstInstance
+	this->occlusionCullingEnabled = this->settings.occlusionCulling && supportedFeatures.drawIndirectFirstInstance;
+	this->depthFormat = this->findDepthFormat(this->physicalDevice);
+	this->meshShaderEnabled = this->settings.meshletRendering && this->settings.preferMeshShaders && this->checkMeshShaderSupport(this->physicalDevice);
+	this->pipelineLibraryEnabled = this->settings.pipelineLibrary && this->checkPipelineLibrarySupport(this->physicalDevice);
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(this->physicalDevice, &familyCount, families.data());
+
+	if (families[this->findQueueFamilies(this->physicalDevice).graphicsFamily.value()].timestampValidBits > 0)
+		this->timestampPeriod = selectedProperties.limits.timestampPeriod;
 }
 
 void 
@@ -206,7 +286,7 @@ GameCore::createLogicalDevice()
 	QueueFamilyIndices indices = this->findQueueFamilies(this->physicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value() };
 
 	//VkDeviceQueueCreateInfo queueCreateInfo{};
 	//queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -215,17 +295,28 @@ GameCore::createLogicalDevice()
 	//float queuePriority = 1.0f;
 	//queueCreateInfo.pQueuePriorities = &queuePriority;
 
-	float queuePriority = 1.0f;
+	// Compute may take a second queue of the graphics family
+	float queuePriorities[] = { 1.0f, 1.0f };
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
 		VkDeviceQueueCreateInfo queueCreateInfo{};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
 		queueCreateInfo.queueFamilyIndex = queueFamily;
-		queueCreateInfo.queueCount = 1;
-		queueCreateInfo.pQueuePriorities = &queuePriority;
+		queueCreateInfo.queueCount = queueFamily == indices.computeFamily.value() ? indices.computeQueueIndex + 1 : 1;
+		queueCreateInfo.pQueuePriorities = queuePriorities;
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
-	VkPhysicalDeviceFeatures deviceFeatures{};
+	VkPhysicalDeviceFeatures deviceFeatures = this->settings.device.requiredFeatures;
+	if (this->pipelineStatisticsEnabled)
+		deviceFeatures.pipelineStatisticsQuery = VK_TRUE;
+	if (this->multiDrawIndirectEnabled)
+		deviceFeatures.multiDrawIndirect = VK_TRUE;
+	if (this->occlusionCullingEnabled)
+		deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	if (this->inheritedQueriesEnabled)
+		deviceFeatures.inheritedQueries = VK_TRUE;
+
+	std::vector<const char*> enabledExtensions(this->deviceExtensions.begin(), this->deviceExtensions.end());
 
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -233,8 +324,74 @@ GameCore::createLogicalDevice()
 	createInfo.queueCreateInfoCount = queueCreateInfos.size();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = this->deviceExtensions.size();
-	createInfo.ppEnabledExtensionNames = this->deviceExtensions.data();
+	// All GPU/CPU synchronization goes through timeline semaphores (core in 1.2, but still a feature to enable)
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+	createInfo.pNext = &timelineFeatures;
+
+	// Dynamic rendering is an extension on 1.1/1.2, and it depends on the renderpass2 + depth stencil resolve extensions
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+	if (this->dynamicRenderingEnabled)
+	{
+		enabledExtensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME);
+		dynamicRenderingFeatures.pNext = timelineFeatures.pNext;
+		timelineFeatures.pNext = &dynamicRenderingFeatures;
+	}
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
+
+	if (this->presentWaitEnabled)
+	{
+		enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		presentWaitFeatures.pNext = &presentIdFeatures;
+		presentIdFeatures.pNext = timelineFeatures.pNext;
+		timelineFeatures.pNext = &presentWaitFeatures;
+	}
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	meshShaderFeatures.taskShader = VK_TRUE;
+	meshShaderFeatures.meshShader = VK_TRUE;
+
+	if (this->meshShaderEnabled)
+	{
+		enabledExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_SPIRV_1_4_EXTENSION_NAME);
+		meshShaderFeatures.pNext = timelineFeatures.pNext;
+		timelineFeatures.pNext = &meshShaderFeatures;
+	}
+
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+	pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	pipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+	if (this->pipelineLibraryEnabled)
+	{
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		pipelineLibraryFeatures.pNext = timelineFeatures.pNext;
+		timelineFeatures.pNext = &pipelineLibraryFeatures;
+	}
+
+	// Only adds a query struct, no feature to enable
+	if (this->memoryBudgetEnabled)
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	createInfo.enabledExtensionCount = enabledExtensions.size();
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (this->enableValidationLayers)
 	{
@@ -246,13 +403,85 @@ GameCore::createLogicalDevice()
 		createInfo.enabledLayerCount = 0;
 	}
 
-	if(vkCreateDevice(this->physicalDevice, &createInfo, nullptr, &this->device) != VK_SUCCESS)
+	if(vkCreateDevice(this->physicalDevice, &createInfo, this->allocationCallbacks(), &this->device) != VK_SUCCESS)
 		throw std::runtime_error("failed to create logical device!");
 		
 	// Since we only have 1 queue from that family queue we get at indx 0
 	vkGetDeviceQueue(this->device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 
-	vkGetDeviceQueue(this->device, indices.graphicsFamily.value(), 0, &presentQueue);
+	vkGetDeviceQueue(this->device, indices.presentFamily.value(), 0, &presentQueue);
+
+	vkGetDeviceQueue(this->device, indices.computeFamily.value(), indices.computeQueueIndex, &computeQueue);
+
+	this->loadDeviceFunctions();
+
+	this->asyncCompute.create(this->device, this->computeQueue, indices.computeFamily.value(), this->graphicsQueue, indices.graphicsFamily.value(), this->allocationCallbacks());
+	// Reported from the flag itself, it is what decides the async paths later on
+	if (this->HasAsyncCompute())
+		std::cout << "[INFO] - async compute on queue family " << indices.computeFamily.value() << " index " << indices.computeQueueIndex << std::endl;
+	else
+		std::cout << "[WARN] - no separate compute queue, compute work shares the graphics queue" << std::endl;
+
+	this->memoryTelemetry.init(this->physicalDevice, this->memoryBudgetEnabled);
+	if (!this->memoryBudgetEnabled)
+		std::cout << "[WARN] - " << VK_EXT_MEMORY_BUDGET_EXTENSION_NAME << " not supported, memory budgets are estimated" << std::endl;
+
+	this->gpuQueries.create(this->device, MAX_FRAMES_IN_FLIGHT, this->settings.maxOcclusionQueries, this->pipelineStatisticsEnabled,
+		this->timestampPeriod, this->allocationCallbacks());
+	if (this->settings.pipelineStatistics && !this->pipelineStatisticsEnabled)
+		std::cout << "[WARN] - pipelineStatisticsQuery not supported, no pipeline statistics" << std::endl;
+
+	this->pipelineLibrary.create(this->device, &this->threadPool, this->pipelineLibraryEnabled, this->allocationCallbacks());
+	if (this->pipelineLibraryEnabled)
+		std::cout << "[INFO] - graphics pipelines are fast-linked from pipeline libraries" << std::endl;
+	else if (this->settings.pipelineLibrary)
+		std::cout << "[WARN] - " << VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME << " not supported, graphics pipelines are compiled whole" << std::endl;
+
+	DynamicResolutionSettings& resolution = this->settings.dynamicResolution;
+	if (resolution.enabled && !this->gpuQueries.hasTimestamps())
+	{
+		std::cout << "[WARN] - graphics queue has no timestamps, dynamic resolution disabled" << std::endl;
+		resolution.enabled = false;
+	}
+
+	if (resolution.enabled)
+	{
+		double targetFps = this->settings.present.targetFps > 0.0 ? this->settings.present.targetFps : 60.0;
+		double budgetMs = resolution.gpuBudgetMs > 0.0 ? resolution.gpuBudgetMs : 1000.0 / targetFps;
+		this->dynamicResolution.configure(budgetMs, resolution.minScale, resolution.maxScale);
+
+		std::cout << "[INFO] - dynamic resolution: " << this->dynamicResolution.getBudgetMs() << " ms gpu budget, scale "
+			<< resolution.minScale << "-" << resolution.maxScale << std::endl;
+	}
+}
+
+void
+GameCore::loadDeviceFunctions()
+{
+	if (this->presentWaitEnabled)
+	{
+		this->waitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(this->device, "vkWaitForPresentKHR");
+		this->presentWaitEnabled = this->waitForPresent != nullptr;
+	}
+
+	if (this->meshShaderEnabled)
+	{
+		this->drawMeshTasks = (PFN_vkCmdDrawMeshTasksEXT)vkGetDeviceProcAddr(this->device, "vkCmdDrawMeshTasksEXT");
+		this->meshShaderEnabled = this->drawMeshTasks != nullptr;
+	}
+
+	if (!this->dynamicRenderingEnabled)
+		return;
+
+	// Extension commands are not exported by the loader, they have to be fetched from the device
+	this->cmdBeginRendering = (PFN_vkCmdBeginRenderingKHR)vkGetDeviceProcAddr(this->device, "vkCmdBeginRenderingKHR");
+	this->cmdEndRendering = (PFN_vkCmdEndRenderingKHR)vkGetDeviceProcAddr(this->device, "vkCmdEndRenderingKHR");
+
+	if (this->cmdBeginRendering == nullptr || this->cmdEndRendering == nullptr)
+	{
+		std::cerr << "[WARN] - vkCmdBeginRenderingKHR not found, falling back to render passes" << std::endl;
+		this->dynamicRenderingEnabled = false;
+	}
 }
 
 SwapChainSupportDetails 
@@ -295,7 +524,7 @@ GameCore::createSurface()
 	//if(vkCreateWin32SurfaceKHR(this->instance, &createInfo, nullptr, &this->surface) != VK_SUCCESS)
 	//	throw std::runtime_error("failed to create window surface!");
 
-	if(glfwCreateWindowSurface(this->instance, this->window, nullptr, &this->surface) != VK_SUCCESS)
+	if(glfwCreateWindowSurface(this->instance, this->window, this->allocationCallbacks(), &this->surface) != VK_SUCCESS)
 		throw std::runtime_error("failed to create window surface!");
 }
 
@@ -314,16 +543,22 @@ GameCore::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availab
 
 VkPresentModeKHR
 GameCore::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-	// (commonly found presentation) This is most similar to vertical sync as found in modern games. The moment that the display is refreshed is known as "vertical blank".
+	/*IMMEDIATE: lowest latency, tears.
+	MAILBOX: low latency without tearing, but renders frames that are never shown (uses a lot of energy, not suitable for mobiles).
+	FIFO: vertical sync, the CPU/GPU idle once the queue is full, lowest power.
+	FIFO_RELAXED: vertical sync, but a late frame is presented immediately (tears) instead of waiting another vblank.*/
+	VkPresentModeKHR requested = this->settings.present.presentMode;
+
 	for (const auto& present : availablePresentModes)
 	{
-		// Uses a lot of energy not suitable for mobiles but most performant
-		if (present == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (present == requested)
 		{
 			return present;
 		}
 	}
 
+	// (commonly found presentation) This is most similar to vertical sync as found in modern games. The moment that the display is refreshed is known as "vertical blank".
+	std::cerr << "[WARN] - present mode " << presentModeName(requested) << " not supported by the surface, using FIFO" << std::endl;
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -348,8 +583,21 @@ GameCore::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
 }
 
 
+bool
+GameCore::surfaceIsEmpty()
+{
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(this->window, &width, &height);
+
+	// Some platforms report a zero current extent for a minimized window before its framebuffer size changes
+	VkSurfaceCapabilitiesKHR capabilities;
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(this->physicalDevice, this->surface, &capabilities);
+
+	return width == 0 || height == 0 || capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0;
+}
+
 void
-GameCore::createSwapChain()
+GameCore::createSwapChain(VkSwapchainKHR oldSwapChain)
 {
 	SwapChainSupportDetails swapChainSupport = this->querySwapChainSupport(this->physicalDevice);
 
@@ -358,8 +606,14 @@ GameCore::createSwapChain()
 	VkExtent2D extent = this->chooseSwapExtent(swapChainSupport.capabilities);
 
 	// How many images in the swap chain, recommende dto request at least one more image 
+	// Fewer images = less queued latency, more images = fewer stalls waiting on the presentation engine
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 
+	if (this->settings.present.imageCount > 0)
+	{
+		imageCount = std::max(this->settings.present.imageCount, swapChainSupport.capabilities.minImageCount);
+	}
+
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 	{
 		imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -381,6 +635,48 @@ GameCore::createSwapChain()
 	to transfer the rendered image to a swap chain image.*/
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	// Frame capture copies straight out of the swap chain images
+	if (this->settings.capture.enabled)
+	{
+		if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		else
+		{
+			std::cout << "[WARN] - surface doesn't allow copying from swap chain images, capture disabled" << std::endl;
+			this->settings.capture.enabled = false;
+		}
+	}
+
+	// Mirror windows render in the swap chain format and blit their view to their own swap chain
+	if (this->settings.mirrorWindows > 0)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(this->physicalDevice, surfaceFormat.format, &properties);
+
+		if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT))
+		{
+			std::cout << "[WARN] - the swap chain format can't be the source of a blit, no mirror windows" << std::endl;
+			this->settings.mirrorWindows = 0;
+		}
+	}
+
+	// The scene is rendered off screen and blitted, scaled, into the swap chain image
+	if (this->settings.dynamicResolution.enabled)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(this->physicalDevice, surfaceFormat.format, &properties);
+		VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+			VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+		if ((swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) && (properties.optimalTilingFeatures & required) == required)
+			createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		else
+		{
+			std::cout << "[WARN] - swap chain images can't be the target of a filtered blit, dynamic resolution disabled" << std::endl;
+			this->settings.dynamicResolution.enabled = false;
+		}
+	}
+
 
 	QueueFamilyIndices indices = this->findQueueFamilies(this->physicalDevice);
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
@@ -414,10 +710,10 @@ GameCore::createSwapChain()
 	
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE; // best performance
-	createInfo.oldSwapchain = VK_NULL_HANDLE; // FOR NOW WE WIL LASSSUME ONLY 1 SWAPCHAINM WILL BE CREATED
-	// AS IF THE WINDOW IS REZIED THE SWAP CHAIN NEEDS TO BE RECREATED FEROM SCRATCH, AND A REFERENCE TO TH EOLD ONE MUST BE SPECIFIED.
+	// WHEN THE SWAP CHAIN IS RECREATED (PRESENT POLICY CHANGE, OUT OF DATE SURFACE) A REFERENCE TO THE OLD ONE MUST BE SPECIFIED.
+	createInfo.oldSwapchain = oldSwapChain;
 
-	if(vkCreateSwapchainKHR(this->device, &createInfo, nullptr, &this->swapChain) != VK_SUCCESS) 
+	if(vkCreateSwapchainKHR(this->device, &createInfo, this->allocationCallbacks(), &this->swapChain) != VK_SUCCESS) 
 		throw std::runtime_error("failed to create swap chain!");
 
 	uint32_t swapChainCount = 0;
@@ -427,7 +723,84 @@ GameCore::createSwapChain()
 
 	this->swapChainImageFormat = surfaceFormat.format;
 	this->swapChainExtent = extent;
+	this->renderExtent = extent;
+
+	std::cout << "[INFO] - swap chain: " << swapChainCount << " images, present mode " << presentModeName(presentMode) << std::endl;
+}
+
+void
+GameCore::destroySwapChainResources()
+{
+	for (auto frameBuffer : this->swapChainFramebuffers)
+	{
+		vkDestroyFramebuffer(this->device, frameBuffer, this->allocationCallbacks());
+	}
+
+	for (auto imageView : this->swapChainImageViews)
+	{
+		vkDestroyImageView(this->device, imageView, this->allocationCallbacks());
+	}
+
+	this->swapChainFramebuffers.clear();
+	this->swapChainImageViews.clear();
+
+	this->destroyDepthResources();
+	this->destroySceneColorTarget();
+}
+
+void
+GameCore::recreateSwapChain()
+{
+	// Minimized: a swap chain can't be created for a 0x0 surface, so block until the window has a size again. Closing
+	// the window meanwhile leaves the swap chain dirty and the frame is skipped.
+	while (this->surfaceIsEmpty())
+	{
+		if (glfwWindowShouldClose(this->window))
+			return;
+		glfwWaitEvents();
+	}
+
+	// Not a hot path (policy change or out of date surface), so simply drain the GPU instead of tracking every image
+	vkDeviceWaitIdle(this->device);
+	this->rendererMetrics.swapChainRecreations.fetch_add(1, std::memory_order_relaxed);
+
+	this->destroySwapChainResources();
+
+	// Present ids of the old swap chain can no longer be waited on, nor waited for once it is destroyed
+	this->latencyTracker.reset();
+
+	VkSwapchainKHR oldSwapChain = this->swapChain;
+	this->createSwapChain(oldSwapChain);
+	vkDestroySwapchainKHR(this->device, oldSwapChain, this->allocationCallbacks());
+
+	this->createImageViews();
+	this->createDepthResources();
+	this->createSceneColorTarget();
+
+	// The image format does not change for the same surface, so the render pass and pipeline stay valid
+	if (!this->dynamicRenderingEnabled)
+		this->createFrameBuffers();
+
+	// The image count may have changed
+	this->destroyRenderFinishedSemaphores();
+	this->createRenderFinishedSemaphores();
 
+	this->swapChainFirstPresentId = this->presentId + 1;
+
+	this->swapChainDirty = false;
+}
+
+void
+GameCore::SetPresentPolicy(const PresentPolicy& policy)
+{
+	bool swapChainChanged = policy.presentMode != this->settings.present.presentMode ||
+		policy.imageCount != this->settings.present.imageCount;
+
+	this->settings.present = policy;
+	this->frameLimiter.setTargetFps(policy.targetFps);
+
+	if (swapChainChanged)
+		this->swapChainDirty = true;
 }
 
 void
@@ -459,13 +832,270 @@ GameCore::createImageViews()
 		VkImageView imageView;
 		/*An image view is sufficient to start using an image as a texture, but it's not quite ready to be used as a render target just yet. 
 		That requires one more step of indirection, known as a framebuffer. But first we'll have to set up the graphics pipeline.*/
-		if(vkCreateImageView(this->device, &createInfo, nullptr, &imageView) != VK_SUCCESS)
+		if(vkCreateImageView(this->device, &createInfo, this->allocationCallbacks(), &imageView) != VK_SUCCESS)
 			throw std::runtime_error("failed to create image views!");
 
 		this->swapChainImageViews.push_back(imageView);
 	}
 }
 
+VkFormat
+GameCore::findDepthFormat(VkPhysicalDevice device)
+{
+	// Sampled as well, the depth pyramid is reduced straight from the depth buffer
+	VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+	for (VkFormat format : candidates)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(device, format, &properties);
+
+		if ((properties.optimalTilingFeatures & required) == required)
+			return format;
+	}
+
+	throw std::runtime_error("failed to find a supported depth format!");
+}
+
+void
+GameCore::createDepthResources()
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = this->depthFormat;
+	imageInfo.extent = { this->swapChainExtent.width, this->swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(this->device, &imageInfo, this->allocationCallbacks(), &this->depthImage) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth image!");
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(this->device, this->depthImage, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	this->allocateMemory(allocInfo, memRequirements.size, this->depthMemory);
+	vkBindImageMemory(this->device, this->depthImage, this->depthMemory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = this->depthImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = this->depthFormat;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+	// A view used as an attachment has to cover every aspect of the format, a sampled one exactly one
+	if (this->depthFormat != VK_FORMAT_D32_SFLOAT)
+		viewInfo.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), &this->depthView) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth image view!");
+
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), &this->depthSampleView) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth image view!");
+
+	if (!this->hizCulling.isEnabled())
+		return;
+
+	// Full resolution level 0, so the first reduction is a plain copy of the farthest depth per texel
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(this->swapChainExtent.width, this->swapChainExtent.height); size > 1; size >>= 1)
+		levels++;
+	levels = std::min(levels, HiZCulling::MAX_PYRAMID_LEVELS);
+
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.mipLevels = levels;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+	if (vkCreateImage(this->device, &imageInfo, this->allocationCallbacks(), &this->depthPyramid) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth pyramid!");
+
+	vkGetImageMemoryRequirements(this->device, this->depthPyramid, &memRequirements);
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	this->allocateMemory(allocInfo, memRequirements.size, this->depthPyramidMemory);
+	vkBindImageMemory(this->device, this->depthPyramid, this->depthPyramidMemory, 0);
+
+	viewInfo.image = this->depthPyramid;
+	viewInfo.format = VK_FORMAT_R32_SFLOAT;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+
+	if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), &this->depthPyramidView) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth pyramid view!");
+
+	this->depthPyramidLevels.resize(levels);
+	for (uint32_t level = 0; level < levels; level++)
+	{
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+		if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), &this->depthPyramidLevels[level]) != VK_SUCCESS)
+			throw std::runtime_error("failed to create depth pyramid view!");
+	}
+
+	this->hizCulling.setDepthPyramid(this->depthSampleView, this->depthPyramid, this->depthPyramidLevels, this->depthPyramidView, this->swapChainExtent);
+}
+
+void
+GameCore::destroyDepthResources()
+{
+	for (VkImageView view : this->depthPyramidLevels)
+		vkDestroyImageView(this->device, view, this->allocationCallbacks());
+	this->depthPyramidLevels.clear();
+
+	if (this->depthPyramid != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(this->device, this->depthPyramidView, this->allocationCallbacks());
+		vkDestroyImage(this->device, this->depthPyramid, this->allocationCallbacks());
+		this->freeMemory(this->depthPyramidMemory);
+		this->depthPyramid = VK_NULL_HANDLE;
+		this->depthPyramidView = VK_NULL_HANDLE;
+	}
+
+	if (this->depthImage != VK_NULL_HANDLE)
+	{
+		vkDestroyImageView(this->device, this->depthSampleView, this->allocationCallbacks());
+		vkDestroyImageView(this->device, this->depthView, this->allocationCallbacks());
+		vkDestroyImage(this->device, this->depthImage, this->allocationCallbacks());
+		this->freeMemory(this->depthMemory);
+		this->depthImage = VK_NULL_HANDLE;
+		this->depthView = VK_NULL_HANDLE;
+		this->depthSampleView = VK_NULL_HANDLE;
+	}
+}
+
+void
+GameCore::createSceneColorTarget()
+{
+	if (!this->settings.dynamicResolution.enabled)
+		return;
+
+	// Full size, a scale change only moves the render area, nothing is reallocated
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = this->swapChainImageFormat;
+	imageInfo.extent = { this->swapChainExtent.width, this->swapChainExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(this->device, &imageInfo, this->allocationCallbacks(), &this->sceneColorImage) != VK_SUCCESS)
+		throw std::runtime_error("failed to create scene color image!");
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(this->device, this->sceneColorImage, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	this->allocateMemory(allocInfo, memRequirements.size, this->sceneColorMemory);
+	vkBindImageMemory(this->device, this->sceneColorImage, this->sceneColorMemory, 0);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = this->sceneColorImage;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = this->swapChainImageFormat;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), &this->sceneColorView) != VK_SUCCESS)
+		throw std::runtime_error("failed to create scene color image view!");
+
+	this->renderExtent = this->dynamicResolution.renderExtent(this->swapChainExtent);
+}
+
+void
+GameCore::destroySceneColorTarget()
+{
+	if (this->sceneColorImage == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyImageView(this->device, this->sceneColorView, this->allocationCallbacks());
+	vkDestroyImage(this->device, this->sceneColorImage, this->allocationCallbacks());
+	this->freeMemory(this->sceneColorMemory);
+	this->sceneColorImage = VK_NULL_HANDLE;
+	this->sceneColorView = VK_NULL_HANDLE;
+}
+
+VkImage
+GameCore::mainColorImage(uint32_t imageIndex) const
+{
+	return this->settings.dynamicResolution.enabled ? this->sceneColorImage : this->swapChainImages[imageIndex];
+}
+
+VkImageView
+GameCore::mainColorView(uint32_t imageIndex) const
+{
+	return this->settings.dynamicResolution.enabled ? this->sceneColorView : this->swapChainImageViews[imageIndex];
+}
+
+VkImageLayout
+GameCore::mainColorLayout() const
+{
+	return this->settings.dynamicResolution.enabled ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+void
+GameCore::recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!this->settings.dynamicResolution.enabled)
+		return;
+
+	// The main pass left the scene color target in TRANSFER_SRC_OPTIMAL. The swap chain image's old content is not
+	// needed; its acquire is waited for at the transfer stage, which this barrier chains onto.
+	VkImageMemoryBarrier toTransfer{};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.srcAccessMask = 0;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = this->swapChainImages[imageIndex];
+	toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkImageBlit region{};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.srcOffsets[1] = { static_cast<int32_t>(this->renderExtent.width), static_cast<int32_t>(this->renderExtent.height), 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstOffsets[1] = { static_cast<int32_t>(this->swapChainExtent.width), static_cast<int32_t>(this->swapChainExtent.height), 1 };
+
+	bool scaled = this->renderExtent.width != this->swapChainExtent.width || this->renderExtent.height != this->swapChainExtent.height;
+	vkCmdBlitImage(commandBuffer, this->sceneColorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		this->swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, scaled ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+
+	VkImageMemoryBarrier toPresent = toTransfer;
+	toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toPresent.dstAccessMask = 0;
+	toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toPresent);
+}
+
 VkShaderModule 
 GameCore::createShaderModule(const std::vector<char>& code) {
 	VkShaderModuleCreateInfo createInfo{};
@@ -474,7 +1104,7 @@ GameCore::createShaderModule(const std::vector<char>& code) {
 	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
 
 	VkShaderModule shaderModule;
-	if(vkCreateShaderModule(this->device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+	if(vkCreateShaderModule(this->device, &createInfo, this->allocationCallbacks(), &shaderModule) != VK_SUCCESS)
 		throw std::runtime_error("failed to create shader module!");
 
 	return shaderModule;
@@ -521,7 +1151,7 @@ means that we don't care what previous layout the image was in. The caveat of th
 image are not guaranteed to be preserved, but that doesn't matter since we're going to clear it anyway. We want the image to be ready for presentation
 using the swap chain after rendering, which is why we use VK_IMAGE_LAYOUT_PRESENT_SRC_KHR as finalLayout.*/
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = this->mainColorLayout();
 
 
 	// Subpasses and attachment references
@@ -537,27 +1167,87 @@ pInputAttachments: Attachments that are read from a shader
 pResolveAttachments: Attachments used for multisampling color attachments
 pDepthStencilAttachment: Attachment for depth and stencil data
 pPreserveAttachments: Attachments that are not used by this subpass, but for which the data must be preserved*/
+	VkAttachmentReference depthAttachmentRef{};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
 	VkSubpassDescription subpass{};
 	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	// Depth is kept after the pass and left readable, the Hi-Z pyramid is built from it between the two culling passes
+	VkAttachmentDescription depthAttachment{};
+	depthAttachment.format = this->depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	// In: the previous frame's depth writes, pyramid reads and upscale, the swap chain image acquire. Out: the pyramid
+	// reduction, the second pass, the upscale and the frame capture copy.
+	VkSubpassDependency dependencies[2]{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+		VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+	VkAttachmentDescription attachments[2] = { colorAttachment, depthAttachment };
 
 	VkRenderPassCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	createInfo.attachmentCount = 1;
-	createInfo.pAttachments = &colorAttachment;
+	createInfo.attachmentCount = 2;
+	createInfo.pAttachments = attachments;
 	createInfo.subpassCount = 1;
 	createInfo.pSubpasses = &subpass;
+	createInfo.dependencyCount = 2;
+	createInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(this->device, &createInfo, this->allocationCallbacks(), &this->renderPass) != VK_SUCCESS)
+		throw std::runtime_error("failed to create render pass!");
+
+	// Compatible with the first one (same formats), so the framebuffers and pipelines work with both
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[0].initialLayout = this->mainColorLayout();
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	if (vkCreateRenderPass(this->device, &createInfo, this->allocationCallbacks(), &this->loadRenderPass) != VK_SUCCESS)
+		throw std::runtime_error("failed to create render pass!");
 
-	if (vkCreateRenderPass(this->device, &createInfo, nullptr, &this->renderPass) != VK_SUCCESS)
+	if (this->settings.mirrorWindows == 0)
+		return;
+
+	// Also compatible, a mirror window's color target is only blitted out of after the pass
+	attachments[0] = colorAttachment;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	attachments[1] = depthAttachment;
+
+	if (vkCreateRenderPass(this->device, &createInfo, this->allocationCallbacks(), &this->windowRenderPass) != VK_SUCCESS)
 		throw std::runtime_error("failed to create render pass!");
 }
 
 void
 GameCore::createGraphicsPipeline()
 {
-	auto vertShaderCode = readFile("shaders/vert.spv");
-	auto fragShaderCode = readFile("shaders/frag.spv");
+	auto vertShaderCode = this->readAsset("shaders/vert.spv");
+	auto fragShaderCode = this->readAsset("shaders/frag.spv");
 
 	VkShaderModule vertShaderModule = this->createShaderModule(vertShaderCode);
 	VkShaderModule fragShaderModule = this->createShaderModule(fragShaderCode);
@@ -670,6 +1360,12 @@ Using any mode other than fill requires enabling a GPU feature.*/
 	multisampling.alphaToOneEnable = VK_FALSE; // Optional
 
 	// Depth and stencil testing
+	// The triangle is a backdrop, it neither tests nor writes depth (but the render pass has a depth attachment)
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_FALSE;
+	depthStencil.depthWriteEnable = VK_FALSE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
 
 	// Color blending
 	/*After a fragment shader has returned a color, it needs to be combined with the color that is already in the framebuffer. 
@@ -729,7 +1425,7 @@ g them until a future chapter, we are still required to create an empty pipeline
 	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
 	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
 
-	if(vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &this->pipelineLayout) != VK_SUCCESS)
+	if(vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, this->allocationCallbacks(), &this->pipelineLayout) != VK_SUCCESS)
 		throw std::runtime_error("failed to create pipeline layout!");
 
 
@@ -742,6 +1438,7 @@ g them until a future chapter, we are still required to create an empty pipeline
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
 	pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = pipelineLayout;
@@ -749,339 +1446,3198 @@ g them until a future chapter, we are still required to create an empty pipeline
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create graphics pipeline!");
+	// With dynamic rendering the pipeline only needs to know the attachment formats, not a compatible render pass
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &this->swapChainImageFormat;
+	renderingInfo.depthAttachmentFormat = this->depthFormat;
+	renderingInfo.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+	if (this->dynamicRenderingEnabled)
+	{
+		pipelineInfo.pNext = &renderingInfo;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
 	}
 
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	this->pipelineLibrary.createPipeline(pipelineInfo, "triangle", this->graphicsPipeline);
+
+	vkDestroyShaderModule(device, fragShaderModule, this->allocationCallbacks());
+	vkDestroyShaderModule(device, vertShaderModule, this->allocationCallbacks());
 }
 
 void
-GameCore::createFrameBuffers()
+GameCore::createMeshPipeline()
 {
-	for (const auto& imageView : this->swapChainImageViews)
+	if (!this->hasAsset("shaders/mesh_vert.spv") || !this->hasAsset("shaders/mesh_frag.spv"))
 	{
-		VkFramebufferCreateInfo frameBufferInfo{};
-		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		frameBufferInfo.renderPass = this->renderPass;
-		frameBufferInfo.attachmentCount = 1;
-		frameBufferInfo.pAttachments = nullptr;
-		frameBufferInfo.pAttachments = &imageView;
-		frameBufferInfo.width = this->swapChainExtent.width;
-		frameBufferInfo.height = this->swapChainExtent.height;
-		frameBufferInfo.layers = 1;
-		frameBufferInfo.pNext = nullptr;
+		std::cout << "[WARN] - shaders/mesh_*.spv not found (built by the Shaders target), scene meshes are not drawn" << std::endl;
+		return;
+	}
 
-		VkFramebuffer frameBuffer{};
-		if(vkCreateFramebuffer(this->device, &frameBufferInfo, nullptr, &frameBuffer) != VK_SUCCESS) 
-			throw std::runtime_error("failed to create framebuffer!");
+	// The transform of an instance is fetched with gl_InstanceIndex, which is the draw's firstInstance
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-		this->swapChainFramebuffers.push_back(frameBuffer);
-	}
-}
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
 
-void 
-GameCore::createCommandPool()
-{
-	auto queueFamilyIndices = this->findQueueFamilies(this->physicalDevice);
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocationCallbacks(), &this->meshSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create mesh descriptor set layout!");
 
-	/*Command buffers are executed by submitting them on one of the device queues, like the graphics and presentation queues we retrieved. 
-	Each command pool can only allocate command buffers that are submitted on a single type of queue. We're going to record commands for drawing,
-	which is why we've chosen the graphics queue family.
+	VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_FRAMES_IN_FLIGHT };
 
-There are two possible flags for command pools:
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
 
-VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
-VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without 
-this flag they all have to be reset together
-We will only record the command buffers at the beginning of the program and then execute them many times in the main loop, 
-so we're not going to use either of these flags.
-*/
-	VkCommandPoolCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	createInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-	createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	if (vkCreateDescriptorPool(this->device, &poolInfo, this->allocationCallbacks(), &this->meshDescriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create mesh descriptor pool!");
 
-	if(vkCreateCommandPool(this->device, &createInfo, nullptr, &this->commandPool) != VK_SUCCESS)
-		throw std::runtime_error("failed to create command pool!");
-}
+	std::vector<VkDescriptorSetLayout> setLayouts(MAX_FRAMES_IN_FLIGHT, this->meshSetLayout);
+	std::vector<VkDescriptorSet> sets(MAX_FRAMES_IN_FLIGHT);
 
-void 
-GameCore::createCommandBuffer() {
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = commandPool;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 1;
+	VkDescriptorSetAllocateInfo setInfo{};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setInfo.descriptorPool = this->meshDescriptorPool;
+	setInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+	setInfo.pSetLayouts = setLayouts.data();
+
+	if (vkAllocateDescriptorSets(this->device, &setInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate mesh descriptor sets!");
 
-	if (vkAllocateCommandBuffers(this->device, &allocInfo, &this->commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate command buffers!");
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		this->frames[i].meshDescriptorSet = sets[i];
+		this->frames[i].meshBoundTransforms = 0;
 	}
-}
+
+	VkPushConstantRange pushConstant{ VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->viewProjection) };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->meshSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstant;
+
+	if (vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, this->allocationCallbacks(), &this->meshPipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create mesh pipeline layout!");
+
+	VkShaderModule vertShaderModule = this->createShaderModule(this->readAsset("shaders/mesh_vert.spv"));
+	VkShaderModule fragShaderModule = this->createShaderModule(this->readAsset("shaders/mesh_frag.spv"));
+
+	VkPipelineShaderStageCreateInfo shaderStages[2]{};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+
+	VkVertexInputBindingDescription vertexBinding{ 0, sizeof(MeshVertex), VK_VERTEX_INPUT_RATE_VERTEX };
+	VkVertexInputAttributeDescription attributes[3] = {
+		{ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertex, position) },
+		{ 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(MeshVertex, normal) },
+		{ 2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(MeshVertex, uv) },
+	};
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = 1;
+	vertexInputInfo.pVertexBindingDescriptions = &vertexBinding;
+	vertexInputInfo.vertexAttributeDescriptionCount = 3;
+	vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// Meshes are wound counter clockwise, the y flip in the projection keeps them that way in framebuffer space
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->meshPipelineLayout;
+	pipelineInfo.renderPass = this->renderPass;
+	pipelineInfo.subpass = 0;
+
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &this->swapChainImageFormat;
+	renderingInfo.depthAttachmentFormat = this->depthFormat;
+
+	if (this->dynamicRenderingEnabled)
+	{
+		pipelineInfo.pNext = &renderingInfo;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
+	}
+
+	this->pipelineLibrary.createPipeline(pipelineInfo, "mesh", this->meshPipeline);
+
+	vkDestroyShaderModule(this->device, fragShaderModule, this->allocationCallbacks());
+	vkDestroyShaderModule(this->device, vertShaderModule, this->allocationCallbacks());
+}
+
+void
+GameCore::destroyMeshPipeline()
+{
+	if (this->meshPipeline == VK_NULL_HANDLE)
+		return;
+
+	this->pipelineLibrary.cancel(this->meshPipeline);
+	vkDestroyPipeline(this->device, this->meshPipeline, this->allocationCallbacks());
+	vkDestroyPipelineLayout(this->device, this->meshPipelineLayout, this->allocationCallbacks());
+	vkDestroyDescriptorPool(this->device, this->meshDescriptorPool, this->allocationCallbacks());
+	vkDestroyDescriptorSetLayout(this->device, this->meshSetLayout, this->allocationCallbacks());
+	this->meshPipeline = VK_NULL_HANDLE;
+}
+
+void
+GameCore::createMeshletRenderer()
+{
+	if (!this->settings.meshletRendering)
+		return;
+
+	// Without mesh shaders the meshlets are culled in compute and pulled by a vertex shader
+	bool meshShaders = this->meshShaderEnabled
+		&& this->hasAsset("shaders/meshlet_task.spv") && this->hasAsset("shaders/meshlet_mesh.spv");
+	if (this->meshShaderEnabled && !meshShaders)
+		std::cout << "[WARN] - shaders/meshlet_task.spv / meshlet_mesh.spv not found, meshlets fall back to compute culling" << std::endl;
+
+	if (!this->hasAsset("shaders/mesh_frag.spv")
+		|| (!meshShaders && (!this->hasAsset("shaders/meshlet_cull.spv") || !this->hasAsset("shaders/meshlet_vert.spv"))))
+	{
+		std::cout << "[WARN] - shaders/meshlet_*.spv not found (built by the Shaders target), meshlet rendering disabled" << std::endl;
+		return;
+	}
+
+	MeshletShaders shaders;
+	if (meshShaders)
+	{
+		shaders.task = this->createShaderModule(this->readAsset("shaders/meshlet_task.spv"));
+		shaders.mesh = this->createShaderModule(this->readAsset("shaders/meshlet_mesh.spv"));
+	}
+	else
+	{
+		shaders.cull = this->createShaderModule(this->readAsset("shaders/meshlet_cull.spv"));
+		shaders.vertex = this->createShaderModule(this->readAsset("shaders/meshlet_vert.spv"));
+	}
+	shaders.fragment = this->createShaderModule(this->readAsset("shaders/mesh_frag.spv"));
+
+	this->meshletRenderer.create(this->device, MAX_FRAMES_IN_FLIGHT, shaders,
+		this->dynamicRenderingEnabled ? VK_NULL_HANDLE : this->renderPass,
+		this->swapChainImageFormat, this->depthFormat,
+		meshShaders ? this->drawMeshTasks : nullptr, this->allocationCallbacks());
+
+	VkShaderModule modules[] = { shaders.cull, shaders.vertex, shaders.task, shaders.mesh, shaders.fragment };
+	for (VkShaderModule module : modules)
+	{
+		if (module != VK_NULL_HANDLE)
+			vkDestroyShaderModule(this->device, module, this->allocationCallbacks());
+	}
+
+	std::cout << "[INFO] - meshlet rendering: "
+		<< (meshShaders ? "task/mesh shader culling" : "compute culling, vertex pulling") << std::endl;
+}
+
+void
+GameCore::destroyMeshletRenderer()
+{
+	this->meshletRenderer.destroy();
+
+	if (this->meshletDrawBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, this->meshletDrawBuffer, this->allocationCallbacks());
+		this->freeMemory(this->meshletDrawMemory);
+		this->meshletDrawBuffer = VK_NULL_HANDLE;
+		this->meshletDrawCapacity = 0;
+	}
+
+	if (this->meshletCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, this->meshletCommandBuffer, this->allocationCallbacks());
+		this->freeMemory(this->meshletCommandMemory);
+		this->meshletCommandBuffer = VK_NULL_HANDLE;
+		this->meshletCommandCapacity = 0;
+	}
+}
+
+bool
+GameCore::hasMemoryType(VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			return true;
+	}
+
+	return false;
+}
+
+uint32_t
+GameCore::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("failed to find suitable memory type!");
+}
+
+void
+GameCore::allocateMemory(const VkMemoryAllocateInfo& allocInfo, VkDeviceSize requestedSize, VkDeviceMemory& memory)
+{
+	// Give back whatever already retired before going over budget and letting the driver page
+	if (this->memoryTelemetry.exceedsBudget(allocInfo.memoryTypeIndex, allocInfo.allocationSize))
+		this->deletionQueue.collect(this->graphicsTimeline.completedValue());
+
+	if (vkAllocateMemory(this->device, &allocInfo, this->allocationCallbacks(), &memory) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate device memory!");
+
+	this->memoryTelemetry.allocated(memory, allocInfo.memoryTypeIndex, allocInfo.allocationSize, requestedSize);
+}
+
+void
+GameCore::freeMemory(VkDeviceMemory memory)
+{
+	this->memoryTelemetry.freed(memory);
+	vkFreeMemory(this->device, memory, this->allocationCallbacks());
+}
+
+void
+GameCore::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory)
+{
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(this->device, &bufferInfo, this->allocationCallbacks(), &buffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to create buffer!");
+	this->resourceGeneration++;
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(this->device, buffer, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, properties);
+
+	this->allocateMemory(allocInfo, size, memory);
+
+	vkBindBufferMemory(this->device, buffer, memory, 0);
+}
+
+void
+GameCore::ensureSceneBufferCapacity(FrameData& frame)
+{
+	uint32_t required = this->scene.getTransformSlotCount();
+
+	if (required > this->sceneTransformCapacity)
+	{
+		// Grow geometrically, the old buffer may still be read by the other frame in flight
+		uint32_t capacity = std::max(required, this->sceneTransformCapacity * 2);
+
+		if (this->sceneTransformBuffer != VK_NULL_HANDLE)
+			this->DeferDestroyBuffer(this->sceneTransformBuffer, this->sceneTransformMemory);
+
+		this->createBuffer(capacity * sizeof(Transform),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->sceneTransformBuffer, this->sceneTransformMemory);
+
+		this->sceneTransformCapacity = capacity;
+		this->sceneTransformGeneration = this->resourceGeneration;
+
+		// The new buffer starts out empty
+		this->scene.markAllTransformsDirty();
+	}
+
+	if (frame.sceneStagingCapacity < this->sceneTransformCapacity)
+	{
+		// This frame slot already retired on the GPU, its staging buffer can go right away
+		if (frame.sceneStagingBuffer != VK_NULL_HANDLE)
+		{
+			vkDestroyBuffer(this->device, frame.sceneStagingBuffer, this->allocationCallbacks());
+			this->freeMemory(frame.sceneStagingMemory);
+		}
+
+		this->createBuffer(this->sceneTransformCapacity * sizeof(Transform),
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			frame.sceneStagingBuffer, frame.sceneStagingMemory);
+
+		vkMapMemory(this->device, frame.sceneStagingMemory, 0, VK_WHOLE_SIZE, 0, &frame.sceneStagingMapped);
+		frame.sceneStagingCapacity = this->sceneTransformCapacity;
+	}
+}
+
+void
+GameCore::recordSceneUpload(VkCommandBuffer commandBuffer, FrameData& frame)
+{
+	if (this->scene.getTransformSlotCount() == 0)
+		return;
+
+	this->ensureSceneBufferCapacity(frame);
+
+	// Only the transforms touched since the last frame, coalesced into runs
+	std::vector<VkBufferCopy> regions;
+
+	this->scene.consumeDirtyTransforms([&](uint32_t firstSlot, const Transform* data, uint32_t count) {
+		VkDeviceSize offset = static_cast<VkDeviceSize>(firstSlot) * sizeof(Transform);
+		VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(Transform);
+
+		memcpy(static_cast<char*>(frame.sceneStagingMapped) + offset, data, size);
+		regions.push_back({ offset, offset, size });
+	});
+
+	if (regions.empty())
+		return;
+
+	// The previous frame's shaders may still read the slots we are about to overwrite
+	VkMemoryBarrier beforeCopy{};
+	beforeCopy.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	beforeCopy.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	beforeCopy.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		this->meshReadStages(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 1, &beforeCopy, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(commandBuffer, frame.sceneStagingBuffer, this->sceneTransformBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+
+	VkBufferMemoryBarrier afterCopy{};
+	afterCopy.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	afterCopy.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	afterCopy.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	afterCopy.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	afterCopy.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	afterCopy.buffer = this->sceneTransformBuffer;
+	afterCopy.offset = 0;
+	afterCopy.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, this->meshReadStages(),
+		0, 0, nullptr, 1, &afterCopy, 0, nullptr);
+}
+
+VkPipelineStageFlags
+GameCore::meshReadStages() const
+{
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	// Only valid with the features enabled
+	if (this->meshShaderEnabled)
+		stages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+
+	return stages;
+}
+
+void
+GameCore::destroySceneBuffers()
+{
+	for (auto& frame : this->frames)
+	{
+		if (frame.sceneStagingBuffer == VK_NULL_HANDLE)
+			continue;
+
+		vkDestroyBuffer(this->device, frame.sceneStagingBuffer, this->allocationCallbacks());
+		this->freeMemory(frame.sceneStagingMemory);
+		frame.sceneStagingBuffer = VK_NULL_HANDLE;
+	}
+
+	if (this->sceneTransformBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, this->sceneTransformBuffer, this->allocationCallbacks());
+		this->freeMemory(this->sceneTransformMemory);
+		this->sceneTransformBuffer = VK_NULL_HANDLE;
+	}
+}
+
+uint32_t
+GameCore::LoadMesh(const std::string& path)
+{
+	if (const PakEntry* entry = this->assetArchive.find(path))
+	{
+		// The .vmesh layout is already what the GPU wants, so the whole file becomes the staging buffer
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingMemory;
+		this->createBuffer(entry->size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			stagingBuffer, stagingMemory);
+
+		void* mapped;
+		vkMapMemory(this->device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+
+		MeshAsset asset;
+
+		try {
+			this->assetArchive.read(*entry, mapped, &this->threadPool);
+			asset.view(static_cast<const uint8_t*>(mapped), static_cast<size_t>(entry->size), path);
+		}
+		catch (...) {
+			vkDestroyBuffer(this->device, stagingBuffer, this->allocationCallbacks());
+			this->freeMemory(stagingMemory);
+			throw;
+		}
+
+		const MeshFileHeader& header = asset.getHeader();
+		MeshStagingOffsets sources{ header.vertexOffset, header.indexOffset, header.meshletOffset, header.meshletVertexOffset, header.meshletTriangleOffset };
+		uint32_t id = this->createMesh(asset, stagingBuffer, stagingMemory, sources);
+
+		vkUnmapMemory(this->device, stagingMemory);
+
+		return id;
+	}
+
+	MeshAsset asset;
+	asset.open(path);
+
+	return this->UploadMesh(asset);
+}
+
+uint32_t
+GameCore::UploadMesh(const MeshAsset& asset)
+{
+	const MeshFileHeader& header = asset.getHeader();
+	const void* blobs[5] = { asset.getVertices(), asset.getIndices(), asset.getMeshlets(), asset.getMeshletVertices(), asset.getMeshletTriangles() };
+	VkDeviceSize sizes[5] = {
+		asset.getVertexBytes(), asset.getIndexBytes(), VkDeviceSize(header.meshletCount) * sizeof(Meshlet),
+		VkDeviceSize(header.meshletVertexCount) * sizeof(uint32_t), header.meshletTriangleBytes
+	};
+
+	// One staging buffer for every blob, filled straight from the file mapping
+	MeshStagingOffsets sources;
+	VkDeviceSize* offsets[5] = { &sources.vertices, &sources.indices, &sources.meshlets, &sources.meshletVertices, &sources.meshletTriangles };
+	VkDeviceSize stagingSize = 0;
+	for (uint32_t i = 0; i < 5; i++)
+	{
+		*offsets[i] = stagingSize;
+		stagingSize += sizes[i];
+	}
+
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	this->createBuffer(stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer, stagingMemory);
+
+	void* mapped;
+	vkMapMemory(this->device, stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+	for (uint32_t i = 0; i < 5; i++)
+		memcpy(static_cast<char*>(mapped) + *offsets[i], blobs[i], sizes[i]);
+	vkUnmapMemory(this->device, stagingMemory);
+
+	return this->createMesh(asset, stagingBuffer, stagingMemory, sources);
+}
+
+uint32_t
+GameCore::createMesh(const MeshAsset& asset, VkBuffer stagingBuffer, VkDeviceMemory stagingMemory, const MeshStagingOffsets& sources)
+{
+	const MeshFileHeader& header = asset.getHeader();
+
+	VkDeviceSize vertexBytes = asset.getVertexBytes();
+	VkDeviceSize indexBytes = asset.getIndexBytes();
+
+	// The staging buffer is ours from here on, whatever happens
+	auto freeStaging = [this, stagingBuffer, stagingMemory]() {
+		vkDestroyBuffer(this->device, stagingBuffer, this->allocationCallbacks());
+		this->freeMemory(stagingMemory);
+	};
+
+	if (vertexBytes == 0 || indexBytes == 0)
+	{
+		freeStaging();
+		throw std::runtime_error("failed to upload mesh: no geometry!");
+	}
+
+	GpuMesh mesh;
+	mesh.vertexCount = header.vertexCount;
+	mesh.lods.assign(asset.getLods(), asset.getLods() + header.lodCount);
+	std::copy(header.boundsCenter, header.boundsCenter + 3, mesh.boundsCenter);
+	mesh.boundsRadius = header.boundsRadius;
+	mesh.meshletCount = header.meshletCount;
+
+	// Only read by the meshlet shaders
+	VkDeviceSize meshletBytes[3] = {
+		VkDeviceSize(header.meshletCount) * sizeof(Meshlet), VkDeviceSize(header.meshletVertexCount) * sizeof(uint32_t), header.meshletTriangleBytes
+	};
+	VkDeviceSize meshletSources[3] = { sources.meshlets, sources.meshletVertices, sources.meshletTriangles };
+	VkBuffer* meshletBuffers[3] = { &mesh.meshletBuffer, &mesh.meshletVertexBuffer, &mesh.meshletTriangleBuffer };
+	VkDeviceMemory* meshletMemory[3] = { &mesh.meshletMemory, &mesh.meshletVertexMemory, &mesh.meshletTriangleMemory };
+
+	auto recordCopies = [&](VkCommandBuffer commandBuffer) {
+		VkBufferCopy vertexRegion{ sources.vertices, 0, vertexBytes };
+		VkBufferCopy indexRegion{ sources.indices, 0, indexBytes };
+
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, mesh.vertexBuffer, 1, &vertexRegion);
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, mesh.indexBuffer, 1, &indexRegion);
+
+		for (uint32_t i = 0; i < 3 && mesh.meshletCount > 0; i++)
+		{
+			VkBufferCopy meshletRegion{ meshletSources[i], 0, meshletBytes[i] };
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, *meshletBuffers[i], 1, &meshletRegion);
+		}
+
+		// Later submissions on this queue read the buffers as vertex input or from shaders
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | this->meshReadStages(),
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	};
+
+	// Until the upload is submitted nothing reads the mesh on the GPU (SubmitUpload throws before or instead of its
+	// vkQueueSubmit), so a failure frees what was created so far, the staging buffer included, right away
+	try {
+		this->createBuffer(vertexBytes,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			mesh.vertexBuffer, mesh.vertexMemory);
+
+		this->createBuffer(indexBytes,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			mesh.indexBuffer, mesh.indexMemory);
+
+		if (mesh.meshletCount > 0)
+		{
+			for (uint32_t i = 0; i < 3; i++)
+				this->createBuffer(meshletBytes[i], VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *meshletBuffers[i], *meshletMemory[i]);
+		}
+
+		mesh.readyValue = this->SubmitUpload(recordCopies);
+	}
+	catch (...) {
+		VkBuffer* buffers[] = { &mesh.vertexBuffer, &mesh.indexBuffer, meshletBuffers[0], meshletBuffers[1], meshletBuffers[2] };
+		VkDeviceMemory* memory[] = { &mesh.vertexMemory, &mesh.indexMemory, meshletMemory[0], meshletMemory[1], meshletMemory[2] };
+
+		// createBuffer may have failed between creating a buffer and allocating its memory
+		for (uint32_t i = 0; i < 5; i++)
+		{
+			if (*buffers[i] != VK_NULL_HANDLE)
+				vkDestroyBuffer(this->device, *buffers[i], this->allocationCallbacks());
+			if (*memory[i] != VK_NULL_HANDLE)
+				this->freeMemory(*memory[i]);
+		}
+
+		freeStaging();
+		throw;
+	}
+
+	// The staging memory is only needed until the copy retires
+	this->deletionQueue.push(mesh.readyValue, freeStaging);
+
+	std::cout << "[INFO] - uploaded mesh: " << header.vertexCount << " vertices, "
+		<< header.indexCount << " indices, " << header.lodCount << " LODs, " << header.meshletCount << " meshlets" << std::endl;
+
+	this->meshes.push_back(std::move(mesh));
+
+	return static_cast<uint32_t>(this->meshes.size() - 1);
+}
+
+void
+GameCore::openAssetArchive()
+{
+	if (this->settings.assetArchive.empty() || !fs::exists(this->settings.assetArchive))
+	{
+		std::cout << "[INFO] - no asset archive, reading loose files" << std::endl;
+		return;
+	}
+
+	this->assetArchive.open(this->settings.assetArchive);
+
+	std::cout << "[INFO] - asset archive " << this->settings.assetArchive << ": "
+		<< this->assetArchive.getEntryCount() << " entries" << std::endl;
+}
+
+std::vector<char>
+GameCore::readAsset(const std::string& name)
+{
+	auto prefetched = this->prefetchedAssets.find(name);
+	if (prefetched != this->prefetchedAssets.end())
+	{
+		std::vector<char> data = prefetched->second.get();
+		this->prefetchedAssets.erase(prefetched);
+		return data;
+	}
+
+	if (const PakEntry* entry = this->assetArchive.find(name))
+		return this->assetArchive.read(*entry, &this->threadPool);
+
+	return readFile(name);
+}
+
+bool
+GameCore::hasAsset(const std::string& name)
+{
+	return this->prefetchedAssets.count(name) != 0 || this->assetArchive.find(name) != nullptr || fs::exists(name);
+}
+
+void
+GameCore::prefetchAsset(const std::string& name)
+{
+	this->prefetchedAssets[name] = this->threadPool.submit([this, name]() {
+		StartupTimer::clock::time_point begin = StartupTimer::clock::now();
+
+		std::vector<char> data;
+		if (const PakEntry* entry = this->assetArchive.find(name))
+			data = this->assetArchive.read(*entry, &this->threadPool);
+		else
+			data = readFile(name);
+
+		this->startupTimer.record("read " + name, begin, StartupTimer::clock::now(), true);
+		return data;
+	});
+}
+
+void
+GameCore::destroyMeshes()
+{
+	for (auto& mesh : this->meshes)
+	{
+		vkDestroyBuffer(this->device, mesh.vertexBuffer, this->allocationCallbacks());
+		this->freeMemory(mesh.vertexMemory);
+		vkDestroyBuffer(this->device, mesh.indexBuffer, this->allocationCallbacks());
+		this->freeMemory(mesh.indexMemory);
+
+		if (mesh.meshletCount == 0)
+			continue;
+
+		vkDestroyBuffer(this->device, mesh.meshletBuffer, this->allocationCallbacks());
+		this->freeMemory(mesh.meshletMemory);
+		vkDestroyBuffer(this->device, mesh.meshletVertexBuffer, this->allocationCallbacks());
+		this->freeMemory(mesh.meshletVertexMemory);
+		vkDestroyBuffer(this->device, mesh.meshletTriangleBuffer, this->allocationCallbacks());
+		this->freeMemory(mesh.meshletTriangleMemory);
+	}
+
+	this->meshes.clear();
+}
+
+void
+GameCore::createParticleSystem()
+{
+	const char* shaderNames[] = {
+		"shaders/particle_emit.spv", "shaders/particle_simulate.spv", "shaders/particle_args.spv",
+		"shaders/particle_vert.spv", "shaders/particle_frag.spv"
+	};
+
+	for (const char* name : shaderNames)
+	{
+		if (!this->hasAsset(name))
+		{
+			std::cout << "[WARN] - " << name << " not found (built by the Shaders target), particles disabled" << std::endl;
+			return;
+		}
+	}
+
+	uint32_t capacity = this->settings.particleCapacity;
+	VkDeviceSize sizes[4] = {
+		VkDeviceSize(capacity) * sizeof(GpuParticle),
+		VkDeviceSize(capacity) * 2 * sizeof(uint32_t),
+		VkDeviceSize(capacity) * sizeof(uint32_t),
+		sizeof(ParticleCounters)
+	};
+	VkBuffer* buffers[4] = { &this->particleBuffers.particles, &this->particleBuffers.alive, &this->particleBuffers.dead, &this->particleBuffers.counters };
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		// Transfer source for the read back of checkParticles
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		if (buffers[i] == &this->particleBuffers.counters)
+			usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+		this->createBuffer(sizes[i], usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *buffers[i], this->particleMemory[i]);
+	}
+
+	// Every slot starts out dead, the counters follow the dead list in the staging buffer
+	VkDeviceSize stagingSize = sizes[2] + sizes[3];
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingMemory;
+	this->createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
+
+	void* mapped;
+	vkMapMemory(this->device, stagingMemory, 0, stagingSize, 0, &mapped);
+
+	uint32_t* deadList = static_cast<uint32_t*>(mapped);
+	for (uint32_t i = 0; i < capacity; i++)
+		deadList[i] = capacity - 1 - i;
+
+	ParticleCounters counters{};
+	counters.deadCount = static_cast<int32_t>(capacity);
+	memcpy(static_cast<char*>(mapped) + sizes[2], &counters, sizeof(counters));
+
+	vkUnmapMemory(this->device, stagingMemory);
+
+	this->SubmitUpload([&](VkCommandBuffer commandBuffer) {
+		VkBufferCopy deadCopy{ 0, 0, sizes[2] };
+		VkBufferCopy countersCopy{ sizes[2], 0, sizes[3] };
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, this->particleBuffers.dead, 1, &deadCopy);
+		vkCmdCopyBuffer(commandBuffer, stagingBuffer, this->particleBuffers.counters, 1, &countersCopy);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// Simulated on the compute queue from here on, the first simulation waits for this upload
+		std::vector<ComputeHandoff> handoffs = this->particleHandoffs(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		handoffs.push_back({ this->particleBuffers.dead, 0, VK_WHOLE_SIZE, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT });
+		this->asyncCompute.recordReturn(commandBuffer, handoffs);
+	});
+
+	// Released once the first frame retires, which is after the upload
+	this->DeferDestroyBuffer(stagingBuffer, stagingMemory);
+
+	ParticleShaders shaders;
+	VkShaderModule* modules[5] = { &shaders.emit, &shaders.simulate, &shaders.args, &shaders.vertex, &shaders.fragment };
+	for (uint32_t i = 0; i < 5; i++)
+		*modules[i] = this->createShaderModule(this->readAsset(shaderNames[i]));
+
+	this->particles.create(this->device, capacity, this->particleBuffers, shaders,
+		this->dynamicRenderingEnabled ? VK_NULL_HANDLE : this->renderPass, this->swapChainImageFormat, this->depthFormat, this->allocationCallbacks());
+
+	for (VkShaderModule* module : modules)
+		vkDestroyShaderModule(this->device, *module, this->allocationCallbacks());
+
+	std::cout << "[INFO] - particle system: " << capacity << " particles, "
+		<< (sizes[0] + sizes[1] + sizes[2]) / (1024 * 1024) << " MB" << std::endl;
+}
+
+void
+GameCore::simulateParticles()
+{
+	if (!this->particles.isEnabled())
+		return;
+
+	// Overlaps the frame's uploads and culling when the queue is async. The previous frame drew these buffers and gave
+	// them back, so the simulation waits for everything submitted to graphics so far.
+	float dt = this->frameDeltaTime;
+	this->SubmitCompute([this, dt](VkCommandBuffer commandBuffer) {
+		this->particles.recordSimulation(commandBuffer, dt);
+	}, this->particleHandoffs(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT), this->graphicsTimeline.lastSubmittedValue());
+}
+
+std::vector<ComputeHandoff>
+GameCore::particleHandoffs(VkPipelineStageFlags stage, VkAccessFlags access) const
+{
+	return {
+		{ this->particleBuffers.particles, 0, VK_WHOLE_SIZE, stage, access },
+		{ this->particleBuffers.alive, 0, VK_WHOLE_SIZE, stage, access },
+		{ this->particleBuffers.counters, 0, VK_WHOLE_SIZE, stage, access },
+	};
+}
+
+void
+GameCore::destroyParticleSystem()
+{
+	this->particles.destroy();
+
+	VkBuffer buffers[4] = { this->particleBuffers.particles, this->particleBuffers.alive, this->particleBuffers.dead, this->particleBuffers.counters };
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (buffers[i] == VK_NULL_HANDLE)
+			continue;
+
+		vkDestroyBuffer(this->device, buffers[i], this->allocationCallbacks());
+		this->freeMemory(this->particleMemory[i]);
+	}
+
+	this->particleBuffers = {};
+}
+
+void
+GameCore::createOcclusionCulling()
+{
+	if (!this->occlusionCullingEnabled)
+		return;
+
+	if (!this->hasAsset("shaders/hiz_reduce.spv") || !this->hasAsset("shaders/hiz_cull.spv"))
+	{
+		std::cout << "[WARN] - shaders/hiz_*.spv not found (built by the Shaders target), occlusion culling disabled" << std::endl;
+		this->occlusionCullingEnabled = false;
+		return;
+	}
+
+	VkShaderModule reduceShader = this->createShaderModule(this->readAsset("shaders/hiz_reduce.spv"));
+	VkShaderModule cullShader = this->createShaderModule(this->readAsset("shaders/hiz_cull.spv"));
+
+	this->hizCulling.create(this->device, MAX_FRAMES_IN_FLIGHT, reduceShader, cullShader, this->allocationCallbacks());
+
+	vkDestroyShaderModule(this->device, cullShader, this->allocationCallbacks());
+	vkDestroyShaderModule(this->device, reduceShader, this->allocationCallbacks());
+
+	std::cout << "[INFO] - occlusion culling: two phase hi-z"
+		<< (this->multiDrawIndirectEnabled ? ", multi draw indirect" : ", single draw indirect") << std::endl;
+}
+
+void
+GameCore::destroyOcclusionCulling()
+{
+	this->hizCulling.destroy();
+
+	for (FrameData& frame : this->frames)
+	{
+		if (frame.cullCandidateBuffer == VK_NULL_HANDLE)
+			continue;
+
+		vkDestroyBuffer(this->device, frame.cullCandidateBuffer, this->allocationCallbacks());
+		this->freeMemory(frame.cullCandidateMemory);
+		frame.cullCandidateBuffer = VK_NULL_HANDLE;
+		frame.cullCandidateCapacity = 0;
+	}
+
+	if (this->cullVisibilityBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, this->cullVisibilityBuffer, this->allocationCallbacks());
+		this->freeMemory(this->cullVisibilityMemory);
+		this->cullVisibilityBuffer = VK_NULL_HANDLE;
+	}
+
+	if (this->cullCommandBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, this->cullCommandBuffer, this->allocationCallbacks());
+		this->freeMemory(this->cullCommandMemory);
+		this->cullCommandBuffer = VK_NULL_HANDLE;
+	}
+}
+
+void
+GameCore::createFrameCapture()
+{
+	VkFormat format = this->swapChainImageFormat;
+	if (format != VK_FORMAT_B8G8R8A8_UNORM && format != VK_FORMAT_B8G8R8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB)
+	{
+		std::cout << "[WARN] - capture only handles 8 bit RGBA/BGRA swap chains, capture disabled" << std::endl;
+		return;
+	}
+
+	FrameCapture::Consumer consumer;
+	if (this->isGoldenRun())
+	{
+		std::string path = this->goldenPath(".ppm");
+		consumer = [this, path](const CapturedFrame& frame) {
+			if (this->settings.golden.update)
+				this->goldenImageResult = { writeGoldenImage(path, frame), "wrote " + path };
+			else
+				this->goldenImageResult = compareWithGolden(frame, path, this->settings.golden.tolerance);
+		};
+	}
+	else if (!this->settings.capture.directory.empty())
+		consumer = FrameCapture::fileWriter(this->settings.capture.directory, this->settings.capture.png);
+
+	this->frameCapture.init(this->device, &this->threadPool, std::max(1u, this->settings.capture.ringSize), std::move(consumer));
+
+	std::cout << "[INFO] - capturing frames" << (this->settings.capture.directory.empty() ? "" : " to " + this->settings.capture.directory)
+		<< ", " << this->frameCapture.getSlotCount() << " buffers in flight" << std::endl;
+}
+
+void
+GameCore::ensureCaptureSlotSize(FrameCapture::Slot& slot, VkDeviceSize size)
+{
+	if (slot.size >= size)
+		return;
+
+	// Free slots are neither read by the GPU nor by a consumer
+	if (slot.buffer != VK_NULL_HANDLE)
+	{
+		vkUnmapMemory(this->device, slot.memory);
+		vkDestroyBuffer(this->device, slot.buffer, this->allocationCallbacks());
+		this->freeMemory(slot.memory);
+	}
+
+	// Cached memory makes the CPU reads fast, it just may need an invalidate
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (this->hasMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+		properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	else if (this->hasMemoryType(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+		properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+	this->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, slot.buffer, slot.memory);
+
+	void* mapped;
+	vkMapMemory(this->device, slot.memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+
+	slot.mapped = static_cast<uint8_t*>(mapped);
+	slot.size = size;
+	slot.coherent = (properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+bool
+GameCore::recordCapture(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format)
+{
+	if (!this->frameCapture.isEnabled())
+		return false;
+
+	uint32_t frameLimit = this->settings.capture.frameLimit;
+	if (frameLimit > 0 && this->capturesRequested >= frameLimit)
+		return false;
+
+	// presentId is the number of frames submitted so far
+	if (this->presentId < this->settings.capture.startFrame)
+		return false;
+
+	FrameCapture::Slot* slot = this->frameCapture.acquire();
+	if (slot == nullptr)
+		return false;
+
+	uint32_t rowPitch = extent.width * 4;
+	this->ensureCaptureSlotSize(*slot, VkDeviceSize(rowPitch) * extent.height);
+
+	VkImageMemoryBarrier toTransfer{};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	// Written by the main pass or by the upscale blit
+	toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toTransfer.oldLayout = layout;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = image;
+	toTransfer.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	// The transition to the present layout before this (end of the main pass, or after the upscale blit) may end at
+	// BOTTOM_OF_PIPE; ALL_COMMANDS chains onto whichever stage it was, COLOR_ATTACHMENT_OUTPUT would not
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &region);
+
+	VkImageMemoryBarrier toOriginal = toTransfer;
+	toOriginal.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toOriginal.dstAccessMask = 0;
+	toOriginal.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toOriginal.newLayout = layout;
+
+	// Make the copy visible to host reads once the timeline says it is done
+	VkBufferMemoryBarrier toHost{};
+	toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.buffer = slot->buffer;
+	toHost.offset = 0;
+	toHost.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+		0, 0, nullptr, 1, &toHost, 1, &toOriginal);
+
+	slot->frame.frameNumber = this->capturesRequested++;
+	slot->frame.width = extent.width;
+	slot->frame.height = extent.height;
+	slot->frame.format = format;
+	slot->frame.rowPitch = rowPitch;
+	this->pendingCapture = slot;
+
+	return true;
+}
+
+void
+GameCore::destroyFrameCapture()
+{
+	if (!this->frameCapture.isEnabled())
+		return;
+
+	this->frameCapture.flush(this->graphicsTimeline);
+
+	FrameCapture::Slot* slots = this->frameCapture.getSlots();
+	for (uint32_t i = 0; i < this->frameCapture.getSlotCount(); i++)
+	{
+		if (slots[i].buffer == VK_NULL_HANDLE)
+			continue;
+
+		vkUnmapMemory(this->device, slots[i].memory);
+		vkDestroyBuffer(this->device, slots[i].buffer, this->allocationCallbacks());
+		this->freeMemory(slots[i].memory);
+	}
+
+	std::cout << "[INFO] - captured " << this->frameCapture.getCapturedCount() << " frames, "
+		<< this->frameCapture.getDroppedCount() << " skipped (all buffers busy)" << std::endl;
+}
+
+void
+GameCore::createFrameBuffers()
+{
+	for (const auto& imageView : this->swapChainImageViews)
+	{
+		VkImageView attachments[] = { this->settings.dynamicResolution.enabled ? this->sceneColorView : imageView, this->depthView };
+
+		VkFramebufferCreateInfo frameBufferInfo{};
+		frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferInfo.renderPass = this->renderPass;
+		frameBufferInfo.attachmentCount = 2;
+		frameBufferInfo.pAttachments = attachments;
+		frameBufferInfo.width = this->swapChainExtent.width;
+		frameBufferInfo.height = this->swapChainExtent.height;
+		frameBufferInfo.layers = 1;
+		frameBufferInfo.pNext = nullptr;
+
+		VkFramebuffer frameBuffer{};
+		if(vkCreateFramebuffer(this->device, &frameBufferInfo, this->allocationCallbacks(), &frameBuffer) != VK_SUCCESS) 
+			throw std::runtime_error("failed to create framebuffer!");
+
+		this->swapChainFramebuffers.push_back(frameBuffer);
+	}
+}
+
+void 
+GameCore::createCommandPool()
+{
+	auto queueFamilyIndices = this->findQueueFamilies(this->physicalDevice);
+
+	/*Command buffers are executed by submitting them on one of the device queues, like the graphics and presentation queues we retrieved. 
+	Each command pool can only allocate command buffers that are submitted on a single type of queue. We're going to record commands for drawing,
+	which is why we've chosen the graphics queue family.
+
+There are two possible flags for command pools:
+
+VK_COMMAND_POOL_CREATE_TRANSIENT_BIT: Hint that command buffers are rerecorded with new commands very often (may change memory allocation behavior)
+VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT: Allow command buffers to be rerecorded individually, without 
+this flag they all have to be reset together
+We will only record the command buffers at the beginning of the program and then execute them many times in the main loop, 
+so we're not going to use either of these flags.
+*/
+	VkCommandPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+	createInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if(vkCreateCommandPool(this->device, &createInfo, this->allocationCallbacks(), &this->commandPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create command pool!");
+}
+
+void
+GameCore::createUploadCommandPool()
+{
+	// Uploads are short lived, one-time-submit command buffers that get recycled once the timeline passes them
+	VkCommandPoolCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	createInfo.queueFamilyIndex = this->findQueueFamilies(this->physicalDevice).graphicsFamily.value();
+	createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(this->device, &createInfo, this->allocationCallbacks(), &this->uploadCommandPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create upload command pool!");
+}
+
+void 
+GameCore::createCommandBuffer() {
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	// One command buffer per frame in flight so the CPU can record frame N+1 while the GPU still executes frame N
+	for (auto& frame : this->frames)
+	{
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate command buffers!");
+		}
+
+		if (this->settings.dynamicResolution.enabled && vkAllocateCommandBuffers(this->device, &allocInfo, &frame.presentCommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate command buffers!");
+	}
+}
+
+void
+GameCore::createCommandCache()
+{
+	if (!this->settings.cacheCommandBuffers)
+		return;
+
+	if (this->pipelineStatisticsEnabled && !this->inheritedQueriesEnabled)
+	{
+		std::cout << "[WARN] - inheritedQueries not supported, command buffers are re-recorded every frame" << std::endl;
+		return;
+	}
+
+	// Secondaries inherit the pass from the primary: the render pass without a framebuffer, or the formats of the
+	// dynamic rendering scope
+	this->passRenderingInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR;
+	this->passRenderingInheritance.colorAttachmentCount = 1;
+	this->passRenderingInheritance.pColorAttachmentFormats = &this->swapChainImageFormat;
+	this->passRenderingInheritance.depthAttachmentFormat = this->depthFormat;
+	// The pass only attaches the depth aspect (pStencilAttachment is null) even for D24S8 / D32S8
+	this->passRenderingInheritance.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+	this->passRenderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	this->passInheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	this->passInheritance.pNext = this->dynamicRenderingEnabled ? &this->passRenderingInheritance : nullptr;
+	this->passInheritance.renderPass = this->dynamicRenderingEnabled ? VK_NULL_HANDLE : this->renderPass;
+	this->passInheritance.subpass = 0;
+	this->passInheritance.pipelineStatistics = this->gpuQueries.statisticsFlags();
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = this->commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	allocInfo.commandBufferCount = 1;
+
+	for (auto& frame : this->frames)
+	{
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &frame.backdropCommandBuffer) != VK_SUCCESS ||
+			vkAllocateCommandBuffers(this->device, &allocInfo, &frame.overlayCommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate secondary command buffers!");
+	}
+
+	// Early / all and late geometry of every frame in flight
+	this->commandCache.create(this->device, this->commandPool, MAX_FRAMES_IN_FLIGHT * 2);
+	std::cout << "[INFO] - scene geometry recorded into cached secondary command buffers" << std::endl;
+}
+
+void 
+GameCore::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("failed to begin recording command buffer!");
+	}
+
+	// First thing, so the statistics cover the compute work below as well as the render pass. The main pass renders into
+	// the swap chain image unless there is an upscale, then the first timestamp also waits for the acquire: the GPU time
+	// is what the frame took, not how long the presentation engine held on to the image.
+	bool upscaled = this->settings.dynamicResolution.enabled;
+	this->gpuQueries.beginFrame(commandBuffer, this->currentFrame,
+		upscaled ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+	// Copies have to be recorded outside of the render pass
+	this->recordSceneUpload(commandBuffer, this->frames[this->currentFrame]);
+	this->simulateParticles();
+	this->computeWaitValue = this->asyncCompute.recordAcquire(commandBuffer, this->computeWaitStages);
+	bool culled = this->prepareMeshDraws(commandBuffer);
+
+	this->beginMainPass(commandBuffer, imageIndex, true);
+	this->recordMainPassContents(commandBuffer, culled ? MeshDrawList::Early : MeshDrawList::All, !culled);
+
+	if (culled)
+	{
+		// The early pass' depth decides what else is visible, the late pass draws only that
+		this->endMainPass(commandBuffer, imageIndex);
+		this->hizCulling.recordLateCull(commandBuffer, this->currentFrame, this->viewProjection, this->indexedCandidateCount);
+		this->beginMainPass(commandBuffer, imageIndex, false);
+		this->recordMainPassContents(commandBuffer, MeshDrawList::Late, true);
+	}
+
+	this->endMainPass(commandBuffer, imageIndex);
+	// Drawn, next frame's simulation writes them again
+	if (this->particles.isEnabled())
+		this->asyncCompute.recordReturn(commandBuffer, this->particleHandoffs(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+			VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT));
+
+	// The main pass leaves the image in its final layout, the upscale is in the present command buffer
+	if (!upscaled)
+		this->recordCapture(commandBuffer, this->swapChainImages[imageIndex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, this->swapChainExtent, this->swapChainImageFormat);
+	this->gpuQueries.endFrame(commandBuffer);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("failed to record command buffer!");
+	}
+}
+
+void
+GameCore::recordPresentCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording present command buffer!");
+
+	this->recordUpscale(commandBuffer, imageIndex);
+	this->recordCapture(commandBuffer, this->swapChainImages[imageIndex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, this->swapChainExtent, this->swapChainImageFormat);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record present command buffer!");
+}
+
+void
+GameCore::recordWindowView(VkCommandBuffer commandBuffer, const MirrorView& view) const
+{
+	const WindowTarget& target = this->windowTargets.at(view.id);
+	const FrameData& frame = this->frames[this->currentFrame];
+
+	VkClearValue clearValues[2]{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (this->depthFormat != VK_FORMAT_D32_SFLOAT)
+		depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	if (!this->dynamicRenderingEnabled)
+	{
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = this->windowRenderPass;
+		renderPassInfo.framebuffer = target.framebuffer;
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = target.extent;
+		renderPassInfo.clearValueCount = 2;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	}
+	else
+	{
+		// The window's previous frame may still blit out of the target or test against its depth
+		VkImageMemoryBarrier toAttachment[2]{};
+		toAttachment[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		toAttachment[0].srcAccessMask = 0;
+		toAttachment[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		toAttachment[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		toAttachment[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		toAttachment[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toAttachment[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		toAttachment[0].image = target.colorImage;
+		toAttachment[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+		toAttachment[1] = toAttachment[0];
+		toAttachment[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		toAttachment[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		toAttachment[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		toAttachment[1].image = target.depthImage;
+		toAttachment[1].subresourceRange = { depthAspect, 0, 1, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			0, 0, nullptr, 0, nullptr, 2, toAttachment);
+
+		VkRenderingAttachmentInfoKHR colorAttachment{};
+		colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		colorAttachment.imageView = target.colorView;
+		colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		colorAttachment.clearValue = clearValues[0];
+
+		VkRenderingAttachmentInfoKHR depthAttachment{};
+		depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		depthAttachment.imageView = target.depthView;
+		depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		depthAttachment.clearValue = clearValues[1];
+
+		VkRenderingInfoKHR renderingInfo{};
+		renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+		renderingInfo.renderArea.offset = { 0, 0 };
+		renderingInfo.renderArea.extent = target.extent;
+		renderingInfo.layerCount = 1;
+		renderingInfo.colorAttachmentCount = 1;
+		renderingInfo.pColorAttachments = &colorAttachment;
+		renderingInfo.pDepthAttachment = &depthAttachment;
+
+		this->cmdBeginRendering(commandBuffer, &renderingInfo);
+	}
+
+	VkViewport viewport{};
+	viewport.width = static_cast<float>(target.extent.width);
+	viewport.height = static_cast<float>(target.extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.extent = target.extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+
+	// Every instance the frame gathered, meshlet meshes included (through their index buffers): the main view's Hi-Z
+	// and meshlet culling results say nothing about what this camera sees. Particles stay in the main view.
+	if (this->meshPipeline != VK_NULL_HANDLE && !this->cullCandidates.empty())
+	{
+		float aspect = static_cast<float>(view.extent.width) / static_cast<float>(std::max(1u, view.extent.height));
+		float viewProjection[16];
+		(view.camera != nullptr ? *view.camera : this->camera).viewProjection(aspect, viewProjection);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->meshPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->meshPipelineLayout, 0, 1, &frame.meshDescriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, this->meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(viewProjection), viewProjection);
+
+		auto drawInstances = [&](uint32_t mesh, uint32_t first, uint32_t count) {
+			const GpuMesh& gpuMesh = this->meshes[mesh];
+			VkDeviceSize vertexOffset = 0;
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, &gpuMesh.vertexBuffer, &vertexOffset);
+			vkCmdBindIndexBuffer(commandBuffer, gpuMesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const CullCandidate& candidate = this->cullCandidates[i];
+				vkCmdDrawIndexed(commandBuffer, candidate.indexCount, 1, candidate.firstIndex, 0, candidate.transformSlot);
+			}
+		};
+
+		for (const MeshDrawBatch& batch : this->meshBatches)
+			drawInstances(batch.mesh, batch.firstDraw, batch.drawCount);
+		for (const MeshletBatch& batch : this->meshletBatches)
+			drawInstances(batch.mesh, batch.firstCandidate, batch.candidateCount);
+	}
+
+	if (!this->dynamicRenderingEnabled)
+		vkCmdEndRenderPass(commandBuffer);
+	else
+		this->cmdEndRendering(commandBuffer);
+
+	// windowRenderPass leaves the color in TRANSFER_SRC_OPTIMAL and made it visible to transfers
+	VkImageMemoryBarrier toTransfer[2]{};
+	toTransfer[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toTransfer[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toTransfer[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	toTransfer[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toTransfer[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer[0].image = target.colorImage;
+	toTransfer[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	toTransfer[1] = toTransfer[0];
+	toTransfer[1].srcAccessMask = 0;
+	toTransfer[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toTransfer[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransfer[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransfer[1].image = view.image;
+
+	uint32_t firstBarrier = this->dynamicRenderingEnabled ? 0 : 1;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 2 - firstBarrier, toTransfer + firstBarrier);
+
+	// Same size, the target follows the window's extent
+	VkImageBlit region{};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.srcOffsets[1] = { static_cast<int32_t>(target.extent.width), static_cast<int32_t>(target.extent.height), 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstOffsets[1] = region.srcOffsets[1];
+
+	vkCmdBlitImage(commandBuffer, target.colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		view.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_NEAREST);
+
+	VkImageMemoryBarrier toPresent = toTransfer[1];
+	toPresent.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toPresent.dstAccessMask = 0;
+	toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toPresent.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &toPresent);
+}
+
+void
+GameCore::beginMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool clear)
+{
+	VkClearValue clearValues[2]{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	if (!this->dynamicRenderingEnabled)
+	{
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = clear ? this->renderPass : this->loadRenderPass;
+		renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
+		renderPassInfo.renderArea.offset = { 0, 0 };
+		renderPassInfo.renderArea.extent = this->renderExtent;
+		renderPassInfo.clearValueCount = clear ? 2 : 0;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+			this->commandCache.isEnabled() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	// Without a render pass there is no initialLayout/finalLayout, so the layout transitions are explicit barriers.
+	// They mirror renderPass / loadRenderPass: a second pass picks the attachments up where endMainPass left them.
+	VkImageMemoryBarrier toAttachment[2]{};
+	toAttachment[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toAttachment[0].srcAccessMask = clear ? 0 : VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toAttachment[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toAttachment[0].oldLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : this->mainColorLayout();
+	toAttachment[0].newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	toAttachment[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toAttachment[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toAttachment[0].image = this->mainColorImage(imageIndex);
+	toAttachment[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	// The previous frame may still write depth or read it into its pyramid
+	toAttachment[1] = toAttachment[0];
+	toAttachment[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	toAttachment[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	toAttachment[1].oldLayout = clear ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	toAttachment[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	toAttachment[1].image = this->depthImage;
+	toAttachment[1].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+	if (this->depthFormat != VK_FORMAT_D32_SFLOAT)
+		toAttachment[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	// Transfer: the previous frame's upscale may still read the scene color target
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		0, 0, nullptr, 0, nullptr, 2, toAttachment);
+
+	VkRenderingAttachmentInfoKHR colorAttachment{};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = this->mainColorView(imageIndex);
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.clearValue = clearValues[0];
+
+	VkRenderingAttachmentInfoKHR depthAttachment{};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	depthAttachment.imageView = this->depthView;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.clearValue = clearValues[1];
+
+	VkRenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea.offset = { 0, 0 };
+	renderingInfo.renderArea.extent = this->renderExtent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+	if (this->commandCache.isEnabled())
+		renderingInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
+
+	this->cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void
+GameCore::endMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (!this->dynamicRenderingEnabled)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+		return;
+	}
+
+	this->cmdEndRendering(commandBuffer);
+
+	VkImageMemoryBarrier toFinal[2]{};
+	toFinal[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toFinal[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toFinal[0].dstAccessMask = this->settings.dynamicResolution.enabled ? VK_ACCESS_TRANSFER_READ_BIT : 0;
+	toFinal[0].oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	toFinal[0].newLayout = this->mainColorLayout();
+	toFinal[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toFinal[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toFinal[0].image = this->mainColorImage(imageIndex);
+	toFinal[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	toFinal[1] = toFinal[0];
+	toFinal[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	toFinal[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	toFinal[1].oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	toFinal[1].newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	toFinal[1].image = this->depthImage;
+	toFinal[1].subresourceRange = { VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, 0, 1 };
+
+	if (this->depthFormat != VK_FORMAT_D32_SFLOAT)
+		toFinal[1].subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 2, toFinal);
+}
+
+void
+GameCore::recordMainPassContents(VkCommandBuffer commandBuffer, MeshDrawList meshes, bool lastPass)
+{
+	bool firstPass = meshes != MeshDrawList::Late;
+
+	if (!this->commandCache.isEnabled())
+	{
+		this->setMainViewport(commandBuffer);
+		if (firstPass)
+			this->recordBackdrop(commandBuffer);
+		this->recordGeometry(commandBuffer, meshes);
+		// Blended, after every opaque draw
+		if (lastPass)
+			this->particles.recordDraw(commandBuffer);
+		return;
+	}
+
+	// A pass begun for secondaries can only execute them, so the per frame parts are recorded into their own
+	FrameData& frame = this->frames[this->currentFrame];
+	VkCommandBuffer secondaries[3];
+	uint32_t secondaryCount = 0;
+
+	if (firstPass)
+	{
+		this->beginPassSecondary(frame.backdropCommandBuffer);
+		this->setMainViewport(frame.backdropCommandBuffer);
+		this->recordBackdrop(frame.backdropCommandBuffer);
+		if (vkEndCommandBuffer(frame.backdropCommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to record backdrop command buffer!");
+		secondaries[secondaryCount++] = frame.backdropCommandBuffer;
+	}
+
+	secondaries[secondaryCount++] = this->cachedGeometry(meshes);
+
+	if (lastPass && this->particles.isEnabled())
+	{
+		this->beginPassSecondary(frame.overlayCommandBuffer);
+		this->setMainViewport(frame.overlayCommandBuffer);
+		this->particles.recordDraw(frame.overlayCommandBuffer);
+		if (vkEndCommandBuffer(frame.overlayCommandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to record overlay command buffer!");
+		secondaries[secondaryCount++] = frame.overlayCommandBuffer;
+	}
+
+	vkCmdExecuteCommands(commandBuffer, secondaryCount, secondaries);
+}
+
+void
+GameCore::setMainViewport(VkCommandBuffer commandBuffer)
+{
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(this->renderExtent.width);
+	viewport.height = static_cast<float>(this->renderExtent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = this->renderExtent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
+void
+GameCore::recordBackdrop(VkCommandBuffer commandBuffer)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
+	bool queried = this->gpuQueries.beginOcclusion(commandBuffer, TRIANGLE_OBJECT_ID);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	if (queried)
+		this->gpuQueries.endOcclusion(commandBuffer);
+}
+
+void
+GameCore::recordGeometry(VkCommandBuffer commandBuffer, MeshDrawList meshes)
+{
+	this->recordMeshDraws(commandBuffer, meshes);
+
+	// Never occlusion culled, so always in the first pass where they add to the depth the pyramid is built from
+	if (meshes != MeshDrawList::Late)
+		this->meshletRenderer.recordDraw(commandBuffer, this->currentFrame, this->meshletBatches, this->viewProjection, this->camera.position);
+}
+
+void
+GameCore::beginPassSecondary(VkCommandBuffer commandBuffer)
+{
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	beginInfo.pInheritanceInfo = &this->passInheritance;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording secondary command buffer!");
+}
+
+VkCommandBuffer
+GameCore::cachedGeometry(MeshDrawList meshes)
+{
+	// Per frame slot: the recording binds the slot's descriptor sets and reads its candidate list
+	uint32_t slot = this->currentFrame * 2 + (meshes == MeshDrawList::Late ? 1 : 0);
+	CommandKey key = this->geometryKey(meshes);
+
+	VkCommandBuffer commandBuffer = this->commandCache.lookup(slot, key);
+	if (commandBuffer != VK_NULL_HANDLE)
+		return commandBuffer;
+
+	commandBuffer = this->commandCache.begin(slot, key, this->passInheritance);
+	this->setMainViewport(commandBuffer);
+	this->recordGeometry(commandBuffer, meshes);
+	this->commandCache.end(slot);
+	return commandBuffer;
+}
+
+CommandKey
+GameCore::geometryKey(MeshDrawList meshes) const
+{
+	const FrameData& frame = this->frames[this->currentFrame];
+
+	// Everything recordGeometry bakes into the commands. Buffer contents (transforms, candidates, GPU written draw lists)
+	// are read when the commands execute and don't count; new buffers and the descriptor writes for them do, by the
+	// generation of just the buffers this segment uses. Mesh buffers live as long as the mesh, its index is enough.
+	CommandKey key;
+	key.add(meshes).add(this->renderExtent.width).add(this->renderExtent.height)
+		.add(this->meshPipeline).add(frame.meshDescriptorSet).add(frame.meshBoundTransforms)
+		.addBytes(this->viewProjection, sizeof(this->viewProjection));
+
+	for (const MeshDrawBatch& batch : this->meshBatches)
+		key.add(batch.mesh).add(batch.firstDraw).add(batch.drawCount);
+
+	if (meshes == MeshDrawList::All)
+	{
+		for (uint32_t i = 0; i < this->indexedCandidateCount; i++)
+		{
+			const CullCandidate& candidate = this->cullCandidates[i];
+			key.add(candidate.firstIndex).add(candidate.indexCount).add(candidate.transformSlot);
+		}
+	}
+	else
+		key.add(this->cullCommandGeneration).add(this->hizCulling.commandOffset(this->currentFrame, meshes == MeshDrawList::Late));
+
+	if (meshes != MeshDrawList::Late && !this->meshletBatches.empty())
+	{
+		// The buffers behind the meshlet renderer's frame set, see setFrameBuffers in prepareMeshDraws
+		key.add(this->sceneTransformGeneration).add(frame.cullCandidateGeneration)
+			.add(this->meshletDrawGeneration).add(this->meshletCommandGeneration);
+		key.addBytes(this->camera.position, sizeof(this->camera.position));
+		for (const MeshletBatch& batch : this->meshletBatches)
+			key.add(batch.mesh).add(batch.meshletCount).add(batch.firstCandidate).add(batch.candidateCount).add(batch.firstDraw);
+	}
+
+	return key;
+}
+
+bool
+GameCore::prepareMeshDraws(VkCommandBuffer commandBuffer)
+{
+	this->meshBatches.clear();
+	this->meshletBatches.clear();
+	this->cullCandidates.clear();
+	this->indexedCandidateCount = 0;
+
+	bool indexedPath = this->meshPipeline != VK_NULL_HANDLE;
+	bool meshletPath = this->meshletRenderer.isEnabled();
+	if ((!indexedPath && !meshletPath) || this->sceneTransformBuffer == VK_NULL_HANDLE)
+		return false;
+
+	// Bucketed by mesh, so every mesh is one vertex/index buffer bind and one (multi) draw per list
+	std::vector<std::vector<CullCandidate>> perMesh(this->meshes.size());
+
+	this->scene.forEachChunk(COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_BOUNDS, [&](SceneChunk& chunk) {
+		for (uint32_t row = 0; row < chunk.count; row++)
+		{
+			uint32_t meshIndex = chunk.meshes[row].meshIndex;
+			// Still uploading, or nothing to draw
+			if (meshIndex >= this->meshes.size() || this->meshes[meshIndex].lods.empty()
+				|| !this->graphicsTimeline.hasReached(this->meshes[meshIndex].readyValue))
+				continue;
+
+			bool meshlets = meshletPath && this->meshes[meshIndex].meshletCount > 0;
+			if (!meshlets && !indexedPath)
+				continue;
+
+			const MeshLod& lod = this->meshes[meshIndex].lods[0];
+			const Bounds& bounds = chunk.bounds[row];
+			perMesh[meshIndex].push_back({ { bounds.center[0], bounds.center[1], bounds.center[2] }, bounds.radius,
+				lod.firstIndex, lod.indexCount, chunk.gpuSlotBase + row, 0 });
+		}
+	});
+
+	for (uint32_t mesh = 0; mesh < perMesh.size(); mesh++)
+	{
+		if (perMesh[mesh].empty())
+			continue;
+
+		if (meshletPath && this->meshes[mesh].meshletCount > 0)
+			continue;
+
+		uint32_t firstDraw = static_cast<uint32_t>(this->cullCandidates.size());
+		for (CullCandidate& candidate : perMesh[mesh])
+		{
+			candidate.drawIndex = static_cast<uint32_t>(this->cullCandidates.size());
+			this->cullCandidates.push_back(candidate);
+		}
+		this->meshBatches.push_back({ mesh, firstDraw, static_cast<uint32_t>(perMesh[mesh].size()) });
+	}
+	this->indexedCandidateCount = static_cast<uint32_t>(this->cullCandidates.size());
+
+	// Behind the indexed instances, so the Hi-Z cull can keep treating the list as one draw per candidate
+	uint32_t meshletDrawCount = 0;
+	for (uint32_t mesh = 0; mesh < perMesh.size() && meshletPath; mesh++)
+	{
+		const GpuMesh& gpuMesh = this->meshes[mesh];
+		if (perMesh[mesh].empty() || gpuMesh.meshletCount == 0)
+			continue;
+
+		MeshletBatch batch{};
+		batch.mesh = mesh;
+		batch.buffers = { gpuMesh.meshletBuffer, gpuMesh.meshletVertexBuffer, gpuMesh.meshletTriangleBuffer, gpuMesh.vertexBuffer };
+		batch.meshletCount = gpuMesh.meshletCount;
+		batch.firstCandidate = static_cast<uint32_t>(this->cullCandidates.size());
+		batch.candidateCount = static_cast<uint32_t>(perMesh[mesh].size());
+		batch.firstDraw = meshletDrawCount;
+		meshletDrawCount += batch.candidateCount * batch.meshletCount;
+
+		this->cullCandidates.insert(this->cullCandidates.end(), perMesh[mesh].begin(), perMesh[mesh].end());
+		this->meshletBatches.push_back(batch);
+	}
+
+	if (this->cullCandidates.empty())
+		return false;
+
+	float aspect = static_cast<float>(this->swapChainExtent.width) / static_cast<float>(std::max(1u, this->swapChainExtent.height));
+	this->camera.viewProjection(aspect, this->viewProjection);
+
+	// This frame slot retired, its set can be pointed at a transform buffer that grew
+	FrameData& frame = this->frames[this->currentFrame];
+	if (frame.meshBoundTransforms != this->sceneTransformGeneration)
+	{
+		VkDescriptorBufferInfo bufferInfo{ this->sceneTransformBuffer, 0, VK_WHOLE_SIZE };
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = frame.meshDescriptorSet;
+		write.dstBinding = 0;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.pBufferInfo = &bufferInfo;
+
+		vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+		frame.meshBoundTransforms = this->sceneTransformGeneration;
+	}
+
+	bool culled = this->hizCulling.isEnabled() && this->indexedCandidateCount > 0;
+	if (!culled && this->meshletBatches.empty())
+		return false;
+
+	// Both cull paths read the instances from the same per frame list
+	uint32_t candidateCount = static_cast<uint32_t>(this->cullCandidates.size());
+	this->ensureCandidateCapacity(frame, candidateCount);
+	memcpy(frame.cullCandidateMapped, this->cullCandidates.data(), candidateCount * sizeof(CullCandidate));
+
+	if (!this->meshletBatches.empty())
+	{
+		if (!this->meshletRenderer.usesMeshShaders())
+			this->ensureMeshletCapacity(meshletDrawCount, static_cast<uint32_t>(this->meshletBatches.size()));
+
+		this->meshletRenderer.setFrameBuffers(this->currentFrame, { this->sceneTransformBuffer, frame.cullCandidateBuffer, this->meshletDrawBuffer, this->meshletCommandBuffer });
+		this->meshletRenderer.recordCull(commandBuffer, this->currentFrame, this->meshletBatches, this->viewProjection, this->camera.position);
+	}
+
+	if (!culled)
+		return false;
+
+	this->ensureCullingCapacity(commandBuffer, this->indexedCandidateCount);
+
+	this->hizCulling.setBuffers(this->currentFrame, { frame.cullCandidateBuffer, this->cullVisibilityBuffer, this->cullCommandBuffer, this->cullDrawCapacity });
+	this->hizCulling.setRenderExtent(this->renderExtent);
+	this->hizCulling.recordEarlyCull(commandBuffer, this->currentFrame, this->viewProjection, this->indexedCandidateCount);
+	return true;
+}
+
+void
+GameCore::recordMeshDraws(VkCommandBuffer commandBuffer, MeshDrawList list)
+{
+	if (this->meshBatches.empty())
+		return;
+
+	const FrameData& frame = this->frames[this->currentFrame];
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->meshPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->meshPipelineLayout, 0, 1, &frame.meshDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, this->meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->viewProjection), this->viewProjection);
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	VkDeviceSize listOffset = list == MeshDrawList::All ? 0 : this->hizCulling.commandOffset(this->currentFrame, list == MeshDrawList::Late);
+
+	for (const MeshDrawBatch& batch : this->meshBatches)
+	{
+		const GpuMesh& mesh = this->meshes[batch.mesh];
+		VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh.vertexBuffer, &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+
+		// Not culled: every instance, straight from the CPU side list
+		if (list == MeshDrawList::All)
+		{
+			for (uint32_t i = batch.firstDraw; i < batch.firstDraw + batch.drawCount; i++)
+			{
+				const CullCandidate& candidate = this->cullCandidates[i];
+				vkCmdDrawIndexed(commandBuffer, candidate.indexCount, 1, candidate.firstIndex, 0, candidate.transformSlot);
+			}
+			continue;
+		}
+
+		// Culled instances have instanceCount 0, the draw is still issued but produces nothing
+		VkDeviceSize offset = listOffset + VkDeviceSize(batch.firstDraw) * stride;
+		if (this->multiDrawIndirectEnabled)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, this->cullCommandBuffer, offset, batch.drawCount, stride);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < batch.drawCount; i++)
+			vkCmdDrawIndexedIndirect(commandBuffer, this->cullCommandBuffer, offset + VkDeviceSize(i) * stride, 1, stride);
+	}
+}
+
+void
+GameCore::ensureCullingCapacity(VkCommandBuffer commandBuffer, uint32_t drawCount)
+{
+	// Visibility is per transform slot so it survives instances moving around in the candidate list
+	if (this->cullVisibilityCapacity < this->sceneTransformCapacity)
+	{
+		if (this->cullVisibilityBuffer != VK_NULL_HANDLE)
+			this->DeferDestroyBuffer(this->cullVisibilityBuffer, this->cullVisibilityMemory);
+
+		this->createBuffer(VkDeviceSize(this->sceneTransformCapacity) * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->cullVisibilityBuffer, this->cullVisibilityMemory);
+
+		this->cullVisibilityCapacity = this->sceneTransformCapacity;
+
+		// Nothing counts as visible yet, so the late phase tests (and draws) everything
+		vkCmdFillBuffer(commandBuffer, this->cullVisibilityBuffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (this->cullDrawCapacity < drawCount)
+	{
+		// The other frame in flight may still draw from the old lists
+		uint32_t capacity = std::max(drawCount, this->cullDrawCapacity * 2);
+
+		if (this->cullCommandBuffer != VK_NULL_HANDLE)
+			this->DeferDestroyBuffer(this->cullCommandBuffer, this->cullCommandMemory);
+
+		this->createBuffer(VkDeviceSize(capacity) * 2 * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->cullCommandBuffer, this->cullCommandMemory);
+
+		this->cullDrawCapacity = capacity;
+		this->cullCommandGeneration = this->resourceGeneration;
+	}
+}
+
+void
+GameCore::ensureCandidateCapacity(FrameData& frame, uint32_t candidateCount)
+{
+	if (frame.cullCandidateCapacity >= candidateCount)
+		return;
+
+	// This frame slot already retired on the GPU, its candidate buffer can go right away
+	if (frame.cullCandidateBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(this->device, frame.cullCandidateBuffer, this->allocationCallbacks());
+		this->freeMemory(frame.cullCandidateMemory);
+	}
+
+	uint32_t capacity = std::max(candidateCount, frame.cullCandidateCapacity * 2);
+	this->createBuffer(VkDeviceSize(capacity) * sizeof(CullCandidate),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		frame.cullCandidateBuffer, frame.cullCandidateMemory);
+
+	vkMapMemory(this->device, frame.cullCandidateMemory, 0, VK_WHOLE_SIZE, 0, &frame.cullCandidateMapped);
+	frame.cullCandidateCapacity = capacity;
+	frame.cullCandidateGeneration = this->resourceGeneration;
+}
+
+void
+GameCore::ensureMeshletCapacity(uint32_t drawCount, uint32_t batchCount)
+{
+	// The other frame in flight may still draw from the old buffers
+	if (this->meshletDrawCapacity < drawCount)
+	{
+		uint32_t capacity = std::max(drawCount, this->meshletDrawCapacity * 2);
+
+		if (this->meshletDrawBuffer != VK_NULL_HANDLE)
+			this->DeferDestroyBuffer(this->meshletDrawBuffer, this->meshletDrawMemory);
+
+		// uvec2 (transform slot, meshlet) per entry
+		this->createBuffer(VkDeviceSize(capacity) * 2 * sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->meshletDrawBuffer, this->meshletDrawMemory);
+
+		this->meshletDrawCapacity = capacity;
+		this->meshletDrawGeneration = this->resourceGeneration;
+	}
+
+	if (this->meshletCommandCapacity < batchCount)
+	{
+		uint32_t capacity = std::max(batchCount, this->meshletCommandCapacity * 2);
+
+		if (this->meshletCommandBuffer != VK_NULL_HANDLE)
+			this->DeferDestroyBuffer(this->meshletCommandBuffer, this->meshletCommandMemory);
+
+		this->createBuffer(VkDeviceSize(capacity) * sizeof(VkDrawIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->meshletCommandBuffer, this->meshletCommandMemory);
+
+		this->meshletCommandCapacity = capacity;
+		this->meshletCommandGeneration = this->resourceGeneration;
+	}
+}
+
+void
+GameCore::createMirrorWindows()
+{
+	QueueFamilyIndices indices = this->findQueueFamilies(this->physicalDevice);
+
+	MirrorContext context{};
+	context.instance = this->instance;
+	context.physicalDevice = this->physicalDevice;
+	context.device = this->device;
+	context.graphicsFamily = indices.graphicsFamily.value();
+	context.presentFamily = indices.presentFamily.value();
+	context.frameCount = MAX_FRAMES_IN_FLIGHT;
+	context.presentMode = this->settings.present.presentMode;
+	context.allocator = this->allocationCallbacks();
+
+	this->mirrorWindows.create(context, this->settings.mirrorWindows, this->width, this->height);
+}
+
+void
+GameCore::prepareWindowTargets()
+{
+	for (auto it = this->windowTargets.begin(); it != this->windowTargets.end();)
+	{
+		if (this->mirrorWindows.isOpen(it->first))
+		{
+			it++;
+			continue;
+		}
+
+		this->destroyWindowTarget(it->second);
+		it = this->windowTargets.erase(it);
+	}
+
+	// A resized window gets a new target, the old one may still be rendered into by the other frame in flight
+	for (const MirrorView& view : this->mirrorWindows.getViews())
+	{
+		WindowTarget& target = this->windowTargets[view.id];
+		if (target.extent.width == view.extent.width && target.extent.height == view.extent.height)
+			continue;
+
+		if (target.colorImage != VK_NULL_HANDLE)
+			this->destroyWindowTarget(target);
+		this->createWindowTarget(target, view.extent);
+	}
+}
+
+void
+GameCore::createWindowTarget(WindowTarget& target, VkExtent2D extent)
+{
+	target = WindowTarget{};
+	target.extent = extent;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent = { extent.width, extent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+
+	VkImageAspectFlags depthAspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (this->depthFormat != VK_FORMAT_D32_SFLOAT)
+		depthAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	struct {
+		VkFormat format;
+		VkImageUsageFlags usage;
+		VkImageAspectFlags aspect;
+		VkImage* image;
+		VkDeviceMemory* memory;
+		VkImageView* view;
+	} attachments[] = {
+		{ this->swapChainImageFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+			&target.colorImage, &target.colorMemory, &target.colorView },
+		{ this->depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depthAspect,
+			&target.depthImage, &target.depthMemory, &target.depthView },
+	};
+
+	for (const auto& attachment : attachments)
+	{
+		imageInfo.format = attachment.format;
+		imageInfo.usage = attachment.usage;
+
+		if (vkCreateImage(this->device, &imageInfo, this->allocationCallbacks(), attachment.image) != VK_SUCCESS)
+			throw std::runtime_error("failed to create mirror window target!");
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(this->device, *attachment.image, &memRequirements);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = this->findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		this->allocateMemory(allocInfo, memRequirements.size, *attachment.memory);
+		vkBindImageMemory(this->device, *attachment.image, *attachment.memory, 0);
+
+		viewInfo.image = *attachment.image;
+		viewInfo.format = attachment.format;
+		viewInfo.subresourceRange = { attachment.aspect, 0, 1, 0, 1 };
+
+		if (vkCreateImageView(this->device, &viewInfo, this->allocationCallbacks(), attachment.view) != VK_SUCCESS)
+			throw std::runtime_error("failed to create mirror window target view!");
+	}
+
+	if (this->dynamicRenderingEnabled)
+		return;
+
+	VkImageView views[] = { target.colorView, target.depthView };
+
+	VkFramebufferCreateInfo frameBufferInfo{};
+	frameBufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	frameBufferInfo.renderPass = this->windowRenderPass;
+	frameBufferInfo.attachmentCount = 2;
+	frameBufferInfo.pAttachments = views;
+	frameBufferInfo.width = extent.width;
+	frameBufferInfo.height = extent.height;
+	frameBufferInfo.layers = 1;
+
+	if (vkCreateFramebuffer(this->device, &frameBufferInfo, this->allocationCallbacks(), &target.framebuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to create framebuffer!");
+}
+
+void
+GameCore::destroyWindowTarget(const WindowTarget& target)
+{
+	if (target.framebuffer != VK_NULL_HANDLE)
+	{
+		VkFramebuffer framebuffer = target.framebuffer;
+		this->DeferDelete([this, framebuffer]() { vkDestroyFramebuffer(this->device, framebuffer, this->allocationCallbacks()); });
+	}
+
+	this->DeferDestroyImage(target.colorImage, target.colorView, target.colorMemory);
+	this->DeferDestroyImage(target.depthImage, target.depthView, target.depthMemory);
+}
+
+void 
+GameCore::createSyncObjects() {
+	this->graphicsTimeline.create(this->device, 0, this->allocationCallbacks());
+
+	// vkAcquireNextImageKHR and vkQueuePresentKHR only accept binary semaphores, everything else waits on the timeline
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (auto& frame : this->frames)
+	{
+		if (vkCreateSemaphore(this->device, &semaphoreInfo, this->allocationCallbacks(), &frame.imageAvailableSemaphore) != VK_SUCCESS)
+			throw std::runtime_error("failed to create synchronization objects for a frame!");
+	}
+
+	this->createRenderFinishedSemaphores();
+	this->startLatencyTracking();
+}
+
+void
+GameCore::createRenderFinishedSemaphores()
+{
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	// Indexed by swap chain image: the presentation engine may still hold the semaphore of an image after its frame slot retired
+	this->renderFinishedSemaphores.resize(this->swapChainImages.size());
+
+	for (auto& semaphore : this->renderFinishedSemaphores)
+	{
+		if (vkCreateSemaphore(this->device, &semaphoreInfo, this->allocationCallbacks(), &semaphore) != VK_SUCCESS)
+			throw std::runtime_error("failed to create synchronization objects for a frame!");
+	}
+}
+
+void
+GameCore::destroySyncObjects()
+{
+	for (auto& frame : this->frames)
+	{
+		vkDestroySemaphore(this->device, frame.imageAvailableSemaphore, this->allocationCallbacks());
+	}
+
+	this->destroyRenderFinishedSemaphores();
+	this->graphicsTimeline.destroy();
+}
+
+void
+GameCore::destroyRenderFinishedSemaphores()
+{
+	for (auto semaphore : this->renderFinishedSemaphores)
+	{
+		vkDestroySemaphore(this->device, semaphore, this->allocationCallbacks());
+	}
+
+	this->renderFinishedSemaphores.clear();
+}
+
+void 
+GameCore::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
+	createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
+	// Subscribe to everything, DebugMessageLog applies the runtime filter before copying anything
+	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+	createInfo.pfnUserCallback = DebugMessageLog::callback;
+	createInfo.pUserData = &this->debugLog;
+}
+
+void 
+GameCore::setupDebugMessenger()
+{
+	if (!this->enableValidationLayers)
+		return;
+
+	VkDebugUtilsMessengerCreateInfoEXT createInfo;
+	this->populateDebugMessengerCreateInfo(createInfo);
+
+	if (this->CreateDebugUtilsMessengerEXT(instance, &createInfo, this->allocationCallbacks(), &debugMessenger) != VK_SUCCESS) {
+		throw std::runtime_error("failed to set up debug messenger!");
+	}
+}
+
+void
+GameCore::initVulkan()
+{
+	StartupTimer& timer = this->startupTimer;
+
+	timer.measure("asset archive", [this]() { this->openAssetArchive(); });
+
+	// Shader bytes don't depend on the device, the workers read them while the instance and device come up
+	this->prefetchAsset("shaders/vert.spv");
+	this->prefetchAsset("shaders/frag.spv");
+
+	timer.measure("instance", [this]() { this->createVulkanInstance(); });
+	timer.measure("debug messenger", [this]() { this->setupDebugMessenger(); });
+
+	timer.measure("surface", [this]() { this->createSurface(); });
+	
+	timer.measure("pick physical device", [this]() { this->pickPhysicalDevice(); });
+	timer.measure("logical device", [this]() { this->createLogicalDevice(); });
+	// Before the depth buffer, which only gets a pyramid when culling is on
+	timer.measure("occlusion culling", [this]() { this->createOcclusionCulling(); });
+	timer.measure("swap chain", [this]() {
+		this->createSwapChain();
+		this->createImageViews();
+		this->createDepthResources();
+		this->createSceneColorTarget();
+	});
+
+	// The dynamic rendering path has no render pass or framebuffers to keep in sync with the swap chain
+	if (!this->dynamicRenderingEnabled)
+		timer.measure("render pass", [this]() { this->createRenderPass(); });
+
+	timer.measure("graphics pipeline", [this]() {
+		this->createGraphicsPipeline();
+		this->createMeshPipeline();
+		this->createMeshletRenderer();
+	});
+
+	if (!this->dynamicRenderingEnabled)
+		timer.measure("framebuffers", [this]() { this->createFrameBuffers(); });
+
+	timer.measure("command buffers and sync", [this]() {
+		this->createCommandPool();
+		this->createCommandBuffer();
+		this->createCommandCache();
+		this->createSyncObjects();
+	});
+
+	if (this->settings.mirrorWindows > 0)
+		timer.measure("mirror windows", [this]() { this->createMirrorWindows(); });
+
+	if (this->settings.particleCapacity > 0)
+		timer.measure("particles", [this]() { this->createParticleSystem(); });
+
+	if (this->settings.capture.enabled)
+		this->createFrameCapture();
+
+	if (this->settings.metricsPort != 0 && this->metricsServer.start(this->settings.metricsPort, &this->rendererMetrics))
+	{
+		// Published where the budget is refreshed, so the render thread never copies the heaps for the endpoint
+		this->memoryTelemetry.setPublishCallback([this](const std::vector<MemoryHeapStats>& heaps) {
+			RendererMetrics& metrics = this->rendererMetrics;
+			uint32_t heapCount = std::min<uint32_t>(static_cast<uint32_t>(heaps.size()), VK_MAX_MEMORY_HEAPS);
+			for (uint32_t i = 0; i < heapCount; i++)
+			{
+				metrics.heaps[i].size.store(heaps[i].size, std::memory_order_relaxed);
+				metrics.heaps[i].budget.store(heaps[i].budget, std::memory_order_relaxed);
+				metrics.heaps[i].usage.store(heaps[i].usage, std::memory_order_relaxed);
+				metrics.heaps[i].deviceLocal.store(heaps[i].deviceLocal, std::memory_order_relaxed);
+			}
+			metrics.heapCount.store(heapCount, std::memory_order_relaxed);
+		});
+	}
+}
+
+int 
+GameCore::rateDeviceSuitability(VkPhysicalDevice device, std::string& breakdown)
+{
+	const DeviceProfile& profile = this->settings.device;
+
+	VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 deviceProperties{};
+	deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(device, &deviceProperties);
+
+	// Every usable device scores at least 1, so a CPU implementation still runs when it is all there is
+	int score = 1;
+	auto add = [&](int points, const std::string& why) {
+		score += points;
+		breakdown += (breakdown.empty() ? "" : ", ") + why + " +" + std::to_string(points);
+	};
+
+	switch (deviceProperties.properties.deviceType)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: add(profile.preferDiscrete ? 1000 : 500, "discrete"); break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: add(profile.preferDiscrete ? 500 : 1000, "integrated"); break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: add(200, "virtual"); break;
+	default: breakdown += "cpu/other"; break;
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+	VkDeviceSize deviceLocalBytes = 0;
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			deviceLocalBytes = std::max(deviceLocalBytes, memoryProperties.memoryHeaps[i].size);
+	}
+
+	if (profile.preferredDeviceLocalBytes > 0)
+	{
+		double share = std::min(1.0, double(deviceLocalBytes) / double(profile.preferredDeviceLocalBytes));
+		add(static_cast<int>(share * 500), std::to_string(deviceLocalBytes / (1024 * 1024)) + " MB device local");
+	}
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	QueueFamilyIndices indices = this->findQueueFamilies(device);
+	if (profile.preferCombinedGraphicsPresent && indices.graphicsFamily == indices.presentFamily)
+		add(100, "combined graphics/present");
+
+	bool asyncCompute = std::any_of(queueFamilies.begin(), queueFamilies.end(), [](const VkQueueFamilyProperties& family) {
+		return (family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(family.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+	});
+	if (profile.preferAsyncCompute && asyncCompute)
+		add(100, "async compute");
+
+	if (profile.preferredSubgroupSize != 0 && subgroupProperties.subgroupSize == profile.preferredSubgroupSize)
+		add(50, "subgroup " + std::to_string(subgroupProperties.subgroupSize));
+
+	return score;
+}
+
+bool
+GameCore::matchesDeviceOverride(VkPhysicalDevice device, uint32_t index, const std::string& deviceOverride)
+{
+	// Short all-digit strings are indices, anything else is compared against the UUID
+	if (deviceOverride.size() < 8 && std::all_of(deviceOverride.begin(), deviceOverride.end(), ::isdigit))
+		return std::stoul(deviceOverride) == index;
+
+	VkPhysicalDeviceIDProperties idProperties{};
+	idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 deviceProperties{};
+	deviceProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	deviceProperties.pNext = &idProperties;
+	vkGetPhysicalDeviceProperties2(device, &deviceProperties);
+
+	static const char* hex = "0123456789abcdef";
+	std::string uuid;
+	for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+	{
+		uuid += hex[idProperties.deviceUUID[i] >> 4];
+		uuid += hex[idProperties.deviceUUID[i] & 0xF];
+	}
+
+	std::string wanted;
+	for (char c : deviceOverride)
+	{
+		if (c != '-')
+			wanted += static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+	}
+
+	return wanted == uuid;
+}
+
+QueueFamilyIndices  
+GameCore::findQueueFamilies(VkPhysicalDevice device) {
+
+	uint32_t queueFamilyCount = 0;
+
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+
+	QueueFamilyIndices indices;
+
+	int i = 0;
+	for (const auto& queueFamily : queueFamilies) {
+		bool graphicsSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+
+		VkBool32 presentSupport = false;
+		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+
+		// A family that does both wins, it saves an ownership transfer of every swap chain image
+		if (graphicsSupport && presentSupport)
+		{
+			indices.graphicsFamily = i;
+			indices.presentFamily = i;
+			break;
+		}
+
+		if (graphicsSupport && !indices.graphicsFamily.has_value())
+			indices.graphicsFamily = i;
+
+		if (presentSupport && !indices.presentFamily.has_value())
+			indices.presentFamily = i;
+
+		i++;
+	}
+
+	for (uint32_t family = 0; family < queueFamilyCount; family++)
+	{
+		VkQueueFlags flags = queueFamilies[family].queueFlags;
+		if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.computeFamily = family;
+			break;
+		}
+	}
+
+	// No dedicated family: a second queue of the graphics family still runs concurrently on most hardware
+	if (!indices.computeFamily.has_value() && indices.graphicsFamily.has_value())
+	{
+		indices.computeFamily = indices.graphicsFamily;
+		indices.computeQueueIndex = queueFamilies[indices.graphicsFamily.value()].queueCount > 1 ? 1 : 0;
+	}
+
+	// Logic to find queue family indices to populate struct with
+	return indices;
+
+}
+
+bool
+GameCore::checkDeviceExtensionSupport(VkPhysicalDevice device)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExts(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExts.data());
+
+	std::set<std::string> requiredExtensions(this->deviceExtensions.begin(), this->deviceExtensions.end());
+
+	for (const auto& extension : availableExts) {
+		requiredExtensions.erase(extension.extensionName);
+	}
+
+	return requiredExtensions.empty();
+}
+
+bool
+GameCore::isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExts(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExts.data());
+
+	for (const auto& extension : availableExts) {
+		if (strcmp(extension.extensionName, extensionName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool
+GameCore::hasFeatureQueries(VkPhysicalDevice device)
+{
+	// vkGetPhysicalDeviceFeatures2 and vkGetPhysicalDeviceMemoryProperties2 are core since 1.1, a 1.0 device listing an
+	// extension can't be asked about its features through them
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	return deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+}
+
+bool
+GameCore::checkDynamicRenderingSupport(VkPhysicalDevice device)
+{
+	if (!this->hasFeatureQueries(device) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures{};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamicRenderingFeatures;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return dynamicRenderingFeatures.dynamicRendering == VK_TRUE;
+}
+
+bool
+GameCore::checkTimelineSemaphoreSupport(VkPhysicalDevice device)
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_2)
+		return false;
+
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &timelineFeatures;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool
+GameCore::checkPresentWaitSupport(VkPhysicalDevice device)
+{
+	if (!this->hasFeatureQueries(device) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_PRESENT_ID_EXTENSION_NAME) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.pNext = &presentIdFeatures;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &presentWaitFeatures;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return presentIdFeatures.presentId == VK_TRUE && presentWaitFeatures.presentWait == VK_TRUE;
+}
+
+bool
+GameCore::checkMemoryBudgetSupport(VkPhysicalDevice device)
+{
+	// Also needs vkGetPhysicalDeviceMemoryProperties2, which is core since 1.1
+	return this->hasFeatureQueries(device) && this->isDeviceExtensionAvailable(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+}
+
+bool
+GameCore::checkMeshShaderSupport(VkPhysicalDevice device)
+{
+	// Mesh shaders are SPIR-V 1.4, which a 1.2 device only accepts with VK_KHR_spirv_1_4
+	if (!this->hasFeatureQueries(device) ||
+		!this->isDeviceExtensionAvailable(device, VK_EXT_MESH_SHADER_EXTENSION_NAME) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_SPIRV_1_4_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &meshShaderFeatures;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return meshShaderFeatures.taskShader == VK_TRUE && meshShaderFeatures.meshShader == VK_TRUE;
+}
+
+bool
+GameCore::checkPipelineLibrarySupport(VkPhysicalDevice device)
+{
+	if (!this->hasFeatureQueries(device) ||
+		!this->isDeviceExtensionAvailable(device, VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) ||
+		!this->isDeviceExtensionAvailable(device, VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME))
+		return false;
+
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+	pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &pipelineLibraryFeatures;
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	return pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+}
+
+bool 
+GameCore::isDeviceSuitable(VkPhysicalDevice device, std::string& reason)
+{
+	const DeviceProfile& profile = this->settings.device;
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+	if (deviceProperties.apiVersion < profile.minApiVersion)
+	{
+		reason = "Vulkan " + std::to_string(VK_API_VERSION_MAJOR(deviceProperties.apiVersion)) + "." +
+			std::to_string(VK_API_VERSION_MINOR(deviceProperties.apiVersion)) + " is too old";
+		return false;
+	}
+
+	// VkPhysicalDeviceFeatures is nothing but VkBool32s, compare them member by member
+	VkPhysicalDeviceFeatures deviceFeatures;
+	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+
+	const VkBool32* required = reinterpret_cast<const VkBool32*>(&profile.requiredFeatures);
+	const VkBool32* supported = reinterpret_cast<const VkBool32*>(&deviceFeatures);
+	for (size_t i = 0; i < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); i++)
+	{
+		if (required[i] && !supported[i])
+		{
+			reason = "missing required feature #" + std::to_string(i) + " of VkPhysicalDeviceFeatures";
+			return false;
+		}
+	}
+
+	if (!findQueueFamilies(device).isComplete())
+	{
+		reason = "no graphics or present queue for this surface";
+		return false;
+	}
+
+	if (!checkTimelineSemaphoreSupport(device))
+	{
+		reason = "no timeline semaphores";
+		return false;
+	}
+
+	if (!checkDeviceExtensionSupport(device))
+	{
+		reason = "missing required device extensions";
+		return false;
+	}
+
+	SwapChainSupportDetails details = this->querySwapChainSupport(device);
+	if (details.formats.empty() || details.presentModes.empty())
+	{
+		reason = "no surface formats or present modes";
+		return false;
+	}
+
+	return true;
+}
 
 void 
-GameCore::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+GameCore::drawFrame() {
+	if (this->swapChainDirty)
+	{
+		this->recreateSwapChain();
+		if (this->swapChainDirty)
+			return;
+	}
 
-	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
-		throw std::runtime_error("failed to begin recording command buffer!");
+	FrameData& frame = this->frames[this->currentFrame];
+
+	// Block on the GPU first and only then sample input, so the input is as fresh as possible when recording starts
+	auto waitStart = std::chrono::steady_clock::now();
+	this->waitForFrameSlot(frame);
+	this->gpuQueries.addGpuWait(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - waitStart).count());
+	this->gpuQueries.collect(this->currentFrame);
+	this->gpuQueries.report(this->renderExtent);
+
+	if (this->settings.dynamicResolution.enabled)
+	{
+		// The slot just retired, its GPU time belongs to the scale it was recorded at
+		this->dynamicResolution.update(this->gpuQueries.getGpuFrameMs(), frame.renderScale);
+		frame.renderScale = this->dynamicResolution.getScale();
+		this->renderExtent = this->dynamicResolution.renderExtent(this->swapChainExtent);
+		this->dynamicResolution.report(this->swapChainExtent);
 	}
+	this->recycleUploads();
+	this->deletionQueue.collect(this->graphicsTimeline.completedValue());
+	this->frameCapture.poll(this->graphicsTimeline);
+	this->latencyTracker.report(this->presentWaitEnabled ? "present wait" : "gpu complete");
+	this->memoryTelemetry.update();
+	this->memoryTelemetry.report();
+	this->hostAllocator.report();
+	this->commandCache.report();
+
+	glfwPollEvents();
+	auto inputTime = LatencyTracker::clock::now();
+
+	// Clamped so a hitch (or the first frame) doesn't throw every particle across the screen
+	if (this->isGoldenRun())
+		this->frameDeltaTime = 1.0f / 60.0f; // golden images must not depend on how fast the frames came
+	else if (this->lastFrameTime.time_since_epoch().count() != 0)
+		this->frameDeltaTime = std::min(0.1f, std::chrono::duration<float>(inputTime - this->lastFrameTime).count());
+
+	if (this->metricsServer.isRunning() && this->lastFrameTime.time_since_epoch().count() != 0)
+		this->publishMetrics(std::chrono::duration<float, std::milli>(inputTime - this->lastFrameTime).count());
+	this->lastFrameTime = inputTime;
 
-	VkRenderPassBeginInfo renderPassInfo{};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = this->renderPass;
-	renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = this->swapChainExtent;
+	uint32_t imageIndex;
+	VkResult acquireResult = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
 
-	VkClearValue clearColor = { {{0.0f, 0.0f, 0.0f, 1.0f}} };
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
+	// Nothing was signaled, so the frame slot can simply be retried against the new swap chain next time
+	if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR)
+	{
+		this->recreateSwapChain();
+		return;
+	}
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR)
+		throw std::runtime_error("failed to acquire swap chain image!");
+
+	// The fast-linked pipelines an optimized link replaces may still be used by the frames in flight
+	this->pipelineLibrary.poll([this](VkPipeline pipeline) {
+		this->deletionQueue.push([this, pipeline]() { vkDestroyPipeline(this->device, pipeline, this->allocationCallbacks()); });
+	});
+
+	vkResetCommandBuffer(frame.commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
+	recordCommandBuffer(frame.commandBuffer, imageIndex);
+
+	// Skips (never waits for) mirror windows without a free image. Their views draw the instances the frame just
+	// gathered, one worker per window, while this thread finishes the frame.
+	this->mirrorWindows.acquire(this->currentFrame);
+	this->prepareWindowTargets();
+	this->mirrorWindows.beginRecording(this->currentFrame, [this](VkCommandBuffer commandBuffer, const MirrorView& view) {
+		this->recordWindowView(commandBuffer, view);
+	}, this->threadPool);
+
+	// With dynamic resolution the swap chain image is only written by the upscale: the scene goes in a submission of its
+	// own that doesn't wait for the acquire, so its uploads and compute aren't held up by it either
+	bool splitSubmit = this->settings.dynamicResolution.enabled;
+	if (splitSubmit)
+	{
+		vkResetCommandBuffer(frame.presentCommandBuffer, 0);
+		this->recordPresentCommandBuffer(frame.presentCommandBuffer, imageIndex);
+	}
+	this->mirrorWindows.finishRecording();
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	uint64_t signalValue = this->graphicsTimeline.nextValue();
+	uint64_t framePresentId = ++this->presentId;
 
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(this->swapChainExtent.width);
-	viewport.height = static_cast<float>(this->swapChainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	// One submission and one present for every window, the main window's entries first
+	PresentBatch& batch = this->presentBatch;
+	batch.clear();
 
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = this->swapChainExtent;
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	// The compute wait is only there when this frame consumes buffers handed off by SubmitCompute
+	VkSemaphore computeSemaphore = this->asyncCompute.getTimeline().handle();
 
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	VkTimelineSemaphoreSubmitInfo sceneTimelineInfo{};
+	sceneTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	VkSubmitInfo sceneSubmitInfo{};
+	sceneSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	vkCmdEndRenderPass(commandBuffer);
+	if (splitSubmit)
+	{
+		if (this->computeWaitValue > 0)
+		{
+			sceneTimelineInfo.waitSemaphoreValueCount = 1;
+			sceneTimelineInfo.pWaitSemaphoreValues = &this->computeWaitValue;
+			sceneSubmitInfo.pNext = &sceneTimelineInfo;
+			sceneSubmitInfo.waitSemaphoreCount = 1;
+			sceneSubmitInfo.pWaitSemaphores = &computeSemaphore;
+			sceneSubmitInfo.pWaitDstStageMask = &this->computeWaitStages;
+		}
+		sceneSubmitInfo.commandBufferCount = 1;
+		sceneSubmitInfo.pCommandBuffers = &frame.commandBuffer;
 
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-		throw std::runtime_error("failed to record command buffer!");
+		batch.addWait(frame.imageAvailableSemaphore, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		batch.commandBuffers.push_back(frame.presentCommandBuffer);
 	}
-}
+	else
+	{
+		batch.addWait(frame.imageAvailableSemaphore, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		if (this->computeWaitValue > 0)
+			batch.addWait(computeSemaphore, this->computeWaitStages, this->computeWaitValue);
+		batch.commandBuffers.push_back(frame.commandBuffer);
+	}
+	batch.addSignal(this->renderFinishedSemaphores[imageIndex]);
+	batch.addSignal(this->graphicsTimeline.handle(), signalValue);
+	batch.addPresent(this->renderFinishedSemaphores[imageIndex], this->swapChain, imageIndex, framePresentId);
 
-void 
-GameCore::createSyncObjects() {
-	VkSemaphoreCreateInfo semaphoreInfo{};
-	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	// Behind the frame's command buffer, which uploads the transforms their views draw
+	this->mirrorWindows.append(this->currentFrame, batch);
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(batch.waitValues.size());
+	timelineInfo.pWaitSemaphoreValues = batch.waitValues.data();
+	timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(batch.signalValues.size());
+	timelineInfo.pSignalSemaphoreValues = batch.signalValues.data();
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
 
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(batch.waitSemaphores.size());
+	submitInfo.pWaitSemaphores = batch.waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = batch.waitStages.data();
 
-	if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->imageAvailableSemaphore) != VK_SUCCESS ||
-		vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->renderFinishedSemaphore) != VK_SUCCESS ||
-		vkCreateFence(this->device, &fenceInfo, nullptr, &this->inFlightFence) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create synchronization objects for a frame!");
+	submitInfo.commandBufferCount = static_cast<uint32_t>(batch.commandBuffers.size());
+	submitInfo.pCommandBuffers = batch.commandBuffers.data();
+
+	submitInfo.signalSemaphoreCount = static_cast<uint32_t>(batch.signalSemaphores.size());
+	submitInfo.pSignalSemaphores = batch.signalSemaphores.data();
+
+	// The scene submission (split frames only) comes first, the batch signals what the present waits for
+	VkSubmitInfo submitInfos[2] = { sceneSubmitInfo, submitInfo };
+	uint32_t firstSubmit = splitSubmit ? 0 : 1;
+
+	if (vkQueueSubmit(graphicsQueue, 2 - firstSubmit, submitInfos + firstSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit draw command buffer!");
+	}
+
+	frame.timelineValue = signalValue;
+
+	if (this->pendingCapture != nullptr)
+	{
+		this->frameCapture.submitted(this->pendingCapture, signalValue);
+		this->pendingCapture = nullptr;
 	}
+	// Anything released while this frame was recorded may still be referenced by it
+	this->deletionQueue.stamp(signalValue);
+
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+	presentInfo.waitSemaphoreCount = static_cast<uint32_t>(batch.presentWaits.size());
+	presentInfo.pWaitSemaphores = batch.presentWaits.data();
+
+	presentInfo.swapchainCount = static_cast<uint32_t>(batch.swapChains.size());
+	presentInfo.pSwapchains = batch.swapChains.data();
+	presentInfo.pImageIndices = batch.imageIndices.data();
+	// Per swap chain, so an out of date mirror doesn't get mistaken for the main window
+	presentInfo.pResults = batch.presentResults.data();
+
+	VkPresentIdKHR presentIdInfo{};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = static_cast<uint32_t>(batch.presentIds.size());
+	presentIdInfo.pPresentIds = batch.presentIds.data();
+
+	if (this->presentWaitEnabled)
+		presentInfo.pNext = &presentIdInfo;
+
+	VkResult batchResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+	VkResult presentResult = batch.presentResults[0];
 
+	// A lost mirror surface fails the whole call, the per swap chain results say whose it was
+	if (batchResult != VK_SUCCESS && batchResult != VK_SUBOPTIMAL_KHR && batchResult != VK_ERROR_OUT_OF_DATE_KHR && batchResult != VK_ERROR_SURFACE_LOST_KHR)
+		throw std::runtime_error("failed to present swap chain image!");
+
+	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR)
+		this->swapChainDirty = true;
+	else if (presentResult != VK_SUCCESS)
+		throw std::runtime_error("failed to present swap chain image!");
+
+	this->mirrorWindows.presented(batch.presentResults.data() + 1);
+
+	this->latencyTracker.frameSubmitted(framePresentId, signalValue, this->swapChain, inputTime);
+	this->startupTimer.firstFramePresented();
+
+	this->currentFrame = (this->currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void 
-GameCore::populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo) {
-	createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT;
-	createInfo.messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
-	createInfo.messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
-	createInfo.pfnUserCallback = debugCallback;
+void
+GameCore::publishMetrics(float frameMs)
+{
+	// Plain relaxed stores, the server thread reads whatever is there when it is scraped
+	RendererMetrics& metrics = this->rendererMetrics;
+	metrics.addFrame(frameMs);
+	metrics.gpuFrameMs.store(this->gpuQueries.getGpuFrameMs(), std::memory_order_relaxed);
+	metrics.draws.store(this->cullCandidates.size(), std::memory_order_relaxed);
+	metrics.triangles.store(this->gpuQueries.getStatistics().clippingInvocations, std::memory_order_relaxed);
+	// The heaps are published by memoryTelemetry.update(), see Initialize
 }
 
-void 
-GameCore::setupDebugMessenger()
+void
+GameCore::waitForFrameSlot(FrameData& frame)
 {
-	if (!this->enableValidationLayers)
+	// Wait until the GPU retired the last submission that used this frame slot (MAX_FRAMES_IN_FLIGHT frames ago)
+	this->graphicsTimeline.wait(frame.timelineValue);
+
+	if (!this->settings.lowLatency)
 		return;
 
-	VkDebugUtilsMessengerCreateInfoEXT createInfo;
-	this->populateDebugMessengerCreateInfo(createInfo);
+	// Low latency: don't let the CPU run ahead at all, the previous frame must be on screen (or at least done on the GPU)
+	if (this->presentWaitEnabled && this->presentId >= this->swapChainFirstPresentId)
+	{
+		// Bounded, a minimized or occluded window may never present
+		VkResult res = this->waitForPresent(this->device, this->swapChain, this->presentId, 100'000'000);
 
-	if (this->CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
-		throw std::runtime_error("failed to set up debug messenger!");
+		if (res == VK_ERROR_OUT_OF_DATE_KHR)
+			this->swapChainDirty = true;
+		else if (res != VK_SUCCESS && res != VK_TIMEOUT && res != VK_SUBOPTIMAL_KHR)
+			throw std::runtime_error("failed to wait for present!");
+	}
+	else
+	{
+		this->graphicsTimeline.wait(this->graphicsTimeline.lastSubmittedValue());
 	}
 }
 
 void
-GameCore::initVulkan()
+GameCore::startLatencyTracking()
 {
-	this->createVulkanInstance();
-	this->setupDebugMessenger();
-
-	this->createSurface();
-	
-	this->pickPhysicalDevice();
-	this->createLogicalDevice();
-	this->createSwapChain();
-	this->createImageViews();
-	this->createRenderPass();
-	this->createGraphicsPipeline();
-	this->createFrameBuffers();
-	this->createCommandPool();
-
-	this->createCommandBuffer();
-	this->createSyncObjects();
+	// Runs on the tracker's waiter thread, the frame carries the swap chain it was presented to
+	if (this->presentWaitEnabled)
+	{
+		this->latencyTracker.start([this](const LatencyTracker::PendingFrame& frame, uint64_t timeoutNs) {
+			return this->waitForPresent(this->device, frame.swapChain, frame.presentId, timeoutNs);
+		});
+	}
+	else
+	{
+		// Without present wait the best estimate is when the frame finished on the GPU
+		this->latencyTracker.start([this](const LatencyTracker::PendingFrame& frame, uint64_t timeoutNs) {
+			return this->graphicsTimeline.wait(frame.timelineValue, timeoutNs) ? VK_SUCCESS : VK_TIMEOUT;
+		});
+	}
 }
 
-int 
-GameCore::rateDeviceSuitability(VkPhysicalDevice device) {
-
-	VkPhysicalDeviceProperties deviceProperties;
-	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+uint64_t
+GameCore::SubmitUpload(const std::function<void(VkCommandBuffer)>& record)
+{
+	// Nothing uploads during startup yet, so the pool is only created on first use
+	if (this->uploadCommandPool == VK_NULL_HANDLE)
+		this->createUploadCommandPool();
 
-	VkPhysicalDeviceFeatures deviceFeatures;
-	vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
+	this->recycleUploads();
 
-	int score = 0;
+	VkCommandBuffer commandBuffer;
 
-	// Discrete GPUs have a significant performance advantage
-	if (deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
-		score += 1000;
+	if (!this->freeUploadCommandBuffers.empty())
+	{
+		commandBuffer = this->freeUploadCommandBuffers.back();
+		this->freeUploadCommandBuffers.pop_back();
+		vkResetCommandBuffer(commandBuffer, 0);
 	}
-
-	// Maximum possible size of textures affects graphics quality
-	score += deviceProperties.limits.maxImageDimension2D;
-
-	// Application can't function without geometry shaders
-	if (!deviceFeatures.geometryShader) {
-		return 0;
+	else
+	{
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = this->uploadCommandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate upload command buffer!");
 	}
 
-	return score;
-}
-
-QueueFamilyIndices  
-GameCore::findQueueFamilies(VkPhysicalDevice device) {
-
-	uint32_t queueFamilyCount = 0;
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording upload command buffer!");
 
-	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	record(commandBuffer);
 
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record upload command buffer!");
 
-	QueueFamilyIndices indices;
+	uint64_t signalValue = this->graphicsTimeline.nextValue();
+	VkSemaphore timeline = this->graphicsTimeline.handle();
 
-	int i = 0;
-	for (const auto& queueFamily : queueFamilies) {
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			indices.graphicsFamily = i;
-		}
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &timeline;
 
-		// you could add logic to explicitly prefer a physical device that supports drawing and presentation in the same queue for improved performance.
-		if (presentSupport)
-		{
-			indices.presentFamily = i;
-		}
+	if (vkQueueSubmit(this->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		throw std::runtime_error("failed to submit upload command buffer!");
 
-		i++;
-	}
+	this->uploadsInFlight.push_back({ commandBuffer, signalValue });
 
+	return signalValue;
+}
 
-	// Logic to find queue family indices to populate struct with
-	return indices;
+uint64_t
+GameCore::SubmitCompute(const std::function<void(VkCommandBuffer)>& record, const std::vector<ComputeHandoff>& handoffs, uint64_t waitGraphicsValue)
+{
+	if (waitGraphicsValue > 0)
+		return this->asyncCompute.submit(record, handoffs, this->graphicsTimeline.handle(), waitGraphicsValue);
 
+	return this->asyncCompute.submit(record, handoffs);
 }
 
-bool
-GameCore::checkDeviceExtensionSupport(VkPhysicalDevice device)
+void
+GameCore::DeferDelete(std::function<void()> deleter)
 {
-	uint32_t extensionCount;
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
-
-	std::vector<VkExtensionProperties> availableExts(extensionCount);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExts.data());
+	this->deletionQueue.push(std::move(deleter));
+}
 
-	std::set<std::string> requiredExtensions(this->deviceExtensions.begin(), this->deviceExtensions.end());
+void
+GameCore::DeferDestroyBuffer(VkBuffer buffer, VkDeviceMemory memory)
+{
+	this->deletionQueue.push([this, buffer, memory]() {
+		vkDestroyBuffer(this->device, buffer, this->allocationCallbacks());
+		this->freeMemory(memory);
+	});
+}
 
-	for (const auto& extension : availableExts) {
-		requiredExtensions.erase(extension.extensionName);
-	}
+void
+GameCore::DeferDestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+{
+	this->deletionQueue.push([this, image, view, memory]() {
+		vkDestroyImageView(this->device, view, this->allocationCallbacks());
+		vkDestroyImage(this->device, image, this->allocationCallbacks());
+		this->freeMemory(memory);
+	});
+}
 
-	return requiredExtensions.empty();
+void
+GameCore::DeferDestroyPipeline(VkPipeline pipeline)
+{
+	this->deletionQueue.push([this, pipeline]() {
+		vkDestroyPipeline(this->device, pipeline, this->allocationCallbacks());
+	});
 }
 
-bool 
-GameCore::isDeviceSuitable(VkPhysicalDevice device)
+void
+GameCore::recycleUploads()
 {
-	bool success = findQueueFamilies(device).isComplete();
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	
-	bool swapChainGood = false;
+	if (this->uploadsInFlight.empty())
+		return;
 
-	if (extensionsSupported)
+	// Submission order == signal order, so everything up to the first unfinished upload can be reused
+	uint64_t completed = this->graphicsTimeline.completedValue();
+
+	auto firstPending = std::find_if(this->uploadsInFlight.begin(), this->uploadsInFlight.end(),
+		[completed](const PendingUpload& upload) { return upload.timelineValue > completed; });
+
+	for (auto it = this->uploadsInFlight.begin(); it != firstPending; ++it)
 	{
-		SwapChainSupportDetails details = this->querySwapChainSupport(device);
-		swapChainGood = !details.formats.empty() && !details.presentModes.empty();
+		this->freeUploadCommandBuffers.push_back(it->commandBuffer);
 	}
 
-	return success && extensionsSupported && swapChainGood;
+	this->uploadsInFlight.erase(this->uploadsInFlight.begin(), firstPending);
 }
 
 void 
-GameCore::drawFrame() {
-	vkWaitForFences(device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
-	vkResetFences(device, 1, &inFlightFence);
+GameCore::mainLoop()
+{
+	this->frameLimiter.setTargetFps(this->settings.present.targetFps);
 
-	uint32_t imageIndex;
-	vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+	// Input is polled inside drawFrame, after the GPU wait
+	if (!this->isGoldenRun())
+	{
+		while (!glfwWindowShouldClose(window)) {
+			this->frameLimiter.wait();
+			drawFrame();
+		}
 
-	vkResetCommandBuffer(commandBuffer, /*VkCommandBufferResetFlagBits*/ 0);
-	recordCommandBuffer(commandBuffer, imageIndex);
+		vkDeviceWaitIdle(device);
+		return;
+	}
 
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// Golden run: fixed frame count, frame to frame time of the measured frames is what the baseline tracks
+	const GoldenSettings& golden = this->settings.golden;
+	auto previous = std::chrono::steady_clock::now();
 
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	for (uint32_t frame = 0; frame < golden.warmupFrames + golden.measuredFrames && !glfwWindowShouldClose(window); frame++)
+	{
+		drawFrame();
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
+		auto now = std::chrono::steady_clock::now();
+		if (frame >= golden.warmupFrames)
+			this->goldenFrameTimesMs.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+		previous = now;
+	}
 
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+	vkDeviceWaitIdle(device);
 
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
-		throw std::runtime_error("failed to submit draw command buffer!");
-	}
+	FrameTimeStats stats = computeFrameTimeStats(this->goldenFrameTimesMs);
+	std::string baselinePath = this->goldenPath(".frametime");
 
-	VkPresentInfoKHR presentInfo{};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	if (golden.update)
+		this->goldenTimingResult = { writeFrameTimeBaseline(baselinePath, stats), "wrote " + baselinePath };
+	else
+		this->goldenTimingResult = checkFrameTimes(stats, baselinePath, golden.tolerance);
+}
+
+void
+GameCore::configureGoldenRun()
+{
+	GoldenSettings& golden = this->settings.golden;
+	fs::create_directories(golden.directory);
+
+	// Capture exactly the first measured frame, and don't let vsync decide the frame times
+	this->settings.capture.enabled = true;
+	this->settings.capture.directory.clear();
+	this->settings.capture.startFrame = golden.warmupFrames;
+	this->settings.capture.frameLimit = 1;
+	this->settings.present.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	this->settings.present.targetFps = 0.0;
+	// The image and frame times must not depend on how fast the earlier frames were
+	this->settings.dynamicResolution.enabled = false;
+	this->settings.mirrorWindows = 0;
+	this->settings.metricsPort = 0;
+
+	this->goldenImageResult = { false, "no frame was captured" };
+	this->goldenTimingResult = { false, "no frames were measured" };
+}
 
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+std::string
+GameCore::goldenPath(const std::string& extension)
+{
+	std::string path = (fs::path(this->settings.golden.directory) / this->settings.golden.scene).string();
 
-	VkSwapchainKHR swapChains[] = { swapChain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
+	// Frame times only compare on the same GPU / driver
+	if (extension == ".frametime")
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
 
-	presentInfo.pImageIndices = &imageIndex;
+		std::string deviceName = properties.deviceName;
+		std::replace_if(deviceName.begin(), deviceName.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+		path += "." + deviceName;
+	}
 
-	vkQueuePresentKHR(presentQueue, &presentInfo);
+	return path + extension;
 }
 
-void 
-GameCore::mainLoop()
+void
+GameCore::reportGoldenResults()
 {
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
-		drawFrame();
-	}
+	auto prefix = [](const GoldenResult& result) { return result.passed ? "[INFO] - " : result.skipped ? "[WARN] - " : "[ERROR] - "; };
 
-	vkDeviceWaitIdle(device);
+	std::cout << prefix(this->goldenImageResult) << "golden image '" << this->settings.golden.scene << "': " << this->goldenImageResult.message << std::endl;
+	std::cout << prefix(this->goldenTimingResult) << "frame times '" << this->settings.golden.scene << "': " << this->goldenTimingResult.message << std::endl;
+
+	if (this->GoldenSkipped())
+		std::cout << "[WARN] - golden run skipped" << std::endl;
+	else
+		std::cout << (this->GoldenPassed() ? "[INFO] - golden run passed" : "[ERROR] - golden run failed") << std::endl;
 }
 
 void 
@@ -1089,28 +4645,60 @@ GameCore::cleanup()
 {
 	if (this->enableValidationLayers)
 	{
-		DestroyDebugUtilsMessengerEXT(this->instance, this->debugMessenger, nullptr);
+		DestroyDebugUtilsMessengerEXT(this->instance, this->debugMessenger, this->allocationCallbacks());
 	}
 
-	vkDestroyCommandPool(this->device, this->commandPool, nullptr);
+	this->metricsServer.stop();
+	this->latencyTracker.stop();
+
+	// The device is idle here, whatever is still queued can go
+	this->destroyFrameCapture();
+	for (const auto& [id, target] : this->windowTargets)
+		this->destroyWindowTarget(target);
+	this->windowTargets.clear();
+	this->deletionQueue.flush();
+	this->destroySceneBuffers();
+	this->destroyMeshletRenderer();
+	this->destroyOcclusionCulling();
+	this->destroyMeshes();
+	this->destroyParticleSystem();
+	this->assetArchive.close();
+
+	this->destroySyncObjects();
+	this->asyncCompute.destroy();
+	this->gpuQueries.destroy();
+	this->commandCache.destroy();
+	this->mirrorWindows.destroy();
+
+	if (this->uploadCommandPool != VK_NULL_HANDLE)
+		vkDestroyCommandPool(this->device, this->uploadCommandPool, this->allocationCallbacks());
+	vkDestroyCommandPool(this->device, this->commandPool, this->allocationCallbacks());
 	for (auto frameBuffer : this->swapChainFramebuffers)
 	{
-		vkDestroyFramebuffer(this->device, frameBuffer, nullptr);
+		vkDestroyFramebuffer(this->device, frameBuffer, this->allocationCallbacks());
 	}
+	this->swapChainFramebuffers.clear();
 
-	vkDestroyPipeline(this->device, this->graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(this->device, this->pipelineLayout, nullptr);
-	vkDestroyRenderPass(this->device, this->renderPass, nullptr);
+	this->pipelineLibrary.destroy();
+	this->destroyMeshPipeline();
+	vkDestroyPipeline(this->device, this->graphicsPipeline, this->allocationCallbacks());
+	vkDestroyPipelineLayout(this->device, this->pipelineLayout, this->allocationCallbacks());
 
-	for (auto imageView : this->swapChainImageViews)
+	if (this->renderPass != VK_NULL_HANDLE)
 	{
-		vkDestroyImageView(this->device, imageView, nullptr);
+		if (this->windowRenderPass != VK_NULL_HANDLE)
+			vkDestroyRenderPass(this->device, this->windowRenderPass, this->allocationCallbacks());
+		vkDestroyRenderPass(this->device, this->loadRenderPass, this->allocationCallbacks());
+		vkDestroyRenderPass(this->device, this->renderPass, this->allocationCallbacks());
 	}
 
-	vkDestroySwapchainKHR(this->device, this->swapChain, nullptr);
-	vkDestroyDevice(this->device, nullptr);
-	vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
-	vkDestroyInstance(this->instance, nullptr);
+	this->destroySwapChainResources();
+
+	vkDestroySwapchainKHR(this->device, this->swapChain, this->allocationCallbacks());
+	vkDestroyDevice(this->device, this->allocationCallbacks());
+	vkDestroySurfaceKHR(this->instance, this->surface, this->allocationCallbacks());
+	vkDestroyInstance(this->instance, this->allocationCallbacks());
+	this->debugLog.stop();
 	glfwDestroyWindow(this->window);
 
 	glfwTerminate();
@@ -1119,13 +4707,169 @@ GameCore::cleanup()
 void 
 GameCore::Initialize() 
 {
-	this->initWindow();
+	if (this->isGoldenRun())
+		this->configureGoldenRun();
+
+	this->startupTimer.measure("window", [this]() { this->initWindow(); });
 	this->initVulkan();
 }
 
+bool
+GameCore::checkParticles(uint32_t steps)
+{
+	if (!this->particles.isEnabled())
+	{
+		std::cout << "[ERROR] - particle check: no particle system (EngineSettings::particleCapacity, particle shaders)" << std::endl;
+		return false;
+	}
+
+	uint32_t capacity = this->particles.getCapacity();
+	ParticleReference reference(capacity);
+
+	// Steady state well below capacity: once the pool runs dry, which spawns get a slot depends on the GPU's atomics.
+	// At most lifetime + jitter = 150 steps of spawns are alive at a time.
+	ParticleEmitter emitter;
+	uint32_t emitCount = std::max(1u, capacity / 256);
+	const float gravity[3] = { 0.0f, 1.5f, 0.0f };
+	const float drag = 0.1f;
+	const float dt = 1.0f / 60.0f;
+
+	this->particles.setGravity(gravity[0], gravity[1], gravity[2]);
+	this->particles.setDrag(drag);
+
+	// Counters, both alive lists and the particles, in that order
+	VkDeviceSize aliveOffset = sizeof(ParticleCounters);
+	VkDeviceSize particlesOffset = aliveOffset + VkDeviceSize(capacity) * 2 * sizeof(uint32_t);
+	VkDeviceSize readbackSize = particlesOffset + VkDeviceSize(capacity) * sizeof(GpuParticle);
+
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackMemory;
+	this->createBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackMemory);
+
+	void* mapped;
+	vkMapMemory(this->device, readbackMemory, 0, readbackSize, 0, &mapped);
+	const char* readback = static_cast<const char*>(mapped);
+
+	auto particleLess = [](const GpuParticle& a, const GpuParticle& b) { return memcmp(&a, &b, sizeof(GpuParticle)) < 0; };
+	std::vector<GpuParticle> gpuParticles;
+	std::vector<GpuParticle> cpuParticles;
+	bool passed = true;
+
+	for (uint32_t step = 0; step < steps && passed; step++)
+	{
+		uint32_t seed = 0x5EED0000u + step;
+		this->particles.burst(emitter, emitCount, seed);
+		reference.emit(emitter, emitCount, seed);
+		reference.simulate(dt, gravity, drag);
+
+		// Compared once per simulated second and after the last step
+		bool compare = (step + 1) % 60 == 0 || step + 1 == steps;
+
+		// Same path as a frame: simulated on the compute queue, handed to graphics for the read back and handed back
+		// after it, so the ownership transfers run whenever the device has a separate compute family
+		std::vector<ComputeHandoff> handoffs;
+		if (compare)
+			handoffs = this->particleHandoffs(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+
+		uint64_t simulated = this->SubmitCompute([&](VkCommandBuffer commandBuffer) {
+			this->particles.recordSimulation(commandBuffer, dt);
+		}, handoffs, this->graphicsTimeline.lastSubmittedValue());
+
+		if (!compare)
+			continue;
+
+		// Uploads don't wait on semaphores, the check is synchronous anyway
+		this->GetComputeTimeline().wait(simulated);
+
+		uint64_t done = this->SubmitUpload([&](VkCommandBuffer commandBuffer) {
+			VkPipelineStageFlags waitStages;
+			this->asyncCompute.recordAcquire(commandBuffer, waitStages);
+
+			VkBufferCopy countersCopy{ 0, 0, sizeof(ParticleCounters) };
+			VkBufferCopy aliveCopy{ 0, aliveOffset, particlesOffset - aliveOffset };
+			VkBufferCopy particlesCopy{ 0, particlesOffset, readbackSize - particlesOffset };
+			vkCmdCopyBuffer(commandBuffer, this->particleBuffers.counters, readbackBuffer, 1, &countersCopy);
+			vkCmdCopyBuffer(commandBuffer, this->particleBuffers.alive, readbackBuffer, 1, &aliveCopy);
+			vkCmdCopyBuffer(commandBuffer, this->particleBuffers.particles, readbackBuffer, 1, &particlesCopy);
+			this->asyncCompute.recordReturn(commandBuffer, handoffs);
+
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+				0, 1, &barrier, 0, nullptr, 0, nullptr);
+		});
+
+		this->graphicsTimeline.wait(done);
+
+		ParticleCounters counters;
+		memcpy(&counters, readback, sizeof(counters));
+
+		uint32_t list = this->particles.getAliveList();
+		uint32_t aliveCount = counters.aliveCount[list];
+
+		if (aliveCount != reference.getAliveCount())
+		{
+			std::cout << "[ERROR] - particle check: step " << step << ", " << aliveCount << " particles alive on the GPU, "
+				<< reference.getAliveCount() << " on the CPU" << std::endl;
+			passed = false;
+			break;
+		}
+
+		// Survivors are compacted in atomic order on the GPU, so both sides are compared as sorted sets
+		const uint32_t* alive = reinterpret_cast<const uint32_t*>(readback + aliveOffset) + VkDeviceSize(list) * capacity;
+		const GpuParticle* pool = reinterpret_cast<const GpuParticle*>(readback + particlesOffset);
+
+		gpuParticles.resize(aliveCount);
+		cpuParticles.resize(aliveCount);
+		for (uint32_t i = 0; i < aliveCount; i++)
+		{
+			gpuParticles[i] = pool[std::min(alive[i], capacity - 1)];
+			cpuParticles[i] = reference.getParticle(i);
+		}
+
+		std::sort(gpuParticles.begin(), gpuParticles.end(), particleLess);
+		std::sort(cpuParticles.begin(), cpuParticles.end(), particleLess);
+
+		auto mismatch = std::mismatch(gpuParticles.begin(), gpuParticles.end(), cpuParticles.begin(),
+			[](const GpuParticle& a, const GpuParticle& b) { return memcmp(&a, &b, sizeof(GpuParticle)) == 0; });
+
+		if (mismatch.first != gpuParticles.end())
+		{
+			std::cout << "[ERROR] - particle check: step " << step << ", particle " << mismatch.first - gpuParticles.begin()
+				<< " of " << aliveCount << " differs (gpu position " << mismatch.first->position[0] << ", " << mismatch.first->position[1]
+				<< ", " << mismatch.first->position[2] << " life " << mismatch.first->life << ", cpu position " << mismatch.second->position[0]
+				<< ", " << mismatch.second->position[1] << ", " << mismatch.second->position[2] << " life " << mismatch.second->life << ")" << std::endl;
+			passed = false;
+		}
+	}
+
+	vkDeviceWaitIdle(this->device);
+	vkUnmapMemory(this->device, readbackMemory);
+	vkDestroyBuffer(this->device, readbackBuffer, this->allocationCallbacks());
+	this->freeMemory(readbackMemory);
+
+	if (passed)
+		std::cout << "[INFO] - particle check: " << steps << " steps, " << reference.getAliveCount()
+			<< " particles alive, GPU matches ParticleReference bit for bit"
+			<< (this->asyncCompute.isAsync() ? " (async compute queue)" : "") << std::endl;
+
+	return passed;
+}
+
 void
 GameCore::Run()
 {
-	this->mainLoop();
+	if (this->settings.particleCheckSteps > 0)
+		this->particleCheckPassed = this->checkParticles(this->settings.particleCheckSteps);
+	else
+		this->mainLoop();
+	// Also flushes the capture ring, so the golden comparison has run by the time it returns
 	this->cleanup();
+
+	if (this->isGoldenRun())
+		this->reportGoldenResults();
 }
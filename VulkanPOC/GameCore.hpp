@@ -1,9 +1,41 @@
 #include "engine_lib.h"
+#include "GpuTimeline.hpp"
+#include "AsyncCompute.hpp"
+#include "DeletionQueue.hpp"
+#include "FrameLimiter.hpp"
+#include "LatencyTracker.hpp"
+#include "MemoryTelemetry.hpp"
+#include "HostAllocator.hpp"
+#include "StartupTimer.hpp"
+#include "DebugMessageLog.hpp"
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+#include "MeshAsset.hpp"
+#include "PakArchive.hpp"
+#include "ParticleSystem.hpp"
+#include "FrameCapture.hpp"
+#include "GoldenImage.hpp"
+#include "GpuQueries.hpp"
+#include "HiZCulling.hpp"
+#include "MeshletRenderer.hpp"
+#include "Camera.hpp"
+#include "DynamicResolution.hpp"
+#include "CommandCache.hpp"
+#include "PipelineLibrary.hpp"
+#include "MirrorWindows.hpp"
+#include "MetricsServer.hpp"
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
 
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
-
+	// A compute-only family when there is one, else a second graphics queue, else the graphics queue itself
+	std::optional<uint32_t> computeFamily;
+	uint32_t computeQueueIndex = 0;
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -16,19 +48,296 @@ struct SwapChainSupportDetails {
 	std::vector<VkPresentModeKHR> presentModes;
 };         
 
+// Latency vs throughput vs power trade-off of the presentation, see chooseSwapPresentMode
+struct PresentPolicy {
+	// FIFO / FIFO_RELAXED / MAILBOX / IMMEDIATE, falls back to FIFO (always supported) if the surface lacks it
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// 0 = minImageCount + 1, otherwise clamped to the surface limits
+	uint32_t imageCount = 0;
+	// CPU side frame cap, 0 = unlimited
+	double targetFps = 0.0;
+};
+
+// Copies presented frames into a ring of mapped buffers and hands them to a consumer on a worker thread
+struct CaptureSettings {
+	// Adds TRANSFER_SRC to the swap chain usage, so it has to be decided before the swap chain exists
+	bool enabled = false;
+	// frame_NNNNNN.png / .raw files are written here unless a consumer is set with SetCaptureConsumer
+	std::string directory;
+	bool png = true;
+	// Frames in flight between the GPU copy and the consumer, a frame is skipped when all are busy
+	uint32_t ringSize = 3;
+	// Stop after this many frames, 0 = until exit
+	uint32_t frameLimit = 0;
+	// Frames submitted before this one are not captured
+	uint64_t startFrame = 0;
+};
+
+// Rendering regression run: render a fixed number of frames with a fixed time step in a hidden window, compare the
+// first measured frame against <directory>/<scene>.ppm and the frame times against <directory>/<scene>.<gpu>.frametime.
+// Meant for CI on a software driver (lavapipe, SwiftShader) selected through VK_ICD_FILENAMES.
+struct GoldenSettings {
+	// Empty = normal interactive run
+	std::string directory;
+	std::string scene = "default";
+	uint32_t warmupFrames = 60;
+	uint32_t measuredFrames = 300;
+	// Write the golden image and the frame time baseline instead of checking against them
+	bool update = false;
+	GoldenTolerance tolerance;
+};
+
+// Render the scene below the window resolution while the GPU runs over its frame time budget, see DynamicResolution
+struct DynamicResolutionSettings {
+	// Adds TRANSFER_DST to the swap chain usage, so it has to be decided before the swap chain exists
+	bool enabled = false;
+	// GPU milliseconds a frame may take, 0 = the frame cap's period, or 60 fps without a cap
+	double gpuBudgetMs = 0.0;
+	// Per axis, relative to the swap chain extent
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+};
+
+// What the engine needs from a GPU (hard requirements, devices missing any are rejected) and what it
+// would like (preferences, turned into a score), see pickPhysicalDevice
+struct DeviceProfile {
+	uint32_t minApiVersion = VK_API_VERSION_1_2;
+	// Core features the shaders rely on, enabled on the logical device. Nothing needs any today.
+	VkPhysicalDeviceFeatures requiredFeatures{};
+
+	bool preferDiscrete = true;
+	// Graphics and present on the same family avoids queue ownership transfers of the swap chain images
+	bool preferCombinedGraphicsPresent = true;
+	// A compute family without graphics can run next to the frame instead of inside it
+	bool preferAsyncCompute = true;
+	VkDeviceSize preferredDeviceLocalBytes = VkDeviceSize(2) * 1024 * 1024 * 1024;
+	uint32_t preferredSubgroupSize = 32;
+
+	// Device index (enumeration order) or deviceUUID as 32 hex digits, bypasses the scoring.
+	// Falls back to the VKPOC_DEVICE environment variable when empty.
+	std::string deviceOverride;
+};
+
+struct EngineSettings {
+	// Render through VK_KHR_dynamic_rendering when the device supports it, otherwise fall back to a VkRenderPass + VkFramebuffers
+	bool preferDynamicRendering = true;
+	PresentPolicy present;
+	// Keep at most one frame queued: wait for the previous frame to be presented (VK_KHR_present_wait) or
+	// finish on the GPU before sampling input, trading throughput for input-to-photon latency
+	bool lowLatency = false;
+	// Packed assets, read in preference to loose files when the archive exists. Empty = loose files only
+	std::string assetArchive = "assets.pak";
+	DeviceProfile device;
+	// Route driver host allocations through HostAllocator to count them per scope and pool the small ones
+	bool trackHostAllocations = false;
+	// List every instance extension during startup
+	bool verboseStartup = false;
+	// Validation messages below these severities / outside these types are dropped in the callback
+	VkDebugUtilsMessageSeverityFlagsEXT debugMessageSeverities = VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+	VkDebugUtilsMessageTypeFlagsEXT debugMessageTypes = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+	// GPU particle pool size, 0 = no particle system
+	uint32_t particleCapacity = 0;
+	// Instead of rendering: simulate this many seeded steps on the GPU and on ParticleReference and compare the read back
+	// particles bit for bit, see ParticleCheckPassed
+	uint32_t particleCheckSteps = 0;
+	// Count vertex / fragment / compute work per frame (needs the pipelineStatisticsQuery feature) and report it with [PERF]
+	bool pipelineStatistics = true;
+	// Per-object occlusion queries a frame can record, see GpuQueries::beginOcclusion
+	uint32_t maxOcclusionQueries = 1024;
+	// Two phase Hi-Z culling of the scene's meshes on the GPU (needs drawIndirectFirstInstance), otherwise every mesh is drawn
+	bool occlusionCulling = true;
+	// Draw meshes meshlet by meshlet, dropping meshlets outside the frustum or facing away on the GPU
+	bool meshletRendering = true;
+	// Cull and draw meshlets in task / mesh shaders (VK_EXT_mesh_shader) when supported, otherwise compute + vertex pulling
+	bool preferMeshShaders = true;
+	// Record the scene geometry into secondary command buffers and replay them while nothing they depend on changed
+	// (with pipeline statistics on this needs the inheritedQueries feature)
+	bool cacheCommandBuffers = true;
+	// Build graphics pipelines from VK_EXT_graphics_pipeline_library parts, fast-linked first and replaced by an optimized
+	// link compiled in the background, when supported; otherwise as monolithic pipelines
+	bool pipelineLibrary = true;
+	// Extra windows each rendering its own view of the scene into its own swap chain, submitted and presented together with
+	// the main one. They follow the main camera unless given their own, see GetWindowCamera.
+	uint32_t mirrorWindows = 0;
+	// Serve live renderer counters as Prometheus text on http://127.0.0.1:<port>/metrics, 0 = off
+	uint16_t metricsPort = 0;
+	CaptureSettings capture;
+	GoldenSettings golden;
+	DynamicResolutionSettings dynamicResolution;
+};
+
+// Per frame-in-flight resources, the frame slot can be reused once the timeline reaches timelineValue
+struct FrameData {
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	// With dynamic resolution: the upscale into the acquired image and its capture, submitted after commandBuffer so
+	// only they wait for the acquire
+	VkCommandBuffer presentCommandBuffer = VK_NULL_HANDLE;
+	VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+	uint64_t timelineValue = 0;
+
+	// Persistently mapped staging for the dirty scene transforms copied by this frame
+	VkBuffer sceneStagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory sceneStagingMemory = VK_NULL_HANDLE;
+	void* sceneStagingMapped = nullptr;
+	uint32_t sceneStagingCapacity = 0;
+
+	// Persistently mapped CullCandidate list the GPU culls this frame
+	VkBuffer cullCandidateBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory cullCandidateMemory = VK_NULL_HANDLE;
+	void* cullCandidateMapped = nullptr;
+	uint32_t cullCandidateCapacity = 0;
+	uint64_t cullCandidateGeneration = 0;
+
+	VkDescriptorSet meshDescriptorSet = VK_NULL_HANDLE;
+	// Generation of the transform buffer meshDescriptorSet points at, 0 = not written yet
+	uint64_t meshBoundTransforms = 0;
+
+	// Dynamic resolution scale the slot's last frame was recorded at, what its GPU time is measured against
+	float renderScale = 1.0f;
+
+	// With the command cache the main pass only executes secondaries: these hold what changes every frame around the
+	// cached scene geometry, the triangle with its occlusion query before it and the particles after it
+	VkCommandBuffer backdropCommandBuffer = VK_NULL_HANDLE;
+	VkCommandBuffer overlayCommandBuffer = VK_NULL_HANDLE;
+};
+
+// Instances of one mesh, consecutive in the frame's candidate list and draw lists
+struct MeshDrawBatch {
+	uint32_t mesh;
+	uint32_t firstDraw;
+	uint32_t drawCount;
+};
+
+// Device local copy of a .vmesh, the buffers may only be read once the graphics timeline reaches readyValue
+struct GpuMesh {
+	VkBuffer vertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory indexMemory = VK_NULL_HANDLE;
+	uint32_t vertexCount = 0;
+	std::vector<MeshLod> lods;
+	float boundsCenter[3] = {};
+	float boundsRadius = 0.0f;
+	// Meshlets, their vertex indices and packed triangles, empty for meshes converted without meshlets
+	VkBuffer meshletBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletMemory = VK_NULL_HANDLE;
+	VkBuffer meshletVertexBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletVertexMemory = VK_NULL_HANDLE;
+	VkBuffer meshletTriangleBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletTriangleMemory = VK_NULL_HANDLE;
+	uint32_t meshletCount = 0;
+	uint64_t readyValue = 0;
+};
+
+// Where each blob of a .vmesh starts in the staging buffer of its upload
+struct MeshStagingOffsets {
+	VkDeviceSize vertices = 0;
+	VkDeviceSize indices = 0;
+	VkDeviceSize meshlets = 0;
+	VkDeviceSize meshletVertices = 0;
+	VkDeviceSize meshletTriangles = 0;
+};
+
+struct PendingUpload {
+	VkCommandBuffer commandBuffer;
+	uint64_t timelineValue;
+};
+
 class GameCore {
 public:
-	GameCore(uint32_t width = 800, uint32_t height = 600) :
+	GameCore(uint32_t width = 800, uint32_t height = 600, EngineSettings settings = {}) :
 		physicalDevice(VK_NULL_HANDLE),
 		width(width),
-		height(height)
+		height(height),
+		settings(settings),
+		hostAllocator(settings.trackHostAllocations)
 	{
-
+		this->debugLog.setFilter(settings.debugMessageSeverities, settings.debugMessageTypes);
+		this->memoryTelemetry.setLimitCallback(0.9f, [](uint32_t heapIndex, const MemoryHeapStats& stats) {
+			std::cout << "[WARN] - gpu memory heap " << heapIndex << " is at " << stats.usage / (1024 * 1024)
+				<< " of " << stats.budget / (1024 * 1024) << " MB budget" << std::endl;
+		});
 	}
 	
 	void Initialize();
 	void Run();
 
+	// Only meaningful after Run() with EngineSettings::golden set: image and frame times within tolerance
+	// Frame times only gate on devices that have a baseline
+	bool GoldenPassed() const { return this->goldenImageResult.passed && (this->goldenTimingResult.passed || this->goldenTimingResult.skipped); }
+	// No golden image for the scene, the run could neither pass nor fail
+	bool GoldenSkipped() const { return this->goldenImageResult.skipped; }
+	// Only meaningful after Run() with EngineSettings::particleCheckSteps set: GPU and CPU particles matched every check
+	bool ParticleCheckPassed() const { return this->particleCheckPassed; }
+
+	// Records and submits a one-off transfer on the graphics queue, returns the timeline value that marks its completion
+	uint64_t SubmitUpload(const std::function<void(VkCommandBuffer)>& record);
+
+	// Every graphics queue submission signals this timeline; hasReached() can be polled from worker threads
+	GpuTimeline& GetGraphicsTimeline() { return this->graphicsTimeline; }
+
+	// Records and submits compute work on the async compute queue, returns its value on the compute timeline.
+	// Handed off buffers are transferred to the graphics family and the next frame waits for this submission;
+	// waitGraphicsValue > 0 makes the compute work wait for that graphics timeline value first.
+	uint64_t SubmitCompute(const std::function<void(VkCommandBuffer)>& record, const std::vector<ComputeHandoff>& handoffs = {}, uint64_t waitGraphicsValue = 0);
+	GpuTimeline& GetComputeTimeline() { return this->asyncCompute.getTimeline(); }
+	bool HasAsyncCompute() const { return this->asyncCompute.isAsync(); }
+
+	// Resources released at runtime are destroyed once the frame that last used them has retired on the GPU
+	void DeferDelete(std::function<void()> deleter);
+	void DeferDestroyBuffer(VkBuffer buffer, VkDeviceMemory memory);
+	void DeferDestroyImage(VkImage image, VkImageView view, VkDeviceMemory memory);
+	void DeferDestroyPipeline(VkPipeline pipeline);
+
+	// Takes effect on the next frame, the swap chain is recreated if the mode or image count changed
+	void SetPresentPolicy(const PresentPolicy& policy);
+	const PresentPolicy& GetPresentPolicy() const { return this->settings.present; }
+
+	// Called on a worker thread for every captured frame (EngineSettings::capture), the pixels are only valid during the call
+	void SetCaptureConsumer(FrameCapture::Consumer consumer) { this->frameCapture.setConsumer(std::move(consumer)); }
+	const FrameCapture& GetFrameCapture() const { return this->frameCapture; }
+
+	// Per-phase startup breakdown and time to first frame (printed once the first frame is presented)
+	const StartupTimer& GetStartupTimer() const { return this->startupTimer; }
+
+	// Validation output is filtered and printed by a logger thread, the filter can be changed at any time
+	void SetDebugMessageFilter(VkDebugUtilsMessageSeverityFlagsEXT severities, VkDebugUtilsMessageTypeFlagsEXT types) { this->debugLog.setFilter(severities, types); }
+
+	LatencyStats GetLatencyStats() const { return this->latencyTracker.getStats(); }
+
+	// Last read back pipeline statistics and occlusion results, MAX_FRAMES_IN_FLIGHT frames old
+	const PipelineStatistics& GetPipelineStatistics() const { return this->gpuQueries.getStatistics(); }
+	bool IsObjectVisible(uint32_t objectId) const { return this->gpuQueries.isVisible(objectId); }
+
+	// Per-heap usage / budget / peak, every device memory allocation goes through allocateMemory and is counted here
+	const MemoryTelemetry& GetMemoryTelemetry() const { return this->memoryTelemetry; }
+	// Driver host memory per allocation scope, all zero unless EngineSettings::trackHostAllocations is set
+	HostAllocationStats GetHostAllocationStats(VkSystemAllocationScope scope) const { return this->hostAllocator.getStats(scope); }
+
+	// Called once when a heap's usage crosses limitFraction of its budget, replaces the default warning
+	void SetMemoryLimitCallback(float limitFraction, MemoryTelemetry::LimitCallback callback) { this->memoryTelemetry.setLimitCallback(limitFraction, std::move(callback)); }
+
+	// Transforms edited through the scene are re-uploaded to the GPU on the next frame, and only those
+	Scene& GetScene() { return this->scene; }
+	// Emitters can be added before Initialize, nothing is drawn unless EngineSettings::particleCapacity > 0
+	ParticleSystem& GetParticles() { return this->particles; }
+	// Read when a frame is recorded, edits apply to the next frame
+	Camera& GetCamera() { return this->camera; }
+	// Camera of the extra window (0 based, see EngineSettings::mirrorWindows), nullptr once it's closed. The window
+	// follows the main camera until this is first called for it, then renders from the returned camera.
+	Camera* GetWindowCamera(uint32_t window) { return this->mirrorWindows.getCamera(window, this->camera); }
+	ThreadPool& GetThreadPool() { return this->threadPool; }
+
+	// Maps a .vmesh (see MeshConverter) and copies its blobs straight into device local buffers, returns the mesh id.
+	// Meshes found in the asset archive are decoded by the worker threads directly into the staging buffer.
+	uint32_t LoadMesh(const std::string& path);
+	uint32_t UploadMesh(const MeshAsset& asset);
+	const GpuMesh& GetMesh(uint32_t id) const { return this->meshes.at(id); }
+
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+	// Occlusion query id of the built-in triangle, kept clear of entity indices
+	static constexpr uint32_t TRIANGLE_OBJECT_ID = UINT32_MAX;
+
 
 private:
 	void pickPhysicalDevice();
@@ -38,14 +347,29 @@ private:
 	bool areValidationLayersAvailable();
 	std::vector<const char*> getRequiredExtensions();
 
-	int rateDeviceSuitability(VkPhysicalDevice device);
+	int rateDeviceSuitability(VkPhysicalDevice device, std::string& breakdown);
 	QueueFamilyIndices  findQueueFamilies(VkPhysicalDevice device);
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
-	bool
-		isDeviceSuitable(VkPhysicalDevice device);
+	bool isDeviceExtensionAvailable(VkPhysicalDevice device, const char* extensionName);
+	// Device is 1.1 or newer, so the *2 property and feature queries can be used on it
+	bool hasFeatureQueries(VkPhysicalDevice device);
+	bool checkDynamicRenderingSupport(VkPhysicalDevice device);
+	bool checkTimelineSemaphoreSupport(VkPhysicalDevice device);
+	bool checkPresentWaitSupport(VkPhysicalDevice device);
+	bool checkMemoryBudgetSupport(VkPhysicalDevice device);
+	bool checkMeshShaderSupport(VkPhysicalDevice device);
+	bool checkPipelineLibrarySupport(VkPhysicalDevice device);
+	void loadDeviceFunctions();
+	bool isDeviceSuitable(VkPhysicalDevice device, std::string& reason);
+	bool matchesDeviceOverride(VkPhysicalDevice device, uint32_t index, const std::string& deviceOverride);
 
 	void mainLoop();
+	bool isGoldenRun() const { return !this->settings.golden.directory.empty(); }
+	void configureGoldenRun();
+	std::string goldenPath(const std::string& extension);
+	void reportGoldenResults();
+	bool checkParticles(uint32_t steps);
 	void cleanup();
 
 	void initWindow();
@@ -72,37 +396,120 @@ private:
 		}
 	}
 
-	static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
-		VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-		VkDebugUtilsMessageTypeFlagsEXT messageType,
-		const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-		void* pUserData) {
-
-		std::cerr << "[DEBUG] - validation layer: " << pCallbackData->pMessage << std::endl;
-
-		return VK_FALSE;
-	}
-
 	void createSurface();
 	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 	VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
 	VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
-	void createSwapChain();
+	void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE);
+	// Waits out a minimized window first; leaves swapChainDirty set if the window was closed meanwhile
+	void recreateSwapChain();
+	// The window or its surface currently has a zero extent
+	bool surfaceIsEmpty();
+	void destroySwapChainResources();
 	void createImageViews();
 	void createRenderPass();
 	void createGraphicsPipeline();
+	void createMeshPipeline();
+	void destroyMeshPipeline();
+	VkFormat findDepthFormat(VkPhysicalDevice device);
+	void createDepthResources();
+	void destroyDepthResources();
+	void createSceneColorTarget();
+	void destroySceneColorTarget();
+	// Where the main pass renders: the swap chain image, or the scene color target with dynamic resolution
+	VkImage mainColorImage(uint32_t imageIndex) const;
+	VkImageView mainColorView(uint32_t imageIndex) const;
+	// Layout the main pass leaves its color attachment in
+	VkImageLayout mainColorLayout() const;
+	// Scales the rendered part of the scene color target up into the swap chain image
+	void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void createOcclusionCulling();
+	void destroyOcclusionCulling();
+	void createMeshletRenderer();
+	void destroyMeshletRenderer();
 	void createFrameBuffers();
 	void createCommandPool();
+	void createUploadCommandPool();
 	void createCommandBuffer();
+	void createCommandCache();
+	void createMirrorWindows();
+	// Stores this frame's counters for the metrics endpoint, frameMs = time since the previous frame
+	void publishMetrics(float frameMs);
 	void createSyncObjects();
+	void destroySyncObjects();
+	void createRenderFinishedSemaphores();
+	void destroyRenderFinishedSemaphores();
+	void recycleUploads();
+
+	enum class MeshDrawList { All, Early, Late };
 
 	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void recordPresentCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// Runs on a worker: the backdrop and every mesh instance seen from the window's camera, blitted to its swap chain
+	void recordWindowView(VkCommandBuffer commandBuffer, const MirrorView& view) const;
+	// Render thread, before the views are recorded: targets for the acquired windows, none for the closed ones
+	void prepareWindowTargets();
+	// clear = first pass of the frame, otherwise the attachments are loaded as the previous pass left them
+	void beginMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, bool clear);
+	void endMainPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	// Everything a main pass draws; lastPass adds the particles. Executes secondaries when the command cache is on.
+	void recordMainPassContents(VkCommandBuffer commandBuffer, MeshDrawList meshes, bool lastPass);
+	void setMainViewport(VkCommandBuffer commandBuffer);
+	void recordBackdrop(VkCommandBuffer commandBuffer);
+	void recordGeometry(VkCommandBuffer commandBuffer, MeshDrawList meshes);
+	void beginPassSecondary(VkCommandBuffer commandBuffer);
+	// The frame slot's recording of recordGeometry for the list, re-recorded only when geometryKey changed
+	VkCommandBuffer cachedGeometry(MeshDrawList meshes);
+	CommandKey geometryKey(MeshDrawList meshes) const;
+	// Gathers the frame's mesh instances and, when culling, records the early cull. True if the frame is culled.
+	bool prepareMeshDraws(VkCommandBuffer commandBuffer);
+	void recordMeshDraws(VkCommandBuffer commandBuffer, MeshDrawList list);
+	void ensureCullingCapacity(VkCommandBuffer commandBuffer, uint32_t drawCount);
+	void ensureCandidateCapacity(FrameData& frame, uint32_t candidateCount);
+	void ensureMeshletCapacity(uint32_t drawCount, uint32_t batchCount);
+	// Shader stages that read mesh and scene buffers, what uploads into them have to make their writes visible to
+	VkPipelineStageFlags meshReadStages() const;
 	void drawFrame();
+	void waitForFrameSlot(FrameData& frame);
+	// Starts timestamping frames as they reach the display, see LatencyTracker
+	void startLatencyTracking();
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	// pAllocator for every vkCreate* / vkDestroy*, nullptr unless host allocation tracking is on
+	const VkAllocationCallbacks* allocationCallbacks() const { return this->hostAllocator.callbacks(); }
+	void allocateMemory(const VkMemoryAllocateInfo& allocInfo, VkDeviceSize requestedSize, VkDeviceMemory& memory);
+	void freeMemory(VkDeviceMemory memory);
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
+
+	void recordSceneUpload(VkCommandBuffer commandBuffer, FrameData& frame);
+	void ensureSceneBufferCapacity(FrameData& frame);
+	void destroySceneBuffers();
+	void destroyMeshes();
+	void createParticleSystem();
+	void destroyParticleSystem();
+	// Submits the frame's simulation to the compute queue, the frame acquires the buffers before drawing them
+	void simulateParticles();
+	// The buffers a particle draw (or whatever stage / access says) reads, the dead list stays with compute
+	std::vector<ComputeHandoff> particleHandoffs(VkPipelineStageFlags stage, VkAccessFlags access) const;
+	void createFrameCapture();
+	void destroyFrameCapture();
+	// Copies image (left in layout) into the next free capture slot, false if the frame had to be skipped
+	bool recordCapture(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout, VkExtent2D extent, VkFormat format);
+	void ensureCaptureSlotSize(FrameCapture::Slot& slot, VkDeviceSize size);
+	bool hasMemoryType(VkMemoryPropertyFlags properties);
+	uint32_t createMesh(const MeshAsset& asset, VkBuffer stagingBuffer, VkDeviceMemory stagingMemory, const MeshStagingOffsets& sources);
+
+	void openAssetArchive();
+	// Starts reading an asset on the thread pool, the next readAsset of that name picks up the result
+	void prefetchAsset(const std::string& name);
+	std::vector<char> readAsset(const std::string& name);
+	bool hasAsset(const std::string& name);
+
 	uint32_t width;
 	int32_t height;
+	EngineSettings settings;
 
 	const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation" //, "VK_LAYER_KHRONOS_profiles"
@@ -125,23 +532,199 @@ private:
 	VkDevice device;
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	VkQueue computeQueue;
 
 	VkSurfaceKHR surface;
 	VkSwapchainKHR swapChain;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
-	VkRenderPass renderPass;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	// Same attachments as renderPass but loaded, for the second (late culling) pass of a frame
+	VkRenderPass loadRenderPass = VK_NULL_HANDLE;
+	// Compatible with renderPass, leaves color ready to be blitted; for the mirror windows' views
+	VkRenderPass windowRenderPass = VK_NULL_HANDLE;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
+
+	// Shared by every frame in flight, the queue runs the frames one after the other
+	VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+	VkImage depthImage = VK_NULL_HANDLE;
+	VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+	VkImageView depthView = VK_NULL_HANDLE;
+	// Depth aspect only, what the depth pyramid reduction samples
+	VkImageView depthSampleView = VK_NULL_HANDLE;
+
+	// Dynamic resolution: swap chain sized, the main pass renders into its top left renderExtent
+	VkImage sceneColorImage = VK_NULL_HANDLE;
+	VkDeviceMemory sceneColorMemory = VK_NULL_HANDLE;
+	VkImageView sceneColorView = VK_NULL_HANDLE;
+	// Size the main pass renders at this frame, the swap chain extent without dynamic resolution
+	VkExtent2D renderExtent{};
+	DynamicResolution dynamicResolution;
+	// Nanoseconds per timestamp tick, 0 when the graphics queue can't write timestamps
+	float timestampPeriod = 0.0f;
+
+	// Scene meshes, one instance per draw with the transform slot as firstInstance
+	VkDescriptorSetLayout meshSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool meshDescriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout meshPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline meshPipeline = VK_NULL_HANDLE;
+	Camera camera;
+	float viewProjection[16] = {};
+	std::vector<MeshDrawBatch> meshBatches;
+	// Indexed meshes' instances first, then the meshlet batches'; Hi-Z only sees the first indexedCandidateCount
+	std::vector<CullCandidate> cullCandidates;
+	uint32_t indexedCandidateCount = 0;
+	bool multiDrawIndirectEnabled = false;
+
+	bool occlusionCullingEnabled = false;
+	HiZCulling hizCulling;
+	VkImage depthPyramid = VK_NULL_HANDLE;
+	VkDeviceMemory depthPyramidMemory = VK_NULL_HANDLE;
+	VkImageView depthPyramidView = VK_NULL_HANDLE;
+	std::vector<VkImageView> depthPyramidLevels;
+	// Shared by the frames in flight: visibility per transform slot, early + late draw lists
+	VkBuffer cullVisibilityBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory cullVisibilityMemory = VK_NULL_HANDLE;
+	uint32_t cullVisibilityCapacity = 0;
+	VkBuffer cullCommandBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory cullCommandMemory = VK_NULL_HANDLE;
+	uint32_t cullDrawCapacity = 0;
+	uint64_t cullCommandGeneration = 0;
+
+	// VK_EXT_mesh_shader, only used by the meshlet renderer
+	bool meshShaderEnabled = false;
+	PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = nullptr;
+	MeshletRenderer meshletRenderer;
+	// Meshes with meshlets go here instead of meshBatches while the meshlet renderer is enabled
+	std::vector<MeshletBatch> meshletBatches;
+	// Compute path only, shared by the frames in flight: surviving (transform slot, meshlet) pairs, one draw per batch
+	VkBuffer meshletDrawBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletDrawMemory = VK_NULL_HANDLE;
+	uint32_t meshletDrawCapacity = 0;
+	uint64_t meshletDrawGeneration = 0;
+	VkBuffer meshletCommandBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory meshletCommandMemory = VK_NULL_HANDLE;
+	uint32_t meshletCommandCapacity = 0;
+	uint64_t meshletCommandGeneration = 0;
 	VkCommandPool commandPool;
-	VkCommandBuffer commandBuffer;
 
-	VkSemaphore imageAvailableSemaphore;
-	VkSemaphore renderFinishedSemaphore;
-	VkFence inFlightFence;
+	// Frame pacing is driven by the graphics timeline, binary semaphores are only kept where the swap chain requires them
+	GpuTimeline graphicsTimeline;
+	std::array<FrameData, MAX_FRAMES_IN_FLIGHT> frames;
+	uint32_t currentFrame = 0;
+	std::vector<VkSemaphore> renderFinishedSemaphores;
+
+	VkCommandPool uploadCommandPool = VK_NULL_HANDLE;
+	std::vector<PendingUpload> uploadsInFlight;
+	std::vector<VkCommandBuffer> freeUploadCommandBuffers;
+
+	AsyncCompute asyncCompute;
+	// Set while recording a frame that consumes compute handoffs, its submission waits on the compute timeline
+	uint64_t computeWaitValue = 0;
+	VkPipelineStageFlags computeWaitStages = 0;
+
+	DeletionQueue deletionQueue;
+
+	FrameLimiter frameLimiter;
+	bool swapChainDirty = false;
+
+	// VK_KHR_present_id + VK_KHR_present_wait, lets the CPU wait for / poll an actual present instead of GPU completion
+	bool presentWaitEnabled = false;
+	PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+	uint64_t presentId = 0;
+	// Ids below this were presented to an older swap chain and can't be waited on anymore
+	uint64_t swapChainFirstPresentId = 1;
+	LatencyTracker latencyTracker;
+
+	// VK_EXT_memory_budget, without it the telemetry budget is an estimate
+	bool memoryBudgetEnabled = false;
+	MemoryTelemetry memoryTelemetry;
+	HostAllocator hostAllocator;
+	// Pipeline statistics need a device feature, occlusion queries don't
+	bool pipelineStatisticsEnabled = false;
+	GpuQueries gpuQueries;
+
+	// Secondaries run inside the frame's pipeline statistics query only with inheritedQueries
+	bool inheritedQueriesEnabled = false;
+	CommandCache commandCache;
+	VkCommandBufferInheritanceRenderingInfoKHR passRenderingInheritance{};
+	VkCommandBufferInheritanceInfo passInheritance{};
+	bool pipelineLibraryEnabled = false;
+	PipelineLibrary pipelineLibrary;
+
+	MirrorWindows mirrorWindows;
+	// A mirror window's color and depth, in the main pass' formats so the main pipelines draw into them. Sized to
+	// the window and only read by the blit into its swap chain image.
+	struct WindowTarget {
+		VkExtent2D extent{};
+		VkImage colorImage = VK_NULL_HANDLE;
+		VkDeviceMemory colorMemory = VK_NULL_HANDLE;
+		VkImageView colorView = VK_NULL_HANDLE;
+		VkImage depthImage = VK_NULL_HANDLE;
+		VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+		VkImageView depthView = VK_NULL_HANDLE;
+		// Without dynamic rendering
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	};
+	// By MirrorView::id
+	std::unordered_map<uint32_t, WindowTarget> windowTargets;
+	void createWindowTarget(WindowTarget& target, VkExtent2D extent);
+	// Deferred, the frames in flight may still render into it
+	void destroyWindowTarget(const WindowTarget& target);
+	// The frame's submission and present, reused so the per frame lists don't allocate
+	PresentBatch presentBatch;
+
+	// Written by drawFrame, read by the metrics server's thread
+	RendererMetrics rendererMetrics;
+	MetricsServer metricsServer;
+
+	// Bumped for every buffer created. The buffers cached recordings bake in keep the value they were created at (their
+	// *Generation), a handle alone can't tell a new buffer from a destroyed one that had the same handle.
+	uint64_t resourceGeneration = 0;
+	StartupTimer startupTimer;
+	DebugMessageLog debugLog;
+
+	Scene scene;
+	// Device local mirror of every scene transform, indexed by SceneChunk::gpuSlotBase + row
+	VkBuffer sceneTransformBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory sceneTransformMemory = VK_NULL_HANDLE;
+	uint32_t sceneTransformCapacity = 0;
+	uint64_t sceneTransformGeneration = 0;
+
+	std::vector<GpuMesh> meshes;
+
+	FrameCapture frameCapture;
+	// Recorded into the current frame's command buffer, handed to frameCapture once the frame is submitted
+	FrameCapture::Slot* pendingCapture = nullptr;
+	uint64_t capturesRequested = 0;
+
+	// Written by the capture consumer, read after the capture ring was flushed
+	GoldenResult goldenImageResult;
+	GoldenResult goldenTimingResult;
+	std::vector<double> goldenFrameTimesMs;
+
+	ParticleSystem particles;
+	ParticleBuffers particleBuffers;
+	VkDeviceMemory particleMemory[4] = {};
+	bool particleCheckPassed = false;
+	// Simulation time step, measured between frame starts
+	std::chrono::steady_clock::time_point lastFrameTime;
+	float frameDeltaTime = 0.0f;
+	PakArchive assetArchive;
+	std::unordered_map<std::string, std::future<std::vector<char>>> prefetchedAssets;
 
 	std::vector<VkImage> swapChainImages;;
 	std::vector<VkImageView> swapChainImageViews;
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	std::vector<VkCommandBuffer> commandBuffers;
+
+	// Dynamic rendering replaces renderPass/swapChainFramebuffers when enabled
+	bool dynamicRenderingEnabled = false;
+	PFN_vkCmdBeginRenderingKHR cmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR cmdEndRendering = nullptr;
+
+	// Declared last so it is destroyed first: its workers are joined before anything a queued job
+	// touches (the asset archive, prefetchedAssets, the capture ring...) goes away, also when init throws
+	ThreadPool threadPool;
 };
@@ -0,0 +1,184 @@
+#include "GoldenImage.hpp"
+
+#include <cmath>
+#include <sstream>
+
+static bool
+isBgra(VkFormat format)
+{
+	return format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+}
+
+// Tightly packed RGB, whatever the swap chain order was
+static std::vector<uint8_t>
+toRgb(const CapturedFrame& frame)
+{
+	std::vector<uint8_t> rgb(size_t(frame.width) * frame.height * 3);
+	bool bgra = isBgra(frame.format);
+
+	for (uint32_t y = 0; y < frame.height; y++)
+	{
+		const uint8_t* src = frame.pixels + size_t(y) * frame.rowPitch;
+		uint8_t* dst = rgb.data() + size_t(y) * frame.width * 3;
+
+		for (uint32_t x = 0; x < frame.width; x++, src += 4)
+		{
+			*dst++ = src[bgra ? 2 : 0];
+			*dst++ = src[1];
+			*dst++ = src[bgra ? 0 : 2];
+		}
+	}
+
+	return rgb;
+}
+
+static bool
+writePpm(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgb)
+{
+	std::ofstream file(path, std::ios::binary);
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+	return file.good();
+}
+
+static bool
+readPpm(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgb)
+{
+	std::ifstream file(path, std::ios::binary);
+	std::string magic;
+	uint32_t maxValue = 0;
+
+	if (!(file >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255)
+		return false;
+
+	file.get(); // single whitespace before the pixels
+	rgb.resize(size_t(width) * height * 3);
+	file.read(reinterpret_cast<char*>(rgb.data()), static_cast<std::streamsize>(rgb.size()));
+
+	return file.gcount() == static_cast<std::streamsize>(rgb.size());
+}
+
+bool
+writeGoldenImage(const std::string& path, const CapturedFrame& frame)
+{
+	return writePpm(path, frame.width, frame.height, toRgb(frame));
+}
+
+GoldenResult
+compareWithGolden(const CapturedFrame& frame, const std::string& goldenPath, const GoldenTolerance& tolerance)
+{
+	GoldenResult result;
+
+	uint32_t width, height;
+	std::vector<uint8_t> golden;
+	if (!readPpm(goldenPath, width, height, golden))
+	{
+		result.skipped = true;
+		result.message = "no golden image " + goldenPath + " (run with --golden-update to create it)";
+		return result;
+	}
+
+	std::vector<uint8_t> actual = toRgb(frame);
+	std::string stem = goldenPath.substr(0, goldenPath.rfind('.'));
+
+	if (width != frame.width || height != frame.height)
+	{
+		writePpm(stem + ".actual.ppm", frame.width, frame.height, actual);
+		result.message = "size mismatch: golden " + std::to_string(width) + "x" + std::to_string(height) +
+			", rendered " + std::to_string(frame.width) + "x" + std::to_string(frame.height);
+		return result;
+	}
+
+	// Pixels over the tolerance are red in the diff image, the rest is the golden dimmed
+	std::vector<uint8_t> diff(golden.size());
+	size_t differentPixels = 0;
+	uint32_t maxDifference = 0;
+
+	for (size_t pixel = 0; pixel < golden.size(); pixel += 3)
+	{
+		uint32_t difference = 0;
+		for (size_t channel = 0; channel < 3; channel++)
+			difference = std::max<uint32_t>(difference, std::abs(int(golden[pixel + channel]) - int(actual[pixel + channel])));
+
+		maxDifference = std::max(maxDifference, difference);
+		bool different = difference > tolerance.channelTolerance;
+		differentPixels += different;
+
+		diff[pixel + 0] = different ? 255 : golden[pixel + 0] / 4;
+		diff[pixel + 1] = different ? 0 : golden[pixel + 1] / 4;
+		diff[pixel + 2] = different ? 0 : golden[pixel + 2] / 4;
+	}
+
+	double share = double(differentPixels) / (double(width) * height);
+	result.passed = share <= tolerance.maxDifferentPixels;
+
+	std::ostringstream message;
+	message << differentPixels << " pixels (" << share * 100.0 << "%) differ by more than " << tolerance.channelTolerance
+		<< ", max difference " << maxDifference;
+	result.message = message.str();
+
+	if (!result.passed)
+	{
+		writePpm(stem + ".actual.ppm", width, height, actual);
+		writePpm(stem + ".diff.ppm", width, height, diff);
+	}
+
+	return result;
+}
+
+FrameTimeStats
+computeFrameTimeStats(std::vector<double> frameTimesMs)
+{
+	FrameTimeStats stats;
+	if (frameTimesMs.empty())
+		return stats;
+
+	std::sort(frameTimesMs.begin(), frameTimesMs.end());
+	stats.medianMs = frameTimesMs[frameTimesMs.size() / 2];
+	stats.p95Ms = frameTimesMs[std::min(frameTimesMs.size() - 1, frameTimesMs.size() * 95 / 100)];
+
+	return stats;
+}
+
+bool
+writeFrameTimeBaseline(const std::string& path, const FrameTimeStats& stats)
+{
+	std::ofstream file(path);
+	file << "median_ms " << stats.medianMs << "\np95_ms " << stats.p95Ms << "\n";
+	return file.good();
+}
+
+GoldenResult
+checkFrameTimes(const FrameTimeStats& measured, const std::string& baselinePath, const GoldenTolerance& tolerance)
+{
+	GoldenResult result;
+
+	std::ifstream file(baselinePath);
+	std::string key;
+	double value;
+	FrameTimeStats baseline;
+
+	while (file >> key >> value)
+	{
+		if (key == "median_ms") baseline.medianMs = value;
+		else if (key == "p95_ms") baseline.p95Ms = value;
+	}
+
+	if (baseline.medianMs <= 0.0)
+	{
+		result.skipped = true;
+		result.message = "not checked, no frame time baseline for this device " + baselinePath + " (run with --golden-update to create it)";
+		return result;
+	}
+
+	// Only the median gates: p95 on a shared CI machine is mostly noise, it is reported for context
+	double regression = measured.medianMs / baseline.medianMs - 1.0;
+	result.passed = regression <= tolerance.frameTimeThreshold;
+
+	std::ostringstream message;
+	message << "median " << measured.medianMs << " ms (baseline " << baseline.medianMs << " ms, "
+		<< (regression >= 0 ? "+" : "") << regression * 100.0 << "%), p95 " << measured.p95Ms << " ms (baseline " << baseline.p95Ms << " ms)";
+	result.message = message.str();
+
+	return result;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "FrameCapture.hpp"
+
+#include <string>
+#include <vector>
+
+// Regression checks for --golden runs: a captured frame against a reference image, and the measured frame
+// times against a stored baseline. References are binary PPM (P6) so any image tool can open them and the
+// engine needs no decoder; a failed comparison leaves <name>.actual.ppm and <name>.diff.ppm next to the golden.
+struct GoldenTolerance {
+	// Per channel difference that still counts as equal (rasterization / filtering differences between drivers)
+	uint32_t channelTolerance = 2;
+	// Share of pixels allowed to exceed channelTolerance
+	double maxDifferentPixels = 0.001;
+	// Frame time regression that fails the run, relative to the baseline median
+	double frameTimeThreshold = 0.10;
+};
+
+struct GoldenResult {
+	bool passed = false;
+	std::string message;
+	// There was nothing to compare against (no golden image, no frame time baseline for this device)
+	bool skipped = false;
+};
+
+struct FrameTimeStats {
+	double medianMs = 0.0;
+	double p95Ms = 0.0;
+};
+
+GoldenResult compareWithGolden(const CapturedFrame& frame, const std::string& goldenPath, const GoldenTolerance& tolerance);
+GoldenResult checkFrameTimes(const FrameTimeStats& measured, const std::string& baselinePath, const GoldenTolerance& tolerance);
+FrameTimeStats computeFrameTimeStats(std::vector<double> frameTimesMs);
+
+bool writeGoldenImage(const std::string& path, const CapturedFrame& frame);
+bool writeFrameTimeBaseline(const std::string& path, const FrameTimeStats& stats);
@@ -0,0 +1,300 @@
+#include "GpuQueries.hpp"
+
+#include <algorithm>
+
+namespace {
+	// Same order as the PipelineStatistics members, results come back sorted by bit
+	constexpr VkQueryPipelineStatisticFlags STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	constexpr uint32_t STATISTICS_COUNT = sizeof(PipelineStatistics) / sizeof(uint64_t);
+
+	// Below this share of the interval spent waiting on the GPU, the GPU is not what limits the frame rate
+	constexpr double GPU_BOUND_WAIT_FRACTION = 0.1;
+
+	void accumulate(PipelineStatistics& total, const PipelineStatistics& frame)
+	{
+		total.inputAssemblyVertices += frame.inputAssemblyVertices;
+		total.inputAssemblyPrimitives += frame.inputAssemblyPrimitives;
+		total.vertexShaderInvocations += frame.vertexShaderInvocations;
+		total.clippingInvocations += frame.clippingInvocations;
+		total.clippingPrimitives += frame.clippingPrimitives;
+		total.fragmentShaderInvocations += frame.fragmentShaderInvocations;
+		total.computeShaderInvocations += frame.computeShaderInvocations;
+	}
+}
+
+void
+GpuQueries::create(VkDevice device, uint32_t frameCount, uint32_t maxOcclusionQueries, bool pipelineStatistics, float timestampPeriod,
+	const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->statisticsEnabled = pipelineStatistics;
+	this->maxOcclusionQueries = maxOcclusionQueries;
+	this->timestampPeriod = timestampPeriod;
+	this->frames.resize(frameCount);
+
+	for (FrameQueries& frame : this->frames)
+	{
+		VkQueryPoolCreateInfo createInfo{};
+		createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+
+		if (this->statisticsEnabled)
+		{
+			createInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			createInfo.queryCount = 1;
+			createInfo.pipelineStatistics = STATISTICS;
+
+			if (vkCreateQueryPool(device, &createInfo, allocator, &frame.statisticsPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create pipeline statistics query pool!");
+		}
+
+		if (maxOcclusionQueries > 0)
+		{
+			createInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+			createInfo.queryCount = maxOcclusionQueries;
+			createInfo.pipelineStatistics = 0;
+
+			if (vkCreateQueryPool(device, &createInfo, allocator, &frame.occlusionPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create occlusion query pool!");
+		}
+
+		if (this->hasTimestamps())
+		{
+			createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			createInfo.queryCount = 2;
+			createInfo.pipelineStatistics = 0;
+
+			if (vkCreateQueryPool(device, &createInfo, allocator, &frame.timestampPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create timestamp query pool!");
+		}
+
+		frame.occlusionObjects.reserve(maxOcclusionQueries);
+	}
+}
+
+VkQueryPipelineStatisticFlags
+GpuQueries::statisticsFlags() const
+{
+	return this->statisticsEnabled ? STATISTICS : 0;
+}
+
+void
+GpuQueries::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	for (FrameQueries& frame : this->frames)
+	{
+		if (frame.statisticsPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(this->device, frame.statisticsPool, this->allocator);
+		if (frame.occlusionPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(this->device, frame.occlusionPool, this->allocator);
+		if (frame.timestampPool != VK_NULL_HANDLE)
+			vkDestroyQueryPool(this->device, frame.timestampPool, this->allocator);
+	}
+
+	this->frames.clear();
+	this->visibleSamples.clear();
+	this->recording = nullptr;
+	this->device = VK_NULL_HANDLE;
+}
+
+void
+GpuQueries::collect(uint32_t frameIndex)
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	FrameQueries& frame = this->frames[frameIndex];
+	this->gpuFrameMs = -1.0;
+
+	// Never recorded (or already read), the queries were not reset and hold nothing
+	if (!frame.recorded)
+		return;
+	frame.recorded = false;
+
+	if (frame.timestampPool != VK_NULL_HANDLE)
+	{
+		// { ticks, availability } per query
+		uint64_t results[4] = {};
+		VkResult res = vkGetQueryPoolResults(this->device, frame.timestampPool, 0, 2, sizeof(results), results, 2 * sizeof(uint64_t),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if ((res == VK_SUCCESS || res == VK_NOT_READY) && results[1] != 0 && results[3] != 0 && results[2] >= results[0])
+		{
+			this->gpuFrameMs = static_cast<double>(results[2] - results[0]) * this->timestampPeriod * 1e-6;
+			this->intervalGpuMs += this->gpuFrameMs;
+			this->intervalTimedFrames++;
+		}
+	}
+
+	if (this->statisticsEnabled)
+	{
+		// The values followed by the availability word
+		uint64_t results[STATISTICS_COUNT + 1] = {};
+		VkResult res = vkGetQueryPoolResults(this->device, frame.statisticsPool, 0, 1, sizeof(results), results, sizeof(results),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if ((res == VK_SUCCESS || res == VK_NOT_READY) && results[STATISTICS_COUNT] != 0)
+		{
+			std::copy(results, results + STATISTICS_COUNT, reinterpret_cast<uint64_t*>(&this->statistics));
+			accumulate(this->intervalTotals, this->statistics);
+			this->intervalFrames++;
+		}
+	}
+	else
+	{
+		this->intervalFrames++;
+	}
+
+	uint32_t count = static_cast<uint32_t>(frame.occlusionObjects.size());
+	if (count == 0)
+		return;
+
+	// { samples, availability } per query
+	std::vector<uint64_t> results(count * 2);
+	VkResult res = vkGetQueryPoolResults(this->device, frame.occlusionPool, 0, count, results.size() * sizeof(uint64_t), results.data(),
+		2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if (res == VK_SUCCESS || res == VK_NOT_READY)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (results[i * 2 + 1] != 0)
+				this->visibleSamples[frame.occlusionObjects[i]] = results[i * 2];
+		}
+	}
+
+	frame.occlusionObjects.clear();
+}
+
+void
+GpuQueries::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineStageFlagBits timestampStage)
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	FrameQueries& frame = this->frames[frameIndex];
+
+	// Queries have to be reset before every use, and the reset can't happen inside a render pass
+	if (frame.statisticsPool != VK_NULL_HANDLE)
+		vkCmdResetQueryPool(commandBuffer, frame.statisticsPool, 0, 1);
+	if (frame.occlusionPool != VK_NULL_HANDLE)
+		vkCmdResetQueryPool(commandBuffer, frame.occlusionPool, 0, this->maxOcclusionQueries);
+	if (frame.timestampPool != VK_NULL_HANDLE)
+		vkCmdResetQueryPool(commandBuffer, frame.timestampPool, 0, 2);
+
+	if (frame.statisticsPool != VK_NULL_HANDLE)
+		vkCmdBeginQuery(commandBuffer, frame.statisticsPool, 0, 0);
+	if (frame.timestampPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffer, timestampStage, frame.timestampPool, 0);
+
+	frame.occlusionObjects.clear();
+	frame.recorded = true;
+	this->recording = &frame;
+}
+
+void
+GpuQueries::endFrame(VkCommandBuffer commandBuffer)
+{
+	if (this->recording == nullptr)
+		return;
+
+	if (this->recording->statisticsPool != VK_NULL_HANDLE)
+		vkCmdEndQuery(commandBuffer, this->recording->statisticsPool, 0);
+	if (this->recording->timestampPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->recording->timestampPool, 1);
+
+	this->recording = nullptr;
+}
+
+bool
+GpuQueries::beginOcclusion(VkCommandBuffer commandBuffer, uint32_t objectId)
+{
+	if (this->recording == nullptr || this->recording->occlusionObjects.size() >= this->maxOcclusionQueries)
+		return false;
+
+	// Not precise: any non-zero count means visible, which is all culling needs and cheaper on most hardware
+	uint32_t query = static_cast<uint32_t>(this->recording->occlusionObjects.size());
+	vkCmdBeginQuery(commandBuffer, this->recording->occlusionPool, query, 0);
+	this->recording->occlusionObjects.push_back(objectId);
+	return true;
+}
+
+void
+GpuQueries::endOcclusion(VkCommandBuffer commandBuffer)
+{
+	uint32_t query = static_cast<uint32_t>(this->recording->occlusionObjects.size()) - 1;
+	vkCmdEndQuery(commandBuffer, this->recording->occlusionPool, query);
+}
+
+bool
+GpuQueries::isVisible(uint32_t objectId) const
+{
+	auto it = this->visibleSamples.find(objectId);
+	return it == this->visibleSamples.end() || it->second > 0;
+}
+
+uint64_t
+GpuQueries::getVisibleSamples(uint32_t objectId) const
+{
+	auto it = this->visibleSamples.find(objectId);
+	return it != this->visibleSamples.end() ? it->second : 0;
+}
+
+void
+GpuQueries::report(VkExtent2D extent, std::chrono::seconds reportInterval)
+{
+	auto now = std::chrono::steady_clock::now();
+
+	if (now - this->intervalStart < reportInterval || this->intervalFrames == 0)
+		return;
+
+	double intervalMs = std::chrono::duration<double, std::milli>(now - this->intervalStart).count();
+	double waitFraction = this->intervalWaitMs / intervalMs;
+	const char* bound;
+
+	// Invocation counts are a proxy for cost, not a measurement of it, but a frame shading far more
+	// fragments than vertices (or the other way around) is a reliable hint where the GPU time goes
+	if (waitFraction < GPU_BOUND_WAIT_FRACTION)
+		bound = "not gpu-bound (cpu, vsync or frame cap)";
+	else if (!this->statisticsEnabled)
+		bound = "gpu-bound";
+	else if (this->intervalTotals.vertexShaderInvocations > this->intervalTotals.fragmentShaderInvocations)
+		bound = "gpu-bound, vertex heavy";
+	else
+		bound = "gpu-bound, fragment heavy";
+
+	if (this->statisticsEnabled)
+	{
+		const PipelineStatistics& total = this->intervalTotals;
+		uint64_t frames = this->intervalFrames;
+		double pixels = std::max(1.0, static_cast<double>(extent.width) * extent.height);
+
+		std::cout << "[PERF] - gpu pipeline per frame: " << total.inputAssemblyVertices / frames << " vertices, "
+			<< total.inputAssemblyPrimitives / frames << " primitives, " << total.vertexShaderInvocations / frames << " vs, "
+			<< total.clippingInvocations / frames << " -> " << total.clippingPrimitives / frames << " clipped primitives, "
+			<< total.fragmentShaderInvocations / frames << " fs (" << (total.fragmentShaderInvocations / frames) / pixels << "x overdraw), "
+			<< total.computeShaderInvocations / frames << " cs\n";
+	}
+
+	std::cout << "[PERF] - waited on the gpu " << static_cast<int>(waitFraction * 100.0) << "% of the time: " << bound;
+	if (this->intervalTimedFrames > 0)
+		std::cout << ", " << this->intervalGpuMs / this->intervalTimedFrames << " ms gpu per frame";
+	std::cout << "\n";
+
+	this->intervalTotals = PipelineStatistics{};
+	this->intervalFrames = 0;
+	this->intervalWaitMs = 0.0;
+	this->intervalGpuMs = 0.0;
+	this->intervalTimedFrames = 0;
+	this->intervalStart = now;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+// Totals over one frame's command buffer, in VkQueryPipelineStatisticFlagBits order
+struct PipelineStatistics {
+	uint64_t inputAssemblyVertices = 0;
+	uint64_t inputAssemblyPrimitives = 0;
+	uint64_t vertexShaderInvocations = 0;
+	uint64_t clippingInvocations = 0;
+	uint64_t clippingPrimitives = 0;
+	uint64_t fragmentShaderInvocations = 0;
+	uint64_t computeShaderInvocations = 0;
+};
+
+// Pipeline statistics, GPU frame timestamps and per-object occlusion queries, one set of pools per frame in flight.
+// Results are read back without VK_QUERY_RESULT_WAIT_BIT once the frame slot has retired on the GPU, so they
+// lag MAX_FRAMES_IN_FLIGHT frames behind and never stall the CPU. Anything not available yet keeps its last value.
+// Not thread safe, use from the thread that records frames.
+class GpuQueries {
+public:
+	// pipelineStatistics needs VkPhysicalDeviceFeatures::pipelineStatisticsQuery, occlusion queries are always there.
+	// timestampPeriod is VkPhysicalDeviceLimits::timestampPeriod, 0 when the graphics queue has no timestamps.
+	void create(VkDevice device, uint32_t frameCount, uint32_t maxOcclusionQueries, bool pipelineStatistics, float timestampPeriod,
+		const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	bool hasPipelineStatistics() const { return this->statisticsEnabled; }
+	bool hasTimestamps() const { return this->timestampPeriod > 0.0f; }
+	// What secondary command buffers executed inside the frame have to inherit, 0 without pipeline statistics
+	VkQueryPipelineStatisticFlags statisticsFlags() const;
+
+	// The frame slot has retired: reads its results back, must come before the slot's next beginFrame
+	void collect(uint32_t frameIndex);
+
+	// Outside of any render pass. Resets the slot's queries and starts counting pipeline statistics,
+	// endFrame stops counting, so everything recorded in between (render passes included) is covered.
+	// The first timestamp is written at timestampStage: the stage a submission's semaphore wait gates, so the
+	// GPU time doesn't include the wait, or TOP_OF_PIPE when nothing waits.
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, VkPipelineStageFlagBits timestampStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	void endFrame(VkCommandBuffer commandBuffer);
+
+	// Inside a render pass around the draws of one object. objectId is chosen by the caller (an entity index
+	// for instance). Returns false without recording anything once the slot's queries are used up.
+	bool beginOcclusion(VkCommandBuffer commandBuffer, uint32_t objectId);
+	void endOcclusion(VkCommandBuffer commandBuffer);
+
+	const PipelineStatistics& getStatistics() const { return this->statistics; }
+
+	// GPU time from beginFrame to endFrame of the slot the last collect read, negative when it had no result
+	double getGpuFrameMs() const { return this->gpuFrameMs; }
+
+	// Samples that passed the depth test the last time the object was queried. Objects without a result yet
+	// count as visible, so a culling pass built on this only ever drops something it has seen to be hidden.
+	bool isVisible(uint32_t objectId) const;
+	uint64_t getVisibleSamples(uint32_t objectId) const;
+
+	// Time the CPU spent blocked on the GPU this frame, tells a GPU-bound frame from one that isn't
+	void addGpuWait(double waitMs) { this->intervalWaitMs += waitMs; }
+
+	// Prints averages over the interval and which side the frame is bound by, then restarts the interval
+	void report(VkExtent2D extent, std::chrono::seconds reportInterval = std::chrono::seconds(1));
+
+private:
+	struct FrameQueries {
+		VkQueryPool statisticsPool = VK_NULL_HANDLE;
+		VkQueryPool occlusionPool = VK_NULL_HANDLE;
+		// Top of the frame, bottom of the frame
+		VkQueryPool timestampPool = VK_NULL_HANDLE;
+		// Object of every occlusion query recorded into the slot, in query order
+		std::vector<uint32_t> occlusionObjects;
+		bool recorded = false;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	bool statisticsEnabled = false;
+	uint32_t maxOcclusionQueries = 0;
+	float timestampPeriod = 0.0f;
+
+	std::vector<FrameQueries> frames;
+	FrameQueries* recording = nullptr;
+
+	PipelineStatistics statistics;
+	double gpuFrameMs = -1.0;
+	std::unordered_map<uint32_t, uint64_t> visibleSamples;
+
+	PipelineStatistics intervalTotals;
+	uint64_t intervalFrames = 0;
+	double intervalWaitMs = 0.0;
+	double intervalGpuMs = 0.0;
+	uint64_t intervalTimedFrames = 0;
+	std::chrono::steady_clock::time_point intervalStart = std::chrono::steady_clock::now();
+};
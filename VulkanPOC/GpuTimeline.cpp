@@ -0,0 +1,88 @@
+#include "GpuTimeline.hpp"
+
+void
+GpuTimeline::create(VkDevice device, uint64_t initialValue, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->allocator = allocator;
+
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = initialValue;
+
+	VkSemaphoreCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	createInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(this->device, &createInfo, this->allocator, &this->semaphore) != VK_SUCCESS)
+		throw std::runtime_error("failed to create timeline semaphore!");
+
+	this->submitted.store(initialValue);
+	this->completed.store(initialValue);
+}
+
+void
+GpuTimeline::destroy()
+{
+	if (this->semaphore != VK_NULL_HANDLE)
+		vkDestroySemaphore(this->device, this->semaphore, this->allocator);
+
+	this->semaphore = VK_NULL_HANDLE;
+}
+
+uint64_t
+GpuTimeline::nextValue()
+{
+	return this->submitted.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+uint64_t
+GpuTimeline::completedValue()
+{
+	uint64_t value = 0;
+
+	if (vkGetSemaphoreCounterValue(this->device, this->semaphore, &value) != VK_SUCCESS)
+		throw std::runtime_error("failed to query timeline semaphore value!");
+
+	// Several threads may race here, only ever move the cached value forward
+	uint64_t cached = this->completed.load(std::memory_order_relaxed);
+	while (cached < value && !this->completed.compare_exchange_weak(cached, value, std::memory_order_release, std::memory_order_relaxed))
+	{
+	}
+
+	return value;
+}
+
+bool
+GpuTimeline::hasReached(uint64_t value)
+{
+	if (this->completed.load(std::memory_order_acquire) >= value)
+		return true;
+
+	return this->completedValue() >= value;
+}
+
+bool
+GpuTimeline::wait(uint64_t value, uint64_t timeout)
+{
+	if (this->hasReached(value))
+		return true;
+
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &this->semaphore;
+	waitInfo.pValues = &value;
+
+	VkResult res = vkWaitSemaphores(this->device, &waitInfo, timeout);
+
+	if (res == VK_TIMEOUT)
+		return false;
+
+	if (res != VK_SUCCESS)
+		throw std::runtime_error("failed to wait on timeline semaphore!");
+
+	this->completedValue();
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <atomic>
+
+// Wraps a Vulkan 1.2 timeline semaphore that is signaled by every submission on a queue.
+// Each submission reserves the next value with nextValue(); any thread can then ask whether the GPU
+// has reached that value without blocking, which is what resource reclamation keys on.
+class GpuTimeline {
+public:
+	void create(VkDevice device, uint64_t initialValue = 0, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	VkSemaphore handle() const { return this->semaphore; }
+
+	// Reserves the value the next submission will signal, only call from the thread that submits to the queue
+	uint64_t nextValue();
+	uint64_t lastSubmittedValue() const { return this->submitted.load(std::memory_order_acquire); }
+
+	// Non-blocking, safe to call from any thread
+	uint64_t completedValue();
+	bool hasReached(uint64_t value);
+
+	// Returns false if the timeout expired before the value was reached
+	bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	std::atomic<uint64_t> submitted{ 0 };
+	// Last value read back from the driver, lets hasReached() skip the query for values that already retired
+	std::atomic<uint64_t> completed{ 0 };
+};
@@ -0,0 +1,360 @@
+#include "HiZCulling.hpp"
+
+namespace {
+	constexpr uint32_t CULL_GROUP_SIZE = 64;
+	constexpr uint32_t REDUCE_GROUP_SIZE = 8;
+	constexpr uint32_t DRAW_COMMAND_SIZE = sizeof(VkDrawIndexedIndirectCommand);
+}
+
+void
+HiZCulling::create(VkDevice device, uint32_t frameCount, VkShaderModule reduceShader, VkShaderModule cullShader, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->allocator = allocator;
+
+	// Only texelFetch is used, the sampler just has to exist
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(MAX_PYRAMID_LEVELS);
+
+	if (vkCreateSampler(device, &samplerInfo, allocator, &this->sampler) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth pyramid sampler!");
+
+	this->createDescriptors(frameCount);
+	this->createPipelines(reduceShader, cullShader);
+}
+
+void
+HiZCulling::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyPipeline(this->device, this->cullPipeline, this->allocator);
+	vkDestroyPipeline(this->device, this->reducePipeline, this->allocator);
+	vkDestroyPipelineLayout(this->device, this->cullLayout, this->allocator);
+	vkDestroyPipelineLayout(this->device, this->reduceLayout, this->allocator);
+	// Frees the sets too
+	vkDestroyDescriptorPool(this->device, this->descriptorPool, this->allocator);
+	vkDestroyDescriptorSetLayout(this->device, this->cullSetLayout, this->allocator);
+	vkDestroyDescriptorSetLayout(this->device, this->reduceSetLayout, this->allocator);
+	vkDestroySampler(this->device, this->sampler, this->allocator);
+
+	this->frameSets.clear();
+	this->levelExtents.clear();
+	this->device = VK_NULL_HANDLE;
+}
+
+void
+HiZCulling::createDescriptors(uint32_t frameCount)
+{
+	// Reduce: previous level (or depth) -> next level
+	VkDescriptorSetLayoutBinding reduceBindings[2]{};
+	reduceBindings[0].binding = 0;
+	reduceBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	reduceBindings[0].descriptorCount = 1;
+	reduceBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	reduceBindings[1].binding = 1;
+	reduceBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	reduceBindings[1].descriptorCount = 1;
+	reduceBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 2;
+	layoutInfo.pBindings = reduceBindings;
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocator, &this->reduceSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+
+	// Cull: candidates, visibility, commands, pyramid
+	VkDescriptorSetLayoutBinding cullBindings[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		cullBindings[i].binding = i;
+		cullBindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		cullBindings[i].descriptorCount = 1;
+		cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = cullBindings;
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocator, &this->cullSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create cull descriptor set layout!");
+
+	VkDescriptorPoolSize poolSizes[3] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_PYRAMID_LEVELS + frameCount },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_PYRAMID_LEVELS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * frameCount },
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = MAX_PYRAMID_LEVELS + frameCount;
+	poolInfo.poolSizeCount = 3;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, this->allocator, &this->descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create cull descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(MAX_PYRAMID_LEVELS, this->reduceSetLayout);
+	layouts.insert(layouts.end(), frameCount, this->cullSetLayout);
+	std::vector<VkDescriptorSet> sets(layouts.size());
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate cull descriptor sets!");
+
+	std::copy(sets.begin(), sets.begin() + MAX_PYRAMID_LEVELS, this->reduceSets.begin());
+	this->frameSets.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; i++)
+		this->frameSets[i].set = sets[MAX_PYRAMID_LEVELS + i];
+}
+
+void
+HiZCulling::createPipelines(VkShaderModule reduceShader, VkShaderModule cullShader)
+{
+	VkPushConstantRange reduceRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(HiZReducePushConstants) };
+	VkPushConstantRange cullRange{ VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &this->reduceSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &reduceRange;
+
+	if (vkCreatePipelineLayout(this->device, &layoutInfo, this->allocator, &this->reduceLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+
+	layoutInfo.pSetLayouts = &this->cullSetLayout;
+	layoutInfo.pPushConstantRanges = &cullRange;
+
+	if (vkCreatePipelineLayout(this->device, &layoutInfo, this->allocator, &this->cullLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create cull pipeline layout!");
+
+	VkComputePipelineCreateInfo pipelineInfos[2]{};
+	VkShaderModule modules[2] = { reduceShader, cullShader };
+	VkPipelineLayout layouts[2] = { this->reduceLayout, this->cullLayout };
+	for (uint32_t i = 0; i < 2; i++)
+	{
+		pipelineInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfos[i].stage.module = modules[i];
+		pipelineInfos[i].stage.pName = "main";
+		pipelineInfos[i].layout = layouts[i];
+	}
+
+	VkPipeline pipelines[2];
+	if (vkCreateComputePipelines(this->device, VK_NULL_HANDLE, 2, pipelineInfos, this->allocator, pipelines) != VK_SUCCESS)
+		throw std::runtime_error("failed to create cull pipelines!");
+
+	this->reducePipeline = pipelines[0];
+	this->cullPipeline = pipelines[1];
+}
+
+void
+HiZCulling::setDepthPyramid(VkImageView depthView, VkImage pyramid, const std::vector<VkImageView>& levelViews, VkImageView pyramidView, VkExtent2D extent)
+{
+	this->pyramid = pyramid;
+	this->pyramidView = pyramidView;
+	this->levelExtents.clear();
+	this->renderExtent = extent;
+
+	uint32_t levelCount = std::min(static_cast<uint32_t>(levelViews.size()), MAX_PYRAMID_LEVELS);
+	std::vector<VkDescriptorImageInfo> sources(levelCount);
+	std::vector<VkDescriptorImageInfo> destinations(levelCount);
+	std::vector<VkWriteDescriptorSet> writes;
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		// Same rounding as the image's own mip chain
+		this->levelExtents.push_back({ std::max(1u, extent.width >> level), std::max(1u, extent.height >> level) });
+
+		sources[level].sampler = this->sampler;
+		sources[level].imageView = level == 0 ? depthView : levelViews[level - 1];
+		sources[level].imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+		destinations[level].imageView = levelViews[level];
+		destinations[level].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = this->reduceSets[level];
+		write.descriptorCount = 1;
+
+		write.dstBinding = 0;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &sources[level];
+		writes.push_back(write);
+
+		write.dstBinding = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		write.pImageInfo = &destinations[level];
+		writes.push_back(write);
+	}
+
+	VkDescriptorImageInfo pyramidInfo{ this->sampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL };
+	for (FrameSet& frame : this->frameSets)
+	{
+		VkWriteDescriptorSet write{};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = frame.set;
+		write.dstBinding = 3;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &pyramidInfo;
+		writes.push_back(write);
+	}
+
+	vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void
+HiZCulling::setBuffers(uint32_t frameIndex, const CullBuffers& buffers)
+{
+	FrameSet& frame = this->frameSets[frameIndex];
+
+	if (frame.buffers.candidates == buffers.candidates && frame.buffers.visibility == buffers.visibility &&
+		frame.buffers.commands == buffers.commands)
+	{
+		frame.buffers.drawCapacity = buffers.drawCapacity;
+		return;
+	}
+
+	frame.buffers = buffers;
+
+	VkDescriptorBufferInfo bufferInfos[3] = {
+		{ buffers.candidates, 0, VK_WHOLE_SIZE },
+		{ buffers.visibility, 0, VK_WHOLE_SIZE },
+		{ buffers.commands, 0, VK_WHOLE_SIZE },
+	};
+
+	VkWriteDescriptorSet writes[3]{};
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = frame.set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, 3, writes, 0, nullptr);
+}
+
+VkDeviceSize
+HiZCulling::commandOffset(uint32_t frameIndex, bool late) const
+{
+	return late ? VkDeviceSize(this->frameSets[frameIndex].buffers.drawCapacity) * DRAW_COMMAND_SIZE : 0;
+}
+
+void
+HiZCulling::recordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount)
+{
+	// The previous frame's late phase wrote the visibility and its draws read the commands we are about to overwrite
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	this->dispatchCull(commandBuffer, frameIndex, viewProjection, candidateCount, 0);
+}
+
+void
+HiZCulling::recordLateCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount)
+{
+	this->recordPyramid(commandBuffer);
+	this->dispatchCull(commandBuffer, frameIndex, viewProjection, candidateCount, 1);
+}
+
+void
+HiZCulling::recordPyramid(VkCommandBuffer commandBuffer)
+{
+	uint32_t levelCount = static_cast<uint32_t>(this->levelExtents.size());
+
+	// Every texel is rewritten, the previous frame's pyramid (last read by its late cull) can be discarded
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = this->pyramid;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levelCount, 0, 1 };
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->reducePipeline);
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		VkExtent2D source = level == 0 ? this->levelExtents[0] : this->levelExtents[level - 1];
+		VkExtent2D destination = this->levelExtents[level];
+		HiZReducePushConstants push{ { source.width, source.height }, { destination.width, destination.height } };
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->reduceLayout, 0, 1, &this->reduceSets[level], 0, nullptr);
+		vkCmdPushConstants(commandBuffer, this->reduceLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+		vkCmdDispatch(commandBuffer, (destination.width + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (destination.height + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+
+		// The next level (or the cull) reads this one
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+}
+
+void
+HiZCulling::dispatchCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount, uint32_t phase)
+{
+	const FrameSet& frame = this->frameSets[frameIndex];
+
+	CullPushConstants push{};
+	std::copy(viewProjection, viewProjection + 16, push.viewProjection);
+	push.pyramidSize[0] = static_cast<float>(this->levelExtents[0].width);
+	push.pyramidSize[1] = static_cast<float>(this->levelExtents[0].height);
+	push.candidateCount = candidateCount;
+	push.phase = phase;
+	push.lateOffset = frame.buffers.drawCapacity;
+	push.levelCount = static_cast<uint32_t>(this->levelExtents.size());
+	push.viewportScale[0] = static_cast<float>(this->renderExtent.width) / push.pyramidSize[0];
+	push.viewportScale[1] = static_cast<float>(this->renderExtent.height) / push.pyramidSize[1];
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullLayout, 0, 1, &frame.set, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, this->cullLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+	vkCmdDispatch(commandBuffer, (candidateCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <array>
+#include <vector>
+
+// One drawable instance as the cull shader sees it (std430)
+struct CullCandidate {
+	// World space bounding sphere
+	float center[3];
+	float radius;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Row of the scene transform buffer, becomes firstInstance; also indexes the visibility buffer
+	uint32_t transformSlot;
+	// Slot of the instance's VkDrawIndexedIndirectCommand in both draw lists
+	uint32_t drawIndex;
+};
+static_assert(sizeof(CullCandidate) == 32, "CullCandidate must match the shader side std430 struct");
+
+struct CullPushConstants {
+	float viewProjection[16];
+	float pyramidSize[2];
+	uint32_t candidateCount;
+	uint32_t phase;
+	// First command of the late draw list
+	uint32_t lateOffset;
+	uint32_t levelCount;
+	// Part of the pyramid the frame rendered into, dynamic resolution leaves the rest stale
+	float viewportScale[2];
+};
+static_assert(sizeof(CullPushConstants) == 96, "CullPushConstants must match the shader side push constant block");
+
+struct HiZReducePushConstants {
+	uint32_t sourceSize[2];
+	uint32_t destinationSize[2];
+};
+
+// Buffers of one frame slot, created by GameCore so they are counted by the memory telemetry
+struct CullBuffers {
+	VkBuffer candidates = VK_NULL_HANDLE; // CullCandidate[], written by the host every frame
+	VkBuffer visibility = VK_NULL_HANDLE; // uint32_t per transform slot, 1 = visible after the last late phase
+	VkBuffer commands = VK_NULL_HANDLE;   // VkDrawIndexedIndirectCommand[2 * drawCapacity], early list then late list
+	uint32_t drawCapacity = 0;
+};
+
+// Two phase hierarchical-Z occlusion culling:
+//   early: instances visible last frame (and inside the frustum) are drawn, laying down most of the depth
+//   pyramid: the early depth is reduced into a mip chain keeping the farthest depth of each footprint
+//   late: every instance is tested against the pyramid; those visible now but not drawn early are drawn,
+//         and the result becomes next frame's visible set
+// Instances are only ever drawn with instanceCount 0 or 1 in place, so there is no count buffer to read back.
+// Depth is standard (0 near, 1 far); an instance is hidden when its nearest point is behind the farthest
+// depth of every pyramid texel it covers.
+class HiZCulling {
+public:
+	static constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+	void create(VkDevice device, uint32_t frameCount, VkShaderModule reduceShader, VkShaderModule cullShader, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	bool isEnabled() const { return this->device != VK_NULL_HANDLE; }
+
+	// After the depth buffer was (re)created, with the device idle. depthView (depth aspect only) is sampled in
+	// DEPTH_STENCIL_READ_ONLY_OPTIMAL, the pyramid (R32_SFLOAT, one view per level plus one over all of them) lives in GENERAL.
+	void setDepthPyramid(VkImageView depthView, VkImage pyramid, const std::vector<VkImageView>& levelViews, VkImageView pyramidView, VkExtent2D extent);
+	// The frame slot has retired, its descriptors are only rewritten when a buffer changed
+	void setBuffers(uint32_t frameIndex, const CullBuffers& buffers);
+	// The top left part of the depth buffer this frame renders into, the whole extent unless the resolution is scaled.
+	// Depth outside of it is stale, which only makes the max reduction more conservative.
+	void setRenderExtent(VkExtent2D extent) { this->renderExtent = extent; }
+
+	// Outside of a render pass, before the first one
+	void recordEarlyCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount);
+	// Outside of a render pass, after the early pass wrote depth and left it in DEPTH_STENCIL_READ_ONLY_OPTIMAL
+	void recordLateCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount);
+
+	// Byte offset of the first command of a draw list in CullBuffers::commands
+	VkDeviceSize commandOffset(uint32_t frameIndex, bool late) const;
+
+private:
+	struct FrameSet {
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		CullBuffers buffers;
+	};
+
+	void createDescriptors(uint32_t frameCount);
+	void createPipelines(VkShaderModule reduceShader, VkShaderModule cullShader);
+	void recordPyramid(VkCommandBuffer commandBuffer);
+	void dispatchCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const float viewProjection[16], uint32_t candidateCount, uint32_t phase);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	VkDescriptorSetLayout reduceSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout cullSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkPipelineLayout reduceLayout = VK_NULL_HANDLE;
+	VkPipelineLayout cullLayout = VK_NULL_HANDLE;
+	VkPipeline reducePipeline = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+
+	// Level i reads level i - 1 (level 0 reads the depth buffer) and writes level i
+	std::array<VkDescriptorSet, MAX_PYRAMID_LEVELS> reduceSets{};
+	std::vector<FrameSet> frameSets;
+
+	VkImage pyramid = VK_NULL_HANDLE;
+	VkImageView pyramidView = VK_NULL_HANDLE;
+	std::vector<VkExtent2D> levelExtents;
+	VkExtent2D renderExtent{};
+};
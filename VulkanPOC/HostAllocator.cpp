@@ -0,0 +1,292 @@
+#include "HostAllocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Sits right in front of every pointer handed to the driver
+struct AllocationHeader {
+	uint64_t size;
+	// Distance from the start of the underlying malloc block, unused for pooled slots
+	uint32_t offset;
+	uint8_t scope;
+	uint8_t sizeClass;
+	uint16_t reserved;
+};
+static_assert(sizeof(AllocationHeader) == 16, "the header keeps pooled slots 16 byte aligned");
+
+constexpr uint8_t NOT_POOLED = 0xFF;
+constexpr size_t POOL_ALIGNMENT = 16;
+constexpr size_t POOL_BLOCK_SIZE = 64 * 1024;
+constexpr std::array<size_t, 7> SIZE_CLASSES = { 16, 32, 64, 128, 256, 512, 1024 };
+
+struct FreeSlot {
+	FreeSlot* next;
+};
+
+// Blocks outlive every thread, so a slot can always be pushed on whichever thread frees it
+struct BlockRegistry {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<uint8_t[]>> blocks;
+
+	uint8_t* allocateBlock()
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->blocks.emplace_back(new uint8_t[POOL_BLOCK_SIZE]);
+		return this->blocks.back().get();
+	}
+};
+
+BlockRegistry&
+blockRegistry()
+{
+	static BlockRegistry registry;
+	return registry;
+}
+
+struct ThreadPools {
+	std::array<FreeSlot*, SIZE_CLASSES.size()> freeLists{};
+	// Bump region of the current block
+	uint8_t* cursor = nullptr;
+	uint8_t* end = nullptr;
+
+	void* pop(uint8_t sizeClass)
+	{
+		if (FreeSlot* slot = this->freeLists[sizeClass])
+		{
+			this->freeLists[sizeClass] = slot->next;
+			return slot;
+		}
+
+		size_t slotSize = sizeof(AllocationHeader) + SIZE_CLASSES[sizeClass];
+
+		if (this->cursor == nullptr || static_cast<size_t>(this->end - this->cursor) < slotSize)
+		{
+			// new[] is aligned for any fundamental type, so slots stay 16 byte aligned
+			this->cursor = blockRegistry().allocateBlock();
+			this->end = this->cursor + POOL_BLOCK_SIZE;
+		}
+
+		void* slot = this->cursor;
+		this->cursor += slotSize;
+		return slot;
+	}
+
+	void push(uint8_t sizeClass, void* memory)
+	{
+		FreeSlot* slot = static_cast<FreeSlot*>(memory);
+		slot->next = this->freeLists[sizeClass];
+		this->freeLists[sizeClass] = slot;
+	}
+};
+
+thread_local ThreadPools threadPools;
+
+uint8_t
+sizeClassFor(size_t size)
+{
+	for (uint8_t i = 0; i < SIZE_CLASSES.size(); i++)
+	{
+		if (size <= SIZE_CLASSES[i])
+			return i;
+	}
+
+	return NOT_POOLED;
+}
+
+AllocationHeader*
+headerOf(void* memory)
+{
+	return reinterpret_cast<AllocationHeader*>(static_cast<uint8_t*>(memory) - sizeof(AllocationHeader));
+}
+
+} // namespace
+
+HostAllocator::HostAllocator(bool enabled) :
+	enabled(enabled)
+{
+	this->vkCallbacks.pUserData = this;
+	this->vkCallbacks.pfnAllocation = &HostAllocator::vkAllocate;
+	this->vkCallbacks.pfnReallocation = &HostAllocator::vkReallocate;
+	this->vkCallbacks.pfnFree = &HostAllocator::vkFree;
+	this->vkCallbacks.pfnInternalAllocation = &HostAllocator::vkInternalAllocation;
+	this->vkCallbacks.pfnInternalFree = &HostAllocator::vkInternalFree;
+}
+
+void
+HostAllocator::counted(VkSystemAllocationScope scope, size_t size, bool pooled)
+{
+	ScopeCounters& counters = this->scopes[scope];
+
+	counters.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+	counters.totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (pooled)
+		counters.pooledAllocations.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t live = counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !counters.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+		;
+}
+
+void
+HostAllocator::uncounted(VkSystemAllocationScope scope, size_t size)
+{
+	ScopeCounters& counters = this->scopes[scope];
+
+	counters.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void*
+HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	bool poolable = (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND || scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) && alignment <= POOL_ALIGNMENT;
+	uint8_t sizeClass = poolable ? sizeClassFor(size) : NOT_POOLED;
+
+	uint8_t* memory;
+	AllocationHeader header{};
+	header.size = size;
+	header.scope = static_cast<uint8_t>(scope);
+	header.sizeClass = sizeClass;
+
+	if (sizeClass != NOT_POOLED)
+	{
+		memory = static_cast<uint8_t*>(threadPools.pop(sizeClass)) + sizeof(AllocationHeader);
+	}
+	else
+	{
+		// Room for the header plus enough slack to align the user pointer
+		alignment = std::max(alignment, POOL_ALIGNMENT);
+		uint8_t* base = static_cast<uint8_t*>(std::malloc(size + sizeof(AllocationHeader) + alignment));
+		if (base == nullptr)
+			return nullptr;
+
+		uintptr_t user = reinterpret_cast<uintptr_t>(base) + sizeof(AllocationHeader);
+		user = (user + alignment - 1) & ~(uintptr_t(alignment) - 1);
+
+		memory = reinterpret_cast<uint8_t*>(user);
+		header.offset = static_cast<uint32_t>(memory - base);
+	}
+
+	std::memcpy(headerOf(memory), &header, sizeof(header));
+	this->counted(scope, size, sizeClass != NOT_POOLED);
+
+	return memory;
+}
+
+void
+HostAllocator::release(void* memory)
+{
+	if (memory == nullptr)
+		return;
+
+	AllocationHeader* header = headerOf(memory);
+	this->uncounted(static_cast<VkSystemAllocationScope>(header->scope), static_cast<size_t>(header->size));
+
+	if (header->sizeClass != NOT_POOLED)
+		threadPools.push(header->sizeClass, header);
+	else
+		std::free(static_cast<uint8_t*>(memory) - header->offset);
+}
+
+void* VKAPI_CALL
+HostAllocator::vkAllocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<HostAllocator*>(userData)->allocate(size, alignment, scope);
+}
+
+void* VKAPI_CALL
+HostAllocator::vkReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	HostAllocator* allocator = static_cast<HostAllocator*>(userData);
+
+	if (original == nullptr)
+		return allocator->allocate(size, alignment, scope);
+
+	if (size == 0)
+	{
+		allocator->release(original);
+		return nullptr;
+	}
+
+	// Per the spec the original allocation stays valid if this fails
+	void* memory = allocator->allocate(size, alignment, scope);
+	if (memory == nullptr)
+		return nullptr;
+
+	std::memcpy(memory, original, std::min(size, static_cast<size_t>(headerOf(original)->size)));
+	allocator->release(original);
+
+	return memory;
+}
+
+void VKAPI_CALL
+HostAllocator::vkFree(void* userData, void* memory)
+{
+	static_cast<HostAllocator*>(userData)->release(memory);
+}
+
+void VKAPI_CALL
+HostAllocator::vkInternalAllocation(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	// The driver allocated this itself, it only shows up in the counters
+	static_cast<HostAllocator*>(userData)->counted(scope, size, false);
+}
+
+void VKAPI_CALL
+HostAllocator::vkInternalFree(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope)
+{
+	static_cast<HostAllocator*>(userData)->uncounted(scope, size);
+}
+
+HostAllocationStats
+HostAllocator::getStats(VkSystemAllocationScope scope) const
+{
+	const ScopeCounters& counters = this->scopes[scope];
+
+	HostAllocationStats stats;
+	stats.liveAllocations = counters.liveAllocations.load(std::memory_order_relaxed);
+	stats.liveBytes = counters.liveBytes.load(std::memory_order_relaxed);
+	stats.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+	stats.totalAllocations = counters.totalAllocations.load(std::memory_order_relaxed);
+	stats.pooledAllocations = counters.pooledAllocations.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+void
+HostAllocator::report(std::chrono::seconds reportInterval)
+{
+	if (!this->enabled)
+		return;
+
+	auto now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - this->lastReport).count();
+
+	if (now - this->lastReport < reportInterval)
+		return;
+
+	this->lastReport = now;
+
+	static const char* scopeNames[SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+
+	for (uint32_t i = 0; i < SCOPE_COUNT; i++)
+	{
+		HostAllocationStats stats = this->getStats(static_cast<VkSystemAllocationScope>(i));
+		uint64_t sinceReport = stats.totalAllocations - this->totalAtLastReport[i];
+		this->totalAtLastReport[i] = stats.totalAllocations;
+
+		std::cout << "[PERF] - host allocations (" << scopeNames[i] << "): " << stats.liveAllocations << " live, "
+			<< stats.liveBytes / 1024 << " KB (peak " << stats.peakBytes / 1024 << " KB), "
+			<< sinceReport / seconds << " allocs/s, " << stats.pooledAllocations << " of " << stats.totalAllocations << " pooled\n";
+	}
+}
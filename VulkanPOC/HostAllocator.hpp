@@ -0,0 +1,67 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+struct HostAllocationStats {
+	uint64_t liveAllocations = 0;
+	uint64_t liveBytes = 0;
+	uint64_t peakBytes = 0;
+	uint64_t totalAllocations = 0;
+	// Served from the thread-local pools instead of malloc
+	uint64_t pooledAllocations = 0;
+};
+
+// VkAllocationCallbacks for driver host memory, counted per VkSystemAllocationScope. Small command and
+// object scope allocations (the ones drivers make while recording and creating per-frame objects) are
+// served from thread-local size-class pools, everything else goes to the system allocator.
+//
+// Pool memory is carved from blocks that are kept until the process exits: a slot freed on another
+// thread simply joins that thread's free list.
+class HostAllocator {
+public:
+	static constexpr uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+
+	explicit HostAllocator(bool enabled = false);
+
+	HostAllocator(const HostAllocator&) = delete;
+	HostAllocator& operator=(const HostAllocator&) = delete;
+
+	// nullptr when disabled, so it can be passed straight to every vkCreate* / vkDestroy*
+	const VkAllocationCallbacks* callbacks() const { return this->enabled ? &this->vkCallbacks : nullptr; }
+
+	HostAllocationStats getStats(VkSystemAllocationScope scope) const;
+
+	// Prints one line per scope once reportInterval has elapsed, with the allocation rate since the last report
+	void report(std::chrono::seconds reportInterval = std::chrono::seconds(5));
+
+private:
+	struct ScopeCounters {
+		std::atomic<uint64_t> liveAllocations{ 0 };
+		std::atomic<uint64_t> liveBytes{ 0 };
+		std::atomic<uint64_t> peakBytes{ 0 };
+		std::atomic<uint64_t> totalAllocations{ 0 };
+		std::atomic<uint64_t> pooledAllocations{ 0 };
+	};
+
+	static void* VKAPI_CALL vkAllocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void* VKAPI_CALL vkReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static void VKAPI_CALL vkFree(void* userData, void* memory);
+	static void VKAPI_CALL vkInternalAllocation(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static void VKAPI_CALL vkInternalFree(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void release(void* memory);
+	void counted(VkSystemAllocationScope scope, size_t size, bool pooled);
+	void uncounted(VkSystemAllocationScope scope, size_t size);
+
+	bool enabled;
+	VkAllocationCallbacks vkCallbacks{};
+	std::array<ScopeCounters, SCOPE_COUNT> scopes;
+
+	std::chrono::steady_clock::time_point lastReport = std::chrono::steady_clock::now();
+	std::array<uint64_t, SCOPE_COUNT> totalAtLastReport{};
+};
@@ -0,0 +1,125 @@
+#include "LatencyTracker.hpp"
+
+namespace {
+	// Bounds a single wait so stop() and reset() never hold up for long, a minimized window may never present
+	constexpr uint64_t WAIT_TIMEOUT_NS = 50'000'000;
+}
+
+void
+LatencyTracker::start(WaitPresented waitPresented)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->running)
+		return;
+
+	this->waitPresented = std::move(waitPresented);
+	this->running = true;
+	this->waiter = std::thread(&LatencyTracker::waiterLoop, this);
+}
+
+void
+LatencyTracker::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (!this->running)
+			return;
+		this->running = false;
+	}
+
+	this->submitted.notify_one();
+	this->waiter.join();
+	this->pending.clear();
+}
+
+void
+LatencyTracker::frameSubmitted(uint64_t presentId, uint64_t timelineValue, VkSwapchainKHR swapChain, clock::time_point inputTime)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (!this->running)
+			return;
+		this->pending.push_back({ presentId, timelineValue, swapChain, inputTime });
+	}
+
+	this->submitted.notify_one();
+}
+
+void
+LatencyTracker::reset()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pending.clear();
+	}
+
+	// A wait that already started may still be on the old swap chain, it returns within WAIT_TIMEOUT_NS
+	std::lock_guard<std::mutex> waitLock(this->waitMutex);
+}
+
+void
+LatencyTracker::waiterLoop()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	while (true)
+	{
+		this->submitted.wait(lock, [this]() { return !this->running || !this->pending.empty(); });
+		if (!this->running)
+			return;
+
+		// Taken before the queue is unlocked, so reset() can't drop the frame and return in between
+		std::unique_lock<std::mutex> waitLock(this->waitMutex);
+		PendingFrame frame = this->pending.front();
+		lock.unlock();
+
+		VkResult result = this->waitPresented(frame, WAIT_TIMEOUT_NS);
+		clock::time_point presentedTime = clock::now();
+		waitLock.unlock();
+
+		lock.lock();
+
+		// Dropped by reset() while waiting, or not presented yet
+		if (this->pending.empty() || this->pending.front().presentId != frame.presentId || result == VK_TIMEOUT)
+			continue;
+
+		this->pending.pop_front();
+		if (result != VK_SUCCESS)
+			continue;
+
+		double latencyMs = std::chrono::duration<double, std::milli>(presentedTime - frame.inputTime).count();
+
+		this->stats.lastMs = latencyMs;
+		this->stats.maxMs = std::max(this->stats.maxMs, latencyMs);
+		this->stats.samples++;
+		this->totalMs += latencyMs;
+		this->stats.averageMs = this->totalMs / this->stats.samples;
+	}
+}
+
+LatencyStats
+LatencyTracker::getStats() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->stats;
+}
+
+void
+LatencyTracker::report(const char* method, std::chrono::seconds reportInterval)
+{
+	auto now = clock::now();
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (now - this->intervalStart < reportInterval || this->stats.samples == 0)
+		return;
+
+	std::cout << "[PERF] - input-to-present latency (" << method << "): last " << this->stats.lastMs
+		<< " ms, avg " << this->stats.averageMs << " ms, max " << this->stats.maxMs
+		<< " ms over " << this->stats.samples << " frames\n";
+
+	this->stats = LatencyStats{};
+	this->totalMs = 0.0;
+	this->intervalStart = now;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct LatencyStats {
+	double lastMs = 0.0;
+	double averageMs = 0.0;
+	double maxMs = 0.0;
+	uint64_t samples = 0;
+};
+
+// Estimates input-to-present latency: the time between sampling input for a frame and that frame
+// reaching the display. The owner decides what "presented" means (VK_KHR_present_wait when available,
+// GPU completion of the frame otherwise) by passing a blocking wait to start(). A waiter thread blocks
+// on the frames oldest first and timestamps each one the moment its wait returns, so the figure does
+// not depend on how often the render thread gets around to looking.
+class LatencyTracker {
+public:
+	using clock = std::chrono::steady_clock;
+
+	struct PendingFrame {
+		uint64_t presentId;
+		uint64_t timelineValue;
+		// The swap chain presentId belongs to, the waiter must not read the owner's current one
+		VkSwapchainKHR swapChain;
+		clock::time_point inputTime;
+	};
+
+	// Returns VK_SUCCESS once the frame is presented, VK_TIMEOUT when timeoutNs elapsed first; anything else drops the frame
+	using WaitPresented = std::function<VkResult(const PendingFrame& frame, uint64_t timeoutNs)>;
+
+	~LatencyTracker() { this->stop(); }
+
+	void start(WaitPresented waitPresented);
+	// Joins the waiter, call before the device goes away
+	void stop();
+
+	void frameSubmitted(uint64_t presentId, uint64_t timelineValue, VkSwapchainKHR swapChain, clock::time_point inputTime);
+
+	// Pending frames refer to a swap chain that is going away: drops them and returns once the waiter no
+	// longer waits on any of them, so call it before the swap chain is destroyed
+	void reset();
+
+	// Stats over the current reporting interval
+	LatencyStats getStats() const;
+
+	// Prints and restarts the interval once reportInterval has elapsed
+	void report(const char* method, std::chrono::seconds reportInterval = std::chrono::seconds(1));
+
+private:
+	void waiterLoop();
+
+	WaitPresented waitPresented;
+	std::thread waiter;
+	bool running = false;
+
+	// Guards pending, stats and totalMs
+	mutable std::mutex mutex;
+	std::condition_variable submitted;
+	// Held by the waiter for the duration of one wait, reset() takes it to know the wait is over
+	std::mutex waitMutex;
+
+	std::deque<PendingFrame> pending;
+	LatencyStats stats;
+	double totalMs = 0.0;
+	clock::time_point intervalStart = clock::now();
+};
@@ -0,0 +1,142 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile&
+MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		this->close();
+
+		std::swap(this->bytes, other.bytes);
+		std::swap(this->length, other.length);
+		std::swap(this->opened, other.opened);
+#ifdef _WIN32
+		std::swap(this->fileHandle, other.fileHandle);
+		std::swap(this->mappingHandle, other.mappingHandle);
+#endif
+	}
+
+	return *this;
+}
+
+void
+MappedFile::open(const std::string& path)
+{
+	this->close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("failed to open file " + path);
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		throw std::runtime_error("failed to query size of " + path);
+	}
+
+	this->fileHandle = file;
+	this->length = static_cast<size_t>(fileSize.QuadPart);
+	this->opened = true;
+
+	// Mapping an empty file is an error on Windows
+	if (this->length == 0)
+		return;
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		this->close();
+		throw std::runtime_error("failed to map " + path);
+	}
+
+	this->mappingHandle = mapping;
+	this->bytes = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+	if (this->bytes == nullptr)
+	{
+		this->close();
+		throw std::runtime_error("failed to map " + path);
+	}
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		throw std::runtime_error("failed to open file " + path);
+
+	struct stat info;
+	if (fstat(fd, &info) != 0)
+	{
+		::close(fd);
+		throw std::runtime_error("failed to query size of " + path);
+	}
+
+	this->length = static_cast<size_t>(info.st_size);
+	this->opened = true;
+
+	if (this->length > 0)
+	{
+		void* mapped = mmap(nullptr, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if (mapped == MAP_FAILED)
+		{
+			::close(fd);
+			this->length = 0;
+			this->opened = false;
+			throw std::runtime_error("failed to map " + path);
+		}
+
+		// Assets are read front to back once
+		madvise(mapped, this->length, MADV_SEQUENTIAL);
+		this->bytes = static_cast<const uint8_t*>(mapped);
+	}
+
+	// The mapping keeps the file referenced
+	::close(fd);
+#endif
+}
+
+void
+MappedFile::close()
+{
+#ifdef _WIN32
+	if (this->bytes != nullptr)
+		UnmapViewOfFile(this->bytes);
+	if (this->mappingHandle != nullptr)
+		CloseHandle(this->mappingHandle);
+	if (this->fileHandle != nullptr)
+		CloseHandle(this->fileHandle);
+
+	this->mappingHandle = nullptr;
+	this->fileHandle = nullptr;
+#else
+	if (this->bytes != nullptr)
+		munmap(const_cast<uint8_t*>(this->bytes), this->length);
+#endif
+
+	this->bytes = nullptr;
+	this->length = 0;
+	this->opened = false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. The OS pages data in on first touch, so "loading"
+// is just a pointer and copies go straight from the page cache to wherever they are needed.
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const std::string& path) { this->open(path); }
+	~MappedFile() { this->close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	void open(const std::string& path);
+	void close();
+
+	const uint8_t* data() const { return this->bytes; }
+	size_t size() const { return this->length; }
+	bool isOpen() const { return this->opened; }
+
+private:
+	const uint8_t* bytes = nullptr;
+	size_t length = 0;
+	bool opened = false;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,249 @@
+#include "MemoryTelemetry.hpp"
+
+#include <algorithm>
+
+void
+MemoryTelemetry::init(VkPhysicalDevice physicalDevice, bool budgetExtension)
+{
+	this->physicalDevice = physicalDevice;
+	this->budgetExtension = budgetExtension;
+
+	VkPhysicalDeviceMemoryProperties properties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->typeToHeap.resize(properties.memoryTypeCount);
+	for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
+		this->typeToHeap[i] = properties.memoryTypes[i].heapIndex;
+
+	this->heaps.assign(properties.memoryHeapCount, MemoryHeapStats{});
+	this->allocatedAtQuery.assign(properties.memoryHeapCount, 0);
+	this->overLimit.assign(properties.memoryHeapCount, false);
+
+	for (uint32_t i = 0; i < properties.memoryHeapCount; i++)
+	{
+		this->heaps[i].size = properties.memoryHeaps[i].size;
+		this->heaps[i].deviceLocal = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		this->heaps[i].budget = properties.memoryHeaps[i].size / 10 * 8;
+	}
+
+	this->queryBudget();
+	this->lastUpdate = clock::now();
+}
+
+VkDeviceSize
+MemoryTelemetry::currentUsage(uint32_t heapIndex) const
+{
+	const MemoryHeapStats& heap = this->heaps[heapIndex];
+
+	if (!this->budgetExtension)
+		return heap.allocatedBytes;
+
+	// The driver number is only as fresh as the last query, add what we allocated since
+	VkDeviceSize atQuery = this->allocatedAtQuery[heapIndex];
+	VkDeviceSize sinceQuery = heap.allocatedBytes > atQuery ? heap.allocatedBytes - atQuery : 0;
+
+	return heap.usage + sinceQuery;
+}
+
+void
+MemoryTelemetry::queryBudget()
+{
+	if (!this->budgetExtension)
+	{
+		for (auto& heap : this->heaps)
+			heap.usage = heap.allocatedBytes;
+		return;
+	}
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+	budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	properties.pNext = &budget;
+
+	vkGetPhysicalDeviceMemoryProperties2(this->physicalDevice, &properties);
+
+	for (size_t i = 0; i < this->heaps.size(); i++)
+	{
+		this->heaps[i].budget = budget.heapBudget[i];
+		this->heaps[i].usage = budget.heapUsage[i];
+		this->allocatedAtQuery[i] = this->heaps[i].allocatedBytes;
+	}
+}
+
+void
+MemoryTelemetry::allocated(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize requested)
+{
+	std::vector<uint32_t> crossed;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		uint32_t heapIndex = this->typeToHeap.at(memoryTypeIndex);
+		MemoryHeapStats& heap = this->heaps[heapIndex];
+
+		heap.allocatedBytes += size;
+		heap.requestedBytes += requested;
+		heap.allocationCount++;
+		heap.peakBytes = std::max(heap.peakBytes, heap.allocatedBytes);
+
+		if (!this->budgetExtension)
+			heap.usage = heap.allocatedBytes;
+
+		this->allocations[memory] = { heapIndex, size, requested };
+
+		crossed = this->checkLimits();
+	}
+
+	this->notify(crossed);
+}
+
+void
+MemoryTelemetry::freed(VkDeviceMemory memory)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto it = this->allocations.find(memory);
+	if (it == this->allocations.end())
+		return;
+
+	MemoryHeapStats& heap = this->heaps[it->second.heapIndex];
+
+	heap.allocatedBytes -= it->second.size;
+	heap.requestedBytes -= it->second.requested;
+	heap.allocationCount--;
+
+	if (!this->budgetExtension)
+		heap.usage = heap.allocatedBytes;
+
+	this->allocations.erase(it);
+}
+
+bool
+MemoryTelemetry::exceedsBudget(uint32_t memoryTypeIndex, VkDeviceSize size) const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	uint32_t heapIndex = this->typeToHeap.at(memoryTypeIndex);
+
+	return this->currentUsage(heapIndex) + size > this->heaps[heapIndex].budget;
+}
+
+void
+MemoryTelemetry::setLimitCallback(float limitFraction, LimitCallback callback)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->limitFraction = limitFraction;
+	this->limitCallback = std::move(callback);
+	std::fill(this->overLimit.begin(), this->overLimit.end(), false);
+}
+
+void
+MemoryTelemetry::setPublishCallback(PublishCallback callback)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->publishCallback = std::move(callback);
+}
+
+std::vector<uint32_t>
+MemoryTelemetry::checkLimits()
+{
+	std::vector<uint32_t> crossed;
+
+	for (uint32_t i = 0; i < this->heaps.size(); i++)
+	{
+		const MemoryHeapStats& heap = this->heaps[i];
+		bool over = heap.budget > 0 && this->currentUsage(i) >= VkDeviceSize(double(heap.budget) * this->limitFraction);
+
+		if (over && !this->overLimit[i])
+			crossed.push_back(i);
+
+		this->overLimit[i] = over;
+	}
+
+	return crossed;
+}
+
+void
+MemoryTelemetry::notify(const std::vector<uint32_t>& heaps)
+{
+	if (heaps.empty())
+		return;
+
+	LimitCallback callback;
+	std::vector<MemoryHeapStats> stats;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		callback = this->limitCallback;
+		stats = this->heaps;
+	}
+
+	if (!callback)
+		return;
+
+	// The callback may free memory, which takes the lock again
+	for (uint32_t heapIndex : heaps)
+		callback(heapIndex, stats[heapIndex]);
+}
+
+void
+MemoryTelemetry::update(std::chrono::milliseconds updateInterval)
+{
+	auto now = clock::now();
+	if (now - this->lastUpdate < updateInterval)
+		return;
+
+	this->lastUpdate = now;
+
+	std::vector<uint32_t> crossed;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->queryBudget();
+		crossed = this->checkLimits();
+
+		if (this->publishCallback)
+			this->publishCallback(this->heaps);
+	}
+
+	this->notify(crossed);
+}
+
+std::vector<MemoryHeapStats>
+MemoryTelemetry::getHeaps() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->heaps;
+}
+
+void
+MemoryTelemetry::report(std::chrono::seconds reportInterval)
+{
+	auto now = clock::now();
+	if (now - this->lastReport < reportInterval)
+		return;
+
+	this->lastReport = now;
+
+	constexpr double MB = 1024.0 * 1024.0;
+
+	std::vector<MemoryHeapStats> heaps = this->getHeaps();
+
+	for (size_t i = 0; i < heaps.size(); i++)
+	{
+		const MemoryHeapStats& heap = heaps[i];
+
+		std::cout << "[PERF] - gpu memory heap " << i << (heap.deviceLocal ? " (device local)" : " (host)")
+			<< ": usage " << heap.usage / MB << " / " << heap.budget / MB << " MB budget"
+			<< ", engine " << heap.allocatedBytes / MB << " MB in " << heap.allocationCount << " allocations"
+			<< ", peak " << heap.peakBytes / MB << " MB"
+			<< ", fragmentation " << heap.fragmentation() * 100.0f << "%\n";
+	}
+}
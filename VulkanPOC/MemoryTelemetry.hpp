@@ -0,0 +1,91 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+struct MemoryHeapStats {
+	VkDeviceSize size = 0;
+	bool deviceLocal = false;
+
+	// Driver view of the whole process (VK_EXT_memory_budget). Without the extension the budget is
+	// estimated as 80% of the heap and usage is what this engine allocated.
+	VkDeviceSize budget = 0;
+	VkDeviceSize usage = 0;
+
+	// Engine view, tracked per vkAllocateMemory / vkFreeMemory
+	VkDeviceSize allocatedBytes = 0;
+	VkDeviceSize requestedBytes = 0;
+	VkDeviceSize peakBytes = 0;
+	uint32_t allocationCount = 0;
+
+	// Share of the allocated bytes lost to size and alignment padding, there is no sub-allocator yet
+	// so this is the only fragmentation we can have
+	float fragmentation() const { return this->allocatedBytes == 0 ? 0.0f : 1.0f - float(this->requestedBytes) / float(this->allocatedBytes); }
+};
+
+// Per-heap GPU memory accounting. Allocations are recorded by whoever calls vkAllocateMemory, the driver
+// budget is refreshed by update(). Crossing limitFraction of a heap's budget calls the limit callback
+// once, it re-arms when usage drops back below.
+class MemoryTelemetry {
+public:
+	using LimitCallback = std::function<void(uint32_t heapIndex, const MemoryHeapStats& stats)>;
+	// Called by update() with the refreshed heaps, under the telemetry lock: copy what is needed out and return
+	using PublishCallback = std::function<void(const std::vector<MemoryHeapStats>& heaps)>;
+
+	void init(VkPhysicalDevice physicalDevice, bool budgetExtension);
+
+	void allocated(VkDeviceMemory memory, uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceSize requested);
+	void freed(VkDeviceMemory memory);
+
+	// Would this allocation push its heap past the budget? Lets callers free something first instead of
+	// having the driver page or fail
+	bool exceedsBudget(uint32_t memoryTypeIndex, VkDeviceSize size) const;
+
+	void setLimitCallback(float limitFraction, LimitCallback callback);
+	void setPublishCallback(PublishCallback callback);
+
+	// Re-queries the driver budget, cheap enough for once per frame but throttled to updateInterval
+	void update(std::chrono::milliseconds updateInterval = std::chrono::milliseconds(500));
+
+	std::vector<MemoryHeapStats> getHeaps() const;
+
+	// Prints one line per heap once reportInterval has elapsed
+	void report(std::chrono::seconds reportInterval = std::chrono::seconds(5));
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	struct Allocation {
+		uint32_t heapIndex;
+		VkDeviceSize size;
+		VkDeviceSize requested;
+	};
+
+	VkDeviceSize currentUsage(uint32_t heapIndex) const;
+	void queryBudget();
+	// Returns the heaps that just crossed the limit, the callback runs outside the lock
+	std::vector<uint32_t> checkLimits();
+	void notify(const std::vector<uint32_t>& heaps);
+
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	bool budgetExtension = false;
+	std::vector<uint32_t> typeToHeap;
+
+	mutable std::mutex mutex;
+	std::vector<MemoryHeapStats> heaps;
+	// Usage the driver reported at the last query, allocations since then are added on top
+	std::vector<VkDeviceSize> allocatedAtQuery;
+	std::vector<bool> overLimit;
+	std::unordered_map<VkDeviceMemory, Allocation> allocations;
+
+	float limitFraction = 0.9f;
+	LimitCallback limitCallback;
+	PublishCallback publishCallback;
+
+	clock::time_point lastUpdate;
+	clock::time_point lastReport = clock::now();
+};
@@ -0,0 +1,102 @@
+#include "MeshAsset.hpp"
+
+#include <stdexcept>
+
+void
+MeshAsset::open(const std::string& path)
+{
+	this->file.open(path);
+	this->base = this->file.data();
+	this->size = this->file.size();
+
+	this->validate(path);
+}
+
+void
+MeshAsset::view(const uint8_t* data, size_t size, const std::string& name)
+{
+	this->file.close();
+	this->base = data;
+	this->size = size;
+
+	this->validate(name);
+}
+
+void
+MeshAsset::checkRange(uint64_t offset, uint64_t bytes, const std::string& name) const
+{
+	if (offset % MESH_FILE_ALIGNMENT != 0 || offset > this->size || bytes > this->size - offset)
+		throw std::runtime_error("corrupt mesh file " + name + ": blob out of range");
+}
+
+void
+MeshAsset::validate(const std::string& name) const
+{
+	if (this->size < sizeof(MeshFileHeader))
+		throw std::runtime_error("corrupt mesh file " + name + ": truncated header");
+
+	const MeshFileHeader& header = this->getHeader();
+
+	if (header.magic != MESH_FILE_MAGIC)
+		throw std::runtime_error("not a mesh file: " + name);
+
+	if (header.version != MESH_FILE_VERSION)
+		throw std::runtime_error("unsupported mesh file version in " + name + ", rerun MeshConverter");
+
+	this->checkRange(header.vertexOffset, uint64_t(header.vertexCount) * sizeof(MeshVertex), name);
+	this->checkRange(header.indexOffset, uint64_t(header.indexCount) * sizeof(uint32_t), name);
+	this->checkRange(header.lodOffset, uint64_t(header.lodCount) * sizeof(MeshLod), name);
+	this->checkRange(header.meshletOffset, uint64_t(header.meshletCount) * sizeof(Meshlet), name);
+	this->checkRange(header.meshletVertexOffset, uint64_t(header.meshletVertexCount) * sizeof(uint32_t), name);
+	this->checkRange(header.meshletTriangleOffset, header.meshletTriangleBytes, name);
+
+	if (header.lodCount == 0)
+		throw std::runtime_error("corrupt mesh file " + name + ": no LODs");
+
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		const MeshLod& lod = this->getLods()[i];
+
+		if (uint64_t(lod.firstIndex) + lod.indexCount > header.indexCount)
+			throw std::runtime_error("corrupt mesh file " + name + ": LOD index range");
+	}
+
+	// The shaders index GPU buffers with these values as they are, nothing downstream checks them again
+	const uint32_t* indices = this->getIndices();
+	for (uint32_t i = 0; i < header.indexCount; i++)
+	{
+		if (indices[i] >= header.vertexCount)
+			throw std::runtime_error("corrupt mesh file " + name + ": index out of range");
+	}
+
+	// Triangles are read a uint at a time, the converter pads the blob to a multiple of four bytes
+	if (header.meshletTriangleBytes % 4 != 0)
+		throw std::runtime_error("corrupt mesh file " + name + ": unpadded meshlet triangles");
+
+	const uint32_t* meshletVertices = this->getMeshletVertices();
+	const uint8_t* meshletTriangles = this->getMeshletTriangles();
+
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		const Meshlet& meshlet = this->getMeshlets()[i];
+
+		if (meshlet.vertexCount > MESHLET_MAX_VERTICES || meshlet.triangleCount > MESHLET_MAX_TRIANGLES)
+			throw std::runtime_error("corrupt mesh file " + name + ": meshlet too large");
+
+		if (uint64_t(meshlet.vertexOffset) + meshlet.vertexCount > header.meshletVertexCount
+			|| uint64_t(meshlet.triangleOffset) + uint64_t(meshlet.triangleCount) * 3 > header.meshletTriangleBytes)
+			throw std::runtime_error("corrupt mesh file " + name + ": meshlet range");
+
+		for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		{
+			if (meshletVertices[meshlet.vertexOffset + v] >= header.vertexCount)
+				throw std::runtime_error("corrupt mesh file " + name + ": meshlet vertex out of range");
+		}
+
+		for (uint32_t t = 0; t < meshlet.triangleCount * 3; t++)
+		{
+			if (meshletTriangles[meshlet.triangleOffset + t] >= meshlet.vertexCount)
+				throw std::runtime_error("corrupt mesh file " + name + ": meshlet triangle out of range");
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "MeshFormat.hpp"
+
+#include <string>
+
+// Zero-parse view over a .vmesh file. The file is validated once (blob ranges, every index and every
+// meshlet range), after that every accessor is a pointer into the mapping, ready to be copied into a
+// staging buffer as-is.
+class MeshAsset {
+public:
+	// Maps the file and keeps it mapped for the lifetime of the asset
+	void open(const std::string& path);
+	// Views memory owned by someone else (e.g. an entry of a mapped archive)
+	void view(const uint8_t* data, size_t size, const std::string& name);
+
+	const MeshFileHeader& getHeader() const { return *reinterpret_cast<const MeshFileHeader*>(this->base); }
+
+	const MeshVertex* getVertices() const { return this->at<MeshVertex>(this->getHeader().vertexOffset); }
+	size_t getVertexBytes() const { return this->getHeader().vertexCount * sizeof(MeshVertex); }
+
+	const uint32_t* getIndices() const { return this->at<uint32_t>(this->getHeader().indexOffset); }
+	size_t getIndexBytes() const { return this->getHeader().indexCount * sizeof(uint32_t); }
+
+	const MeshLod* getLods() const { return this->at<MeshLod>(this->getHeader().lodOffset); }
+	const Meshlet* getMeshlets() const { return this->at<Meshlet>(this->getHeader().meshletOffset); }
+	const uint32_t* getMeshletVertices() const { return this->at<uint32_t>(this->getHeader().meshletVertexOffset); }
+	const uint8_t* getMeshletTriangles() const { return this->at<uint8_t>(this->getHeader().meshletTriangleOffset); }
+
+private:
+	template<typename T>
+	const T* at(uint64_t offset) const { return reinterpret_cast<const T*>(this->base + offset); }
+
+	void validate(const std::string& name) const;
+	void checkRange(uint64_t offset, uint64_t bytes, const std::string& name) const;
+
+	MappedFile file;
+	const uint8_t* base = nullptr;
+	size_t size = 0;
+};
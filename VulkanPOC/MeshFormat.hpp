@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of .vmesh files, shared by the runtime loader and the offline MeshConverter.
+// Every blob is stored exactly as the GPU consumes it, so loading is a bounds check plus memcpy.
+//
+//   MeshFileHeader
+//   vertex blob     MeshVertex[vertexCount]
+//   index blob      uint32_t[indexCount]        every LOD's indices, back to back
+//   LOD table       MeshLod[lodCount]           LOD 0 = full detail
+//   meshlet table   Meshlet[meshletCount]       built from LOD 0
+//   meshlet vertices uint32_t[...]              indices into the vertex blob
+//   meshlet triangles uint8_t[...]              3 per triangle, local to the meshlet
+//
+// Offsets are from the start of the file and aligned to MESH_FILE_ALIGNMENT.
+
+constexpr uint32_t MESH_FILE_MAGIC = 0x48534D56; // "VMSH"
+constexpr uint32_t MESH_FILE_VERSION = 1;
+constexpr uint32_t MESH_FILE_ALIGNMENT = 64;
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+struct MeshVertex {
+	float position[3];
+	float normal[3];
+	float uv[2];
+};
+static_assert(sizeof(MeshVertex) == 32, "MeshVertex must match the vertex input stride");
+
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Simplification error in object space units, used to pick a LOD by projected size
+	float error;
+	uint32_t reserved;
+};
+
+// Bounding sphere plus normal cone: the meshlet is invisible when
+// dot(center - camera, coneAxis) >= coneCutoff * length(center - camera) + radius
+struct Meshlet {
+	uint32_t vertexOffset;   // into the meshlet vertex blob
+	uint32_t triangleOffset; // into the meshlet triangle blob, in bytes
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	float center[3];
+	float radius;
+	float coneAxis[3];
+	float coneCutoff;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet must match the shader side std430 struct");
+
+struct alignas(MESH_FILE_ALIGNMENT) MeshFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount;
+	uint32_t meshletTriangleBytes;
+
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t lodOffset;
+	uint64_t meshletOffset;
+	uint64_t meshletVertexOffset;
+	uint64_t meshletTriangleOffset;
+
+	float boundsCenter[3];
+	float boundsRadius;
+};
+static_assert(sizeof(MeshFileHeader) % MESH_FILE_ALIGNMENT == 0, "header must keep the first blob aligned");
@@ -0,0 +1,448 @@
+#include "MeshletRenderer.hpp"
+
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t CULL_GROUP_SIZE = 64;
+	// Meshlets per task workgroup, matches local_size_x in meshlet.task
+	constexpr uint32_t TASK_GROUP_SIZE = 32;
+	// Guaranteed minimum of maxComputeWorkGroupCount[1] and maxTaskWorkGroupCount[1], instances are dispatched in chunks of it
+	constexpr uint32_t MAX_INSTANCE_GROUPS = 65535;
+	constexpr uint32_t MESH_SETS_PER_POOL = 64;
+	// vkCmdUpdateBuffer takes at most 64 KB
+	constexpr uint32_t MAX_COMMANDS_PER_UPDATE = 65536 / sizeof(VkDrawIndirectCommand);
+}
+
+void
+MeshletRenderer::create(VkDevice device, uint32_t frameCount, const MeshletShaders& shaders, VkRenderPass renderPass,
+	VkFormat colorFormat, VkFormat depthFormat, PFN_vkCmdDrawMeshTasksEXT drawMeshTasks, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->allocator = allocator;
+
+	bool meshShaders = drawMeshTasks != nullptr && shaders.task != VK_NULL_HANDLE && shaders.mesh != VK_NULL_HANDLE;
+	this->drawMeshTasks = meshShaders ? drawMeshTasks : nullptr;
+	this->stages = meshShaders ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+
+	this->createDescriptors(frameCount);
+	this->createPipelines(shaders, renderPass, colorFormat, depthFormat);
+}
+
+void
+MeshletRenderer::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	if (this->cullPipeline != VK_NULL_HANDLE)
+		vkDestroyPipeline(this->device, this->cullPipeline, this->allocator);
+	vkDestroyPipeline(this->device, this->drawPipeline, this->allocator);
+	vkDestroyPipelineLayout(this->device, this->pipelineLayout, this->allocator);
+	// Frees the sets too
+	for (VkDescriptorPool pool : this->meshPools)
+		vkDestroyDescriptorPool(this->device, pool, this->allocator);
+	vkDestroyDescriptorPool(this->device, this->framePool, this->allocator);
+	vkDestroyDescriptorSetLayout(this->device, this->meshSetLayout, this->allocator);
+	vkDestroyDescriptorSetLayout(this->device, this->frameSetLayout, this->allocator);
+
+	this->cullPipeline = VK_NULL_HANDLE;
+	this->meshPools.clear();
+	this->meshSets.clear();
+	this->frameSets.clear();
+	this->drawMeshTasks = nullptr;
+	this->device = VK_NULL_HANDLE;
+}
+
+void
+MeshletRenderer::createDescriptors(uint32_t frameCount)
+{
+	// Both sets are four storage buffers: transforms, candidates, draws, commands / meshlets, meshlet vertices, meshlet triangles, vertices
+	VkDescriptorSetLayoutBinding bindings[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = this->stages;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocator, &this->frameSetLayout) != VK_SUCCESS ||
+		vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocator, &this->meshSetLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create meshlet descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frameCount };
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = frameCount;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, this->allocator, &this->framePool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create meshlet descriptor pool!");
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, this->frameSetLayout);
+	std::vector<VkDescriptorSet> sets(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->framePool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, sets.data()) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate meshlet descriptor sets!");
+
+	this->frameSets.resize(frameCount);
+	for (uint32_t i = 0; i < frameCount; i++)
+		this->frameSets[i].set = sets[i];
+}
+
+void
+MeshletRenderer::createPipelines(const MeshletShaders& shaders, VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat)
+{
+	VkDescriptorSetLayout setLayouts[2] = { this->frameSetLayout, this->meshSetLayout };
+	VkPushConstantRange pushRange{ this->stages, 0, sizeof(MeshletPushConstants) };
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 2;
+	layoutInfo.pSetLayouts = setLayouts;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+
+	if (vkCreatePipelineLayout(this->device, &layoutInfo, this->allocator, &this->pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create meshlet pipeline layout!");
+
+	if (!this->usesMeshShaders())
+	{
+		VkComputePipelineCreateInfo cullInfo{};
+		cullInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		cullInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		cullInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		cullInfo.stage.module = shaders.cull;
+		cullInfo.stage.pName = "main";
+		cullInfo.layout = this->pipelineLayout;
+
+		if (vkCreateComputePipelines(this->device, VK_NULL_HANDLE, 1, &cullInfo, this->allocator, &this->cullPipeline) != VK_SUCCESS)
+			throw std::runtime_error("failed to create meshlet cull pipeline!");
+	}
+
+	std::vector<VkPipelineShaderStageCreateInfo> stages;
+	auto addStage = [&stages](VkShaderStageFlagBits stage, VkShaderModule module) {
+		VkPipelineShaderStageCreateInfo info{};
+		info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		info.stage = stage;
+		info.module = module;
+		info.pName = "main";
+		stages.push_back(info);
+	};
+
+	if (this->usesMeshShaders())
+	{
+		addStage(VK_SHADER_STAGE_TASK_BIT_EXT, shaders.task);
+		addStage(VK_SHADER_STAGE_MESH_BIT_EXT, shaders.mesh);
+	}
+	else
+	{
+		addStage(VK_SHADER_STAGE_VERTEX_BIT, shaders.vertex);
+	}
+	addStage(VK_SHADER_STAGE_FRAGMENT_BIT, shaders.fragment);
+
+	// Vertex pulling, nothing comes from vertex input
+	VkPipelineVertexInputStateCreateInfo vertexInput{};
+	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// Same winding and depth state as the indexed mesh pipeline, the two are interchangeable per mesh
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_TRUE;
+	depthStencil.depthWriteEnable = VK_TRUE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	VkPipelineColorBlendAttachmentState blendAttachment{};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &blendAttachment;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+	pipelineInfo.pStages = stages.data();
+	// Mesh shading pipelines have no vertex input or input assembly stage
+	pipelineInfo.pVertexInputState = this->usesMeshShaders() ? nullptr : &vertexInput;
+	pipelineInfo.pInputAssemblyState = this->usesMeshShaders() ? nullptr : &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &colorFormat;
+	renderingInfo.depthAttachmentFormat = depthFormat;
+
+	if (renderPass == VK_NULL_HANDLE)
+		pipelineInfo.pNext = &renderingInfo;
+
+	if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &pipelineInfo, this->allocator, &this->drawPipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create meshlet pipeline!");
+}
+
+void
+MeshletRenderer::setFrameBuffers(uint32_t frameIndex, const MeshletFrameBuffers& buffers)
+{
+	FrameSet& frame = this->frameSets[frameIndex];
+
+	if (frame.buffers.transforms == buffers.transforms && frame.buffers.candidates == buffers.candidates &&
+		frame.buffers.draws == buffers.draws && frame.buffers.commands == buffers.commands)
+		return;
+
+	frame.buffers = buffers;
+
+	// The mesh shader path has no draw list, the bindings are still there (and must be valid) in the shared layout
+	VkBuffer handles[4] = { buffers.transforms, buffers.candidates,
+		buffers.draws != VK_NULL_HANDLE ? buffers.draws : buffers.candidates,
+		buffers.commands != VK_NULL_HANDLE ? buffers.commands : buffers.candidates };
+
+	VkDescriptorBufferInfo bufferInfos[4];
+	VkWriteDescriptorSet writes[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bufferInfos[i] = { handles[i], 0, VK_WHOLE_SIZE };
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = frame.set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, 4, writes, 0, nullptr);
+}
+
+VkDescriptorSet
+MeshletRenderer::meshSet(uint32_t mesh, const MeshletBuffers& buffers)
+{
+	if (mesh < this->meshSets.size() && this->meshSets[mesh] != VK_NULL_HANDLE)
+		return this->meshSets[mesh];
+
+	if (mesh >= this->meshSets.size())
+		this->meshSets.resize(mesh + 1, VK_NULL_HANDLE);
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->meshSetLayout;
+
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	VkResult result = VK_ERROR_OUT_OF_POOL_MEMORY;
+
+	if (!this->meshPools.empty())
+	{
+		allocInfo.descriptorPool = this->meshPools.back();
+		result = vkAllocateDescriptorSets(this->device, &allocInfo, &set);
+	}
+
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * MESH_SETS_PER_POOL };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.maxSets = MESH_SETS_PER_POOL;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+
+		VkDescriptorPool pool;
+		if (vkCreateDescriptorPool(this->device, &poolInfo, this->allocator, &pool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create meshlet descriptor pool!");
+		this->meshPools.push_back(pool);
+
+		allocInfo.descriptorPool = pool;
+		result = vkAllocateDescriptorSets(this->device, &allocInfo, &set);
+	}
+
+	if (result != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate meshlet descriptor set!");
+
+	VkBuffer handles[4] = { buffers.meshlets, buffers.meshletVertices, buffers.meshletTriangles, buffers.vertices };
+	VkDescriptorBufferInfo bufferInfos[4];
+	VkWriteDescriptorSet writes[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bufferInfos[i] = { handles[i], 0, VK_WHOLE_SIZE };
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, 4, writes, 0, nullptr);
+
+	this->meshSets[mesh] = set;
+	return set;
+}
+
+MeshletPushConstants
+MeshletRenderer::pushConstants(const MeshletBatch& batch, const float viewProjection[16], const float cameraPosition[3]) const
+{
+	MeshletPushConstants push{};
+	std::copy(viewProjection, viewProjection + 16, push.viewProjection);
+	std::copy(cameraPosition, cameraPosition + 3, push.cameraPosition);
+	push.meshletCount = batch.meshletCount;
+	push.firstCandidate = batch.firstCandidate;
+	push.candidateCount = batch.candidateCount;
+	push.firstDraw = batch.firstDraw;
+	return push;
+}
+
+void
+MeshletRenderer::recordCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<MeshletBatch>& batches,
+	const float viewProjection[16], const float cameraPosition[3])
+{
+	if (this->usesMeshShaders() || batches.empty())
+		return;
+
+	const FrameSet& frame = this->frameSets[frameIndex];
+
+	// The previous frame's draws may still read the list and the commands we are about to reset
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Every batch starts out with no instances, the cull counts them up
+	std::vector<VkDrawIndirectCommand> commands(batches.size(), { MESHLET_MAX_TRIANGLES * 3, 0, 0, 0 });
+	for (uint32_t first = 0; first < commands.size(); first += MAX_COMMANDS_PER_UPDATE)
+	{
+		uint32_t count = std::min(static_cast<uint32_t>(commands.size()) - first, MAX_COMMANDS_PER_UPDATE);
+		vkCmdUpdateBuffer(commandBuffer, frame.buffers.commands, VkDeviceSize(first) * sizeof(VkDrawIndirectCommand),
+			VkDeviceSize(count) * sizeof(VkDrawIndirectCommand), &commands[first]);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 1, &frame.set, 0, nullptr);
+
+	for (uint32_t i = 0; i < batches.size(); i++)
+	{
+		const MeshletBatch& batch = batches[i];
+		VkDescriptorSet set = this->meshSet(batch.mesh, batch.buffers);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 1, 1, &set, 0, nullptr);
+
+		MeshletPushConstants push = this->pushConstants(batch, viewProjection, cameraPosition);
+		push.commandIndex = i;
+
+		// The draw count keeps accumulating across the chunks, they all append to the batch's range
+		for (uint32_t first = 0; first < batch.candidateCount; first += MAX_INSTANCE_GROUPS)
+		{
+			push.firstCandidate = batch.firstCandidate + first;
+			push.candidateCount = std::min(batch.candidateCount - first, MAX_INSTANCE_GROUPS);
+
+			vkCmdPushConstants(commandBuffer, this->pipelineLayout, this->stages, 0, sizeof(push), &push);
+			vkCmdDispatch(commandBuffer, (batch.meshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, push.candidateCount, 1);
+		}
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void
+MeshletRenderer::recordDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<MeshletBatch>& batches,
+	const float viewProjection[16], const float cameraPosition[3])
+{
+	if (batches.empty())
+		return;
+
+	const FrameSet& frame = this->frameSets[frameIndex];
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->drawPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &frame.set, 0, nullptr);
+
+	for (uint32_t i = 0; i < batches.size(); i++)
+	{
+		const MeshletBatch& batch = batches[i];
+		VkDescriptorSet set = this->meshSet(batch.mesh, batch.buffers);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 1, 1, &set, 0, nullptr);
+
+		MeshletPushConstants push = this->pushConstants(batch, viewProjection, cameraPosition);
+		push.commandIndex = i;
+
+		if (!this->usesMeshShaders())
+		{
+			// One instance per surviving meshlet, counted by the cull
+			vkCmdPushConstants(commandBuffer, this->pipelineLayout, this->stages, 0, sizeof(push), &push);
+			vkCmdDrawIndirect(commandBuffer, frame.buffers.commands, VkDeviceSize(i) * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+			continue;
+		}
+
+		for (uint32_t first = 0; first < batch.candidateCount; first += MAX_INSTANCE_GROUPS)
+		{
+			push.firstCandidate = batch.firstCandidate + first;
+			push.candidateCount = std::min(batch.candidateCount - first, MAX_INSTANCE_GROUPS);
+
+			vkCmdPushConstants(commandBuffer, this->pipelineLayout, this->stages, 0, sizeof(push), &push);
+			this->drawMeshTasks(commandBuffer, (batch.meshletCount + TASK_GROUP_SIZE - 1) / TASK_GROUP_SIZE, push.candidateCount, 1);
+		}
+	}
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "MeshFormat.hpp"
+
+#include <vector>
+
+struct MeshletPushConstants {
+	float viewProjection[16];
+	float cameraPosition[3];
+	uint32_t meshletCount;
+	// Instances of the batch in the frame's candidate list
+	uint32_t firstCandidate;
+	uint32_t candidateCount;
+	// Compute path: first (transform slot, meshlet) entry of the batch and its draw command
+	uint32_t firstDraw;
+	uint32_t commandIndex;
+};
+static_assert(sizeof(MeshletPushConstants) == 96, "MeshletPushConstants must match the shader side push constant block");
+
+// Meshlet data of one mesh, created by GameCore with the rest of the mesh
+struct MeshletBuffers {
+	VkBuffer meshlets = VK_NULL_HANDLE;
+	VkBuffer meshletVertices = VK_NULL_HANDLE;
+	VkBuffer meshletTriangles = VK_NULL_HANDLE;
+	VkBuffer vertices = VK_NULL_HANDLE;
+};
+
+// Per frame buffers, created by GameCore so they are counted by the memory telemetry
+struct MeshletFrameBuffers {
+	VkBuffer transforms = VK_NULL_HANDLE; // scene transforms
+	VkBuffer candidates = VK_NULL_HANDLE; // CullCandidate[], the instances of every batch
+	VkBuffer draws = VK_NULL_HANDLE;      // uvec2 (transform slot, meshlet) per surviving meshlet, compute path only
+	VkBuffer commands = VK_NULL_HANDLE;   // VkDrawIndirectCommand per batch, compute path only
+};
+
+// Instances of one mesh, consecutive in the candidate list
+struct MeshletBatch {
+	uint32_t mesh;
+	MeshletBuffers buffers;
+	uint32_t meshletCount;
+	uint32_t firstCandidate;
+	uint32_t candidateCount;
+	// Compute path: the batch owns draws [firstDraw, firstDraw + candidateCount * meshletCount)
+	uint32_t firstDraw;
+};
+
+struct MeshletShaders {
+	VkShaderModule cull = VK_NULL_HANDLE;
+	VkShaderModule vertex = VK_NULL_HANDLE;
+	// Both set = mesh shader path
+	VkShaderModule task = VK_NULL_HANDLE;
+	VkShaderModule mesh = VK_NULL_HANDLE;
+	VkShaderModule fragment = VK_NULL_HANDLE;
+};
+
+// Draws meshes one meshlet (<= 64 vertices / 124 triangles, see MeshConverter) at a time, dropping meshlets outside
+// the frustum or facing away from the camera (normal cone) before any of their vertices are shaded:
+//   mesh shader path: a task shader culls 32 meshlets of an instance and launches a mesh workgroup per survivor
+//   compute path: a compute pass culls every (instance, meshlet) pair into a list, and one instanced draw per
+//                 mesh pulls the surviving meshlets' vertices in the vertex shader
+class MeshletRenderer {
+public:
+	// renderPass == VK_NULL_HANDLE builds the pipeline for dynamic rendering into colorFormat / depthFormat.
+	// drawMeshTasks is only needed for the mesh shader path.
+	void create(VkDevice device, uint32_t frameCount, const MeshletShaders& shaders, VkRenderPass renderPass,
+		VkFormat colorFormat, VkFormat depthFormat, PFN_vkCmdDrawMeshTasksEXT drawMeshTasks, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	bool isEnabled() const { return this->device != VK_NULL_HANDLE; }
+	bool usesMeshShaders() const { return this->drawMeshTasks != nullptr; }
+
+	// The frame slot has retired, its descriptors are only rewritten when a buffer changed
+	void setFrameBuffers(uint32_t frameIndex, const MeshletFrameBuffers& buffers);
+
+	// Outside of a render pass, before the pass drawing the batches. Nothing to do on the mesh shader path.
+	void recordCull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<MeshletBatch>& batches,
+		const float viewProjection[16], const float cameraPosition[3]);
+	// Inside the render pass, viewport and scissor already set
+	void recordDraw(VkCommandBuffer commandBuffer, uint32_t frameIndex, const std::vector<MeshletBatch>& batches,
+		const float viewProjection[16], const float cameraPosition[3]);
+
+private:
+	struct FrameSet {
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		MeshletFrameBuffers buffers;
+	};
+
+	void createDescriptors(uint32_t frameCount);
+	void createPipelines(const MeshletShaders& shaders, VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat);
+	// Allocated the first time a mesh is drawn, meshes are never unloaded before shutdown
+	VkDescriptorSet meshSet(uint32_t mesh, const MeshletBuffers& buffers);
+	MeshletPushConstants pushConstants(const MeshletBatch& batch, const float viewProjection[16], const float cameraPosition[3]) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	PFN_vkCmdDrawMeshTasksEXT drawMeshTasks = nullptr;
+	VkShaderStageFlags stages = 0;
+
+	VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;
+	VkDescriptorSetLayout meshSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool framePool = VK_NULL_HANDLE;
+	// Mesh sets come from a chain of fixed size pools, a new one is added when the last is full
+	std::vector<VkDescriptorPool> meshPools;
+	std::vector<VkDescriptorSet> meshSets;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline cullPipeline = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+	std::vector<FrameSet> frameSets;
+};
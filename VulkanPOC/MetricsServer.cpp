@@ -0,0 +1,281 @@
+#include "MetricsServer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using NativeSocket = SOCKET;
+#define METRICS_SEND_FLAGS 0
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+// A client hanging up mid response must not SIGPIPE the renderer
+#define METRICS_SEND_FLAGS MSG_NOSIGNAL
+using NativeSocket = int;
+#endif
+
+namespace {
+	// How often the server thread notices stop()
+	constexpr long POLL_INTERVAL_MS = 200;
+	// Requests are a single line and a few headers, anything bigger is cut off and answered anyway
+	constexpr size_t MAX_REQUEST = 4096;
+
+	void
+	closeSocket(intptr_t handle)
+	{
+#ifdef _WIN32
+		closesocket(static_cast<NativeSocket>(handle));
+#else
+		close(static_cast<NativeSocket>(handle));
+#endif
+	}
+
+	void
+	sendAll(NativeSocket client, const std::string& data)
+	{
+		size_t sent = 0;
+		while (sent < data.size())
+		{
+			int n = send(client, data.data() + sent, static_cast<int>(data.size() - sent), METRICS_SEND_FLAGS);
+			if (n <= 0)
+				return;
+			sent += static_cast<size_t>(n);
+		}
+	}
+
+	void
+	writeMetric(std::ostringstream& out, const char* name, const char* type, const char* help)
+	{
+		out << "# HELP " << name << ' ' << help << '\n';
+		out << "# TYPE " << name << ' ' << type << '\n';
+	}
+}
+
+void
+RendererMetrics::addFrame(float ms)
+{
+	uint64_t index = this->frameCount.load(std::memory_order_relaxed);
+	this->frameMs[index % FRAME_HISTORY].store(ms, std::memory_order_relaxed);
+	// Release, a reader that sees the new count also sees the sample
+	this->frameCount.store(index + 1, std::memory_order_release);
+}
+
+bool
+MetricsServer::start(uint16_t port, const RendererMetrics* metrics)
+{
+	this->metrics = metrics;
+
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		std::cout << "[WARN] - metrics endpoint disabled, winsock failed to initialize\n";
+		return false;
+	}
+	NativeSocket listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	bool valid = listener != INVALID_SOCKET;
+#else
+	NativeSocket listener = socket(AF_INET, SOCK_STREAM, 0);
+	bool valid = listener >= 0;
+
+	// Restarting the renderer must not wait for the previous run's connections to leave TIME_WAIT
+	int reuse = 1;
+	if (valid)
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+
+	// Loopback only, the endpoint has no authentication
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (!valid
+		|| bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+		|| listen(listener, 4) != 0)
+	{
+		std::cout << "[WARN] - metrics endpoint disabled, can't listen on 127.0.0.1:" << port << "\n";
+		if (valid)
+			closeSocket(static_cast<intptr_t>(listener));
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return false;
+	}
+
+	this->listenSocket = static_cast<intptr_t>(listener);
+	this->stopping = false;
+	this->thread = std::thread(&MetricsServer::serve, this);
+
+	std::cout << "[INFO] - metrics on http://127.0.0.1:" << port << "/metrics\n";
+	return true;
+}
+
+void
+MetricsServer::stop()
+{
+	if (!this->thread.joinable())
+		return;
+
+	this->stopping = true;
+	this->thread.join();
+
+	closeSocket(this->listenSocket);
+	this->listenSocket = -1;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+void
+MetricsServer::serve()
+{
+	NativeSocket listener = static_cast<NativeSocket>(this->listenSocket);
+
+	while (!this->stopping)
+	{
+		// Bounded wait instead of a blocking accept, so stop() never has to interrupt the thread
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(listener, &readable);
+
+		timeval timeout{};
+		timeout.tv_usec = POLL_INTERVAL_MS * 1000;
+
+		if (select(static_cast<int>(listener) + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+			continue;
+
+		NativeSocket client = accept(listener, nullptr, nullptr);
+#ifdef _WIN32
+		if (client == INVALID_SOCKET)
+			continue;
+#else
+		if (client < 0)
+			continue;
+#endif
+
+		this->respond(static_cast<intptr_t>(client));
+		closeSocket(static_cast<intptr_t>(client));
+	}
+}
+
+void
+MetricsServer::respond(intptr_t client) const
+{
+	NativeSocket connection = static_cast<NativeSocket>(client);
+
+	// A client that connects and never sends must not keep the endpoint busy
+#ifdef _WIN32
+	DWORD receiveTimeout = 1000;
+#else
+	timeval receiveTimeout{ 1, 0 };
+#endif
+	setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&receiveTimeout), sizeof(receiveTimeout));
+
+	std::string request;
+	char buffer[512];
+	while (request.size() < MAX_REQUEST && request.find("\r\n\r\n") == std::string::npos)
+	{
+		int n = recv(connection, buffer, sizeof(buffer), 0);
+		if (n <= 0)
+			break;
+		request.append(buffer, static_cast<size_t>(n));
+	}
+
+	std::string status = "200 OK";
+	std::string body;
+	if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0)
+		body = this->render();
+	else
+	{
+		status = "404 Not Found";
+		body = "only GET /metrics is served\n";
+	}
+
+	std::ostringstream response;
+	response << "HTTP/1.1 " << status << "\r\n"
+		<< "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body;
+
+	sendAll(connection, response.str());
+}
+
+std::string
+MetricsServer::render() const
+{
+	const RendererMetrics& metrics = *this->metrics;
+	std::ostringstream out;
+
+	// Frame times: quantiles over the history window, count / sum over the same window
+	uint64_t frameCount = metrics.frameCount.load(std::memory_order_acquire);
+	size_t sampleCount = static_cast<size_t>(std::min<uint64_t>(frameCount, RendererMetrics::FRAME_HISTORY));
+
+	std::vector<float> samples(sampleCount);
+	double sumMs = 0.0;
+	for (size_t i = 0; i < sampleCount; i++)
+	{
+		samples[i] = metrics.frameMs[i].load(std::memory_order_relaxed);
+		sumMs += samples[i];
+	}
+	std::sort(samples.begin(), samples.end());
+
+	writeMetric(out, "vulkanpoc_frame_time_seconds", "summary", "CPU frame to frame time over the last frames.");
+	for (double quantile : { 0.5, 0.9, 0.99 })
+	{
+		double value = samples.empty() ? 0.0 : samples[std::min(sampleCount - 1, static_cast<size_t>(quantile * sampleCount))] / 1000.0;
+		out << "vulkanpoc_frame_time_seconds{quantile=\"" << quantile << "\"} " << value << '\n';
+	}
+	out << "vulkanpoc_frame_time_seconds_sum " << sumMs / 1000.0 << '\n';
+	out << "vulkanpoc_frame_time_seconds_count " << sampleCount << '\n';
+
+	writeMetric(out, "vulkanpoc_frames_total", "counter", "Frames rendered since startup.");
+	out << "vulkanpoc_frames_total " << frameCount << '\n';
+
+	double gpuFrameMs = metrics.gpuFrameMs.load(std::memory_order_relaxed);
+	if (gpuFrameMs >= 0.0)
+	{
+		writeMetric(out, "vulkanpoc_gpu_frame_seconds", "gauge", "GPU time of the last frame read back.");
+		out << "vulkanpoc_gpu_frame_seconds " << gpuFrameMs / 1000.0 << '\n';
+	}
+
+	writeMetric(out, "vulkanpoc_draws", "gauge", "Mesh instances submitted by the last frame.");
+	out << "vulkanpoc_draws " << metrics.draws.load(std::memory_order_relaxed) << '\n';
+	writeMetric(out, "vulkanpoc_triangles", "gauge", "Primitives of the last frame read back that reached clipping.");
+	out << "vulkanpoc_triangles " << metrics.triangles.load(std::memory_order_relaxed) << '\n';
+	writeMetric(out, "vulkanpoc_swapchain_recreations_total", "counter", "Swap chain recreations since startup.");
+	out << "vulkanpoc_swapchain_recreations_total " << metrics.swapChainRecreations.load(std::memory_order_relaxed) << '\n';
+
+	uint32_t heapCount = std::min<uint32_t>(metrics.heapCount.load(std::memory_order_relaxed), VK_MAX_MEMORY_HEAPS);
+	const struct {
+		const char* name;
+		const char* help;
+		std::atomic<uint64_t> RendererMetrics::Heap::* value;
+	} heapMetrics[] = {
+		{ "vulkanpoc_memory_heap_size_bytes", "Size of the memory heap.", &RendererMetrics::Heap::size },
+		{ "vulkanpoc_memory_heap_budget_bytes", "Memory the process may use from the heap.", &RendererMetrics::Heap::budget },
+		{ "vulkanpoc_memory_heap_usage_bytes", "Memory the process uses from the heap.", &RendererMetrics::Heap::usage },
+	};
+
+	for (const auto& metric : heapMetrics)
+	{
+		writeMetric(out, metric.name, "gauge", metric.help);
+		for (uint32_t i = 0; i < heapCount; i++)
+		{
+			const RendererMetrics::Heap& heap = metrics.heaps[i];
+			out << metric.name << "{heap=\"" << i << "\",device_local=\"" << (heap.deviceLocal.load(std::memory_order_relaxed) ? "true" : "false")
+				<< "\"} " << (heap.*metric.value).load(std::memory_order_relaxed) << '\n';
+		}
+	}
+
+	return out.str();
+}
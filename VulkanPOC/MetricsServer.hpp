@@ -0,0 +1,60 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+// Renderer counters the metrics endpoint reads. The render thread only does relaxed stores, the server thread only
+// relaxed loads, so neither ever waits for the other; a scrape may mix values of two consecutive frames.
+struct RendererMetrics {
+	// CPU frame times of the last FRAME_HISTORY frames, frameCount % FRAME_HISTORY is the next one written
+	static constexpr uint32_t FRAME_HISTORY = 1024;
+	std::atomic<float> frameMs[FRAME_HISTORY];
+	std::atomic<uint64_t> frameCount{ 0 };
+
+	// Of the last frame the GPU queries were read back for, negative without timestamps
+	std::atomic<double> gpuFrameMs{ -1.0 };
+	// Mesh instances submitted and primitives that reached the clipper (pipeline statistics, 0 without them)
+	std::atomic<uint64_t> draws{ 0 };
+	std::atomic<uint64_t> triangles{ 0 };
+	std::atomic<uint64_t> swapChainRecreations{ 0 };
+
+	struct Heap {
+		std::atomic<uint64_t> size{ 0 };
+		std::atomic<uint64_t> budget{ 0 };
+		std::atomic<uint64_t> usage{ 0 };
+		std::atomic<bool> deviceLocal{ false };
+	};
+	std::atomic<uint32_t> heapCount{ 0 };
+	Heap heaps[VK_MAX_MEMORY_HEAPS];
+
+	void addFrame(float ms);
+};
+
+// Serves the counters as Prometheus text on http://127.0.0.1:<port>/metrics from its own thread, e.g.
+//     curl http://127.0.0.1:9464/metrics
+// Only binds the loopback interface, one request per connection.
+class MetricsServer {
+public:
+	~MetricsServer() { this->stop(); }
+
+	// Returns false (and logs why) when the port can't be bound, the renderer simply runs without the endpoint
+	bool start(uint16_t port, const RendererMetrics* metrics);
+	// Joins the server thread, takes at most one poll interval
+	void stop();
+
+	bool isRunning() const { return this->thread.joinable(); }
+
+private:
+	void serve();
+	void respond(intptr_t client) const;
+	std::string render() const;
+
+	const RendererMetrics* metrics = nullptr;
+	// SOCKET on Windows, a file descriptor elsewhere
+	intptr_t listenSocket = -1;
+	std::atomic<bool> stopping{ false };
+	std::thread thread;
+};
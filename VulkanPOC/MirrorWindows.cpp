@@ -0,0 +1,464 @@
+#include "MirrorWindows.hpp"
+
+void
+PresentBatch::clear()
+{
+	this->waitSemaphores.clear();
+	this->waitStages.clear();
+	this->waitValues.clear();
+	this->commandBuffers.clear();
+	this->signalSemaphores.clear();
+	this->signalValues.clear();
+	this->presentWaits.clear();
+	this->swapChains.clear();
+	this->imageIndices.clear();
+	this->presentIds.clear();
+	this->presentResults.clear();
+}
+
+void
+PresentBatch::addWait(VkSemaphore semaphore, VkPipelineStageFlags stages, uint64_t value)
+{
+	this->waitSemaphores.push_back(semaphore);
+	this->waitStages.push_back(stages);
+	this->waitValues.push_back(value);
+}
+
+void
+PresentBatch::addSignal(VkSemaphore semaphore, uint64_t value)
+{
+	this->signalSemaphores.push_back(semaphore);
+	this->signalValues.push_back(value);
+}
+
+void
+PresentBatch::addPresent(VkSemaphore wait, VkSwapchainKHR swapChain, uint32_t imageIndex, uint64_t presentId)
+{
+	this->presentWaits.push_back(wait);
+	this->swapChains.push_back(swapChain);
+	this->imageIndices.push_back(imageIndex);
+	this->presentIds.push_back(presentId);
+	this->presentResults.push_back(VK_SUCCESS);
+}
+
+void
+MirrorWindows::create(const MirrorContext& context, uint32_t windowCount, uint32_t width, uint32_t height)
+{
+	this->context = context;
+
+	int monitorCount = 0;
+	GLFWmonitor** monitors = glfwGetMonitors(&monitorCount);
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	for (uint32_t i = 0; i < windowCount; i++)
+	{
+		Window window;
+		window.id = i;
+		window.title = "Vulkan - mirror " + std::to_string(i + 1);
+		window.window = glfwCreateWindow(width, height, window.title.c_str(), nullptr, nullptr);
+		if (!window.window)
+			throw std::runtime_error("Mirror window could not be initialized");
+
+		// The main window opens on the primary monitor
+		if (monitorCount > 1)
+		{
+			int x = 0, y = 0;
+			glfwGetMonitorPos(monitors[(i + 1) % monitorCount], &x, &y);
+			glfwSetWindowPos(window.window, x, y);
+		}
+
+		if (glfwCreateWindowSurface(context.instance, window.window, context.allocator, &window.surface) != VK_SUCCESS)
+			throw std::runtime_error("failed to create mirror window surface!");
+
+		// The device was picked for the main window's surface, this one may live on another adapter's output
+		VkBool32 presentSupport = VK_FALSE;
+		vkGetPhysicalDeviceSurfaceSupportKHR(context.physicalDevice, context.presentFamily, window.surface, &presentSupport);
+		if (!presentSupport)
+		{
+			std::cout << "[WARN] - " << window.title << ": the present queue can't present to it, window closed" << std::endl;
+			this->destroyWindow(window);
+			continue;
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = context.graphicsFamily;
+
+		window.imageAvailable.resize(context.frameCount);
+		window.commandPools.resize(context.frameCount);
+		window.commandBuffers.resize(context.frameCount);
+
+		for (uint32_t frame = 0; frame < context.frameCount; frame++)
+		{
+			if (vkCreateSemaphore(context.device, &semaphoreInfo, context.allocator, &window.imageAvailable[frame]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create synchronization objects for a mirror window!");
+
+			if (vkCreateCommandPool(context.device, &poolInfo, context.allocator, &window.commandPools[frame]) != VK_SUCCESS)
+				throw std::runtime_error("failed to create mirror command pool!");
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = window.commandPools[frame];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(context.device, &allocInfo, &window.commandBuffers[frame]) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate mirror command buffers!");
+		}
+
+		if (!this->createSwapChain(window))
+		{
+			this->destroyWindow(window);
+			continue;
+		}
+
+		this->windows.push_back(std::move(window));
+	}
+
+	std::cout << "[INFO] - " << this->windows.size() << " mirror window(s), each rendering its own view, presented together with the main window" << std::endl;
+}
+
+void
+MirrorWindows::destroy()
+{
+	for (Window& window : this->windows)
+		this->destroyWindow(window);
+
+	this->windows.clear();
+	this->acquired.clear();
+	this->views.clear();
+}
+
+bool
+MirrorWindows::isOpen(uint32_t id) const
+{
+	return std::any_of(this->windows.begin(), this->windows.end(), [id](const Window& window) { return window.id == id; });
+}
+
+Camera*
+MirrorWindows::getCamera(uint32_t id, const Camera& follow)
+{
+	for (Window& window : this->windows)
+	{
+		if (window.id != id)
+			continue;
+
+		if (!window.camera)
+			window.camera = std::make_unique<Camera>(follow);
+		return window.camera.get();
+	}
+
+	return nullptr;
+}
+
+void
+MirrorWindows::acquire(uint32_t frameIndex)
+{
+	this->acquired.clear();
+	this->views.clear();
+
+	for (size_t i = 0; i < this->windows.size();)
+	{
+		Window& window = this->windows[i];
+
+		// Not a hot path, like the main swap chain simply drain the GPU rather than tracking what still uses the images
+		if (glfwWindowShouldClose(window.window) || window.lost)
+		{
+			vkDeviceWaitIdle(this->context.device);
+			if (window.lost)
+				std::cout << "[WARN] - " << window.title << ": surface lost, window closed" << std::endl;
+			else
+				std::cout << "[INFO] - " << window.title << " closed" << std::endl;
+			this->destroyWindow(window);
+			this->windows.erase(this->windows.begin() + i);
+			continue;
+		}
+
+		if (window.dirty)
+		{
+			// Minimized windows have no swap chain, nothing can still be using it
+			if (window.swapChain != VK_NULL_HANDLE)
+				vkDeviceWaitIdle(this->context.device);
+
+			window.dirty = false;
+			if (!this->createSwapChain(window))
+			{
+				this->destroyWindow(window);
+				this->windows.erase(this->windows.begin() + i);
+				continue;
+			}
+		}
+
+		i++;
+	}
+
+	for (uint32_t i = 0; i < this->windows.size(); i++)
+	{
+		Window& window = this->windows[i];
+		if (window.swapChain == VK_NULL_HANDLE)
+			continue;
+
+		// Zero timeout: a window whose presentation engine still holds every image just misses this frame
+		VkResult res = vkAcquireNextImageKHR(this->context.device, window.swapChain, 0, window.imageAvailable[frameIndex], VK_NULL_HANDLE, &window.imageIndex);
+
+		if (res == VK_SUCCESS || res == VK_SUBOPTIMAL_KHR)
+		{
+			this->acquired.push_back(i);
+			this->views.push_back({ window.id, window.images[window.imageIndex], window.extent, window.camera.get() });
+		}
+		else if (res == VK_ERROR_OUT_OF_DATE_KHR)
+			window.dirty = true;
+		else if (res == VK_ERROR_SURFACE_LOST_KHR)
+			window.lost = true;
+		else if (res != VK_NOT_READY && res != VK_TIMEOUT)
+			throw std::runtime_error("failed to acquire mirror swap chain image!");
+	}
+}
+
+void
+MirrorWindows::beginRecording(uint32_t frameIndex, RecordView record, ThreadPool& threadPool)
+{
+	this->record = std::move(record);
+
+	// Every window has its own pool per frame slot, so the command buffers can be recorded concurrently,
+	// with each other and with the frame's own command buffer
+	for (uint32_t i = 0; i < this->acquired.size(); i++)
+	{
+		this->recordings.push_back(threadPool.submit([this, i, frameIndex]() {
+			this->recordView(i, frameIndex);
+		}));
+	}
+}
+
+void
+MirrorWindows::finishRecording()
+{
+	// get() rethrows a failed recording here, on the render thread
+	for (std::future<void>& recording : this->recordings)
+		recording.get();
+
+	this->recordings.clear();
+}
+
+void
+MirrorWindows::append(uint32_t frameIndex, PresentBatch& batch) const
+{
+	for (uint32_t index : this->acquired)
+	{
+		const Window& window = this->windows[index];
+
+		// Only the final blit writes the image, so the acquire is only waited for at the transfer stage
+		batch.addWait(window.imageAvailable[frameIndex], VK_PIPELINE_STAGE_TRANSFER_BIT);
+		batch.commandBuffers.push_back(window.commandBuffers[frameIndex]);
+		batch.addSignal(window.renderFinished[window.imageIndex]);
+		batch.addPresent(window.renderFinished[window.imageIndex], window.swapChain, window.imageIndex);
+	}
+}
+
+void
+MirrorWindows::presented(const VkResult* results)
+{
+	for (size_t i = 0; i < this->acquired.size(); i++)
+	{
+		if (results[i] == VK_ERROR_OUT_OF_DATE_KHR || results[i] == VK_SUBOPTIMAL_KHR)
+			this->windows[this->acquired[i]].dirty = true;
+		else if (results[i] == VK_ERROR_SURFACE_LOST_KHR)
+			this->windows[this->acquired[i]].lost = true;
+		else if (results[i] != VK_SUCCESS)
+			throw std::runtime_error("failed to present mirror swap chain image!");
+	}
+}
+
+bool
+MirrorWindows::createSwapChain(Window& window)
+{
+	const MirrorContext& context = this->context;
+
+	VkSurfaceCapabilitiesKHR capabilities;
+	if (vkGetPhysicalDeviceSurfaceCapabilitiesKHR(context.physicalDevice, window.surface, &capabilities) != VK_SUCCESS)
+	{
+		std::cout << "[WARN] - " << window.title << ": surface lost, window closed" << std::endl;
+		return false;
+	}
+
+	VkExtent2D extent = capabilities.currentExtent;
+	if (extent.width == UINT32_MAX)
+	{
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(window.window, &width, &height);
+		extent.width = std::clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+		extent.height = std::clamp(static_cast<uint32_t>(height), capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+	}
+
+	// Whatever happens, the old swap chain (only kept to hand it to the new one) and its semaphores go
+	VkSwapchainKHR oldSwapChain = window.swapChain;
+	window.swapChain = VK_NULL_HANDLE;
+	this->destroySwapChain(window);
+
+	auto retireOld = [&]() {
+		if (oldSwapChain != VK_NULL_HANDLE)
+			vkDestroySwapchainKHR(context.device, oldSwapChain, context.allocator);
+	};
+
+	// Minimized: nothing to present to, try again next frame
+	if (extent.width == 0 || extent.height == 0)
+	{
+		retireOld();
+		window.dirty = true;
+		return true;
+	}
+
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(context.physicalDevice, window.surface, &formatCount, nullptr);
+	std::vector<VkSurfaceFormatKHR> formats(formatCount);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(context.physicalDevice, window.surface, &formatCount, formats.data());
+
+	uint32_t modeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(context.physicalDevice, window.surface, &modeCount, nullptr);
+	std::vector<VkPresentModeKHR> modes(modeCount);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(context.physicalDevice, window.surface, &modeCount, modes.data());
+
+	if (formats.empty())
+	{
+		std::cout << "[WARN] - " << window.title << ": no surface formats, window closed" << std::endl;
+		retireOld();
+		return false;
+	}
+
+	VkSurfaceFormatKHR surfaceFormat = formats[0];
+	for (const VkSurfaceFormatKHR& format : formats)
+	{
+		if (format.format == VK_FORMAT_B8G8R8A8_SRGB && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
+			surfaceFormat = format;
+	}
+
+	// The window's view is blitted in from the render target it was drawn into
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(context.physicalDevice, surfaceFormat.format, &properties);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	if (!(capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) || (properties.optimalTilingFeatures & required) != required)
+	{
+		std::cout << "[WARN] - " << window.title << ": swap chain images can't be the target of a blit, window closed" << std::endl;
+		retireOld();
+		return false;
+	}
+
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	if (std::find(modes.begin(), modes.end(), context.presentMode) != modes.end())
+		presentMode = context.presentMode;
+
+	uint32_t imageCount = capabilities.minImageCount + 1;
+	if (capabilities.maxImageCount > 0)
+		imageCount = std::min(imageCount, capabilities.maxImageCount);
+
+	uint32_t queueFamilyIndices[] = { context.graphicsFamily, context.presentFamily };
+
+	VkSwapchainCreateInfoKHR createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+	createInfo.surface = window.surface;
+	createInfo.minImageCount = imageCount;
+	createInfo.imageFormat = surfaceFormat.format;
+	createInfo.imageColorSpace = surfaceFormat.colorSpace;
+	createInfo.imageExtent = extent;
+	createInfo.imageArrayLayers = 1;
+	createInfo.imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	createInfo.imageSharingMode = context.graphicsFamily != context.presentFamily ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	createInfo.queueFamilyIndexCount = context.graphicsFamily != context.presentFamily ? 2 : 0;
+	createInfo.pQueueFamilyIndices = queueFamilyIndices;
+	createInfo.preTransform = capabilities.currentTransform;
+	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	createInfo.presentMode = presentMode;
+	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = oldSwapChain;
+
+	VkResult res = vkCreateSwapchainKHR(context.device, &createInfo, context.allocator, &window.swapChain);
+	retireOld();
+
+	if (res == VK_ERROR_SURFACE_LOST_KHR)
+	{
+		std::cout << "[WARN] - " << window.title << ": surface lost, window closed" << std::endl;
+		window.swapChain = VK_NULL_HANDLE;
+		return false;
+	}
+	if (res != VK_SUCCESS)
+		throw std::runtime_error("failed to create mirror swap chain!");
+
+	uint32_t count = 0;
+	vkGetSwapchainImagesKHR(context.device, window.swapChain, &count, nullptr);
+	window.images.resize(count);
+	vkGetSwapchainImagesKHR(context.device, window.swapChain, &count, window.images.data());
+	window.extent = extent;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	window.renderFinished.resize(count);
+	for (VkSemaphore& semaphore : window.renderFinished)
+	{
+		if (vkCreateSemaphore(context.device, &semaphoreInfo, context.allocator, &semaphore) != VK_SUCCESS)
+			throw std::runtime_error("failed to create synchronization objects for a mirror window!");
+	}
+
+	return true;
+}
+
+void
+MirrorWindows::destroySwapChain(Window& window)
+{
+	// The swap chain handle itself is left to the caller, a new one is created from it
+	for (VkSemaphore semaphore : window.renderFinished)
+		vkDestroySemaphore(this->context.device, semaphore, this->context.allocator);
+
+	window.renderFinished.clear();
+	window.images.clear();
+	window.extent = {};
+}
+
+void
+MirrorWindows::destroyWindow(Window& window)
+{
+	const MirrorContext& context = this->context;
+
+	this->destroySwapChain(window);
+	if (window.swapChain != VK_NULL_HANDLE)
+		vkDestroySwapchainKHR(context.device, window.swapChain, context.allocator);
+
+	for (VkSemaphore semaphore : window.imageAvailable)
+		vkDestroySemaphore(context.device, semaphore, context.allocator);
+	for (VkCommandPool pool : window.commandPools)
+		vkDestroyCommandPool(context.device, pool, context.allocator);
+
+	vkDestroySurfaceKHR(context.instance, window.surface, context.allocator);
+	glfwDestroyWindow(window.window);
+
+	window = Window{};
+}
+
+void
+MirrorWindows::recordView(uint32_t acquiredIndex, uint32_t frameIndex) const
+{
+	const Window& window = this->windows[this->acquired[acquiredIndex]];
+	VkCommandBuffer commandBuffer = window.commandBuffers[frameIndex];
+
+	// The frame slot retired, so did the last view recorded from this pool
+	vkResetCommandPool(this->context.device, window.commandPools[frameIndex], 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("failed to begin recording mirror command buffer!");
+
+	this->record(commandBuffer, this->views[acquiredIndex]);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("failed to record mirror command buffer!");
+}
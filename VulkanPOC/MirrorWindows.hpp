@@ -0,0 +1,135 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "Camera.hpp"
+#include "ThreadPool.hpp"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Semaphores, command buffers and swap chains of a frame's single vkQueueSubmit and vkQueuePresentKHR, gathered from
+// every window. Kept by the caller and cleared each frame, so the vectors stop allocating after the first frames.
+struct PresentBatch {
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	// One per wait / signal semaphore, ignored (0) for the binary ones
+	std::vector<uint64_t> waitValues;
+	std::vector<VkCommandBuffer> commandBuffers;
+	std::vector<VkSemaphore> signalSemaphores;
+	std::vector<uint64_t> signalValues;
+
+	std::vector<VkSemaphore> presentWaits;
+	std::vector<VkSwapchainKHR> swapChains;
+	std::vector<uint32_t> imageIndices;
+	// 0 = no present id for that swap chain
+	std::vector<uint64_t> presentIds;
+	std::vector<VkResult> presentResults;
+
+	void clear();
+	void addWait(VkSemaphore semaphore, VkPipelineStageFlags stages, uint64_t value = 0);
+	void addSignal(VkSemaphore semaphore, uint64_t value = 0);
+	void addPresent(VkSemaphore wait, VkSwapchainKHR swapChain, uint32_t imageIndex, uint64_t presentId = 0);
+};
+
+// What a mirror window shows this frame, handed to the callback that records it
+struct MirrorView {
+	// The window's position in the order the windows were opened, stable while it stays open
+	uint32_t id;
+	// The acquired swap chain image, in an undefined layout; the recording leaves it in PRESENT_SRC_KHR
+	VkImage image;
+	VkExtent2D extent;
+	// nullptr while the window follows the main camera
+	const Camera* camera;
+};
+
+struct MirrorContext {
+	VkInstance instance;
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	uint32_t graphicsFamily;
+	uint32_t presentFamily;
+	uint32_t frameCount;
+	// Used when the surface supports it, FIFO otherwise
+	VkPresentModeKHR presentMode;
+	const VkAllocationCallbacks* allocator;
+};
+
+// Extra windows that each render their own view of the scene, e.g. one per display of a control room, driven from
+// the same device. Every window has its own swap chain and records its view into its own command buffer, in parallel
+// on the thread pool; the views run behind the frame's command buffer in the same submission and all swap chains are
+// presented by the frame's single present.
+// A window never holds up the main one: one without a free image this frame is skipped, one whose surface is lost is
+// closed.
+class MirrorWindows {
+public:
+	// Records view into commandBuffer, which is already begun. Runs on a worker thread, once per acquired window.
+	using RecordView = std::function<void(VkCommandBuffer commandBuffer, const MirrorView& view)>;
+
+	// Opens the windows, spread over the monitors after the first one when there are several
+	void create(const MirrorContext& context, uint32_t windowCount, uint32_t width, uint32_t height);
+	void destroy();
+
+	uint32_t getCount() const { return static_cast<uint32_t>(this->windows.size()); }
+	bool isOpen(uint32_t id) const;
+
+	// The window's own camera, nullptr once the window is closed. The window follows the main camera until the first
+	// call, from then on it renders from the returned one, which starts out as a copy of follow and stays valid until
+	// the window closes.
+	Camera* getCamera(uint32_t id, const Camera& follow);
+
+	// Drops closed and lost windows, rebuilds out of date swap chains and acquires an image on every window that has
+	// one free
+	void acquire(uint32_t frameIndex);
+	// The windows acquire got an image for, until the next acquire
+	const std::vector<MirrorView>& getViews() const { return this->views; }
+	// Starts recording, one task per acquired window on threadPool. record must not touch anything the render thread
+	// changes before finishRecording.
+	void beginRecording(uint32_t frameIndex, RecordView record, ThreadPool& threadPool);
+	// Waits for the recordings, before the frame is submitted
+	void finishRecording();
+	// Adds the acquired windows to the frame's submission and present, after whatever batch already holds
+	void append(uint32_t frameIndex, PresentBatch& batch) const;
+	// results = batch.presentResults from the first entry append added. A lost surface closes its window on the next
+	// acquire instead of failing the frame.
+	void presented(const VkResult* results);
+
+private:
+	struct Window {
+		uint32_t id = 0;
+		std::string title;
+		GLFWwindow* window = nullptr;
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
+		VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+		VkExtent2D extent{};
+		std::vector<VkImage> images;
+		// Per swap chain image, the presentation engine may hold one after its frame slot retired
+		std::vector<VkSemaphore> renderFinished;
+		// Per frame slot; a pool each, so windows can record on different threads
+		std::vector<VkSemaphore> imageAvailable;
+		std::vector<VkCommandPool> commandPools;
+		std::vector<VkCommandBuffer> commandBuffers;
+		uint32_t imageIndex = 0;
+		bool dirty = false;
+		// The surface went away (e.g. its display was unplugged), dropped on the next acquire
+		bool lost = false;
+		// Created when the application asks for it, the main camera is followed until then. Heap allocated so the
+		// pointer handed out survives other windows closing.
+		std::unique_ptr<Camera> camera;
+	};
+
+	bool createSwapChain(Window& window);
+	void destroySwapChain(Window& window);
+	void destroyWindow(Window& window);
+	void recordView(uint32_t acquiredIndex, uint32_t frameIndex) const;
+
+	MirrorContext context{};
+	std::vector<Window> windows;
+	// Indices into windows, in the order append presents them, and what each of them shows
+	std::vector<uint32_t> acquired;
+	std::vector<MirrorView> views;
+	RecordView record;
+	std::vector<std::future<void>> recordings;
+};
@@ -0,0 +1,124 @@
+#include "PakArchive.hpp"
+#include "PakCodec.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+void
+PakArchive::open(const std::string& path)
+{
+	this->file.open(path);
+	this->path = path;
+
+	try {
+		this->validate();
+	}
+	catch (...) {
+		this->file.close();
+		throw;
+	}
+}
+
+void
+PakArchive::validate() const
+{
+	size_t size = this->file.size();
+
+	if (size < sizeof(PakHeader))
+		throw std::runtime_error("corrupt archive " + this->path + ": truncated header");
+
+	const PakHeader& header = this->getHeader();
+
+	if (header.magic != PAK_FILE_MAGIC)
+		throw std::runtime_error("not an asset archive: " + this->path);
+
+	if (header.version != PAK_FILE_VERSION)
+		throw std::runtime_error("unsupported archive version in " + this->path + ", rerun AssetPacker");
+
+	auto inRange = [size](uint64_t offset, uint64_t bytes) { return offset <= size && bytes <= size - offset; };
+
+	if (header.chunkSize == 0 ||
+		!inRange(header.chunkTableOffset, uint64_t(header.chunkCount) * sizeof(PakChunk)) ||
+		!inRange(header.tocOffset, uint64_t(header.entryCount) * sizeof(PakEntry)) ||
+		!inRange(header.stringTableOffset, header.stringTableSize) ||
+		header.chunkTableOffset % alignof(PakChunk) != 0 || header.tocOffset % alignof(PakEntry) != 0)
+		throw std::runtime_error("corrupt archive " + this->path + ": tables out of range");
+
+	// After this reads only need to check the decoded sizes
+	for (uint32_t i = 0; i < header.entryCount; i++)
+	{
+		const PakEntry& entry = this->getEntries()[i];
+		uint64_t expectedChunks = (entry.size + header.chunkSize - 1) / header.chunkSize;
+
+		if (uint64_t(entry.nameOffset) + entry.nameLength > header.stringTableSize ||
+			uint64_t(entry.firstChunk) + entry.chunkCount > header.chunkCount ||
+			entry.chunkCount != expectedChunks)
+			throw std::runtime_error("corrupt archive " + this->path + ": bad TOC entry");
+	}
+
+	for (uint32_t i = 0; i < header.chunkCount; i++)
+	{
+		const PakChunk& chunk = this->getChunks()[i];
+
+		if (!inRange(chunk.offset, chunk.compressedSize))
+			throw std::runtime_error("corrupt archive " + this->path + ": chunk out of range");
+	}
+}
+
+std::string_view
+PakArchive::getName(const PakEntry& entry) const
+{
+	const char* strings = reinterpret_cast<const char*>(this->file.data() + this->getHeader().stringTableOffset);
+	return std::string_view(strings + entry.nameOffset, entry.nameLength);
+}
+
+const PakEntry*
+PakArchive::find(const std::string& name) const
+{
+	if (!this->isOpen())
+		return nullptr;
+
+	const PakEntry* begin = this->getEntries();
+	const PakEntry* end = begin + this->getHeader().entryCount;
+
+	const PakEntry* it = std::lower_bound(begin, end, std::string_view(name), [this](const PakEntry& entry, std::string_view key) {
+		return this->getName(entry) < key;
+	});
+
+	return it != end && this->getName(*it) == name ? it : nullptr;
+}
+
+void
+PakArchive::read(const PakEntry& entry, void* destination, ThreadPool* pool) const
+{
+	const PakHeader& header = this->getHeader();
+	const PakChunk* chunks = this->getChunks() + entry.firstChunk;
+	const uint8_t* base = this->file.data();
+	uint8_t* output = static_cast<uint8_t*>(destination);
+
+	auto decode = [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint64_t offset = i * uint64_t(header.chunkSize);
+			size_t size = static_cast<size_t>(std::min<uint64_t>(header.chunkSize, entry.size - offset));
+
+			decompressPakChunk(chunks[i].codec, base + chunks[i].offset, chunks[i].compressedSize, output + offset, size);
+		}
+	};
+
+	// Every chunk lands at a known offset, so the workers never touch each other's output
+	if (pool && entry.chunkCount > 1)
+		pool->parallelFor(entry.chunkCount, decode);
+	else
+		decode(0, entry.chunkCount);
+}
+
+std::vector<char>
+PakArchive::read(const PakEntry& entry, ThreadPool* pool) const
+{
+	std::vector<char> data(static_cast<size_t>(entry.size));
+	this->read(entry, data.data(), pool);
+
+	return data;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "PakFormat.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+// Read-only view of a .pak: one mapping for the whole archive, the TOC and chunk table are used in place
+class PakArchive {
+public:
+	void open(const std::string& path);
+	void close() { this->file.close(); }
+	bool isOpen() const { return this->file.isOpen(); }
+
+	// nullptr if the archive has no such entry
+	const PakEntry* find(const std::string& name) const;
+
+	// Decodes the entry into destination (entry.size bytes, e.g. a mapped staging buffer). Chunks are
+	// spread over the pool's workers, without a pool everything is decoded on the calling thread.
+	void read(const PakEntry& entry, void* destination, ThreadPool* pool) const;
+	std::vector<char> read(const PakEntry& entry, ThreadPool* pool) const;
+
+	uint32_t getEntryCount() const { return this->getHeader().entryCount; }
+
+private:
+	const PakHeader& getHeader() const { return *reinterpret_cast<const PakHeader*>(this->file.data()); }
+	const PakEntry* getEntries() const { return reinterpret_cast<const PakEntry*>(this->file.data() + this->getHeader().tocOffset); }
+	const PakChunk* getChunks() const { return reinterpret_cast<const PakChunk*>(this->file.data() + this->getHeader().chunkTableOffset); }
+	std::string_view getName(const PakEntry& entry) const;
+
+	void validate() const;
+
+	MappedFile file;
+	std::string path;
+};
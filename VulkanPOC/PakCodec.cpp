@@ -0,0 +1,112 @@
+#include "PakCodec.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifdef VKPOC_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+
+#ifdef VKPOC_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+bool
+isPakCodecAvailable(PakCodec codec)
+{
+	switch (codec)
+	{
+	case PakCodec::Stored: return true;
+#ifdef VKPOC_HAVE_LZ4
+	case PakCodec::LZ4: return true;
+#endif
+#ifdef VKPOC_HAVE_ZSTD
+	case PakCodec::Zstd: return true;
+#endif
+	default: return false;
+	}
+}
+
+const char*
+pakCodecName(PakCodec codec)
+{
+	switch (codec)
+	{
+	case PakCodec::Stored: return "stored";
+	case PakCodec::LZ4: return "lz4";
+	case PakCodec::Zstd: return "zstd";
+	default: return "unknown";
+	}
+}
+
+bool
+compressPakChunk(PakCodec codec, const uint8_t* source, size_t sourceSize, std::vector<uint8_t>& compressed)
+{
+	if (!isPakCodecAvailable(codec))
+		throw std::runtime_error(std::string("codec not available in this build: ") + pakCodecName(codec));
+
+	switch (codec)
+	{
+#ifdef VKPOC_HAVE_LZ4
+	case PakCodec::LZ4:
+	{
+		// HC: packing is offline, decode speed is the same as plain LZ4
+		compressed.resize(LZ4_compressBound(static_cast<int>(sourceSize)));
+		int written = LZ4_compress_HC(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(compressed.data()),
+			static_cast<int>(sourceSize), static_cast<int>(compressed.size()), LZ4HC_CLEVEL_DEFAULT);
+		compressed.resize(written > 0 ? written : 0);
+		break;
+	}
+#endif
+#ifdef VKPOC_HAVE_ZSTD
+	case PakCodec::Zstd:
+	{
+		compressed.resize(ZSTD_compressBound(sourceSize));
+		size_t written = ZSTD_compress(compressed.data(), compressed.size(), source, sourceSize, 19);
+		compressed.resize(ZSTD_isError(written) ? 0 : written);
+		break;
+	}
+#endif
+	default:
+		compressed.assign(source, source + sourceSize);
+		return false;
+	}
+
+	return !compressed.empty() && compressed.size() < sourceSize;
+}
+
+void
+decompressPakChunk(PakCodec codec, const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize)
+{
+	switch (codec)
+	{
+	case PakCodec::Stored:
+		if (sourceSize != destinationSize)
+			throw std::runtime_error("corrupt pak chunk: stored size mismatch");
+		std::memcpy(destination, source, sourceSize);
+		return;
+#ifdef VKPOC_HAVE_LZ4
+	case PakCodec::LZ4:
+	{
+		int decoded = LZ4_decompress_safe(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination),
+			static_cast<int>(sourceSize), static_cast<int>(destinationSize));
+		if (decoded < 0 || static_cast<size_t>(decoded) != destinationSize)
+			throw std::runtime_error("corrupt pak chunk: lz4 decode failed");
+		return;
+	}
+#endif
+#ifdef VKPOC_HAVE_ZSTD
+	case PakCodec::Zstd:
+	{
+		size_t decoded = ZSTD_decompress(destination, destinationSize, source, sourceSize);
+		if (ZSTD_isError(decoded) || decoded != destinationSize)
+			throw std::runtime_error("corrupt pak chunk: zstd decode failed");
+		return;
+	}
+#endif
+	default:
+		throw std::runtime_error(std::string("pak chunk uses a codec not available in this build: ") + pakCodecName(codec));
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "PakFormat.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// LZ4 and Zstd are optional at build time (VKPOC_HAVE_LZ4 / VKPOC_HAVE_ZSTD), Stored always works
+bool isPakCodecAvailable(PakCodec codec);
+const char* pakCodecName(PakCodec codec);
+
+// Returns false when the codec didn't make the chunk smaller, the caller should store it instead
+bool compressPakChunk(PakCodec codec, const uint8_t* source, size_t sourceSize, std::vector<uint8_t>& compressed);
+
+// Throws if the codec is not compiled in or the data does not decode to exactly destinationSize bytes
+void decompressPakChunk(PakCodec codec, const uint8_t* source, size_t sourceSize, uint8_t* destination, size_t destinationSize);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of .pak archives, shared by the runtime PakArchive and the offline AssetPacker.
+//
+//   PakHeader
+//   chunk data      every entry split into chunkSize pieces, each compressed on its own
+//   chunk table     PakChunk[chunkCount]
+//   TOC             PakEntry[entryCount]        sorted by name for binary search
+//   string table    entry names, not null terminated
+//
+// Chunks are independent so a single entry can be decoded by several workers at once.
+
+constexpr uint32_t PAK_FILE_MAGIC = 0x4B415056; // "VPAK"
+constexpr uint32_t PAK_FILE_VERSION = 1;
+constexpr uint32_t PAK_DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+enum class PakCodec : uint32_t {
+	Stored = 0,
+	LZ4 = 1,
+	Zstd = 2,
+};
+
+struct PakHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t chunkCount;
+	// Uncompressed size of every chunk but the last one of an entry
+	uint32_t chunkSize;
+	uint32_t reserved;
+
+	uint64_t chunkTableOffset;
+	uint64_t tocOffset;
+	uint64_t stringTableOffset;
+	uint64_t stringTableSize;
+};
+
+struct PakEntry {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint64_t size;
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+};
+static_assert(sizeof(PakEntry) == 24, "PakEntry is read straight from the mapping");
+
+struct PakChunk {
+	uint64_t offset;
+	uint32_t compressedSize;
+	PakCodec codec;
+};
+static_assert(sizeof(PakChunk) == 16, "PakChunk is read straight from the mapping");
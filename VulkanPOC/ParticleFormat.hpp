@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+// Layouts shared by ParticleSystem, the particle_*.comp / particle.vert shaders and ParticleReference.
+// Must stay in sync with shaders/particle_common.glsl.
+
+constexpr uint32_t PARTICLE_GROUP_SIZE = 256;
+// Every particle is drawn as an instanced two-triangle quad
+constexpr uint32_t PARTICLE_QUAD_VERTICES = 6;
+
+struct GpuParticle {
+	float position[3];
+	float life;        // seconds left, <= 0 means dead
+	float velocity[3];
+	float size;
+	float color[4];
+};
+static_assert(sizeof(GpuParticle) == 48, "GpuParticle must match the std430 Particle struct");
+
+// Head of the counters buffer, also the source of the indirect dispatch / draw
+struct ParticleCounters {
+	uint32_t aliveCount[2]; // one per alive list, the lists swap every frame
+	int32_t deadCount;
+	uint32_t reserved;
+	uint32_t simulateDispatch[4]; // VkDispatchIndirectCommand + padding
+	uint32_t draw[4];             // VkDrawIndirectCommand
+};
+static_assert(sizeof(ParticleCounters) == 48, "ParticleCounters must match the std430 Counters block");
+
+struct ParticleEmitter {
+	float position[3] = { 0.0f, 0.5f, 0.0f };
+	float spawnRadius = 0.02f;
+	float velocity[3] = { 0.0f, -1.2f, 0.0f };
+	float velocityJitter = 0.35f;
+	float color[4] = { 1.0f, 0.55f, 0.15f, 1.0f };
+	float lifetime = 2.0f;
+	float lifetimeJitter = 0.5f;
+	float size = 0.004f;
+	// Particles per second, 0 = bursts only
+	float rate = 100000.0f;
+};
+
+// Push constants of every particle pipeline, one block so they can share a layout
+struct ParticlePushConstants {
+	float position[4];   // xyz emitter position, w spawn radius
+	float velocity[4];   // xyz initial velocity, w velocity jitter
+	float color[4];
+	float lifetime[4];   // x lifetime, y lifetime jitter, z size, w time step
+	float gravity[4];    // xyz gravity, w drag
+	uint32_t emitCount;
+	uint32_t seed;
+	uint32_t capacity;
+	uint32_t list;       // alive list read this pass
+	uint32_t mode;       // particle_args.comp: 0 = prepare simulate, 1 = write draw arguments
+	uint32_t reserved[3];
+};
+static_assert(sizeof(ParticlePushConstants) == 112, "ParticlePushConstants must fit the 128 byte push constant minimum");
+
+// PCG hash, bit exact with the GLSL version so the CPU reference spawns the same particles
+inline uint32_t particleRandomNext(uint32_t& state)
+{
+	state = state * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+inline float particleRandom01(uint32_t& state)
+{
+	return float(particleRandomNext(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+inline uint32_t particleSeed(uint32_t frameSeed, uint32_t index)
+{
+	uint32_t state = index;
+	return frameSeed ^ particleRandomNext(state);
+}
+
+// Spawn rule of particle_emit.comp
+inline GpuParticle spawnParticle(const ParticlePushConstants& push, uint32_t index)
+{
+	uint32_t state = particleSeed(push.seed, index);
+	GpuParticle particle;
+
+	for (int axis = 0; axis < 3; axis++)
+		particle.position[axis] = push.position[axis] + (particleRandom01(state) * 2.0f - 1.0f) * push.position[3];
+	for (int axis = 0; axis < 3; axis++)
+		particle.velocity[axis] = push.velocity[axis] + (particleRandom01(state) * 2.0f - 1.0f) * push.velocity[3];
+
+	particle.life = push.lifetime[0] + (particleRandom01(state) * 2.0f - 1.0f) * push.lifetime[1];
+	particle.size = push.lifetime[2];
+
+	for (int channel = 0; channel < 4; channel++)
+		particle.color[channel] = push.color[channel];
+
+	return particle;
+}
+
+inline void setParticleEmitter(ParticlePushConstants& push, const ParticleEmitter& emitter)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		push.position[axis] = emitter.position[axis];
+		push.velocity[axis] = emitter.velocity[axis];
+	}
+	push.position[3] = emitter.spawnRadius;
+	push.velocity[3] = emitter.velocityJitter;
+
+	for (int channel = 0; channel < 4; channel++)
+		push.color[channel] = emitter.color[channel];
+
+	push.lifetime[0] = emitter.lifetime;
+	push.lifetime[1] = emitter.lifetimeJitter;
+	push.lifetime[2] = emitter.size;
+}
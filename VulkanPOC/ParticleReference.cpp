@@ -0,0 +1,146 @@
+#include "ParticleReference.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLE_REFERENCE_SSE2 1
+#endif
+
+ParticleReference::ParticleReference(uint32_t capacity) :
+	capacity(capacity)
+{
+	for (auto& stream : this->streams)
+		stream.resize(capacity);
+}
+
+uint32_t
+ParticleReference::emit(const ParticleEmitter& emitter, uint32_t count, uint32_t seed)
+{
+	ParticlePushConstants push{};
+	setParticleEmitter(push, emitter);
+	push.seed = seed;
+
+	count = std::min(count, this->capacity - this->count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		GpuParticle particle = spawnParticle(push, i);
+		uint32_t slot = this->count++;
+
+		this->streams[PX][slot] = particle.position[0];
+		this->streams[PY][slot] = particle.position[1];
+		this->streams[PZ][slot] = particle.position[2];
+		this->streams[VX][slot] = particle.velocity[0];
+		this->streams[VY][slot] = particle.velocity[1];
+		this->streams[VZ][slot] = particle.velocity[2];
+		this->streams[LIFE][slot] = particle.life;
+		this->streams[SIZE][slot] = particle.size;
+		this->streams[R][slot] = particle.color[0];
+		this->streams[G][slot] = particle.color[1];
+		this->streams[B][slot] = particle.color[2];
+		this->streams[A][slot] = particle.color[3];
+	}
+
+	return count;
+}
+
+void
+ParticleReference::move(uint32_t from, uint32_t to)
+{
+	if (from == to)
+		return;
+
+	for (auto& stream : this->streams)
+		stream[to] = stream[from];
+}
+
+void
+ParticleReference::simulateScalar(uint32_t begin, uint32_t& write, float dt, const float gravity[3], float damping)
+{
+	float* position[3] = { this->streams[PX].data(), this->streams[PY].data(), this->streams[PZ].data() };
+	float* velocity[3] = { this->streams[VX].data(), this->streams[VY].data(), this->streams[VZ].data() };
+	float* life = this->streams[LIFE].data();
+
+	for (uint32_t i = begin; i < this->count; i++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			velocity[axis][i] = (velocity[axis][i] + gravity[axis] * dt) * damping;
+			position[axis][i] += velocity[axis][i] * dt;
+		}
+		life[i] -= dt;
+
+		if (life[i] > 0.0f)
+			this->move(i, write++);
+	}
+}
+
+void
+ParticleReference::simulate(float dt, const float gravity[3], float drag)
+{
+	float damping = std::max(0.0f, 1.0f - drag * dt);
+	uint32_t write = 0;
+	uint32_t i = 0;
+
+#ifdef PARTICLE_REFERENCE_SSE2
+	const __m128 dtv = _mm_set1_ps(dt);
+	const __m128 dampingv = _mm_set1_ps(damping);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 gravityv[3] = { _mm_set1_ps(gravity[0] * dt), _mm_set1_ps(gravity[1] * dt), _mm_set1_ps(gravity[2] * dt) };
+
+	for (; i + 4 <= this->count; i += 4)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float* position = this->streams[PX + axis].data() + i;
+			float* velocity = this->streams[VX + axis].data() + i;
+
+			__m128 v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velocity), gravityv[axis]), dampingv);
+			_mm_storeu_ps(velocity, v);
+			_mm_storeu_ps(position, _mm_add_ps(_mm_loadu_ps(position), _mm_mul_ps(v, dtv)));
+		}
+
+		float* life = this->streams[LIFE].data() + i;
+		__m128 remaining = _mm_sub_ps(_mm_loadu_ps(life), dtv);
+		_mm_storeu_ps(life, remaining);
+
+		int alive = _mm_movemask_ps(_mm_cmpgt_ps(remaining, zero));
+
+		// Whole block survived and nothing died before it: already in place
+		if (alive == 0xF && write == i)
+		{
+			write += 4;
+			continue;
+		}
+
+		// write <= i + lane, so compacting in place never clobbers a lane that is still to be read
+		for (uint32_t lane = 0; lane < 4; lane++)
+		{
+			if (alive & (1 << lane))
+				this->move(i + lane, write++);
+		}
+	}
+#endif
+
+	this->simulateScalar(i, write, dt, gravity, damping);
+	this->count = write;
+}
+
+GpuParticle
+ParticleReference::getParticle(uint32_t index) const
+{
+	GpuParticle particle;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		particle.position[axis] = this->streams[PX + axis][index];
+		particle.velocity[axis] = this->streams[VX + axis][index];
+	}
+	particle.life = this->streams[LIFE][index];
+	particle.size = this->streams[SIZE][index];
+	for (int channel = 0; channel < 4; channel++)
+		particle.color[channel] = this->streams[R + channel][index];
+
+	return particle;
+}
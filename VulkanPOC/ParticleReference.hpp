@@ -0,0 +1,33 @@
+#pragma once
+
+#include "ParticleFormat.hpp"
+
+#include <vector>
+
+// CPU implementation of the particle pipeline (emit, integrate, compact), for checking the compute shaders and
+// for hosts without a GPU. Same spawn rule, random sequence and integration as particle_*.comp; the only
+// difference is ordering: survivors are compacted stably here, the GPU appends them in whatever order the
+// atomics come out. Particles are stored as structure of arrays and integrated 4 at a time with SSE2.
+class ParticleReference {
+public:
+	explicit ParticleReference(uint32_t capacity);
+
+	// Spawns up to count particles, returns how many fit
+	uint32_t emit(const ParticleEmitter& emitter, uint32_t count, uint32_t seed);
+	// One particle_simulate.comp step, dead particles are dropped and the rest moved to the front
+	void simulate(float dt, const float gravity[3], float drag);
+
+	uint32_t getCapacity() const { return this->capacity; }
+	uint32_t getAliveCount() const { return this->count; }
+	GpuParticle getParticle(uint32_t index) const;
+
+private:
+	enum Stream { PX, PY, PZ, VX, VY, VZ, LIFE, SIZE, R, G, B, A, STREAM_COUNT };
+
+	void simulateScalar(uint32_t begin, uint32_t& write, float dt, const float gravity[3], float damping);
+	void move(uint32_t from, uint32_t to);
+
+	uint32_t capacity;
+	uint32_t count = 0;
+	std::vector<float> streams[STREAM_COUNT];
+};
@@ -0,0 +1,382 @@
+#include "ParticleSystem.hpp"
+
+#include <cstddef>
+
+void
+ParticleSystem::create(VkDevice device, uint32_t capacity, const ParticleBuffers& buffers, const ParticleShaders& shaders,
+	VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->allocator = allocator;
+	this->capacity = capacity;
+	this->countersBuffer = buffers.counters;
+	this->list = 0;
+
+	this->createDescriptors(buffers);
+	this->createPipelines(shaders, renderPass, colorFormat, depthFormat);
+}
+
+void
+ParticleSystem::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	vkDestroyPipeline(this->device, this->drawPipeline, this->allocator);
+	vkDestroyPipeline(this->device, this->argsPipeline, this->allocator);
+	vkDestroyPipeline(this->device, this->simulatePipeline, this->allocator);
+	vkDestroyPipeline(this->device, this->emitPipeline, this->allocator);
+	vkDestroyPipelineLayout(this->device, this->pipelineLayout, this->allocator);
+	// Frees the set too
+	vkDestroyDescriptorPool(this->device, this->descriptorPool, this->allocator);
+	vkDestroyDescriptorSetLayout(this->device, this->setLayout, this->allocator);
+
+	this->device = VK_NULL_HANDLE;
+}
+
+void
+ParticleSystem::createDescriptors(const ParticleBuffers& buffers)
+{
+	VkDescriptorSetLayoutBinding bindings[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, this->allocator, &this->setLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create particle descriptor set layout!");
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = 4;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, this->allocator, &this->descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("failed to create particle descriptor pool!");
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->setLayout;
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, &this->descriptorSet) != VK_SUCCESS)
+		throw std::runtime_error("failed to allocate particle descriptor set!");
+
+	VkDescriptorBufferInfo bufferInfos[4] = {
+		{ buffers.particles, 0, VK_WHOLE_SIZE },
+		{ buffers.alive, 0, VK_WHOLE_SIZE },
+		{ buffers.dead, 0, VK_WHOLE_SIZE },
+		{ buffers.counters, 0, VK_WHOLE_SIZE },
+	};
+
+	VkWriteDescriptorSet writes[4]{};
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = this->descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, 4, writes, 0, nullptr);
+}
+
+void
+ParticleSystem::createPipelines(const ParticleShaders& shaders, VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat)
+{
+	// One layout and one push constant block for every stage, so binding it once covers the whole frame
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(ParticlePushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &this->setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+
+	if (vkCreatePipelineLayout(this->device, &layoutInfo, this->allocator, &this->pipelineLayout) != VK_SUCCESS)
+		throw std::runtime_error("failed to create particle pipeline layout!");
+
+	VkComputePipelineCreateInfo computeInfos[3]{};
+	VkShaderModule computeModules[3] = { shaders.emit, shaders.simulate, shaders.args };
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		computeInfos[i].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		computeInfos[i].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		computeInfos[i].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		computeInfos[i].stage.module = computeModules[i];
+		computeInfos[i].stage.pName = "main";
+		computeInfos[i].layout = this->pipelineLayout;
+	}
+
+	VkPipeline computePipelines[3];
+	if (vkCreateComputePipelines(this->device, VK_NULL_HANDLE, 3, computeInfos, this->allocator, computePipelines) != VK_SUCCESS)
+		throw std::runtime_error("failed to create particle compute pipelines!");
+
+	this->emitPipeline = computePipelines[0];
+	this->simulatePipeline = computePipelines[1];
+	this->argsPipeline = computePipelines[2];
+
+	VkPipelineShaderStageCreateInfo stages[2]{};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = shaders.vertex;
+	stages[0].pName = "main";
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = shaders.fragment;
+	stages[1].pName = "main";
+
+	// Vertices are pulled from the storage buffers
+	VkPipelineVertexInputStateCreateInfo vertexInput{};
+	vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPipelineViewportStateCreateInfo viewportState{};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	rasterizer.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	// Particles are placed in clip space, not by the camera, so they can't be depth tested against the scene
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = VK_FALSE;
+	depthStencil.depthWriteEnable = VK_FALSE;
+	depthStencil.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+
+	// Additive, so the draw order the atomics produce doesn't matter
+	VkPipelineColorBlendAttachmentState blendAttachment{};
+	blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	blendAttachment.blendEnable = VK_TRUE;
+	blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+	blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending{};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &blendAttachment;
+
+	VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState{};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = stages;
+	pipelineInfo.pVertexInputState = &vertexInput;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = this->pipelineLayout;
+	pipelineInfo.renderPass = renderPass;
+	pipelineInfo.subpass = 0;
+
+	VkPipelineRenderingCreateInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachmentFormats = &colorFormat;
+	renderingInfo.depthAttachmentFormat = depthFormat;
+
+	if (renderPass == VK_NULL_HANDLE)
+		pipelineInfo.pNext = &renderingInfo;
+
+	if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &pipelineInfo, this->allocator, &this->drawPipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create particle draw pipeline!");
+}
+
+uint32_t
+ParticleSystem::addEmitter(const ParticleEmitter& emitter)
+{
+	uint32_t id = this->nextEmitterId++;
+	this->emitters[id] = { emitter, 0.0f };
+	return id;
+}
+
+void
+ParticleSystem::removeEmitter(uint32_t id)
+{
+	this->emitters.erase(id);
+}
+
+ParticleEmitter*
+ParticleSystem::getEmitter(uint32_t id)
+{
+	auto it = this->emitters.find(id);
+	return it != this->emitters.end() ? &it->second.emitter : nullptr;
+}
+
+void
+ParticleSystem::burst(const ParticleEmitter& emitter, uint32_t count, std::optional<uint32_t> seed)
+{
+	this->bursts.push_back({ emitter, count, seed });
+}
+
+void
+ParticleSystem::setGravity(float x, float y, float z)
+{
+	this->gravity[0] = x;
+	this->gravity[1] = y;
+	this->gravity[2] = z;
+}
+
+void
+ParticleSystem::computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccess;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void
+ParticleSystem::recordEmit(VkCommandBuffer commandBuffer, const ParticleEmitter& emitter, uint32_t count, std::optional<uint32_t> seed)
+{
+	count = std::min(count, this->capacity);
+	if (count == 0)
+		return;
+
+	setParticleEmitter(this->push, emitter);
+	this->push.emitCount = count;
+	// Different stream per dispatch, otherwise two emitters on the same frame would spawn identical offsets
+	uint32_t state = this->frame * 0x9E3779B9u + this->emitDispatches++;
+	this->push.seed = seed ? *seed : particleRandomNext(state);
+
+	vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->push), &this->push);
+	vkCmdDispatch(commandBuffer, (count + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+}
+
+void
+ParticleSystem::recordSimulation(VkCommandBuffer commandBuffer, float dt)
+{
+	if (!this->isEnabled())
+		return;
+
+	this->frame++;
+
+	// The previous simulation on this queue. The previous frame's draw is on the graphics queue, the submission waits for it.
+	VkMemoryBarrier beforeWrite{};
+	beforeWrite.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	beforeWrite.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	beforeWrite.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &beforeWrite, 0, nullptr, 0, nullptr);
+
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+
+	this->push = {};
+	this->push.capacity = this->capacity;
+	this->push.list = this->list;
+	this->push.lifetime[3] = dt;
+	this->push.gravity[0] = this->gravity[0];
+	this->push.gravity[1] = this->gravity[1];
+	this->push.gravity[2] = this->gravity[2];
+	this->push.gravity[3] = this->drag;
+
+	// Emitters only touch the dead list and the current alive list through atomics, no barrier between them
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->emitPipeline);
+
+	for (auto& entry : this->emitters)
+	{
+		EmitterState& state = entry.second;
+		state.pending += state.emitter.rate * dt;
+
+		uint32_t count = static_cast<uint32_t>(state.pending);
+		state.pending -= static_cast<float>(count);
+
+		this->recordEmit(commandBuffer, state.emitter, count);
+	}
+
+	while (!this->bursts.empty())
+	{
+		const Burst& burst = this->bursts.back();
+		this->recordEmit(commandBuffer, burst.emitter, burst.count, burst.seed);
+		this->bursts.pop_back();
+	}
+
+	this->computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	// Size the simulation from the GPU side alive count
+	this->push.mode = 0;
+	vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->push), &this->push);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->argsPipeline);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	this->computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->simulatePipeline);
+	vkCmdDispatchIndirect(commandBuffer, this->countersBuffer, offsetof(ParticleCounters, simulateDispatch));
+
+	this->computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+	this->push.mode = 1;
+	vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->push), &this->push);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->argsPipeline);
+	vkCmdDispatch(commandBuffer, 1, 1, 1);
+
+	// The survivors are in the other list now, that's what gets drawn and simulated next
+	this->list = 1 - this->list;
+}
+
+void
+ParticleSystem::recordDraw(VkCommandBuffer commandBuffer)
+{
+	if (!this->isEnabled())
+		return;
+
+	this->push.list = this->list;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->drawPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->pipelineLayout, 0, 1, &this->descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(this->push), &this->push);
+	vkCmdDrawIndirect(commandBuffer, this->countersBuffer, offsetof(ParticleCounters, draw), 1, sizeof(VkDrawIndirectCommand));
+}
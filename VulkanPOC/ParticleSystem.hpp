@@ -0,0 +1,99 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "ParticleFormat.hpp"
+
+#include <optional>
+#include <unordered_map>
+
+// Storage buffers of the particle system, created by GameCore so they are counted by the memory telemetry
+struct ParticleBuffers {
+	VkBuffer particles = VK_NULL_HANDLE;  // GpuParticle[capacity]
+	VkBuffer alive = VK_NULL_HANDLE;      // uint32_t[2 * capacity], two alive lists
+	VkBuffer dead = VK_NULL_HANDLE;       // uint32_t[capacity], free slots
+	VkBuffer counters = VK_NULL_HANDLE;   // ParticleCounters, also the indirect argument buffer
+};
+
+struct ParticleShaders {
+	VkShaderModule emit = VK_NULL_HANDLE;
+	VkShaderModule simulate = VK_NULL_HANDLE;
+	VkShaderModule args = VK_NULL_HANDLE;
+	VkShaderModule vertex = VK_NULL_HANDLE;
+	VkShaderModule fragment = VK_NULL_HANDLE;
+};
+
+// GPU resident particles: emitted, integrated and compacted by compute shaders, drawn with an indirect draw whose
+// instance count the GPU writes itself. Nothing is read back, so the CPU cost doesn't depend on the particle count.
+// Emitters are CPU side and only turn into a per-frame emit count plus push constants.
+class ParticleSystem {
+public:
+	// renderPass == VK_NULL_HANDLE builds the draw pipeline for dynamic rendering into colorFormat / depthFormat
+	void create(VkDevice device, uint32_t capacity, const ParticleBuffers& buffers, const ParticleShaders& shaders,
+		VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat, const VkAllocationCallbacks* allocator = nullptr);
+	void destroy();
+
+	bool isEnabled() const { return this->device != VK_NULL_HANDLE; }
+	uint32_t getCapacity() const { return this->capacity; }
+
+	uint32_t addEmitter(const ParticleEmitter& emitter);
+	void removeEmitter(uint32_t id);
+	// nullptr once removed, edits apply from the next frame
+	ParticleEmitter* getEmitter(uint32_t id);
+	// Spawned on the next frame, on top of the emitters' rate. seed pins the random stream (the one
+	// ParticleReference::emit takes), by default every dispatch gets its own.
+	void burst(const ParticleEmitter& emitter, uint32_t count, std::optional<uint32_t> seed = std::nullopt);
+
+	void setGravity(float x, float y, float z);
+	void setDrag(float drag) { this->drag = drag; }
+
+	// Into a compute submission: emit, simulate + compact, then write the draw arguments. Only compute stages are
+	// synchronized, the graphics queue picks the buffers up through ComputeHandoff barriers.
+	void recordSimulation(VkCommandBuffer commandBuffer, float dt);
+	// Inside the frame's rendering scope, after viewport and scissor are set
+	void recordDraw(VkCommandBuffer commandBuffer);
+
+	// Alive list (0 or 1) holding the particles after the last recordSimulation
+	uint32_t getAliveList() const { return this->list; }
+
+private:
+	struct EmitterState {
+		ParticleEmitter emitter;
+		float pending = 0.0f; // fractional particles carried to the next frame
+	};
+
+	void createDescriptors(const ParticleBuffers& buffers);
+	void createPipelines(const ParticleShaders& shaders, VkRenderPass renderPass, VkFormat colorFormat, VkFormat depthFormat);
+	void recordEmit(VkCommandBuffer commandBuffer, const ParticleEmitter& emitter, uint32_t count, std::optional<uint32_t> seed = std::nullopt);
+	void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+
+	VkDevice device = VK_NULL_HANDLE;
+	const VkAllocationCallbacks* allocator = nullptr;
+	uint32_t capacity = 0;
+	VkBuffer countersBuffer = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline emitPipeline = VK_NULL_HANDLE;
+	VkPipeline simulatePipeline = VK_NULL_HANDLE;
+	VkPipeline argsPipeline = VK_NULL_HANDLE;
+	VkPipeline drawPipeline = VK_NULL_HANDLE;
+
+	std::unordered_map<uint32_t, EmitterState> emitters;
+	uint32_t nextEmitterId = 0;
+	struct Burst {
+		ParticleEmitter emitter;
+		uint32_t count;
+		std::optional<uint32_t> seed;
+	};
+	std::vector<Burst> bursts;
+
+	ParticlePushConstants push{};
+	float gravity[3] = { 0.0f, 1.5f, 0.0f }; // +y is down in clip space
+	float drag = 0.1f;
+	// Alive list the next simulation reads, flips every frame
+	uint32_t list = 0;
+	uint32_t frame = 0;
+	uint32_t emitDispatches = 0;
+};
@@ -0,0 +1,297 @@
+#include "PipelineLibrary.hpp"
+
+namespace {
+	constexpr VkPipelineCreateFlags PART_FLAGS = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	// FNV-1a, only fed scalars and structs without padding
+	struct StateHash {
+		uint64_t value = 14695981039346656037ull;
+
+		void add(const void* data, size_t size)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				this->value ^= bytes[i];
+				this->value *= 1099511628211ull;
+			}
+		}
+
+		template<typename T>
+		void add(const T& value) { this->add(&value, sizeof(T)); }
+	};
+
+	void hashDynamicState(StateHash& hash, const VkPipelineDynamicStateCreateInfo* dynamicState)
+	{
+		if (dynamicState == nullptr)
+			return;
+
+		hash.add(dynamicState->dynamicStateCount);
+		hash.add(dynamicState->pDynamicStates, dynamicState->dynamicStateCount * sizeof(VkDynamicState));
+	}
+
+	uint64_t vertexInputKey(const VkGraphicsPipelineCreateInfo& info)
+	{
+		StateHash hash;
+		const VkPipelineVertexInputStateCreateInfo* vertexInput = info.pVertexInputState;
+		hash.add(vertexInput->vertexBindingDescriptionCount);
+		hash.add(vertexInput->pVertexBindingDescriptions, vertexInput->vertexBindingDescriptionCount * sizeof(VkVertexInputBindingDescription));
+		hash.add(vertexInput->vertexAttributeDescriptionCount);
+		hash.add(vertexInput->pVertexAttributeDescriptions, vertexInput->vertexAttributeDescriptionCount * sizeof(VkVertexInputAttributeDescription));
+		hash.add(info.pInputAssemblyState->topology);
+		hash.add(info.pInputAssemblyState->primitiveRestartEnable);
+		hashDynamicState(hash, info.pDynamicState);
+		return hash.value;
+	}
+
+	uint64_t outputKey(const VkGraphicsPipelineCreateInfo& info)
+	{
+		StateHash hash;
+		const VkPipelineColorBlendStateCreateInfo* colorBlend = info.pColorBlendState;
+		hash.add(colorBlend->logicOpEnable);
+		hash.add(colorBlend->logicOp);
+		hash.add(colorBlend->attachmentCount);
+		hash.add(colorBlend->pAttachments, colorBlend->attachmentCount * sizeof(VkPipelineColorBlendAttachmentState));
+		hash.add(colorBlend->blendConstants);
+		hash.add(info.pMultisampleState->rasterizationSamples);
+		hash.add(info.pMultisampleState->alphaToCoverageEnable);
+		hash.add(info.renderPass);
+		hash.add(info.subpass);
+
+		const VkPipelineRenderingCreateInfoKHR* rendering = static_cast<const VkPipelineRenderingCreateInfoKHR*>(info.pNext);
+		if (rendering != nullptr && rendering->sType == VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR)
+		{
+			hash.add(rendering->colorAttachmentCount);
+			hash.add(rendering->pColorAttachmentFormats, rendering->colorAttachmentCount * sizeof(VkFormat));
+			hash.add(rendering->depthAttachmentFormat);
+			hash.add(rendering->stencilAttachmentFormat);
+		}
+
+		hashDynamicState(hash, info.pDynamicState);
+		return hash.value;
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void
+PipelineLibrary::create(VkDevice device, ThreadPool* threadPool, bool enabled, const VkAllocationCallbacks* allocator)
+{
+	this->device = device;
+	this->threadPool = threadPool;
+	this->enabled = enabled;
+	this->allocator = allocator;
+}
+
+void
+PipelineLibrary::destroy()
+{
+	if (this->device == VK_NULL_HANDLE)
+		return;
+
+	// Not swapped in yet, so nobody else has these
+	for (PendingLink& link : this->pending)
+		vkDestroyPipeline(this->device, link.optimized.get(), this->allocator);
+	this->pending.clear();
+	for (std::future<VkPipeline>& optimized : this->cancelled)
+		vkDestroyPipeline(this->device, optimized.get(), this->allocator);
+	this->cancelled.clear();
+
+	for (auto& [key, part] : this->vertexInputParts)
+		vkDestroyPipeline(this->device, part, this->allocator);
+	for (auto& [key, part] : this->outputParts)
+		vkDestroyPipeline(this->device, part, this->allocator);
+	for (VkPipeline part : this->shaderParts)
+		vkDestroyPipeline(this->device, part, this->allocator);
+
+	this->vertexInputParts.clear();
+	this->outputParts.clear();
+	this->shaderParts.clear();
+	this->device = VK_NULL_HANDLE;
+}
+
+void
+PipelineLibrary::createPipeline(const VkGraphicsPipelineCreateInfo& info, const char* name, VkPipeline& pipeline)
+{
+	if (!this->enabled)
+	{
+		if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &info, this->allocator, &pipeline) != VK_SUCCESS)
+			throw std::runtime_error(std::string("failed to create ") + name + " pipeline!");
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t vertexKey = vertexInputKey(info);
+	auto vertexInput = this->vertexInputParts.find(vertexKey);
+	if (vertexInput == this->vertexInputParts.end())
+		vertexInput = this->vertexInputParts.emplace(vertexKey, this->createPart(info, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)).first;
+
+	uint64_t fragmentOutputKey = outputKey(info);
+	auto output = this->outputParts.find(fragmentOutputKey);
+	if (output == this->outputParts.end())
+		output = this->outputParts.emplace(fragmentOutputKey, this->createPart(info, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)).first;
+
+	VkPipeline preRasterization = this->createPart(info, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT);
+	VkPipeline fragment = this->createPart(info, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT);
+	this->shaderParts.push_back(preRasterization);
+	this->shaderParts.push_back(fragment);
+
+	std::vector<VkPipeline> parts = { vertexInput->second, preRasterization, fragment, output->second };
+	pipeline = this->link(parts, info.layout, false);
+
+	std::cout << "[PERF] - " << name << " pipeline compiled and fast-linked in " << millisecondsSince(start) << " ms\n";
+
+	// Linking with link time optimization costs about as much as a monolithic pipeline, but not on this thread
+	PendingLink pendingLink{ &pipeline, pipeline, name, {}, std::chrono::steady_clock::now() };
+	pendingLink.optimized = this->threadPool->submit([this, parts, layout = info.layout]() { return this->link(parts, layout, true); });
+	this->pending.push_back(std::move(pendingLink));
+}
+
+void
+PipelineLibrary::cancel(const VkPipeline& pipeline)
+{
+	for (auto it = this->pending.begin(); it != this->pending.end();)
+	{
+		if (it->target != &pipeline)
+		{
+			++it;
+			continue;
+		}
+
+		this->cancelled.push_back(std::move(it->optimized));
+		it = this->pending.erase(it);
+	}
+}
+
+void
+PipelineLibrary::poll(const std::function<void(VkPipeline)>& retire)
+{
+	// Never handed out, no frame can be using them
+	for (auto it = this->cancelled.begin(); it != this->cancelled.end();)
+	{
+		if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		vkDestroyPipeline(this->device, it->get(), this->allocator);
+		it = this->cancelled.erase(it);
+	}
+
+	for (auto it = this->pending.begin(); it != this->pending.end();)
+	{
+		if (it->optimized.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			++it;
+			continue;
+		}
+
+		VkPipeline optimized = it->optimized.get();
+
+		if (*it->target != it->fastLinked)
+		{
+			std::cout << "[WARN] - " << it->name << " pipeline was replaced without PipelineLibrary::cancel, optimized link dropped\n";
+			vkDestroyPipeline(this->device, optimized, this->allocator);
+			it = this->pending.erase(it);
+			continue;
+		}
+
+		retire(*it->target);
+		*it->target = optimized;
+
+		std::cout << "[PERF] - " << it->name << " pipeline optimized link swapped in after " << millisecondsSince(it->start) << " ms\n";
+		it = this->pending.erase(it);
+	}
+}
+
+VkPipeline
+PipelineLibrary::createPart(const VkGraphicsPipelineCreateInfo& info, VkGraphicsPipelineLibraryFlagsEXT part)
+{
+	// Same pNext as the monolithic pipeline, the rendering formats are part of the pre-rasterization, fragment and output state
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryInfo.pNext = const_cast<void*>(info.pNext);
+	libraryInfo.flags = part;
+
+	VkGraphicsPipelineCreateInfo partInfo{};
+	partInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	partInfo.pNext = &libraryInfo;
+	partInfo.flags = info.flags | PART_FLAGS;
+	partInfo.pDynamicState = info.pDynamicState;
+
+	std::vector<VkPipelineShaderStageCreateInfo> stages;
+
+	switch (part)
+	{
+	case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+		partInfo.pVertexInputState = info.pVertexInputState;
+		partInfo.pInputAssemblyState = info.pInputAssemblyState;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+		for (uint32_t i = 0; i < info.stageCount; i++)
+		{
+			if (info.pStages[i].stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+				stages.push_back(info.pStages[i]);
+		}
+		partInfo.pViewportState = info.pViewportState;
+		partInfo.pRasterizationState = info.pRasterizationState;
+		partInfo.pTessellationState = info.pTessellationState;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+		for (uint32_t i = 0; i < info.stageCount; i++)
+		{
+			if (info.pStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+				stages.push_back(info.pStages[i]);
+		}
+		partInfo.pDepthStencilState = info.pDepthStencilState;
+		partInfo.pMultisampleState = info.pMultisampleState;
+		break;
+	default:
+		partInfo.pColorBlendState = info.pColorBlendState;
+		partInfo.pMultisampleState = info.pMultisampleState;
+		break;
+	}
+
+	partInfo.stageCount = static_cast<uint32_t>(stages.size());
+	partInfo.pStages = stages.data();
+
+	// Everything but the vertex input interface depends on the layout and the render pass (or rendering formats)
+	if (part != VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+	{
+		partInfo.layout = part != VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT ? info.layout : VK_NULL_HANDLE;
+		partInfo.renderPass = info.renderPass;
+		partInfo.subpass = info.subpass;
+	}
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &partInfo, this->allocator, &pipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to create graphics pipeline library!");
+
+	return pipeline;
+}
+
+VkPipeline
+PipelineLibrary::link(const std::vector<VkPipeline>& parts, VkPipelineLayout layout, bool optimize) const
+{
+	VkPipelineLibraryCreateInfoKHR libraries{};
+	libraries.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraries.libraryCount = static_cast<uint32_t>(parts.size());
+	libraries.pLibraries = parts.data();
+
+	VkGraphicsPipelineCreateInfo linkInfo{};
+	linkInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	linkInfo.pNext = &libraries;
+	linkInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	linkInfo.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vkCreateGraphicsPipelines(this->device, VK_NULL_HANDLE, 1, &linkInfo, this->allocator, &pipeline) != VK_SUCCESS)
+		throw std::runtime_error("failed to link graphics pipeline!");
+
+	return pipeline;
+}
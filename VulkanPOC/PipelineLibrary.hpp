@@ -0,0 +1,66 @@
+#pragma once
+
+#include "engine_lib.h"
+#include "ThreadPool.hpp"
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Graphics pipeline creation through VK_EXT_graphics_pipeline_library: a pipeline is compiled as its four parts
+// (vertex input, pre-rasterization shaders, fragment shader, fragment output) and fast-linked, which is cheap enough
+// to do on first use. The interface parts are shared by every pipeline with the same state, so a new permutation only
+// compiles its shaders. A link-time optimized pipeline is built on the thread pool and swapped in by poll().
+// Without the extension createPipeline builds a monolithic pipeline and nothing is swapped.
+class PipelineLibrary {
+public:
+	// enabled = the device has the graphicsPipelineLibrary feature enabled. The optimized links use allocator on the workers.
+	void create(VkDevice device, ThreadPool* threadPool, bool enabled, const VkAllocationCallbacks* allocator = nullptr);
+	// Waits for the optimized links still in flight. The pipelines handed out stay owned by the caller.
+	void destroy();
+
+	bool isEnabled() const { return this->enabled; }
+
+	// Creates the pipeline info describes into pipeline. info.pNext may only chain VkPipelineRenderingCreateInfoKHR and
+	// the shader modules may be destroyed once this returns. With the library pipeline is later replaced by poll(), so
+	// it has to stay at the same address until then, or be cancel()ed first.
+	void createPipeline(const VkGraphicsPipelineCreateInfo& info, const char* name, VkPipeline& pipeline);
+	// Before destroying, replacing or moving a pipeline createPipeline made: its optimized link is dropped instead of
+	// swapped in. Nothing to do for pipelines that were already swapped, or without the library.
+	void cancel(const VkPipeline& pipeline);
+
+	// Swaps in the optimized pipelines that finished. The fast-linked ones they replace are passed to retire, which
+	// destroys them once no frame in flight uses them anymore. A pipeline that no longer holds its fast link (replaced
+	// without cancel) keeps what the caller put there.
+	void poll(const std::function<void(VkPipeline)>& retire);
+
+private:
+	struct PendingLink {
+		VkPipeline* target;
+		// What createPipeline wrote to target, the swap only happens while it is still there
+		VkPipeline fastLinked;
+		std::string name;
+		std::future<VkPipeline> optimized;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	VkPipeline createPart(const VkGraphicsPipelineCreateInfo& info, VkGraphicsPipelineLibraryFlagsEXT part);
+	VkPipeline link(const std::vector<VkPipeline>& parts, VkPipelineLayout layout, bool optimize) const;
+
+	VkDevice device = VK_NULL_HANDLE;
+	ThreadPool* threadPool = nullptr;
+	const VkAllocationCallbacks* allocator = nullptr;
+	bool enabled = false;
+
+	// Interface parts by a hash of their state
+	std::unordered_map<uint64_t, VkPipeline> vertexInputParts;
+	std::unordered_map<uint64_t, VkPipeline> outputParts;
+	// Shader parts, kept for the optimized links (and simply until destroy)
+	std::vector<VkPipeline> shaderParts;
+	std::vector<PendingLink> pending;
+	// Optimized links nobody wants anymore, destroyed once they finish
+	std::vector<std::future<VkPipeline>> cancelled;
+};
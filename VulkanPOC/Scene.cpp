@@ -0,0 +1,310 @@
+#include "Scene.hpp"
+
+uint32_t
+Scene::findOrCreateArchetype(ComponentMask mask)
+{
+	for (uint32_t i = 0; i < this->archetypes.size(); i++)
+	{
+		if (this->archetypes[i].mask == mask)
+			return i;
+	}
+
+	this->archetypes.push_back({ mask, {} });
+	return static_cast<uint32_t>(this->archetypes.size() - 1);
+}
+
+SceneChunk&
+Scene::allocateRow(Archetype& archetype, uint32_t& chunkIndex, uint32_t& row)
+{
+	// Rows are kept packed by swap-remove, so only the last chunk can have room
+	if (archetype.chunks.empty() || archetype.chunks.back()->count == SceneChunk::CAPACITY)
+	{
+		auto chunk = std::make_unique<SceneChunk>();
+		chunk->mask = archetype.mask;
+		chunk->gpuSlotBase = this->nextGpuSlot;
+
+		if (archetype.mask & COMPONENT_TRANSFORM)
+		{
+			chunk->transforms.resize(SceneChunk::CAPACITY);
+			this->nextGpuSlot += SceneChunk::CAPACITY;
+		}
+		if (archetype.mask & COMPONENT_MESH)
+			chunk->meshes.resize(SceneChunk::CAPACITY);
+		if (archetype.mask & COMPONENT_MATERIAL)
+			chunk->materials.resize(SceneChunk::CAPACITY);
+		if (archetype.mask & COMPONENT_BOUNDS)
+			chunk->bounds.resize(SceneChunk::CAPACITY);
+
+		chunk->entityIndices.resize(SceneChunk::CAPACITY);
+
+		archetype.chunks.push_back(std::move(chunk));
+	}
+
+	chunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+	SceneChunk& chunk = *archetype.chunks.back();
+	row = chunk.count++;
+
+	return chunk;
+}
+
+Entity
+Scene::createEntity(ComponentMask mask)
+{
+	uint32_t index;
+
+	if (!this->freeIndices.empty())
+	{
+		index = this->freeIndices.back();
+		this->freeIndices.pop_back();
+	}
+	else
+	{
+		index = static_cast<uint32_t>(this->records.size());
+		this->records.emplace_back();
+	}
+
+	EntityRecord& record = this->records[index];
+	record.archetype = this->findOrCreateArchetype(mask);
+	record.alive = true;
+
+	SceneChunk& chunk = this->allocateRow(this->archetypes[record.archetype], record.chunk, record.row);
+	chunk.entityIndices[record.row] = index;
+
+	if (mask & COMPONENT_TRANSFORM)
+	{
+		chunk.transforms[record.row] = Transform{ { 0.0f, 0.0f, 0.0f }, 1.0f, { 0.0f, 0.0f, 0.0f, 1.0f } };
+		chunk.markDirty(record.row);
+	}
+	if (mask & COMPONENT_MESH)
+		chunk.meshes[record.row] = MeshRef{};
+	if (mask & COMPONENT_MATERIAL)
+		chunk.materials[record.row] = MaterialRef{};
+	if (mask & COMPONENT_BOUNDS)
+		chunk.bounds[record.row] = Bounds{};
+
+	this->aliveCount++;
+
+	return { index, record.generation };
+}
+
+void
+Scene::destroyEntity(Entity entity)
+{
+	const EntityRecord& record = this->getRecord(entity);
+	Archetype& archetype = this->archetypes[record.archetype];
+
+	SceneChunk& hole = *archetype.chunks[record.chunk];
+	uint32_t holeRow = record.row;
+
+	// Swap-remove: the archetype's last row moves into the hole so every chunk stays packed
+	uint32_t lastChunkIndex = static_cast<uint32_t>(archetype.chunks.size() - 1);
+	while (lastChunkIndex > 0 && archetype.chunks[lastChunkIndex]->count == 0)
+	{
+		lastChunkIndex--;
+	}
+
+	SceneChunk& last = *archetype.chunks[lastChunkIndex];
+	uint32_t lastRow = last.count - 1;
+
+	if (&last != &hole || lastRow != holeRow)
+	{
+		if (archetype.mask & COMPONENT_TRANSFORM)
+		{
+			hole.transforms[holeRow] = last.transforms[lastRow];
+			hole.markDirty(holeRow);
+		}
+		if (archetype.mask & COMPONENT_MESH)
+			hole.meshes[holeRow] = last.meshes[lastRow];
+		if (archetype.mask & COMPONENT_MATERIAL)
+			hole.materials[holeRow] = last.materials[lastRow];
+		if (archetype.mask & COMPONENT_BOUNDS)
+			hole.bounds[holeRow] = last.bounds[lastRow];
+
+		uint32_t movedIndex = last.entityIndices[lastRow];
+		hole.entityIndices[holeRow] = movedIndex;
+		this->records[movedIndex].chunk = record.chunk;
+		this->records[movedIndex].row = holeRow;
+	}
+
+	// The vacated slot keeps whatever the GPU had, nothing draws past count so it needs no upload
+	last.dirty[lastRow / 64] &= ~(1ull << (lastRow % 64));
+	last.count--;
+
+	EntityRecord& dead = this->records[entity.index];
+	dead.alive = false;
+	dead.generation++;
+	this->freeIndices.push_back(entity.index);
+	this->aliveCount--;
+}
+
+bool
+Scene::isAlive(Entity entity) const
+{
+	return entity.index < this->records.size() &&
+		this->records[entity.index].alive &&
+		this->records[entity.index].generation == entity.generation;
+}
+
+const Scene::EntityRecord&
+Scene::getRecord(Entity entity) const
+{
+	if (!this->isAlive(entity))
+		throw std::runtime_error("stale or invalid entity handle!");
+
+	return this->records[entity.index];
+}
+
+SceneChunk&
+Scene::getChunk(const EntityRecord& record)
+{
+	return *this->archetypes[record.archetype].chunks[record.chunk];
+}
+
+ComponentMask
+Scene::getMask(Entity entity) const
+{
+	return this->archetypes[this->getRecord(entity).archetype].mask;
+}
+
+const Transform&
+Scene::getTransform(Entity entity) const
+{
+	const EntityRecord& record = this->getRecord(entity);
+	const SceneChunk& chunk = *this->archetypes[record.archetype].chunks[record.chunk];
+
+	if (!(chunk.mask & COMPONENT_TRANSFORM))
+		throw std::runtime_error("entity has no transform component!");
+
+	return chunk.transforms[record.row];
+}
+
+Transform&
+Scene::editTransform(Entity entity)
+{
+	const EntityRecord& record = this->getRecord(entity);
+	SceneChunk& chunk = this->getChunk(record);
+
+	if (!(chunk.mask & COMPONENT_TRANSFORM))
+		throw std::runtime_error("entity has no transform component!");
+
+	chunk.markDirty(record.row);
+	return chunk.transforms[record.row];
+}
+
+MeshRef&
+Scene::getMesh(Entity entity)
+{
+	const EntityRecord& record = this->getRecord(entity);
+	SceneChunk& chunk = this->getChunk(record);
+
+	if (!(chunk.mask & COMPONENT_MESH))
+		throw std::runtime_error("entity has no mesh component!");
+
+	return chunk.meshes[record.row];
+}
+
+MaterialRef&
+Scene::getMaterial(Entity entity)
+{
+	const EntityRecord& record = this->getRecord(entity);
+	SceneChunk& chunk = this->getChunk(record);
+
+	if (!(chunk.mask & COMPONENT_MATERIAL))
+		throw std::runtime_error("entity has no material component!");
+
+	return chunk.materials[record.row];
+}
+
+Bounds&
+Scene::getBounds(Entity entity)
+{
+	const EntityRecord& record = this->getRecord(entity);
+	SceneChunk& chunk = this->getChunk(record);
+
+	if (!(chunk.mask & COMPONENT_BOUNDS))
+		throw std::runtime_error("entity has no bounds component!");
+
+	return chunk.bounds[record.row];
+}
+
+void
+Scene::forEachChunk(ComponentMask required, const std::function<void(SceneChunk&)>& visit)
+{
+	for (auto& archetype : this->archetypes)
+	{
+		if ((archetype.mask & required) != required)
+			continue;
+
+		for (auto& chunk : archetype.chunks)
+		{
+			if (chunk->count > 0)
+				visit(*chunk);
+		}
+	}
+}
+
+void
+Scene::parallelForEachChunk(ThreadPool& pool, ComponentMask required, const std::function<void(SceneChunk&)>& visit)
+{
+	std::vector<SceneChunk*> matching;
+
+	this->forEachChunk(required, [&matching](SceneChunk& chunk) { matching.push_back(&chunk); });
+
+	pool.parallelFor(matching.size(), [&matching, &visit](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			visit(*matching[i]);
+		}
+	});
+}
+
+void
+Scene::consumeDirtyTransforms(const std::function<void(uint32_t firstSlot, const Transform* data, uint32_t count)>& upload)
+{
+	this->forEachChunk(COMPONENT_TRANSFORM, [&upload](SceneChunk& chunk) {
+		if (!chunk.anyDirty)
+			return;
+
+		uint32_t runStart = 0;
+		uint32_t runLength = 0;
+
+		for (uint32_t word = 0; word < (chunk.count + 63) / 64; word++)
+		{
+			uint64_t bits = chunk.dirty[word];
+			chunk.dirty[word] = 0;
+
+			// Fast path for the common all-clean / all-dirty words
+			if (bits == 0 && runLength == 0)
+				continue;
+
+			for (uint32_t bit = 0; bit < 64; bit++)
+			{
+				uint32_t row = word * 64 + bit;
+				bool isDirty = row < chunk.count && (bits & (1ull << bit)) != 0;
+
+				if (isDirty)
+				{
+					if (runLength == 0)
+						runStart = row;
+					runLength++;
+				}
+				else if (runLength > 0)
+				{
+					upload(chunk.gpuSlotBase + runStart, &chunk.transforms[runStart], runLength);
+					runLength = 0;
+				}
+			}
+		}
+
+		if (runLength > 0)
+			upload(chunk.gpuSlotBase + runStart, &chunk.transforms[runStart], runLength);
+
+		chunk.anyDirty = false;
+	});
+}
+
+void
+Scene::markAllTransformsDirty()
+{
+	this->forEachChunk(COMPONENT_TRANSFORM, [](SceneChunk& chunk) { chunk.markAllDirty(); });
+}
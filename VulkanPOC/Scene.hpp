@@ -0,0 +1,135 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Laid out to match a std430 array in the shaders, the GPU builds the matrix itself
+struct Transform {
+	float position[3];
+	float scale;
+	float rotation[4]; // quaternion xyzw
+};
+
+struct MeshRef {
+	uint32_t meshIndex;
+};
+
+struct MaterialRef {
+	uint32_t materialIndex;
+};
+
+// Bounding sphere in world space
+struct Bounds {
+	float center[3];
+	float radius;
+};
+
+enum ComponentBits : uint32_t {
+	COMPONENT_TRANSFORM = 1 << 0,
+	COMPONENT_MESH = 1 << 1,
+	COMPONENT_MATERIAL = 1 << 2,
+	COMPONENT_BOUNDS = 1 << 3,
+};
+using ComponentMask = uint32_t;
+
+struct Entity {
+	uint32_t index;
+	uint32_t generation;
+};
+
+// Fixed-size block of entities sharing one archetype. Every component lives in its own contiguous
+// array (SoA), so a system touching only transforms streams through nothing but transforms.
+struct SceneChunk {
+	static constexpr uint32_t CAPACITY = 4096;
+
+	ComponentMask mask = 0;
+	uint32_t count = 0;
+	// First slot of this chunk in the GPU transform array, row r lives at gpuSlotBase + r
+	uint32_t gpuSlotBase = 0;
+
+	std::vector<Transform> transforms;
+	std::vector<MeshRef> meshes;
+	std::vector<MaterialRef> materials;
+	std::vector<Bounds> bounds;
+	std::vector<uint32_t> entityIndices;
+
+	// One bit per row, set when the transform changed since the last upload
+	std::array<uint64_t, CAPACITY / 64> dirty{};
+	bool anyDirty = false;
+
+	void markDirty(uint32_t row)
+	{
+		this->dirty[row / 64] |= 1ull << (row % 64);
+		this->anyDirty = true;
+	}
+
+	void markAllDirty()
+	{
+		for (uint32_t word = 0; word < (this->count + 63) / 64; word++)
+		{
+			this->dirty[word] = ~0ull;
+		}
+		this->anyDirty = this->count > 0;
+	}
+};
+
+// Archetype based entity-component store feeding the renderer
+class Scene {
+public:
+	Entity createEntity(ComponentMask mask);
+	void destroyEntity(Entity entity);
+	bool isAlive(Entity entity) const;
+	ComponentMask getMask(Entity entity) const;
+
+	const Transform& getTransform(Entity entity) const;
+	// Marks the transform dirty, it gets re-uploaded on the next frame
+	Transform& editTransform(Entity entity);
+	MeshRef& getMesh(Entity entity);
+	MaterialRef& getMaterial(Entity entity);
+	Bounds& getBounds(Entity entity);
+
+	// Visits every non-empty chunk whose archetype contains all of the required components.
+	// Callbacks that modify transforms must call chunk.markDirty(row) themselves.
+	void forEachChunk(ComponentMask required, const std::function<void(SceneChunk&)>& visit);
+	// Same, with chunks spread over the pool; each chunk is only ever seen by one thread
+	void parallelForEachChunk(ThreadPool& pool, ComponentMask required, const std::function<void(SceneChunk&)>& visit);
+
+	// Hands out every run of consecutive dirty transforms as (first GPU slot, data, count) and clears the bits
+	void consumeDirtyTransforms(const std::function<void(uint32_t firstSlot, const Transform* data, uint32_t count)>& upload);
+	void markAllTransformsDirty();
+
+	// Size the GPU transform array must have to hold every chunk's slot range
+	uint32_t getTransformSlotCount() const { return this->nextGpuSlot; }
+	size_t getEntityCount() const { return this->aliveCount; }
+
+private:
+	struct Archetype {
+		ComponentMask mask;
+		std::vector<std::unique_ptr<SceneChunk>> chunks;
+	};
+
+	struct EntityRecord {
+		uint32_t generation = 0;
+		uint32_t archetype = 0;
+		uint32_t chunk = 0;
+		uint32_t row = 0;
+		bool alive = false;
+	};
+
+	uint32_t findOrCreateArchetype(ComponentMask mask);
+	SceneChunk& allocateRow(Archetype& archetype, uint32_t& chunkIndex, uint32_t& row);
+	const EntityRecord& getRecord(Entity entity) const;
+	SceneChunk& getChunk(const EntityRecord& record);
+
+	std::vector<Archetype> archetypes;
+	std::vector<EntityRecord> records;
+	std::vector<uint32_t> freeIndices;
+	size_t aliveCount = 0;
+	uint32_t nextGpuSlot = 0;
+};
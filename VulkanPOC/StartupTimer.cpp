@@ -0,0 +1,44 @@
+#include "StartupTimer.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+void
+StartupTimer::record(const std::string& name, clock::time_point begin, clock::time_point end, bool async)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	this->phases.push_back({ name, this->sinceOrigin(begin), this->sinceOrigin(end), async });
+}
+
+std::vector<StartupPhase>
+StartupTimer::getPhases() const
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->phases;
+}
+
+void
+StartupTimer::firstFramePresented()
+{
+	if (this->hasPresentedFirstFrame())
+		return;
+
+	this->timeToFirstFrameMs = this->sinceOrigin(clock::now());
+
+	std::vector<StartupPhase> phases = this->getPhases();
+	std::sort(phases.begin(), phases.end(), [](const StartupPhase& a, const StartupPhase& b) { return a.beginMs < b.beginMs; });
+
+	std::cout << std::fixed << std::setprecision(2);
+
+	for (const auto& phase : phases)
+	{
+		std::cout << "[PERF] - startup " << std::setw(8) << phase.beginMs << " ms  " << std::setw(8) << phase.endMs - phase.beginMs
+			<< " ms  " << phase.name << (phase.async ? " (async)" : "") << "\n";
+	}
+
+	std::cout << "[PERF] - time to first frame: " << this->timeToFirstFrameMs << " ms" << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "engine_lib.h"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+struct StartupPhase {
+	std::string name;
+	// Relative to the timer's origin (GameCore construction)
+	double beginMs;
+	double endMs;
+	// Ran on a worker, overlapping the phases around it
+	bool async;
+};
+
+// Wall clock breakdown of engine startup up to the first presented frame
+class StartupTimer {
+public:
+	using clock = std::chrono::steady_clock;
+
+	template<typename F>
+	void measure(const char* name, F&& step)
+	{
+		clock::time_point begin = clock::now();
+		step();
+		this->record(name, begin, clock::now(), false);
+	}
+
+	// Thread-safe, for phases that run on workers
+	void record(const std::string& name, clock::time_point begin, clock::time_point end, bool async);
+
+	// Only the first call counts, prints the breakdown
+	void firstFramePresented();
+
+	bool hasPresentedFirstFrame() const { return this->timeToFirstFrameMs >= 0.0; }
+	// -1 until the first frame was presented
+	double getTimeToFirstFrameMs() const { return this->timeToFirstFrameMs; }
+	std::vector<StartupPhase> getPhases() const;
+
+private:
+	double sinceOrigin(clock::time_point time) const { return std::chrono::duration<double, std::milli>(time - this->origin).count(); }
+
+	clock::time_point origin = clock::now();
+	double timeToFirstFrameMs = -1.0;
+
+	mutable std::mutex mutex;
+	std::vector<StartupPhase> phases;
+};
@@ -0,0 +1,140 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	if (threadCount == 0)
+	{
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		this->workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+
+	this->wakeUp.notify_all();
+
+	for (auto& worker : this->workers)
+	{
+		worker.join();
+	}
+}
+
+void
+ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->tasks.push_back(std::move(task));
+	}
+
+	this->wakeUp.notify_one();
+}
+
+bool
+ThreadPool::runPendingTask()
+{
+	std::function<void()> task;
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+
+		if (this->tasks.empty())
+			return false;
+
+		task = std::move(this->tasks.front());
+		this->tasks.pop_front();
+	}
+
+	task();
+	return true;
+}
+
+void
+ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wakeUp.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+			// Drain what is queued before exiting so pending futures are never abandoned
+			if (this->tasks.empty())
+				return;
+
+			task = std::move(this->tasks.front());
+			this->tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+void
+ThreadPool::parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body, size_t minBatch)
+{
+	if (count == 0)
+		return;
+
+	size_t batchCount = std::min<size_t>(this->workers.size() + 1, (count + minBatch - 1) / std::max<size_t>(minBatch, 1));
+	size_t batchSize = (count + batchCount - 1) / batchCount;
+
+	std::vector<std::future<void>> pending;
+	pending.reserve(batchCount);
+
+	for (size_t begin = batchSize; begin < count; begin += batchSize)
+	{
+		size_t end = std::min(begin + batchSize, count);
+		pending.push_back(this->submit([&body, begin, end]() { body(begin, end); }));
+	}
+
+	// The batches reference body, so every one of them has to finish before an exception may leave this frame
+	std::exception_ptr error;
+
+	try
+	{
+		body(0, std::min(batchSize, count));
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	for (auto& future : pending)
+	{
+		// Help out instead of blocking, a worker waiting here could otherwise starve its own batches
+		while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			if (!this->runPendingTask())
+			{
+				future.wait();
+				break;
+			}
+		}
+
+		try
+		{
+			future.get();
+		}
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+
+	if (error)
+		std::rethrow_exception(error);
+}
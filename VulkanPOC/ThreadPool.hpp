@@ -0,0 +1,55 @@
+#pragma once
+
+// No engine_lib.h: the pool and the scene store also build into SceneBenchmark, which has no Vulkan / GLFW
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a single FIFO. Used for chunked scene iteration and any
+// other fan-out work that must not run on the render thread.
+class ThreadPool {
+public:
+	// 0 = one worker per hardware thread minus the calling (render) thread
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	template<typename F>
+	auto submit(F&& task) -> std::future<decltype(task())>
+	{
+		using Result = decltype(task());
+
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+		std::future<Result> future = packaged->get_future();
+
+		this->enqueue([packaged]() { (*packaged)(); });
+
+		return future;
+	}
+
+	// Splits [0, count) into batches of at least minBatch items, the calling thread works on one of them too.
+	// While waiting for the rest it runs queued tasks, so it is safe to call from a worker.
+	void parallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& body, size_t minBatch = 1);
+
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(this->workers.size()); }
+
+private:
+	void enqueue(std::function<void()> task);
+	bool runPendingTask();
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+};
@@ -1,14 +1,226 @@
 ﻿#include "engine_lib.h"
 
 #include "GameCore.hpp"
+#include "ParticleReference.hpp"
 
-int main() {
-   GameCore game;
+#include <algorithm>
+#include <chrono>
 
+// Golden run without a golden image, CTest reports it as skipped (SKIP_RETURN_CODE of the golden tests)
+static const int EXIT_SKIPPED = 77;
+
+static bool parsePresentMode(const std::string& name, VkPresentModeKHR& mode) {
+    if (name == "fifo") mode = VK_PRESENT_MODE_FIFO_KHR;
+    else if (name == "fifo-relaxed") mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    else if (name == "mailbox") mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    else if (name == "immediate") mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    else return false;
+
+    return true;
+}
+
+static EngineSettings parseArguments(int argc, char** argv) {
+    EngineSettings settings;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string value = arg.find('=') != std::string::npos ? arg.substr(arg.find('=') + 1) : "";
+
+        if (arg == "--no-dynamic-rendering")
+            settings.preferDynamicRendering = false;
+        else if (arg.rfind("--present-mode=", 0) == 0) {
+            if (!parsePresentMode(value, settings.present.presentMode))
+                throw std::invalid_argument("unknown present mode '" + value + "' (fifo, fifo-relaxed, mailbox, immediate)");
+        }
+        else if (arg.rfind("--swap-images=", 0) == 0)
+            settings.present.imageCount = static_cast<uint32_t>(std::stoul(value));
+        else if (arg.rfind("--fps=", 0) == 0)
+            settings.present.targetFps = std::stod(value);
+        else if (arg == "--low-latency")
+            settings.lowLatency = true;
+        else if (arg.rfind("--assets=", 0) == 0)
+            settings.assetArchive = value;
+        else if (arg == "--track-host-allocations")
+            settings.trackHostAllocations = true;
+        else if (arg.rfind("--device=", 0) == 0)
+            settings.device.deviceOverride = value;
+        else if (arg == "--verbose")
+        {
+            settings.verboseStartup = true;
+            settings.debugMessageSeverities |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+        }
+        else if (arg.rfind("--particles=", 0) == 0)
+            settings.particleCapacity = static_cast<uint32_t>(std::stoul(value));
+        else if (arg.rfind("--particle-reference=", 0) == 0)
+            continue; // handled in main, no window needed
+        else if (arg.rfind("--particle-check=", 0) == 0)
+            settings.particleCheckSteps = static_cast<uint32_t>(std::stoul(value));
+        else if (arg.rfind("--capture=", 0) == 0) {
+            settings.capture.enabled = true;
+            settings.capture.directory = value;
+        }
+        else if (arg == "--capture-raw")
+            settings.capture.png = false;
+        else if (arg.rfind("--capture-frames=", 0) == 0)
+            settings.capture.frameLimit = static_cast<uint32_t>(std::stoul(value));
+        else if (arg.rfind("--golden=", 0) == 0)
+            settings.golden.directory = value;
+        else if (arg.rfind("--golden-scene=", 0) == 0) {
+            if (value != "default" && value != "particles")
+                throw std::invalid_argument("unknown golden scene '" + value + "' (default, particles)");
+            settings.golden.scene = value;
+        }
+        else if (arg == "--golden-update")
+            settings.golden.update = true;
+        else if (arg.rfind("--golden-threshold=", 0) == 0)
+            settings.golden.tolerance.frameTimeThreshold = std::stod(value);
+        else if (arg == "--no-pipeline-stats")
+            settings.pipelineStatistics = false;
+        else if (arg == "--no-occlusion-culling")
+            settings.occlusionCulling = false;
+        else if (arg == "--no-meshlets")
+            settings.meshletRendering = false;
+        else if (arg == "--no-mesh-shaders")
+            settings.preferMeshShaders = false;
+        else if (arg == "--no-command-cache")
+            settings.cacheCommandBuffers = false;
+        else if (arg == "--no-pipeline-library")
+            settings.pipelineLibrary = false;
+        else if (arg.rfind("--mirror-windows=", 0) == 0)
+            settings.mirrorWindows = static_cast<uint32_t>(std::stoul(value));
+        else if (arg.rfind("--metrics-port=", 0) == 0) {
+            unsigned long port = std::stoul(value);
+            if (port > 65535)
+                throw std::invalid_argument("metrics port '" + value + "' out of range (0-65535)");
+            settings.metricsPort = static_cast<uint16_t>(port);
+        }
+        else if (arg == "--dynamic-resolution")
+            settings.dynamicResolution.enabled = true;
+        else if (arg.rfind("--dynamic-resolution=", 0) == 0) {
+            settings.dynamicResolution.enabled = true;
+            settings.dynamicResolution.gpuBudgetMs = std::stod(value);
+        }
+        else if (arg.rfind("--min-render-scale=", 0) == 0)
+            settings.dynamicResolution.minScale = std::stof(value);
+        else if (arg.rfind("--mesh=", 0) == 0 || arg.rfind("--mesh-grid=", 0) == 0)
+            continue; // handled in main, needs the device
+        else if (arg == "--no-perf-warnings")
+            settings.debugMessageTypes &= ~VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT;
+        else
+            throw std::invalid_argument("unknown argument '" + arg + "'");
+    }
+
+    return settings;
+}
+
+// Runs the CPU particle reference for 10 simulated seconds at steady state, for hosts without a GPU
+static void runParticleReference(uint32_t capacity) {
+    ParticleReference reference(capacity);
+    ParticleEmitter emitter;
+    const float gravity[3] = { 0.0f, 1.5f, 0.0f };
+    const float dt = 1.0f / 60.0f;
+    const uint32_t steps = 600;
+
+    // Emit at the rate that keeps the pool about full for the emitter's lifetime
+    emitter.rate = capacity / emitter.lifetime;
+    uint64_t particleSteps = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (uint32_t step = 0; step < steps; step++) {
+        reference.emit(emitter, static_cast<uint32_t>(emitter.rate * dt), step);
+        particleSteps += reference.getAliveCount();
+        reference.simulate(dt, gravity, 0.1f);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::cout << "[PERF] - particle reference: " << steps << " steps, " << reference.getAliveCount() << " alive, "
+        << seconds * 1e3 / steps << " ms/step, " << seconds * 1e9 / particleSteps << " ns/particle" << std::endl;
+}
+
+// Fills the scene with an N x N grid of one mesh and puts the camera at street level looking across it,
+// so most of the grid is hidden behind its first rows
+static void populateMeshGrid(GameCore& game, const std::string& path, uint32_t gridSize) {
+    uint32_t meshId = game.LoadMesh(path);
+    const GpuMesh& mesh = game.GetMesh(meshId);
+    Scene& scene = game.GetScene();
+
+    float spacing = std::max(mesh.boundsRadius, 0.01f) * 2.5f;
+    float half = spacing * (gridSize - 1) * 0.5f;
+
+    for (uint32_t z = 0; z < gridSize; z++) {
+        for (uint32_t x = 0; x < gridSize; x++) {
+            Entity entity = scene.createEntity(COMPONENT_TRANSFORM | COMPONENT_MESH | COMPONENT_BOUNDS);
+
+            Transform& transform = scene.editTransform(entity);
+            transform = { { x * spacing - half, 0.0f, z * spacing - half }, 1.0f, { 0.0f, 0.0f, 0.0f, 1.0f } };
+            scene.getMesh(entity).meshIndex = meshId;
+
+            Bounds& bounds = scene.getBounds(entity);
+            for (int axis = 0; axis < 3; axis++)
+                bounds.center[axis] = transform.position[axis] + mesh.boundsCenter[axis];
+            bounds.radius = mesh.boundsRadius;
+        }
+    }
+
+    Camera& camera = game.GetCamera();
+    float eyeHeight = mesh.boundsCenter[1];
+    camera.position[0] = 0.0f;
+    camera.position[1] = eyeHeight;
+    camera.position[2] = -half - spacing;
+    camera.target[0] = 0.0f;
+    camera.target[1] = eyeHeight;
+    camera.target[2] = half;
+    camera.farPlane = std::max(camera.farPlane, 4.0f * (half + spacing));
+
+    std::cout << "[INFO] - mesh grid: " << gridSize * gridSize << " instances of " << path << std::endl;
+}
+
+int main(int argc, char** argv) {
     try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--particle-reference=", 0) == 0) {
+                runParticleReference(static_cast<uint32_t>(std::stoul(arg.substr(arg.find('=') + 1))));
+                return EXIT_SUCCESS;
+            }
+        }
+
+        EngineSettings settings = parseArguments(argc, argv);
+        if (settings.particleCheckSteps > 0 && settings.particleCapacity == 0)
+            settings.particleCapacity = 65536;
+        // Golden scenes are fixed, the baselines must not depend on other flags: particles is the default scene plus an emitter
+        if (!settings.golden.directory.empty())
+            settings.particleCapacity = settings.golden.scene == "particles" ? 65536 : 0;
+
+        GameCore game(800, 600, settings);
+
+        // The check spawns its own seeded bursts, an emitter would add unseeded particles
+        if (settings.particleCapacity > 0 && settings.particleCheckSteps == 0)
+            game.GetParticles().addEmitter(ParticleEmitter{});
+
         game.Initialize();
 
+        std::string meshPath;
+        uint32_t meshGrid = 32;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--mesh=", 0) == 0)
+                meshPath = arg.substr(arg.find('=') + 1);
+            else if (arg.rfind("--mesh-grid=", 0) == 0)
+                meshGrid = static_cast<uint32_t>(std::stoul(arg.substr(arg.find('=') + 1)));
+        }
+
+        if (!meshPath.empty())
+            populateMeshGrid(game, meshPath, meshGrid);
+
         game.Run();
+
+        if (!settings.golden.directory.empty() && game.GoldenSkipped())
+            return EXIT_SKIPPED;
+        if (!settings.golden.directory.empty() && !game.GoldenPassed())
+            return EXIT_FAILURE;
+        if (settings.particleCheckSteps > 0 && !game.ParticleCheckPassed())
+            return EXIT_FAILURE;
     }
     catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -1,3 +1,16 @@
 %TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe shader.vert -o vert.spv
 %TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe shader.frag -o frag.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe particle_emit.comp -o particle_emit.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe particle_simulate.comp -o particle_simulate.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe particle_args.comp -o particle_args.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe particle.vert -o particle_vert.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe particle.frag -o particle_frag.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe mesh.vert -o mesh_vert.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe mesh.frag -o mesh_frag.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe hiz_reduce.comp -o hiz_reduce.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe hiz_cull.comp -o hiz_cull.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe meshlet_cull.comp -o meshlet_cull.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe meshlet.vert -o meshlet_vert.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe --target-spv=spv1.4 meshlet.task -o meshlet_task.spv
+%TOOLKIT_ROOT%/VulkanSDK/1.2.176.1/Bin32/glslc.exe --target-spv=spv1.4 meshlet.mesh -o meshlet_mesh.spv
 pause
\ No newline at end of file
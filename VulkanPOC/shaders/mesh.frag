@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 light = normalize(vec3(0.4, 1.0, -0.3));
+    float diffuse = max(dot(normalize(fragNormal), light), 0.0);
+    outColor = vec4(vec3(0.15 + 0.85 * diffuse), 1.0);
+}
@@ -0,0 +1,32 @@
+#version 450
+
+// Matches Transform in Scene.hpp
+struct Transform {
+    vec4 positionScale;
+    vec4 rotation; // quaternion xyzw
+};
+
+layout(std430, binding = 0) readonly buffer Transforms { Transform transforms[]; };
+
+layout(push_constant) uniform Push {
+    mat4 viewProjection;
+} pc;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUv;
+
+layout(location = 0) out vec3 fragNormal;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// firstInstance carries the scene transform slot, one instance per draw
+void main() {
+    Transform transform = transforms[gl_InstanceIndex];
+    vec3 world = rotate(transform.rotation, inPosition * transform.positionScale.w) + transform.positionScale.xyz;
+
+    gl_Position = pc.viewProjection * vec4(world, 1.0);
+    fragNormal = rotate(transform.rotation, inNormal);
+}
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define DRAWS_ACCESS readonly
+#include "meshlet_common.glsl"
+
+layout(location = 0) out vec3 fragNormal;
+
+// Vertex pulling: one instance per visible meshlet, MESHLET_MAX_TRIANGLES * 3 vertices each.
+// Vertices past the meshlet's last triangle collapse onto a point outside the clip volume.
+void main() {
+    uint corner = uint(gl_VertexIndex);
+    uvec2 draw = draws[pc.firstDraw + uint(gl_InstanceIndex)];
+    Meshlet meshlet = meshlets[draw.y];
+
+    if (corner >= meshlet.triangleCount * 3) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        fragNormal = vec3(0.0);
+        return;
+    }
+
+    uint local = meshletTriangleIndex(meshlet.triangleOffset + corner);
+    uint index = meshletVertices[meshlet.vertexOffset + local];
+    Transform transform = transforms[draw.x];
+
+    vec3 world = rotate(transform.rotation, vertexPosition(index) * transform.positionScale.w) + transform.positionScale.xyz;
+    gl_Position = pc.viewProjection * vec4(world, 1.0);
+    fragNormal = rotate(transform.rotation, vertexNormal(index));
+}
@@ -0,0 +1,104 @@
+// Shared by the meshlet cull, vertex, task and mesh shaders, see MeshletRenderer.hpp
+
+// Matches Transform in Scene.hpp
+struct Transform {
+    vec4 positionScale;
+    vec4 rotation; // quaternion xyzw
+};
+
+// Matches CullCandidate in HiZCulling.hpp
+struct Candidate {
+    vec4 sphere;
+    uint firstIndex;
+    uint indexCount;
+    uint transformSlot;
+    uint drawIndex;
+};
+
+// Matches Meshlet in MeshFormat.hpp
+struct Meshlet {
+    uint vertexOffset;
+    uint triangleOffset;
+    uint vertexCount;
+    uint triangleCount;
+    vec3 center;
+    float radius;
+    vec3 coneAxis;
+    float coneCutoff;
+};
+
+struct DrawCommand {
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+};
+
+// Vertex stage storage buffers must be read only without the vertexPipelineStoresAndAtomics feature
+#ifndef DRAWS_ACCESS
+#define DRAWS_ACCESS
+#endif
+
+// Set 0: per frame
+layout(std430, set = 0, binding = 0) readonly buffer Transforms { Transform transforms[]; };
+layout(std430, set = 0, binding = 1) readonly buffer Candidates { Candidate candidates[]; };
+// (transform slot, meshlet) of every meshlet that survived the cull, compute path only
+layout(std430, set = 0, binding = 2) DRAWS_ACCESS buffer Draws { uvec2 draws[]; };
+layout(std430, set = 0, binding = 3) buffer Commands { DrawCommand commands[]; };
+
+// Set 1: per mesh
+layout(std430, set = 1, binding = 0) readonly buffer Meshlets { Meshlet meshlets[]; };
+layout(std430, set = 1, binding = 1) readonly buffer MeshletVertices { uint meshletVertices[]; };
+// Three 8 bit meshlet local vertex indices per triangle, packed four to a uint
+layout(std430, set = 1, binding = 2) readonly buffer MeshletTriangles { uint meshletTriangles[]; };
+// MeshVertex: position xyz, normal xyz, uv
+layout(std430, set = 1, binding = 3) readonly buffer Vertices { float vertices[]; };
+
+layout(push_constant) uniform Push {
+    mat4 viewProjection;
+    vec3 cameraPosition;
+    uint meshletCount;
+    uint firstCandidate;
+    uint candidateCount;
+    uint firstDraw;
+    uint commandIndex;
+} pc;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Byte offset into the triangle blob -> meshlet local vertex index
+uint meshletTriangleIndex(uint byteOffset) {
+    return (meshletTriangles[byteOffset >> 2] >> ((byteOffset & 3u) * 8u)) & 0xFFu;
+}
+
+vec3 vertexPosition(uint index) {
+    return vec3(vertices[index * 8], vertices[index * 8 + 1], vertices[index * 8 + 2]);
+}
+
+vec3 vertexNormal(uint index) {
+    return vec3(vertices[index * 8 + 3], vertices[index * 8 + 4], vertices[index * 8 + 5]);
+}
+
+// Frustum test of the bounding sphere plus the normal cone test: a meshlet whose triangles all face away
+// from the camera is dropped before any of its vertices are transformed
+bool meshletVisible(uint meshletIndex, Transform transform) {
+    Meshlet meshlet = meshlets[meshletIndex];
+    float scale = transform.positionScale.w;
+    vec3 center = rotate(transform.rotation, meshlet.center * scale) + transform.positionScale.xyz;
+    float radius = meshlet.radius * abs(scale);
+
+    // Planes straight from the rows of the view projection matrix (0..1 depth)
+    mat4 m = transpose(pc.viewProjection);
+    vec4 planes[6] = vec4[6](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+
+    for (int i = 0; i < 6; i++) {
+        if (dot(planes[i].xyz, center) + planes[i].w < -radius * length(planes[i].xyz))
+            return false;
+    }
+
+    vec3 axis = rotate(transform.rotation, meshlet.coneAxis);
+    vec3 toCenter = center - pc.cameraPosition;
+    return dot(toCenter, axis) < meshlet.coneCutoff * length(toCenter) + radius;
+}
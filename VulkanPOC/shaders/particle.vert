@@ -0,0 +1,23 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "particle_common.glsl"
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+// One instance per alive particle, pulled from the list the simulation just wrote
+void main() {
+    Particle particle = particles[alive[pc.list * pc.capacity + gl_InstanceIndex]];
+    vec2 corner = corners[gl_VertexIndex];
+
+    // No camera yet, particles live in normalized device coordinates
+    gl_Position = vec4(particle.position.xy + corner * particle.size, 0.0, 1.0);
+    fragColor = vec4(particle.color.rgb, particle.color.a * clamp(particle.life, 0.0, 1.0));
+    fragCorner = corner;
+}
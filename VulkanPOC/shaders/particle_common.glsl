@@ -0,0 +1,53 @@
+// Shared by the particle shaders, must stay in sync with ParticleFormat.hpp
+
+struct Particle {
+    vec3 position;
+    float life;
+    vec3 velocity;
+    float size;
+    vec4 color;
+};
+
+layout(std430, set = 0, binding = 0) buffer Particles {
+    Particle particles[];
+};
+
+// Two alive lists of `capacity` entries each, list N starts at N * capacity
+layout(std430, set = 0, binding = 1) buffer AliveLists {
+    uint alive[];
+};
+
+layout(std430, set = 0, binding = 2) buffer DeadList {
+    uint dead[];
+};
+
+layout(std430, set = 0, binding = 3) buffer Counters {
+    uint aliveCount[2];
+    int deadCount;
+    uint reserved;
+    uvec4 simulateDispatch;
+    uvec4 drawArguments;
+} counters;
+
+layout(push_constant) uniform Push {
+    vec4 position;
+    vec4 velocity;
+    vec4 color;
+    vec4 lifetime;
+    vec4 gravity;
+    uint emitCount;
+    uint seed;
+    uint capacity;
+    uint list;
+    uint mode;
+} pc;
+
+uint randomNext(inout uint state) {
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random01(inout uint state) {
+    return float(randomNext(state) >> 8) * (1.0 / 16777216.0);
+}